@@ -6,7 +6,9 @@
 namespace Halley
 {
 	class ResourceLoader;
-	class VorbisData;
+	class AudioClipStreamer;
+	class AudioClipStreamerPool;
+	class AudioClipChunks;
 
 	class IAudioClip
 	{
@@ -18,6 +20,14 @@ namespace Halley
 		virtual size_t getLength() const = 0; // in samples
 		virtual size_t getLoopPoint() const { return 0; } // in samples
 		virtual bool isLoaded() const { return true; }
+
+		// Clips decoded while they play hand a streamer to each playback, which is read instead of copyChannelData.
+		// Streamers are primed ahead of time, so this never allocates; it returns null if the next one isn't ready yet.
+		virtual bool isStreaming() const { return false; }
+		virtual std::shared_ptr<AudioClipStreamer> takeStreamer() const { return {}; }
+
+		// Called before a playback starting at pos, until it returns true, so the data there is ready by the time it's mixed
+		virtual bool prefetch(size_t pos) const { return true; }
 	};
 
 	class AudioClip : public AsyncResource, public IAudioClip
@@ -36,6 +46,16 @@ namespace Halley
 		size_t getLength() const override; // in samples
 		size_t getLoopPoint() const override; // in samples
 		bool isLoaded() const override;
+		bool isStreaming() const override;
+		std::shared_ptr<AudioClipStreamer> takeStreamer() const override;
+		bool prefetch(size_t pos) const override;
+
+		// Non-streaming clips longer than this (in samples per channel) are kept compressed in memory, and decoded in chunks as they play.
+		// Can be overridden per clip with the "keepCompressed" metadata.
+		static void setCompressedLengthThreshold(size_t samples);
+
+		// Memory budget for decoded chunks of compressed clips, shared by all of them
+		static void setDecodedChunkBudget(size_t bytes);
 
 		static std::shared_ptr<AudioClip> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::AudioClip; }
@@ -45,14 +65,13 @@ namespace Halley
 		size_t sampleLength = 0;
 		size_t numChannels = 0;
 		size_t loopPoint = 0;
-		mutable size_t streamPos = 0;
 		bool streaming = false;
 
-		// TODO: sort this mess?
-		mutable std::vector<std::vector<AudioConfig::SampleFormat>> temp0;
-		mutable std::vector<std::vector<AudioConfig::SampleFormat>> temp1;
-		mutable std::vector<std::vector<AudioConfig::SampleFormat>> samples;
-		mutable std::unique_ptr<VorbisData> vorbisData;
+		std::vector<std::vector<AudioConfig::SampleFormat>> samples;
+		std::shared_ptr<ResourceDataStream> streamData;
+		std::shared_ptr<AudioClipStreamerPool> streamers;
+		mutable std::shared_ptr<AudioClipStreamer> directStreamer; // Only used by copyChannelData
+		std::shared_ptr<AudioClipChunks> chunks;
 	};
 
 	class StreamingAudioClip : public IAudioClip
@@ -84,5 +84,6 @@ namespace Halley
 		float delay = 0.0f;
 		float minimumSpace = 0.0f;
 		bool loop = false;
+		int priority = 0;
 	};
 }
@@ -45,6 +45,7 @@ namespace Halley {
 		void setGroupVolume(const String& groupName, float volume = 1.0f) override;
 
 	    void setOutputChannels(std::vector<AudioChannelData> audioChannelData) override;
+	    void setMaxVoices(size_t maxVoices) override;
 	    void setListener(AudioListenerData listener) override;
 
 		void onAudioException(std::exception& e);
@@ -0,0 +1,59 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <vector>
+#include "halley/core/api/audio_api.h"
+#include "halley/utils/utils.h"
+#include "audio_position.h"
+
+namespace Halley
+{
+	class AudioEngine;
+	class AudioMixer;
+	class Path;
+
+	// Runs the audio engine without an output device, rendering a scripted sequence of events into memory as fast as possible.
+	// Useful for tests, benchmarks and bouncing sounds to disk. Output is always stereo.
+	// As with normal playback, an Executors instance must be set, as the engine starts a mix worker per CPU aux thread.
+	class AudioOfflineRenderer
+	{
+	public:
+		explicit AudioOfflineRenderer(int sampleRate = AudioConfig::sampleRate, int bufferSize = 512, std::unique_ptr<AudioMixer> mixer = {});
+		~AudioOfflineRenderer();
+
+		// Script actions, with time in seconds from the start of the render. They're applied at the start of the first buffer past that time.
+		void postEvent(float time, std::shared_ptr<const AudioEvent> event, AudioPosition position = AudioPosition::makeFixed());
+		void play(float time, std::shared_ptr<const IAudioClip> clip, AudioPosition position = AudioPosition::makeFixed(), float volume = 1.0f, bool loop = false);
+		void setListener(float time, AudioListenerData listener);
+		void setMaxVoices(float time, size_t maxVoices);
+
+		// Renders at least the given number of seconds, appending to the output. Returns the number of buffers generated.
+		size_t render(float duration);
+
+		size_t getNumberOfFrames() const;
+		int getSampleRate() const;
+		gsl::span<const AudioConfig::SampleFormat> getSamples() const; // Interleaved stereo
+		void clearSamples();
+
+		Bytes toWAV() const; // 32-bit float WAV
+		void saveWAV(const Path& path) const;
+
+	private:
+		struct Action
+		{
+			size_t frame;
+			std::function<void(AudioEngine&)> run;
+		};
+
+		std::unique_ptr<AudioEngine> engine;
+		std::unique_ptr<AudioOutputAPI> output;
+		std::vector<AudioConfig::SampleFormat> samples;
+		std::vector<Action> actions;
+		size_t nextAction = 0;
+		size_t framesRendered = 0;
+		size_t nextId = 0;
+		int sampleRate;
+
+		void addAction(float time, std::function<void(AudioEngine&)> action);
+	};
+}
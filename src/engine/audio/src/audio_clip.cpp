@@ -1,12 +1,18 @@
 #include "audio_clip.h"
 #include "halley/resources/resource_data.h"
 #include "vorbis_dec.h"
+#include "audio_clip_streamer.h"
+#include "audio_clip_chunks.h"
 #include "halley/resources/metadata.h"
 #include "halley/concurrency/concurrent.h"
 #include "halley/text/string_converter.h"
 
 using namespace Halley;
 
+namespace {
+	std::atomic<size_t> compressedLengthThreshold(10 * AudioConfig::sampleRate);
+}
+
 AudioClip::AudioClip(size_t numChannels)
 	: numChannels(numChannels)
 {
@@ -24,13 +30,13 @@ AudioClip& AudioClip::operator=(AudioClip&& other) noexcept
 	sampleLength = other.sampleLength;
 	numChannels = other.numChannels;
 	loopPoint = other.loopPoint;
-	streamPos = other.streamPos;
 	streaming = other.streaming;
 
-	temp0 = std::move(other.temp0);
-	temp1 = std::move(other.temp1);
 	samples = std::move(other.samples);
-	vorbisData = std::move(other.vorbisData);
+	streamData = std::move(other.streamData);
+	streamers = std::move(other.streamers);
+	directStreamer = std::move(other.directStreamer);
+	chunks = std::move(other.chunks);
 
 	doneLoading();
 
@@ -39,39 +45,50 @@ AudioClip& AudioClip::operator=(AudioClip&& other) noexcept
 
 void AudioClip::loadFromStatic(std::shared_ptr<ResourceDataStatic> data, Metadata metadata)
 {
-	VorbisData vorbis(data);
-	if (vorbis.getSampleRate() != AudioConfig::sampleRate) {
+	auto vorbis = std::make_unique<VorbisData>(data);
+	if (vorbis->getSampleRate() != AudioConfig::sampleRate) {
 		throw Exception("Sound clip should be " + toString(AudioConfig::sampleRate) + " Hz.", HalleyExceptions::AudioEngine);
 	}	
-	numChannels = vorbis.getNumChannels();
-	sampleLength = vorbis.getNumSamples();
+	numChannels = vorbis->getNumChannels();
+	sampleLength = vorbis->getNumSamples();
 	loopPoint = metadata.getInt("loopPoint", 0);
 	streaming = false;
 
-	samples.resize(numChannels);
-	for (size_t i = 0; i < numChannels; ++i) {
-		samples[i].resize(sampleLength);
+	if (metadata.getBool("keepCompressed", sampleLength > compressedLengthThreshold)) {
+		chunks = std::make_shared<AudioClipChunks>(std::move(vorbis));
+		AudioDecodeWorker::get().add(chunks);
+	} else {
+		samples.resize(numChannels);
+		for (size_t i = 0; i < numChannels; ++i) {
+			samples[i].resize(sampleLength);
+		}
+		vorbis->read(samples);
+		vorbis->close();
 	}
-	vorbis.read(samples);
-	vorbis.close();
 
 	doneLoading();
 }
 
 void AudioClip::loadFromStream(std::shared_ptr<ResourceDataStream> data, Metadata metadata)
 {
-	vorbisData = std::make_unique<VorbisData>(data);
-	size_t nChannels = vorbisData->getNumChannels();
+	auto vorbisData = std::make_unique<VorbisData>(data);
 	if (vorbisData->getSampleRate() != AudioConfig::sampleRate) {
 		throw Exception("Sound clip should be " + toString(AudioConfig::sampleRate) + " Hz.", HalleyExceptions::AudioEngine);
 	}
 	
-	samples.resize(nChannels);
-	numChannels = nChannels;
+	numChannels = vorbisData->getNumChannels();
 	sampleLength = vorbisData->getNumSamples();
+	vorbisData.reset();
+
 	loopPoint = metadata.getInt("loopPoint", 0);
-	streamPos = 0;
+	streamData = std::move(data);
 	streaming = true;
+
+	// Decode the start ahead of time, so playback can begin straight away
+	streamers = std::make_shared<AudioClipStreamerPool>(streamData, numChannels, sampleLength, loopPoint);
+	streamers->fill();
+	AudioDecodeWorker::get().add(streamers);
+
 	doneLoading();
 }
 
@@ -80,34 +97,12 @@ size_t AudioClip::copyChannelData(size_t channelN, size_t pos, size_t len, gsl::
 	Expects(pos + len <= sampleLength);
 
 	if (streaming) {
-		auto& temp = pos == 0 ? temp0 : temp1; // pos == 0 has a different buffer because if it loops around, it will be used together with another buffer
-		if (temp.size() != numChannels) {
-			temp.resize(numChannels);
+		if (!directStreamer) {
+			directStreamer = AudioClipStreamer::makePrimed(streamData, numChannels, sampleLength, loopPoint);
 		}
-
-		if (channelN == 0) { // TODO: this assumes the channels will be read in order. This will break threading.
-			if (pos != streamPos) {
-				vorbisData->seek(pos);
-				streamPos = pos;
-			}
-
-			size_t toRead = len;
-			for (size_t i = 0; i < numChannels; ++i) {
-				if (temp[i].size() < toRead) {
-					temp[i].resize(toRead);
-				}
-			}
-			vorbisData->read(temp);
-			streamPos += len;
-		}
-
-		auto& buf = samples.at(channelN);
-		if (buf.size() < len) {
-			buf.resize(len);
-		}
-
-		memcpy(dst.data(), temp[channelN].data(), len * sizeof(AudioConfig::SampleFormat));
-		return len;
+		return directStreamer->copyChannelData(channelN, pos, len, dst);
+	} else if (chunks) {
+		return chunks->copyChannelData(channelN, pos, len, dst);
 	} else {
 		memcpy(dst.data(), samples.at(channelN).data() + pos, len * sizeof(AudioConfig::SampleFormat));
 		return len;
@@ -136,6 +131,31 @@ bool AudioClip::isLoaded() const
 	return AsyncResource::isLoaded();
 }
 
+bool AudioClip::isStreaming() const
+{
+	return streaming;
+}
+
+std::shared_ptr<AudioClipStreamer> AudioClip::takeStreamer() const
+{
+	return streamers ? streamers->take() : std::shared_ptr<AudioClipStreamer>();
+}
+
+bool AudioClip::prefetch(size_t pos) const
+{
+	return !chunks || chunks->prefetch(pos);
+}
+
+void AudioClip::setCompressedLengthThreshold(size_t samples)
+{
+	compressedLengthThreshold = samples;
+}
+
+void AudioClip::setDecodedChunkBudget(size_t bytes)
+{
+	AudioChunkCache::get().setBudget(bytes);
+}
+
 std::shared_ptr<AudioClip> AudioClip::loadResource(ResourceLoader& loader)
 {
 	auto meta = loader.getMeta();
@@ -0,0 +1,257 @@
+#include "audio_clip_chunks.h"
+#include "vorbis_dec.h"
+#include <cstring>
+#include <algorithm>
+
+using namespace Halley;
+
+constexpr size_t AudioClipChunks::chunkSize;
+
+size_t AudioClipChunk::getSizeBytes() const
+{
+	return channels.empty() ? 0 : channels.size() * channels[0].size() * sizeof(AudioConfig::SampleFormat);
+}
+
+AudioClipChunks::AudioClipChunks(std::unique_ptr<VorbisData> v)
+	: vorbis(std::move(v))
+	, decodeRequested(false)
+{
+	numChannels = size_t(vorbis->getNumChannels());
+	length = vorbis->getNumSamples();
+	numSlots = (length + chunkSize - 1) / chunkSize;
+	slots = std::make_unique<Slot[]>(numSlots);
+}
+
+AudioClipChunks::~AudioClipChunks()
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < numSlots; ++i) {
+		if (slots[i].chunk) {
+			bytes += slots[i].chunk->getSizeBytes();
+		}
+	}
+	AudioChunkCache::get().onChunkRemoved(bytes);
+}
+
+size_t AudioClipChunks::copyChannelData(size_t channelN, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst)
+{
+	Expects(channelN < numChannels);
+	Expects(pos + len <= length);
+	Expects(size_t(dst.size()) >= len);
+
+	size_t written = 0;
+	while (written < len) {
+		const size_t idx = pos / chunkSize;
+		const size_t offset = pos - idx * chunkSize;
+		const size_t n = std::min(len - written, std::min(chunkSize, length - idx * chunkSize) - offset);
+
+		const auto chunk = tryGetChunk(idx);
+		if (chunk) {
+			memcpy(dst.data() + written, chunk->channels[channelN].data() + offset, n * sizeof(AudioConfig::SampleFormat));
+		} else {
+			// Decoding here would stall the mix, so play silence until the decode task gets to it
+			memset(dst.data() + written, 0, n * sizeof(AudioConfig::SampleFormat));
+			requestDecode(idx);
+		}
+		written += n;
+		pos += n;
+
+		// Past halfway through a chunk, get the next one ready
+		if (offset + n > chunkSize / 2 && idx + 1 < numSlots) {
+			requestDecode(idx + 1);
+		}
+	}
+
+	return len;
+}
+
+bool AudioClipChunks::prefetch(size_t pos)
+{
+	if (pos >= length) {
+		return true;
+	}
+
+	const size_t idx = pos / chunkSize;
+	if (tryGetChunk(idx)) {
+		return true;
+	}
+	requestDecode(idx);
+	return false;
+}
+
+bool AudioClipChunks::isDecoded(size_t pos) const
+{
+	return pos >= length || std::atomic_load(&slots[pos / chunkSize].chunk) != nullptr;
+}
+
+size_t AudioClipChunks::getNumberOfChannels() const
+{
+	return numChannels;
+}
+
+size_t AudioClipChunks::getLength() const
+{
+	return length;
+}
+
+std::shared_ptr<const AudioClipChunk> AudioClipChunks::tryGetChunk(size_t idx)
+{
+	Expects(idx < numSlots);
+	auto& slot = slots[idx];
+	auto chunk = std::atomic_load(&slot.chunk);
+	if (chunk) {
+		slot.lastUse = AudioChunkCache::get().nextUse();
+	}
+	return chunk;
+}
+
+void AudioClipChunks::requestDecode(size_t idx)
+{
+	Expects(idx < numSlots);
+
+	// The flag stays set while the chunk is decoded, so this only wakes the worker once per chunk
+	if (!slots[idx].requested.exchange(true)) {
+		decodeRequested = true;
+		AudioDecodeWorker::get().wake();
+	}
+}
+
+void AudioClipChunks::decode()
+{
+	// Anything requested after this is picked up next time the worker wakes up
+	if (!decodeRequested.exchange(false)) {
+		return;
+	}
+
+	for (size_t i = 0; i < numSlots; ++i) {
+		if (slots[i].requested && !std::atomic_load(&slots[i].chunk)) {
+			decodeChunk(i);
+		}
+	}
+}
+
+void AudioClipChunks::decodeChunk(size_t idx)
+{
+	const size_t start = idx * chunkSize;
+	const size_t n = std::min(chunkSize, length - start);
+	if (decodePos != start) {
+		vorbis->seek(start);
+	}
+
+	auto chunk = std::make_shared<AudioClipChunk>();
+	chunk->channels.resize(numChannels);
+	for (auto& c: chunk->channels) {
+		c.resize(n);
+	}
+	const size_t nRead = vorbis->read(chunk->channels); // Anything short of n stays as silence
+	decodePos = start + nRead;
+
+	slots[idx].lastUse = AudioChunkCache::get().nextUse();
+	std::atomic_store(&slots[idx].chunk, std::shared_ptr<const AudioClipChunk>(chunk));
+
+	AudioChunkCache::get().onChunkAdded(shared_from_this(), chunk->getSizeBytes());
+}
+
+bool AudioClipChunks::getLeastRecentlyUsed(size_t& idx, uint64_t& lastUse) const
+{
+	bool found = false;
+	for (size_t i = 0; i < numSlots; ++i) {
+		const uint64_t use = slots[i].lastUse;
+		if (std::atomic_load(&slots[i].chunk) && (!found || use < lastUse)) {
+			idx = i;
+			lastUse = use;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void AudioClipChunks::evict(size_t idx)
+{
+	auto chunk = std::atomic_exchange(&slots[idx].chunk, std::shared_ptr<const AudioClipChunk>());
+	slots[idx].requested = false;
+
+	// Anyone still copying from it holds their own reference
+	if (chunk) {
+		AudioChunkCache::get().onChunkRemoved(chunk->getSizeBytes());
+	}
+}
+
+AudioChunkCache& AudioChunkCache::get()
+{
+	static AudioChunkCache cache;
+	return cache;
+}
+
+AudioChunkCache::AudioChunkCache()
+	: useCount(0)
+	, size(0)
+	, budget(16 * 1024 * 1024)
+{
+}
+
+void AudioChunkCache::setBudget(size_t bytes)
+{
+	budget = bytes;
+	std::unique_lock<std::mutex> lock(mutex);
+	trim();
+}
+
+size_t AudioChunkCache::getBudget() const
+{
+	return budget;
+}
+
+size_t AudioChunkCache::getSize() const
+{
+	return size;
+}
+
+uint64_t AudioChunkCache::nextUse()
+{
+	return ++useCount;
+}
+
+void AudioChunkCache::onChunkAdded(const std::shared_ptr<AudioClipChunks>& owner, size_t bytes)
+{
+	size += bytes;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!owner->registered) {
+		owner->registered = true;
+		owners.erase(std::remove_if(owners.begin(), owners.end(), [] (const std::weak_ptr<AudioClipChunks>& o) { return o.expired(); }), owners.end());
+		owners.push_back(owner);
+	}
+	trim();
+}
+
+void AudioChunkCache::onChunkRemoved(size_t bytes)
+{
+	size -= bytes;
+}
+
+void AudioChunkCache::trim()
+{
+	// Chunks are only added once per decode, which is rare enough that a linear search for the oldest is fine
+	while (size > budget) {
+		std::shared_ptr<AudioClipChunks> oldestOwner;
+		size_t oldestIdx = 0;
+		uint64_t oldestUse = 0;
+
+		for (auto& o: owners) {
+			auto owner = o.lock();
+			size_t idx;
+			uint64_t lastUse;
+			if (owner && owner->getLeastRecentlyUsed(idx, lastUse) && (!oldestOwner || lastUse < oldestUse)) {
+				oldestOwner = std::move(owner);
+				oldestIdx = idx;
+				oldestUse = lastUse;
+			}
+		}
+
+		if (!oldestOwner) {
+			break;
+		}
+		oldestOwner->evict(oldestIdx);
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <gsl/gsl>
+#include "halley/core/api/audio_api.h"
+#include "audio_decode_worker.h"
+
+namespace Halley
+{
+	class VorbisData;
+
+	struct AudioClipChunk
+	{
+		std::vector<std::vector<AudioConfig::SampleFormat>> channels;
+
+		size_t getSizeBytes() const;
+	};
+
+	// Keeps a clip compressed in memory, and decodes it a chunk at a time as it's played.
+	// Decoded chunks are shared by every emitter playing the clip, and evicted by AudioChunkCache once over budget, least recently used first.
+	// All decoding happens on the decode worker: the following chunk is requested ahead of time, and misses play as silence until decoded.
+	// Must be added to the decode worker once created.
+	class AudioClipChunks : public IAudioDecoder, public std::enable_shared_from_this<AudioClipChunks>
+	{
+		friend class AudioChunkCache;
+
+	public:
+		constexpr static size_t chunkSize = 16384; // Per channel, ~0.34s at 48kHz
+
+		explicit AudioClipChunks(std::unique_ptr<VorbisData> vorbis);
+		~AudioClipChunks();
+
+		// Thread-safe, never waits for decoding, and neither locks nor allocates.
+		size_t copyChannelData(size_t channelN, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst);
+
+		// Requests the chunk containing pos, if it isn't decoded yet. Returns true if it is.
+		bool prefetch(size_t pos);
+
+		// Returns true if the chunk containing pos is decoded, without requesting it
+		bool isDecoded(size_t pos) const;
+
+		size_t getNumberOfChannels() const;
+		size_t getLength() const;
+
+		void decode() override;
+
+	private:
+		struct Slot
+		{
+			std::shared_ptr<const AudioClipChunk> chunk; // Only accessed with the std::atomic_* shared_ptr functions
+			std::atomic<uint64_t> lastUse { 0 };
+			std::atomic<bool> requested { false }; // Set until the chunk is evicted, once decoded
+		};
+
+		size_t numChannels = 0;
+		size_t length = 0;
+
+		std::unique_ptr<VorbisData> vorbis; // Only used by the decode worker
+		size_t decodePos = 0;
+
+		std::unique_ptr<Slot[]> slots;
+		size_t numSlots = 0;
+		bool registered = false; // Guarded by the cache
+
+		std::atomic<bool> decodeRequested;
+
+		std::shared_ptr<const AudioClipChunk> tryGetChunk(size_t idx);
+		void requestDecode(size_t idx);
+		void decodeChunk(size_t idx);
+
+		bool getLeastRecentlyUsed(size_t& idx, uint64_t& lastUse) const;
+		void evict(size_t idx);
+	};
+
+	// Global budget for decoded chunks of compressed clips
+	class AudioChunkCache
+	{
+	public:
+		static AudioChunkCache& get();
+
+		void setBudget(size_t bytes);
+		size_t getBudget() const;
+		size_t getSize() const;
+
+		uint64_t nextUse();
+		void onChunkAdded(const std::shared_ptr<AudioClipChunks>& owner, size_t bytes);
+		void onChunkRemoved(size_t bytes);
+
+	private:
+		AudioChunkCache();
+
+		mutable std::mutex mutex;
+		std::vector<std::weak_ptr<AudioClipChunks>> owners;
+		std::atomic<uint64_t> useCount;
+		std::atomic<size_t> size;
+		std::atomic<size_t> budget;
+
+		void trim();
+	};
+}
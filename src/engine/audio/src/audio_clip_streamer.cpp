@@ -0,0 +1,290 @@
+#include "audio_clip_streamer.h"
+#include "vorbis_dec.h"
+#include "halley/resources/resource_data.h"
+#include <cstring>
+
+using namespace Halley;
+
+constexpr size_t AudioClipStreamer::bufferSize;
+constexpr size_t AudioClipStreamer::decodeChunkSize;
+constexpr size_t AudioClipStreamer::npos;
+
+AudioClipStreamer::AudioClipStreamer(std::shared_ptr<ResourceDataStream> data, size_t numChannels, size_t length, size_t loopPoint)
+	: data(std::move(data))
+	, numChannels(numChannels)
+	, length(length)
+	, loopPoint(loopPoint)
+	, readCount(0)
+	, writeCount(0)
+	, seekPending(false)
+	, seekTarget(0)
+	, decodeRequested(false)
+	, ready(false)
+	, reading(false)
+{
+	ring.resize(numChannels);
+	decodeBuffer.resize(numChannels);
+	for (auto& r: ring) {
+		r.resize(bufferSize);
+	}
+}
+
+AudioClipStreamer::~AudioClipStreamer()
+{
+}
+
+std::shared_ptr<AudioClipStreamer> AudioClipStreamer::makePrimed(std::shared_ptr<ResourceDataStream> data, size_t numChannels, size_t length, size_t loopPoint)
+{
+	auto result = std::make_shared<AudioClipStreamer>(std::move(data), numChannels, length, loopPoint);
+	result->prime();
+	AudioDecodeWorker::get().add(result);
+	return result;
+}
+
+void AudioClipStreamer::prime()
+{
+	open();
+	while (decodeChunk() > 0) {}
+	ready.store(true, std::memory_order_release);
+}
+
+bool AudioClipStreamer::isReady() const
+{
+	return ready.load(std::memory_order_acquire);
+}
+
+bool AudioClipStreamer::prefetch(size_t pos, size_t len)
+{
+	if (seekPending.load(std::memory_order_acquire)) {
+		seekTarget.store(pos);
+		return false;
+	}
+
+	// Same as reading, but without consuming anything
+	const size_t offset = getOffsetFromHead(pos);
+	if (offset == npos || offset + len > bufferSize - decodeChunkSize) {
+		requestSeek(pos);
+		return false;
+	}
+
+	const size_t available = writeCount.load(std::memory_order_acquire) - readCount.load(std::memory_order_relaxed);
+	if (offset + len <= available) {
+		return true;
+	}
+	scheduleDecode();
+	return false;
+}
+
+size_t AudioClipStreamer::copyChannelData(size_t channelN, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst)
+{
+	Expects(channelN < numChannels);
+	Expects(size_t(dst.size()) >= len);
+
+	// Each playback has its own streamer, so even when emitters of this clip are mixed on different threads, reads never overlap
+	const bool wasReading = reading.exchange(true, std::memory_order_acquire);
+	Expects(!wasReading);
+	const size_t result = readChannelData(channelN, pos, len, dst);
+	reading.store(false, std::memory_order_release);
+	return result;
+}
+
+size_t AudioClipStreamer::readChannelData(size_t channelN, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst)
+{
+	if (seekPending.load(std::memory_order_acquire)) {
+		seekTarget.store(pos);
+		memset(dst.data(), 0, len * sizeof(AudioConfig::SampleFormat));
+		return len;
+	}
+
+	const size_t read = readCount.load(std::memory_order_relaxed);
+	const size_t available = writeCount.load(std::memory_order_acquire) - read;
+	const size_t offset = getOffsetFromHead(pos);
+
+	// Seek if pos is behind us, or too far ahead to ever fit in the buffer.
+	// Otherwise it's either buffered already, or will be once the decoder catches up.
+	if (offset == npos || offset + len > bufferSize - decodeChunkSize) {
+		requestSeek(pos);
+		memset(dst.data(), 0, len * sizeof(AudioConfig::SampleFormat));
+		return len;
+	}
+
+	size_t toCopy = 0;
+	if (offset <= available) {
+		// Anything before pos has been played by now, so it can be released to the decoder
+		if (offset > 0) {
+			readCount.store(read + offset, std::memory_order_release);
+			headPos = pos;
+		}
+
+		// Copy what's there, wrapping around the ring
+		toCopy = std::min(len, available - offset);
+		const size_t start = (read + offset) & (bufferSize - 1);
+		const size_t firstPart = std::min(toCopy, bufferSize - start);
+		auto& src = ring[channelN];
+		memcpy(dst.data(), src.data() + start, firstPart * sizeof(AudioConfig::SampleFormat));
+		memcpy(dst.data() + firstPart, src.data(), (toCopy - firstPart) * sizeof(AudioConfig::SampleFormat));
+	}
+
+	// Underrun
+	if (toCopy < len) {
+		memset(dst.data() + toCopy, 0, (len - toCopy) * sizeof(AudioConfig::SampleFormat));
+	}
+
+	if (offset > 0 || toCopy < len) {
+		scheduleDecode();
+	}
+
+	return len;
+}
+
+size_t AudioClipStreamer::getNumberOfChannels() const
+{
+	return numChannels;
+}
+
+size_t AudioClipStreamer::getLength() const
+{
+	return length;
+}
+
+size_t AudioClipStreamer::getOffsetFromHead(size_t pos) const
+{
+	if (pos >= headPos) {
+		return pos - headPos;
+	} else if (pos >= loopPoint && loopPoint < length) {
+		// Buffered data wraps around to the loop point after the end of the clip
+		return (length - headPos) + (pos - loopPoint);
+	} else {
+		return npos;
+	}
+}
+
+void AudioClipStreamer::requestSeek(size_t pos)
+{
+	seekTarget.store(pos);
+	seekPending.store(true, std::memory_order_release);
+	scheduleDecode();
+}
+
+void AudioClipStreamer::scheduleDecode()
+{
+	if (!decodeRequested.exchange(true)) {
+		AudioDecodeWorker::get().wake();
+	}
+}
+
+void AudioClipStreamer::decode()
+{
+	// Anything requested after this is picked up next time the worker wakes up
+	if (!decodeRequested.exchange(false)) {
+		return;
+	}
+
+	open();
+	while (canDecode()) {
+		if (seekPending.load(std::memory_order_acquire)) {
+			applySeek();
+		} else if (decodeChunk() == 0) {
+			break;
+		}
+	}
+	ready.store(true, std::memory_order_release);
+}
+
+void AudioClipStreamer::open()
+{
+	if (!vorbis) {
+		vorbis = std::make_unique<VorbisData>(data);
+	}
+}
+
+bool AudioClipStreamer::canDecode() const
+{
+	if (seekPending.load(std::memory_order_acquire)) {
+		return true;
+	}
+	const size_t used = writeCount.load(std::memory_order_relaxed) - readCount.load(std::memory_order_acquire);
+	return bufferSize - used >= decodeChunkSize && (decodePos < length || loopPoint < length);
+}
+
+void AudioClipStreamer::applySeek()
+{
+	// The consumer doesn't touch the buffer while a seek is pending, so it's safe to reset it from here
+	const size_t target = std::min(seekTarget.load(), length);
+	vorbis->seek(target);
+	decodePos = target;
+	headPos = target;
+	writeCount.store(readCount.load(std::memory_order_acquire), std::memory_order_relaxed);
+	seekPending.store(false, std::memory_order_release);
+}
+
+size_t AudioClipStreamer::decodeChunk()
+{
+	const size_t write = writeCount.load(std::memory_order_relaxed);
+	const size_t freeSpace = bufferSize - (write - readCount.load(std::memory_order_acquire));
+
+	if (decodePos >= length) {
+		if (loopPoint >= length) {
+			return 0;
+		}
+		vorbis->seek(loopPoint);
+		decodePos = loopPoint;
+	}
+
+	const size_t toDecode = std::min(std::min(decodeChunkSize, freeSpace), length - decodePos);
+	if (toDecode == 0) {
+		return 0;
+	}
+
+	for (auto& b: decodeBuffer) {
+		b.resize(toDecode);
+	}
+	const size_t nRead = vorbis->read(decodeBuffer);
+	if (nRead == 0) {
+		// Stream ended short of its reported length
+		decodePos = length;
+		return 0;
+	}
+
+	const size_t start = write & (bufferSize - 1);
+	const size_t firstPart = std::min(nRead, bufferSize - start);
+	for (size_t i = 0; i < numChannels; ++i) {
+		memcpy(ring[i].data() + start, decodeBuffer[i].data(), firstPart * sizeof(AudioConfig::SampleFormat));
+		memcpy(ring[i].data(), decodeBuffer[i].data() + firstPart, (nRead - firstPart) * sizeof(AudioConfig::SampleFormat));
+	}
+
+	writeCount.store(write + nRead, std::memory_order_release);
+	decodePos += nRead;
+	return nRead;
+}
+
+
+AudioClipStreamerPool::AudioClipStreamerPool(std::shared_ptr<ResourceDataStream> data, size_t numChannels, size_t length, size_t loopPoint)
+	: data(std::move(data))
+	, numChannels(numChannels)
+	, length(length)
+	, loopPoint(loopPoint)
+	, refillRequested(false)
+{
+}
+
+void AudioClipStreamerPool::fill()
+{
+	std::atomic_store(&primed, AudioClipStreamer::makePrimed(data, numChannels, length, loopPoint));
+}
+
+std::shared_ptr<AudioClipStreamer> AudioClipStreamerPool::take()
+{
+	auto result = std::atomic_exchange(&primed, std::shared_ptr<AudioClipStreamer>());
+	if (result && !refillRequested.exchange(true)) {
+		AudioDecodeWorker::get().wake();
+	}
+	return result;
+}
+
+void AudioClipStreamerPool::decode()
+{
+	if (refillRequested.exchange(false) && !std::atomic_load(&primed)) {
+		fill();
+	}
+}
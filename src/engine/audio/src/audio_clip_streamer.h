@@ -0,0 +1,103 @@
+#pragma once
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <gsl/gsl>
+#include "halley/core/api/audio_api.h"
+#include "audio_decode_worker.h"
+
+namespace Halley
+{
+	class VorbisData;
+	class ResourceDataStream;
+
+	// Decodes a streaming clip ahead of playback on the decode worker, into a ring buffer read by the audio thread.
+	// Single producer (the decode worker), single consumer (one playback of the clip).
+	// Each playback gets its own streamer, with its own decoder, since they're all at different positions.
+	// Once the end of the clip is decoded, decoding carries on from the loop point, so looping playback doesn't stall.
+	class AudioClipStreamer : public IAudioDecoder
+	{
+	public:
+		AudioClipStreamer(std::shared_ptr<ResourceDataStream> data, size_t numChannels, size_t length, size_t loopPoint);
+		~AudioClipStreamer();
+
+		// Creates a streamer with the start of the clip already decoded, and hands it to the decode worker
+		static std::shared_ptr<AudioClipStreamer> makePrimed(std::shared_ptr<ResourceDataStream> data, size_t numChannels, size_t length, size_t loopPoint);
+
+		// Decodes until the buffer is full, on the calling thread. Only call before the streamer is added to the decode worker.
+		void prime();
+
+		// True once the start of the clip has been decoded
+		bool isReady() const;
+
+		// True if [pos, pos + len) is decoded, so reading it won't underrun. Otherwise, asks for it to be decoded. Consumer only.
+		bool prefetch(size_t pos, size_t len);
+
+		// Called when mixing. Samples that aren't decoded yet (after a seek, or if decoding fell behind) are written as silence.
+		size_t copyChannelData(size_t channelN, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst);
+
+		size_t getNumberOfChannels() const;
+		size_t getLength() const;
+
+		void decode() override;
+
+	private:
+		constexpr static size_t bufferSize = 32768; // Per channel, ~0.7s at 48kHz. Must be a power of two.
+		constexpr static size_t decodeChunkSize = 4096;
+		constexpr static size_t npos = size_t(-1);
+
+		std::shared_ptr<ResourceDataStream> data;
+		std::unique_ptr<VorbisData> vorbis; // Opened by the producer
+		size_t numChannels = 0;
+		size_t length = 0;
+		size_t loopPoint = 0;
+
+		std::vector<std::vector<AudioConfig::SampleFormat>> ring;
+		std::atomic<bool> reading; // Only used to check that there's a single consumer
+		std::atomic<size_t> readCount;
+		std::atomic<size_t> writeCount;
+		size_t headPos = 0; // Clip position of the sample at readCount. Owned by the consumer, except while a seek is pending.
+		size_t decodePos = 0; // Producer only
+
+		std::atomic<bool> seekPending;
+		std::atomic<size_t> seekTarget;
+		std::atomic<bool> decodeRequested;
+		std::atomic<bool> ready;
+		std::vector<std::vector<float>> decodeBuffer;
+
+		size_t readChannelData(size_t channelN, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst);
+		size_t getOffsetFromHead(size_t pos) const;
+		void requestSeek(size_t pos);
+		void scheduleDecode();
+
+		void open();
+		bool canDecode() const;
+		void applySeek();
+		size_t decodeChunk();
+	};
+
+	// Keeps a primed streamer ready for the next playback of a streaming clip, so starting playback never creates one on the audio thread.
+	// Once it's taken, the decode worker primes another.
+	class AudioClipStreamerPool : public IAudioDecoder
+	{
+	public:
+		AudioClipStreamerPool(std::shared_ptr<ResourceDataStream> data, size_t numChannels, size_t length, size_t loopPoint);
+
+		// Primes the first streamer on the calling thread. Only call before the pool is added to the decode worker.
+		void fill();
+
+		// Thread-safe, and doesn't allocate. Returns null if the next streamer isn't primed yet.
+		std::shared_ptr<AudioClipStreamer> take();
+
+		void decode() override;
+
+	private:
+		std::shared_ptr<ResourceDataStream> data;
+		size_t numChannels = 0;
+		size_t length = 0;
+		size_t loopPoint = 0;
+
+		std::shared_ptr<AudioClipStreamer> primed; // Only accessed with the std::atomic_* shared_ptr functions
+		std::atomic<bool> refillRequested;
+	};
+}
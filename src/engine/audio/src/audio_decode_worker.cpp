@@ -0,0 +1,80 @@
+#include "audio_decode_worker.h"
+#include "halley/support/logger.h"
+#include "halley/support/profiler.h"
+#include <chrono>
+#include <algorithm>
+
+using namespace Halley;
+
+AudioDecodeWorker& AudioDecodeWorker::get()
+{
+	static AudioDecodeWorker worker;
+	return worker;
+}
+
+AudioDecodeWorker::AudioDecodeWorker()
+	: pending(false)
+{
+	thread = std::thread([this] () { run(); });
+}
+
+AudioDecodeWorker::~AudioDecodeWorker()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	thread.join();
+}
+
+void AudioDecodeWorker::add(std::weak_ptr<IAudioDecoder> decoder)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		decoders.push_back(std::move(decoder));
+	}
+	wake();
+}
+
+void AudioDecodeWorker::wake()
+{
+	// Notifying without the lock can race with the worker going to sleep, so it also wakes up on its own every so often
+	pending.store(true, std::memory_order_release);
+	condition.notify_one();
+}
+
+void AudioDecodeWorker::run()
+{
+	Profiler::setThreadName("Audio decode");
+
+	std::vector<std::shared_ptr<IAudioDecoder>> current;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait_for(lock, std::chrono::milliseconds(5), [&] () { return stopping || pending.load(std::memory_order_acquire); });
+			if (stopping) {
+				return;
+			}
+			pending.store(false, std::memory_order_relaxed);
+
+			decoders.erase(std::remove_if(decoders.begin(), decoders.end(), [] (const std::weak_ptr<IAudioDecoder>& d) { return d.expired(); }), decoders.end());
+			for (auto& d: decoders) {
+				auto decoder = d.lock();
+				if (decoder) {
+					current.push_back(std::move(decoder));
+				}
+			}
+		}
+
+		// Decoders may add more decoders, so this runs without the lock
+		for (auto& decoder: current) {
+			try {
+				decoder->decode();
+			} catch (std::exception& e) {
+				Logger::logException(e);
+			}
+		}
+		current.clear();
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <vector>
+
+namespace Halley
+{
+	// Something that decodes audio ahead of playback. Requests come from the mixing thread, and are served by the decode worker.
+	class IAudioDecoder
+	{
+	public:
+		virtual ~IAudioDecoder() = default;
+
+		// Called on the decode worker every time it's woken up. Should return straight away if this decoder has nothing to do.
+		virtual void decode() = 0;
+	};
+
+	// A thread that stays up for as long as there's audio to decode, so the mixing thread can ask for decoding without queueing tasks.
+	// Requesting work is just a matter of setting a flag on the decoder and calling wake(), neither of which locks or allocates.
+	class AudioDecodeWorker
+	{
+	public:
+		static AudioDecodeWorker& get();
+		~AudioDecodeWorker();
+
+		// Decoders are held weakly, and dropped once they're gone. Don't call from the mixing thread.
+		void add(std::weak_ptr<IAudioDecoder> decoder);
+
+		// Safe to call from the mixing thread
+		void wake();
+
+	private:
+		AudioDecodeWorker();
+
+		std::thread thread;
+		std::mutex mutex; // Never taken by the mixing thread
+		std::condition_variable condition;
+		std::vector<std::weak_ptr<IAudioDecoder>> decoders;
+		std::atomic<bool> pending;
+		bool stopping = false;
+
+		void run();
+	};
+}
@@ -101,6 +101,58 @@ size_t AudioEmitter::getNumberOfChannels() const
 	return nChannels;
 }
 
+void AudioEmitter::setPriority(int p)
+{
+	priority = p;
+}
+
+int AudioEmitter::getPriority() const
+{
+	return priority;
+}
+
+float AudioEmitter::getAudibility() const
+{
+	float result = 0.0f;
+	for (size_t i = 0; i < nChannels * nChannels; ++i) {
+		result = std::max(result, channelMix[i]);
+	}
+	return result;
+}
+
+void AudioEmitter::setVirtual(bool v)
+{
+	if (v && !virtualised) {
+		// Nothing to fade out if it's never been heard
+		fadingOut = hasMixed;
+	} else if (!v && virtualised) {
+		fadingOut = false;
+		prevChannelMix.fill(0.0f);
+	}
+	virtualised = v;
+}
+
+bool AudioEmitter::isVirtual() const
+{
+	return virtualised;
+}
+
+bool AudioEmitter::needsMixing() const
+{
+	return !virtualised || fadingOut;
+}
+
+void AudioEmitter::skip(size_t numSamples)
+{
+	Expects(playing);
+
+	const bool isPlaying = source->skipAudio(numSamples);
+	advancePlayback(numSamples);
+	if (!isPlaying) {
+		stop();
+	}
+}
+
 void AudioEmitter::update(gsl::span<const AudioChannelData> channels, const AudioListenerData& listener, float groupGain)
 {
 	Expects(playing);
@@ -129,6 +181,14 @@ void AudioEmitter::mixTo(size_t numSamples, gsl::span<AudioBuffer*> dst, AudioMi
 
 	const size_t numPacks = numSamples / 16;
 	Expects(dst[0]->packs.size() >= numPacks);
+
+	// Last mix before going virtual
+	if (fadingOut) {
+		channelMix.fill(0.0f);
+		fadingOut = false;
+	}
+	hasMixed = true;
+
 	const size_t nSrcChannels = getNumberOfChannels();
 	const auto nDstChannels = size_t(dst.size());
 
@@ -29,6 +29,19 @@ namespace Halley {
 		float getGain() const;
 		size_t getNumberOfChannels() const;
 
+		void setPriority(int priority);
+		int getPriority() const;
+
+		// Loudest channel gain, as of the last update
+		float getAudibility() const;
+
+		// Virtual emitters keep track of their playback position, but don't generate any audio.
+		// Becoming virtual fades out over the next mix, and becoming real again fades back in.
+		void setVirtual(bool isVirtual);
+		bool isVirtual() const;
+		bool needsMixing() const;
+		void skip(size_t numSamples);
+
 		void update(gsl::span<const AudioChannelData> channels, const AudioListenerData& listener, float groupGain);
 		void mixTo(size_t numSamples, gsl::span<AudioBuffer*> dst, AudioMixer& mixer, AudioBufferPool& pool);
 		
@@ -48,6 +61,10 @@ namespace Halley {
 		bool playing = false;
 		bool done = false;
 		bool isFirstUpdate = true;
+		bool virtualised = false;
+		bool fadingOut = false;
+		bool hasMixed = false;
+		int priority = 0;
     	float gain;
 		float elapsedTime = 0.0f;
 
@@ -2,14 +2,137 @@
 #include "audio_mixer.h"
 #include <thread>
 #include <chrono>
+#include <exception>
 #include "audio_source_clip.h"
 #include "audio_filter_resample.h"
 #include "halley/support/debug.h"
+#include "halley/support/profiler.h"
 #include "halley/core/resources/resources.h"
 #include "audio_event.h"
+#include "halley/concurrency/executor.h"
 
 using namespace Halley;
 
+namespace {
+	// Below this many emitters per thread, splitting the mix costs more than it saves
+	constexpr size_t minEmittersPerPartition = 16;
+}
+
+namespace Halley {
+	// Mixes partitions on the audio thread and a set of worker threads that live as long as the engine, so nothing is allocated
+	// or queued per buffer. Partitions are claimed by whoever gets to them first, so the audio thread never waits on a worker
+	// that hasn't woken up yet; it just mixes the remaining partitions itself.
+	class PartitionedMixJob
+	{
+	public:
+		PartitionedMixJob(AudioEngine& engine, size_t nWorkers)
+			: engine(engine)
+			, claims(0)
+			, completed(0)
+		{
+			for (size_t i = 0; i < nWorkers; ++i) {
+				workers.emplace_back([this] () { workerLoop(); });
+			}
+		}
+
+		~PartitionedMixJob()
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			condition.notify_all();
+			for (auto& w: workers) {
+				w.join();
+			}
+		}
+
+		size_t getMaxPartitions() const
+		{
+			return workers.size() + 1;
+		}
+
+		void run(size_t n)
+		{
+			uint32_t gen;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				gen = ++generation;
+				count = n;
+				completed = 0;
+				claims = uint64_t(gen) << 32;
+			}
+			condition.notify_all();
+
+			runAll(gen, n);
+			while (completed.load() < n) {
+				std::this_thread::yield();
+			}
+
+			if (error) {
+				auto e = error;
+				error = {};
+				std::rethrow_exception(e);
+			}
+		}
+
+	private:
+		AudioEngine& engine;
+		std::vector<std::thread> workers;
+
+		std::mutex mutex;
+		std::condition_variable condition;
+		uint32_t generation = 0;
+		size_t count = 0;
+		bool stopping = false;
+
+		// The job's generation in the high 32 bits and the next partition in the low 32, so a worker that wakes up late can't claim a partition of a newer job
+		std::atomic<uint64_t> claims;
+		std::atomic<size_t> completed;
+
+		std::mutex errorMutex;
+		std::exception_ptr error;
+
+		void workerLoop()
+		{
+			Profiler::setThreadName("Audio mix");
+			uint32_t seen = 0;
+			while (true) {
+				size_t n;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					condition.wait(lock, [&] () { return stopping || generation != seen; });
+					if (stopping) {
+						return;
+					}
+					seen = generation;
+					n = count;
+				}
+				runAll(seen, n);
+			}
+		}
+
+		void runAll(uint32_t gen, size_t n)
+		{
+			uint64_t c = claims.load();
+			while (uint32_t(c >> 32) == gen && size_t(uint32_t(c)) < n) {
+				if (claims.compare_exchange_weak(c, c + 1)) {
+					try {
+						engine.mixPartition(size_t(uint32_t(c)));
+					} catch (...) {
+						std::unique_lock<std::mutex> lock(errorMutex);
+						if (!error) {
+							error = std::current_exception();
+						}
+					}
+					++completed;
+					c = claims.load();
+				}
+			}
+		}
+	};
+}
+
 AudioEngine::AudioEngine()
 	: mixer(AudioMixer::makeMixer())
 	, pool(std::make_unique<AudioBufferPool>())
@@ -21,6 +144,7 @@ AudioEngine::AudioEngine()
 
 AudioEngine::~AudioEngine()
 {
+	mixJob.reset();
 }
 
 void AudioEngine::postEvent(size_t id, std::shared_ptr<const AudioEvent> event, const AudioPosition& position)
@@ -103,6 +227,16 @@ void AudioEngine::start(AudioSpec s, AudioOutputAPI& o)
 	if (spec.sampleRate != 48000) {
 		outResampler = std::make_unique<AudioResampler>(48000, spec.sampleRate, spec.numChannels, Debug::isDebug() ? 0.0f : 0.5f);
 	}
+
+	// Mix workers, one per aux thread, and everything they mix into, so the audio thread never has to allocate them
+	if (!mixJob) {
+		mixJob = std::make_unique<PartitionedMixJob>(*this, Executors::getCPUAux().threadCount());
+		const size_t maxPartitions = mixJob->getMaxPartitions();
+		while (partitionPools.size() < maxPartitions) {
+			partitionPools.push_back(std::make_unique<AudioBufferPool>());
+		}
+		partitionBuffers.resize(maxPartitions);
+	}
 }
 
 void AudioEngine::resume()
@@ -166,6 +300,17 @@ void AudioEngine::setGroupGain(const String& name, float gain)
 	groupGains[getGroupId(name)] = gain;
 }
 
+void AudioEngine::setMaxVoices(size_t n)
+{
+	maxVoices = n;
+}
+
+void AudioEngine::setMixer(std::unique_ptr<AudioMixer> m)
+{
+	Expects(m);
+	mixer = std::move(m);
+}
+
 void AudioEngine::mixEmitters(size_t numSamples, size_t nChannels, gsl::span<AudioBuffer*> buffers)
 {
 	// Clear buffers
@@ -173,21 +318,108 @@ void AudioEngine::mixEmitters(size_t numSamples, size_t nChannels, gsl::span<Aud
 		clearBuffer(buffers[i]->packs);
 	}
 
-	// Mix every emitter
+	updateEmitters();
+	assignVoices(numSamples);
+
+	// Split emitters across the audio thread and the mix workers, if there's enough of them to be worth it
+	const size_t maxPartitions = mixJob ? mixJob->getMaxPartitions() : 1;
+	const size_t nPartitions = std::min(maxPartitions, mixingEmitters.size() / minEmittersPerPartition);
+	if (nPartitions > 1) {
+		mixEmittersParallel(numSamples, nChannels, buffers, nPartitions);
+	} else {
+		mixEmitterRange(0, mixingEmitters.size(), numSamples, buffers, *pool);
+	}
+}
+
+void AudioEngine::updateEmitters()
+{
+	activeEmitters.clear();
 	for (auto& e: emitters) {
 		// Start playing if necessary
 		if (!e->isPlaying() && !e->isDone() && e->isReady()) {
 			e->start();
 		}
 
-		// Mix it in!
 		if (e->isPlaying()) {
 			e->update(channels, listener, masterGain * getGroupGain(e->getGroup()));
-			e->mixTo(numSamples, buffers, *mixer, *pool);
+			activeEmitters.push_back(e.get());
 		}
 	}
 }
 
+void AudioEngine::assignVoices(size_t numSamples)
+{
+	// Highest priority first, then loudest. Only the first maxVoices get to be heard, and anything inaudible never is.
+	constexpr float minAudibility = 0.0001f;
+	if (activeEmitters.size() > maxVoices) {
+		std::stable_sort(activeEmitters.begin(), activeEmitters.end(), [] (const AudioEmitter* a, const AudioEmitter* b)
+		{
+			if (a->getPriority() != b->getPriority()) {
+				return a->getPriority() > b->getPriority();
+			}
+			return a->getAudibility() > b->getAudibility();
+		});
+	}
+
+	mixingEmitters.clear();
+	for (size_t i = 0; i < activeEmitters.size(); ++i) {
+		auto e = activeEmitters[i];
+		e->setVirtual(i >= maxVoices || e->getAudibility() < minAudibility);
+		if (e->needsMixing()) {
+			mixingEmitters.push_back(e);
+		} else {
+			e->skip(numSamples);
+		}
+	}
+}
+
+void AudioEngine::mixEmittersParallel(size_t numSamples, size_t nChannels, gsl::span<AudioBuffer*> buffers, size_t nPartitions)
+{
+	// Emitters share nothing mutable with each other: streaming clips have a streamer per emitter, and compressed clips lock their chunk cache.
+	// Each partition other than the first mixes into its own buffers, from its own pool, to be summed in at the end
+	for (size_t i = 1; i < nPartitions; ++i) {
+		partitionBuffers[i] = partitionPools[i]->getBuffers(nChannels, numSamples);
+	}
+
+	partitionCount = nPartitions;
+	partitionSamples = numSamples;
+	partitionOutput = buffers;
+	mixJob->run(nPartitions);
+
+	// Sum partitions into the output
+	const size_t numPacks = numSamples / AudioSamplePack::NumSamples;
+	for (size_t i = 1; i < nPartitions; ++i) {
+		auto src = partitionBuffers[i].getBuffers();
+		for (size_t channel = 0; channel < nChannels; ++channel) {
+			mixer->sumAudio(gsl::span<const AudioSamplePack>(src[channel]->packs).subspan(0, numPacks), gsl::span<AudioSamplePack>(buffers[channel]->packs).subspan(0, numPacks));
+		}
+		partitionBuffers[i] = AudioBuffersRef();
+	}
+}
+
+void AudioEngine::mixPartition(size_t i)
+{
+	const size_t nEmitters = mixingEmitters.size();
+	const size_t start = nEmitters * i / partitionCount;
+	const size_t end = nEmitters * (i + 1) / partitionCount;
+	if (i == 0) {
+		mixEmitterRange(start, end, partitionSamples, partitionOutput, *pool);
+	} else {
+		auto dst = partitionBuffers[i].getBuffers();
+		for (auto& b: dst) {
+			clearBuffer(b->packs);
+		}
+		mixEmitterRange(start, end, partitionSamples, dst, *partitionPools[i]);
+	}
+}
+
+void AudioEngine::mixEmitterRange(size_t start, size_t end, size_t numSamples, gsl::span<AudioBuffer*> buffers, AudioBufferPool& bufferPool)
+{
+	for (size_t i = start; i < end; ++i) {
+		mixingEmitters[i]->mixTo(numSamples, buffers, *mixer, bufferPool);
+	}
+}
+
 void AudioEngine::removeFinishedEmitters()
 {
 	for (auto& e: emitters) {
@@ -14,6 +14,7 @@ namespace Halley {
 	class AudioMixer;
 	class IAudioClip;
 	class Resources;
+	class PartitionedMixJob;
 
     class AudioEngine
     {
@@ -45,11 +46,21 @@ namespace Halley {
 		void setGroupGain(const String& name, float gain);
 		int getGroupId(const String& group);
 
+		// Maximum number of emitters mixed at once. Beyond that, the lowest priority/quietest ones are virtualised.
+		void setMaxVoices(size_t maxVoices);
+
+		// Replaces the mixer picked by AudioMixer::makeMixer(), e.g. to compare implementations
+		void setMixer(std::unique_ptr<AudioMixer> mixer);
+
     private:
+		friend class PartitionedMixJob;
+
 		AudioSpec spec;
 		AudioOutputAPI* out;
 		std::unique_ptr<AudioMixer> mixer;
 		std::unique_ptr<AudioBufferPool> pool;
+		std::vector<std::unique_ptr<AudioBufferPool>> partitionPools;
+		std::vector<AudioBuffersRef> partitionBuffers;
 		std::unique_ptr<AudioResampler> outResampler;
 
 		std::atomic<bool> running;
@@ -58,6 +69,9 @@ namespace Halley {
 		std::condition_variable backBufferCondition;
 
 		std::vector<std::unique_ptr<AudioEmitter>> emitters;
+		std::vector<AudioEmitter*> activeEmitters;
+		std::vector<AudioEmitter*> mixingEmitters;
+		size_t maxVoices = 64;
 		std::vector<AudioChannelData> channels;
 		
 		std::map<size_t, std::vector<AudioEmitter*>> idToSource;
@@ -71,7 +85,18 @@ namespace Halley {
 
 		Random rng;
 
+		// The parallel mix in progress, read by mixPartition() on the mix workers
+		size_t partitionCount = 0;
+		size_t partitionSamples = 0;
+		gsl::span<AudioBuffer*> partitionOutput;
+		std::unique_ptr<PartitionedMixJob> mixJob;
+
 		void mixEmitters(size_t numSamples, size_t channels, gsl::span<AudioBuffer*> buffers);
+		void mixEmittersParallel(size_t numSamples, size_t channels, gsl::span<AudioBuffer*> buffers, size_t nPartitions);
+		void mixPartition(size_t i);
+		void mixEmitterRange(size_t start, size_t end, size_t numSamples, gsl::span<AudioBuffer*> buffers, AudioBufferPool& pool);
+		void updateEmitters();
+		void assignVoices(size_t numSamples);
 	    void removeFinishedEmitters();
 		void clearBuffer(gsl::span<AudioSamplePack> dst);
 
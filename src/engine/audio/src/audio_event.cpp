@@ -101,6 +101,7 @@ AudioEventActionPlay::AudioEventActionPlay(const ConfigNode& node)
 	minimumSpace = node["minimumSpace"].asFloat(0.0f);
 	delay = node["delay"].asFloat(0.0f);
 	loop = node["loop"].asBool(false);
+	priority = node["priority"].asInt(0);
 }
 
 void AudioEventActionPlay::run(AudioEngine& engine, size_t id, const AudioPosition& position) const
@@ -128,9 +129,11 @@ void AudioEventActionPlay::run(AudioEngine& engine, size_t id, const AudioPositi
 
 	std::shared_ptr<AudioSource> source = std::make_shared<AudioSourceClip>(clip, loop, lround(delay * sampleRate));
 	if (std::abs(curPitch - 1.0f) > 0.01f) {
-		source = std::make_shared<AudioFilterResample>(source, int(lround(sampleRate * curPitch)), sampleRate, engine.getPool());
+		source = std::make_shared<AudioFilterResample>(source, int(lround(sampleRate * curPitch)), sampleRate);
 	}
-	engine.addEmitter(id, std::make_unique<AudioEmitter>(source, position, curVolume, engine.getGroupId(group)));
+	auto emitter = std::make_unique<AudioEmitter>(source, position, curVolume, engine.getGroupId(group));
+	emitter->setPriority(priority);
+	engine.addEmitter(id, std::move(emitter));
 }
 
 AudioEventActionType AudioEventActionPlay::getType() const
@@ -147,6 +150,7 @@ void AudioEventActionPlay::serialize(Serializer& s) const
 	s << delay;
 	s << minimumSpace;
 	s << loop;
+	s << priority;
 }
 
 void AudioEventActionPlay::deserialize(Deserializer& s)
@@ -158,6 +162,7 @@ void AudioEventActionPlay::deserialize(Deserializer& s)
 	s >> delay;
 	s >> minimumSpace;
 	s >> loop;
+	s >> priority;
 }
 
 void AudioEventActionPlay::loadDependencies(const Resources& resources)
@@ -4,6 +4,7 @@
 #include "audio_emitter_behaviour.h"
 #include "halley/support/console.h"
 #include "halley/support/logger.h"
+#include "halley/support/profiler.h"
 #include "halley/core/resources/resources.h"
 #include "audio_event.h"
 
@@ -219,6 +220,13 @@ void AudioFacade::setOutputChannels(std::vector<AudioChannelData> audioChannelDa
 	});
 }
 
+void AudioFacade::setMaxVoices(size_t maxVoices)
+{
+	enqueue([=] () {
+		engine->setMaxVoices(maxVoices);
+	});
+}
+
 void AudioFacade::stopMusic(AudioHandle& handle, float fadeOutTime)
 {
 	if (fadeOutTime > 0.001f) {
@@ -250,6 +258,7 @@ void AudioFacade::onAudioException(std::exception& e)
 
 void AudioFacade::run()
 {
+	Profiler::setThreadName("Audio");
 	while (running) {
 		stepAudio();
 	}
@@ -257,6 +266,7 @@ void AudioFacade::run()
 
 void AudioFacade::stepAudio()
 {
+	HALLEY_PROFILE_SCOPE("Audio step");
 	try {
 		{
 			std::unique_lock<std::mutex> lock(audioMutex);
@@ -3,9 +3,8 @@
 
 using namespace Halley;
 
-AudioFilterResample::AudioFilterResample(std::shared_ptr<AudioSource> source, int fromHz, int toHz, AudioBufferPool& pool)
-	: pool(pool)
-	, source(source)
+AudioFilterResample::AudioFilterResample(std::shared_ptr<AudioSource> source, int fromHz, int toHz)
+	: source(source)
 	, fromHz(fromHz)
 	, toHz(toHz)
 {
@@ -36,13 +35,20 @@ bool AudioFilterResample::getAudioData(size_t numSamples, AudioSourceData& dstBu
 	}
 
 	// Read upstream data
-	auto srcBuffers = pool.getBuffers(nChannels, numSamplesSrc);
-	auto srcs = srcBuffers.getSampleSpans();
+	AudioSourceData srcs;
+	for (size_t i = 0; i < nChannels; ++i) {
+		if (srcBuffers[i].size() < numSamplesSrc) {
+			srcBuffers[i].resize(numSamplesSrc);
+		}
+		srcs[i] = gsl::span<AudioConfig::SampleFormat>(srcBuffers[i]);
+	}
 	bool playing = source->getAudioData(numSamplesSrc, srcs);
 
 	// Prepare temporary destination data
-	auto tmpBuffer = pool.getBuffer(numSamples + 2 * AudioSamplePack::NumSamples);
-	auto tmp = tmpBuffer.getSampleSpan();
+	if (tmpBuffer.size() < numSamples + 2 * AudioSamplePack::NumSamples) {
+		tmpBuffer.resize(numSamples + 2 * AudioSamplePack::NumSamples);
+	}
+	auto tmp = gsl::span<AudioConfig::SampleFormat>(tmpBuffer);
 	
 	// Resample
 	for (size_t channel = 0; channel < nChannels; ++channel) {
@@ -69,3 +75,17 @@ bool AudioFilterResample::getAudioData(size_t numSamples, AudioSourceData& dstBu
 
 	return playing;
 }
+
+bool AudioFilterResample::skipAudio(size_t numSamples)
+{
+	// Drop the resampler state, it'll start fresh once this is audible again
+	resamplers.clear();
+	for (auto& l: leftoverSamples) {
+		l.n = 0;
+	}
+
+	// Keep the fractional part around, so that skipping doesn't drift
+	const size_t total = numSamples * size_t(fromHz) + skipRemainder;
+	skipRemainder = total % size_t(toHz);
+	return source->skipAudio(total / size_t(toHz));
+}
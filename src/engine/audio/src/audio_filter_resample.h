@@ -8,18 +8,19 @@ namespace Halley
 	class AudioFilterResample : public AudioSource
 	{
 	public:
-		AudioFilterResample(std::shared_ptr<AudioSource> source, int fromHz, int toHz, AudioBufferPool& pool);
+		AudioFilterResample(std::shared_ptr<AudioSource> source, int fromHz, int toHz);
 
 		size_t getNumberOfChannels() const override;
 		bool isReady() const override;
 		bool getAudioData(size_t numSamples, AudioSourceData& dst) override;
+		bool skipAudio(size_t numSamples) override;
 
 	private:
-		AudioBufferPool& pool;
 		std::shared_ptr<AudioSource> source;
 		std::vector<std::unique_ptr<AudioResampler>> resamplers;
 		int fromHz;
 		int toHz;
+		size_t skipRemainder = 0;
 
 		struct LeftOverData
 		{
@@ -27,5 +28,9 @@ namespace Halley
 			size_t n = 0;
 		};
 		std::array<LeftOverData, AudioConfig::maxChannels> leftoverSamples;
+
+		// Scratch space owned by this filter, as emitters can be mixed on different threads
+		std::array<std::vector<AudioConfig::SampleFormat>, AudioConfig::maxChannels> srcBuffers;
+		std::vector<AudioConfig::SampleFormat> tmpBuffer;
 	};
 }
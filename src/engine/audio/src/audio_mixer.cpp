@@ -18,7 +18,7 @@ void AudioMixer::mixAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioS
 		}
 	} else {
 		// Interpolate the gain
-		const float scale = 1.0f / (dst.size() * AudioSamplePack::NumSamples);
+		const float scale = 1.0f / (nPacks * AudioSamplePack::NumSamples);
 		for (size_t i = 0; i < nPacks; ++i) {
 			for (size_t j = 0; j < AudioSamplePack::NumSamples; ++j) {
 				dst[i].samples[j] += src[i].samples[j] * lerp(gain0, gain1, (i * AudioSamplePack::NumSamples + j) * scale);
@@ -27,6 +27,16 @@ void AudioMixer::mixAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioS
 	}
 }
 
+void AudioMixer::sumAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioSamplePack> dst)
+{
+	const size_t nPacks = size_t(src.size());
+	for (size_t i = 0; i < nPacks; ++i) {
+		for (size_t j = 0; j < AudioSamplePack::NumSamples; ++j) {
+			dst[i].samples[j] += src[i].samples[j];
+		}
+	}
+}
+
 void AudioMixer::interleaveChannels(gsl::span<AudioSamplePack> dstBuffer, gsl::span<AudioBuffer*> src)
 {
 	size_t n = 0;
@@ -74,15 +84,9 @@ static inline unsigned long long _xgetbv(unsigned int index){
 
 #endif
 
-#ifdef HAS_AVX
-static bool hasAVX()
+bool AudioMixer::hasAVX()
 {
-#ifndef _MSC_VER
-    // It's crashing on Linux :(
-    return false;
-#endif
-
-#ifdef HAS_SSE
+#ifdef HAS_AVX
 	int regs[4];
 	int i = 1;
 
@@ -108,7 +112,6 @@ static bool hasAVX()
 	return false;
 #endif
 }
-#endif
 
 std::unique_ptr<AudioMixer> AudioMixer::makeMixer()
 {
@@ -118,7 +121,7 @@ std::unique_ptr<AudioMixer> AudioMixer::makeMixer()
 	} else {
 		return std::make_unique<AudioMixerSSE>();
 	}
-#elif HAS_SEE
+#elif defined(HAS_SSE)
 	return std::make_unique<AudioMixerSSE>();
 #else
 	return std::make_unique<AudioMixer>();
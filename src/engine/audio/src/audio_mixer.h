@@ -5,10 +5,8 @@
 
 #if defined(_M_X64) || defined(__x86_64__)
 #define HAS_SSE
-#if !defined(__linux__)
 #define HAS_AVX
 #endif
-#endif
 
 #if defined(_M_IX86) || defined(__i386)
 // Might not be available, but do we really care about such old processors?
@@ -23,8 +21,10 @@ namespace Halley
 		virtual ~AudioMixer() {}
 
 		virtual void mixAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioSamplePack> dst, float gainStart, float gainEnd);
+		virtual void sumAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioSamplePack> dst);
 		virtual void interleaveChannels(gsl::span<AudioSamplePack> dst, gsl::span<AudioBuffer*> src);
 		virtual void compressRange(gsl::span<AudioSamplePack> buffer);
 		static std::unique_ptr<AudioMixer> makeMixer();
+		static bool hasAVX();
 	};
 }
@@ -24,7 +24,7 @@ void AudioMixerSSE::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<
 			dst[i + 3] = _mm_add_ps(dst[i + 3], _mm_mul_ps(src[i + 3], gain));
 		}
 	} else {
-		const float sc = 1.0f / (dst.size() * 16);
+		const float sc = 1.0f / (nSamples * 4);
 		const float gainDiff = gain1 - gain0;
 
 		__m128 gain0p = { gain0, gain0, gain0, gain0 };
@@ -41,6 +41,20 @@ void AudioMixerSSE::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<
 	}
 }
 
+void AudioMixerSSE::sumAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<AudioSamplePack> dstRaw)
+{
+	gsl::span<const __m128> src(reinterpret_cast<const __m128*>(srcRaw.data()), srcRaw.size() * 4);
+	gsl::span<__m128> dst(reinterpret_cast<__m128*>(dstRaw.data()), dstRaw.size() * 4);
+	const size_t nSamples = size_t(src.size());
+
+	for (size_t i = 0; i < nSamples; i += 4) {
+		dst[i] = _mm_add_ps(dst[i], src[i]);
+		dst[i + 1] = _mm_add_ps(dst[i + 1], src[i + 1]);
+		dst[i + 2] = _mm_add_ps(dst[i + 2], src[i + 2]);
+		dst[i + 3] = _mm_add_ps(dst[i + 3], src[i + 3]);
+	}
+}
+
 void AudioMixerSSE::compressRange(gsl::span<AudioSamplePack> buffer)
 {
 	gsl::span<__m128> dst(reinterpret_cast<__m128*>(buffer.data()), buffer.size() * 4);
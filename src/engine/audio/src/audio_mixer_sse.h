@@ -8,6 +8,7 @@ namespace Halley
 	{
 	public:
 		void mixAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioSamplePack> dst, float gainStart, float gainEnd) override;
+		void sumAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioSamplePack> dst) override;
 		void compressRange(gsl::span<AudioSamplePack> buffer) override;
 	};
 }
@@ -0,0 +1,185 @@
+#include "audio_offline_renderer.h"
+#include "audio_engine.h"
+#include "audio_mixer.h"
+#include "halley/file/path.h"
+#include <cstring>
+#include <algorithm>
+
+using namespace Halley;
+
+namespace {
+	// Takes everything the engine generates, straight away
+	class AudioOutputMemory final : public AudioOutputAPI
+	{
+	public:
+		explicit AudioOutputMemory(std::vector<AudioConfig::SampleFormat>& dst)
+			: dst(dst)
+		{}
+
+		Vector<std::unique_ptr<const AudioDevice>> getAudioDevices() override { return {}; }
+		AudioSpec openAudioDevice(const AudioSpec& requestedFormat, const AudioDevice*, AudioCallback) override { return requestedFormat; }
+		void closeAudioDevice() override {}
+
+		void startPlayback() override {}
+		void stopPlayback() override {}
+
+		void queueAudio(gsl::span<const float> data) override
+		{
+			dst.insert(dst.end(), data.begin(), data.end());
+		}
+
+		bool needsMoreAudio() override { return true; }
+		bool needsAudioThread() const override { return false; }
+
+	private:
+		std::vector<AudioConfig::SampleFormat>& dst;
+	};
+
+	template <typename T>
+	void writeLE(Bytes& dst, T value)
+	{
+		for (size_t i = 0; i < sizeof(T); ++i) {
+			dst.push_back(Byte((uint64_t(value) >> (8 * i)) & 0xFF));
+		}
+	}
+
+	void writeTag(Bytes& dst, const char* tag)
+	{
+		dst.insert(dst.end(), tag, tag + 4);
+	}
+}
+
+AudioOfflineRenderer::AudioOfflineRenderer(int sampleRate, int bufferSize, std::unique_ptr<AudioMixer> mixer)
+	: engine(std::make_unique<AudioEngine>())
+	, output(std::make_unique<AudioOutputMemory>(samples))
+	, sampleRate(sampleRate)
+{
+	if (mixer) {
+		engine->setMixer(std::move(mixer));
+	}
+	engine->start(AudioSpec(sampleRate, 2, bufferSize, AudioSampleFormat::Float), *output);
+}
+
+AudioOfflineRenderer::~AudioOfflineRenderer()
+{
+}
+
+void AudioOfflineRenderer::postEvent(float time, std::shared_ptr<const AudioEvent> event, AudioPosition position)
+{
+	const size_t id = nextId++;
+	addAction(time, [=] (AudioEngine& e)
+	{
+		e.postEvent(id, event, position);
+	});
+}
+
+void AudioOfflineRenderer::play(float time, std::shared_ptr<const IAudioClip> clip, AudioPosition position, float volume, bool loop)
+{
+	const size_t id = nextId++;
+	addAction(time, [=] (AudioEngine& e)
+	{
+		e.play(id, clip, position, volume, loop);
+	});
+}
+
+void AudioOfflineRenderer::setListener(float time, AudioListenerData listener)
+{
+	addAction(time, [=] (AudioEngine& e)
+	{
+		e.setListener(listener);
+	});
+}
+
+void AudioOfflineRenderer::setMaxVoices(float time, size_t maxVoices)
+{
+	addAction(time, [=] (AudioEngine& e)
+	{
+		e.setMaxVoices(maxVoices);
+	});
+}
+
+size_t AudioOfflineRenderer::render(float duration)
+{
+	const size_t endFrame = framesRendered + size_t(std::max(0.0f, duration) * sampleRate);
+	size_t nBuffers = 0;
+
+	while (framesRendered < endFrame) {
+		while (nextAction < actions.size() && actions[nextAction].frame <= framesRendered) {
+			actions[nextAction++].run(*engine);
+		}
+
+		const size_t prevSize = samples.size();
+		engine->generateBuffer();
+		framesRendered += (samples.size() - prevSize) / 2;
+		++nBuffers;
+	}
+
+	return nBuffers;
+}
+
+size_t AudioOfflineRenderer::getNumberOfFrames() const
+{
+	return samples.size() / 2;
+}
+
+int AudioOfflineRenderer::getSampleRate() const
+{
+	return sampleRate;
+}
+
+gsl::span<const AudioConfig::SampleFormat> AudioOfflineRenderer::getSamples() const
+{
+	return samples;
+}
+
+void AudioOfflineRenderer::clearSamples()
+{
+	samples.clear();
+}
+
+Bytes AudioOfflineRenderer::toWAV() const
+{
+	constexpr uint16_t numChannels = 2;
+	constexpr uint16_t bytesPerSample = sizeof(float);
+	const auto dataSize = uint32_t(samples.size() * bytesPerSample);
+
+	Bytes result;
+	result.reserve(44 + dataSize);
+
+	writeTag(result, "RIFF");
+	writeLE<uint32_t>(result, 36 + dataSize);
+	writeTag(result, "WAVE");
+
+	writeTag(result, "fmt ");
+	writeLE<uint32_t>(result, 16);
+	writeLE<uint16_t>(result, 3); // IEEE float
+	writeLE<uint16_t>(result, numChannels);
+	writeLE<uint32_t>(result, uint32_t(sampleRate));
+	writeLE<uint32_t>(result, uint32_t(sampleRate) * numChannels * bytesPerSample);
+	writeLE<uint16_t>(result, numChannels * bytesPerSample);
+	writeLE<uint16_t>(result, bytesPerSample * 8);
+
+	writeTag(result, "data");
+	writeLE<uint32_t>(result, dataSize);
+	for (auto sample: samples) {
+		uint32_t bits;
+		memcpy(&bits, &sample, sizeof(bits));
+		writeLE<uint32_t>(result, bits);
+	}
+
+	return result;
+}
+
+void AudioOfflineRenderer::saveWAV(const Path& path) const
+{
+	Path::writeFile(path, toWAV());
+}
+
+void AudioOfflineRenderer::addAction(float time, std::function<void(AudioEngine&)> action)
+{
+	const size_t frame = size_t(std::max(0.0f, time) * sampleRate);
+
+	// Keep actions sorted, but in the order they were added for the same time
+	auto iter = std::upper_bound(actions.begin() + nextAction, actions.end(), frame, [] (size_t f, const Action& a) { return f < a.frame; });
+	actions.insert(iter, Action{ frame, std::move(action) });
+}
@@ -15,5 +15,8 @@ namespace Halley
 		virtual size_t getNumberOfChannels() const = 0;
 		virtual bool isReady() const { return true; }
 		virtual bool getAudioData(size_t numSamples, AudioSourceData& dst) = 0;
+
+		// Advances playback without generating any data, used for virtual voices. Same return value as getAudioData.
+		virtual bool skipAudio(size_t numSamples) = 0;
 	};
 }
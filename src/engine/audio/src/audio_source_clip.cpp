@@ -1,6 +1,7 @@
 #include "audio_source_clip.h"
 #include <utility>
 #include "audio_clip.h"
+#include "audio_clip_streamer.h"
 
 using namespace Halley;
 
@@ -20,15 +21,45 @@ size_t AudioSourceClip::getNumberOfChannels() const
 
 bool AudioSourceClip::isReady() const
 {
-	return clip->isLoaded();
+	if (!clip->isLoaded()) {
+		return false;
+	}
+	if (!initialised) {
+		// Streaming clips get a streamer for each playback, so playbacks at different positions don't fight over the decoder.
+		// If another playback just took the primed one, wait for the decode worker to prime the next.
+		if (clip->isStreaming()) {
+			streamer = clip->takeStreamer();
+			if (!streamer) {
+				return false;
+			}
+		}
+		initialised = true;
+	}
+	if (streamer) {
+		return streamer->isReady();
+	}
+
+	// Compressed clips decode off the audio thread, so make sure the first chunk is there before starting
+	return clip->prefetch(size_t(std::max(playbackPos, int64_t(0))));
 }
 
-bool AudioSourceClip::getAudioData(size_t samplesRequested, AudioSourceData& dstChannels)
+bool AudioSourceClip::prefetch(size_t numSamples)
 {
-	Expects(isReady());
-	if (!initialised) {
-		initialised = true;
+	if (!isReady()) {
+		return false;
+	}
+
+	const size_t length = clip->getLength();
+	const size_t pos = std::min(size_t(std::max(playbackPos, int64_t(0))), length);
+	if (streamer) {
+		return streamer->prefetch(pos, std::min(numSamples, length - pos));
 	}
+	return clip->prefetch(pos);
+}
+
+bool AudioSourceClip::getAudioData(size_t samplesRequested, AudioSourceData& dstChannels)
+{
+	Expects(initialised); // isReady() must have been true before playback started
 	const auto playbackLength = int64_t(clip->getLength());
 
 	bool isPlaying = true;
@@ -73,7 +104,7 @@ bool AudioSourceClip::getAudioData(size_t samplesRequested, AudioSourceData& dst
 			// We have some samples that we can read, so go ahead with reading them
 			for (size_t srcChannel = 0; srcChannel < nChannels; ++srcChannel) {
 				auto dst = gsl::span<AudioConfig::SampleFormat>(dstChannels[srcChannel].data() + samplesWritten, samplesToRead);
-				size_t nCopied = clip->copyChannelData(srcChannel, size_t(playbackPos), samplesToRead, dst);
+				size_t nCopied = copyChannelData(srcChannel, size_t(playbackPos), samplesToRead, dst);
 				Expects(nCopied <= samplesRequested * sizeof(AudioConfig::SampleFormat));
 			}
 
@@ -93,3 +124,46 @@ bool AudioSourceClip::getAudioData(size_t samplesRequested, AudioSourceData& dst
 
 	return isPlaying;
 }
+
+bool AudioSourceClip::skipAudio(size_t numSamples)
+{
+	Expects(initialised);
+	const auto playbackLength = int64_t(clip->getLength());
+	auto samplesLeft = int64_t(numSamples);
+
+	// Delay
+	if (playbackPos < 0) {
+		const int64_t delaySamples = std::min(-playbackPos, samplesLeft);
+		playbackPos += delaySamples;
+		samplesLeft -= delaySamples;
+	}
+
+	while (samplesLeft > 0) {
+		if (playbackPos >= playbackLength) {
+			if (!looping) {
+				return false;
+			}
+			playbackPos = int64_t(clip->getLoopPoint());
+			if (playbackPos >= playbackLength) {
+				looping = false;
+				playbackPos = playbackLength;
+				return false;
+			}
+		}
+
+		const int64_t toSkip = std::min(samplesLeft, playbackLength - playbackPos);
+		playbackPos += toSkip;
+		samplesLeft -= toSkip;
+	}
+
+	return true;
+}
+
+size_t AudioSourceClip::copyChannelData(size_t channelN, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst)
+{
+	if (streamer) {
+		return streamer->copyChannelData(channelN, pos, len, dst);
+	} else {
+		return clip->copyChannelData(channelN, pos, len, dst);
+	}
+}
@@ -3,6 +3,8 @@
 
 namespace Halley
 {
+	class AudioClipStreamer;
+
 	class AudioSourceClip : public AudioSource
 	{
 	public:
@@ -10,14 +12,22 @@ namespace Halley
 
 		size_t getNumberOfChannels() const override;
 		bool getAudioData(size_t numSamples, AudioSourceData& dst) override;
+		bool skipAudio(size_t numSamples) override;
 		bool isReady() const override;
 
+		// True if the next numSamples can be mixed without waiting on the decoder. Otherwise, asks for them to be decoded.
+		// Must be called from the thread that mixes this source.
+		bool prefetch(size_t numSamples);
+
 	private:
 		const std::shared_ptr<const IAudioClip> clip;
+		mutable std::shared_ptr<AudioClipStreamer> streamer;
 		
 		int64_t playbackPos = 0;
 
-		bool initialised = false;
+		mutable bool initialised = false;
 		bool looping;
+
+		size_t copyChannelData(size_t channelN, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst);
 	};
 }
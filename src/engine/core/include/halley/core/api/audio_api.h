@@ -151,6 +151,7 @@ namespace Halley
 		virtual void setMasterVolume(float gain = 1.0f) = 0;
 		virtual void setGroupVolume(const String& groupName, float gain = 1.0f) = 0;
 		virtual void setOutputChannels(std::vector<AudioChannelData> audioChannelData) = 0;
+		virtual void setMaxVoices(size_t maxVoices) = 0;
 
 		virtual void setListener(AudioListenerData listener) = 0;
 	};
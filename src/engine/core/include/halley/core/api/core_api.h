@@ -10,6 +10,7 @@ namespace Halley
 	class Resources;
 	class Stage;
 	class HalleyStatics;
+	class World;
 
 	enum class CoreAPITimer
 	{
@@ -34,5 +35,8 @@ namespace Halley
 		virtual const Environment& getEnvironment() = 0;
 
 		virtual int64_t getTime(CoreAPITimer timer, TimeLine tl, StopwatchAveraging::Mode mode) const = 0;
+
+		// The world whose systems are reported to the DevCon server, if connected. Cleared when the stage changes; set it back to nullptr if it's destroyed before that.
+		virtual void setTelemetryWorld(World* world) = 0;
 	};
 }
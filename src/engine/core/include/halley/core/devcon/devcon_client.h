@@ -3,6 +3,7 @@
 #include "halley/text/halleystring.h"
 #include "halley/support/logger.h"
 #include "devcon_server.h"
+#include <chrono>
 
 namespace Halley
 {
@@ -21,13 +22,20 @@ namespace Halley
 
 		void onReceiveReloadAssets(const DevCon::ReloadAssetsMsg& msg);
 
+		bool isConnected() const;
+		bool isTelemetryDue() const;
+		void sendTelemetry(DevCon::TelemetrySample sample);
+
 	private:
+		constexpr static std::chrono::milliseconds telemetryInterval = std::chrono::milliseconds(500);
+
 		const HalleyAPI& api;
 		std::unique_ptr<NetworkService> service;
 		String address;
 		int port;
 
 		std::shared_ptr<MessageQueue> queue;
+		std::chrono::steady_clock::time_point lastTelemetry;
 
 		void connect();
 		void log(LoggerLevel level, const String& msg) override;
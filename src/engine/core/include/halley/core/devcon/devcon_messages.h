@@ -1,12 +1,16 @@
 #pragma once
 #include "halley/support/logger.h"
 #include "halley/net/connection/network_message.h"
+#include "halley/time/halleytime.h"
+#include "halley/text/halleystring.h"
 #include <gsl/gsl>
+#include <array>
+#include <vector>
 
 namespace Halley
 {
 	class Serializer;
-	class String;
+	class Deserializer;
 	class MessageQueue;
 
 	namespace DevCon
@@ -17,7 +21,40 @@ namespace Halley
 		enum class MessageType
 		{
 			Log,
-			ReloadAssets
+			ReloadAssets,
+			Telemetry
+		};
+
+		struct TelemetrySystem
+		{
+			String name;
+			TimeLine timeline = TimeLine::FixedUpdate;
+			int64_t averageTime = 0; // Nanoseconds
+			uint32_t entityCount = 0;
+
+			void serialize(Serializer& s) const;
+			void deserialize(Deserializer& s);
+		};
+
+		// A snapshot of how the game is running, sent periodically to the DevCon server. Times are averaged over recent frames.
+		struct TelemetrySample
+		{
+			uint64_t frame = 0;
+			std::array<int64_t, int(TimeLine::NUMBER_OF_TIMELINES)> engineTime = {};
+			std::array<int64_t, int(TimeLine::NUMBER_OF_TIMELINES)> gameTime = {};
+			int64_t vsyncTime = 0;
+
+			uint32_t entityCount = 0;
+			std::vector<TelemetrySystem> systems; // Only if a world was registered, see CoreAPI::setTelemetryWorld()
+
+			uint32_t drawCalls = 0;
+			uint32_t triangles = 0;
+			uint32_t vertices = 0;
+
+			uint64_t memoryUsage = 0; // Resident bytes, or 0 if the platform doesn't report it
+
+			void serialize(Serializer& s) const;
+			void deserialize(Deserializer& s);
 		};
 
 
@@ -60,5 +97,21 @@ namespace Halley
 		private:
 			std::vector<String> ids;
 		};
+
+		class TelemetryMsg : public DevConMessage
+		{
+		public:
+			TelemetryMsg(gsl::span<const gsl::byte> data);
+			TelemetryMsg(TelemetrySample sample);
+
+			void serialize(Serializer& s) const override;
+
+			const TelemetrySample& getSample() const;
+
+			MessageType getMessageType() const override;
+
+		private:
+			TelemetrySample sample;
+		};
 	}
 }
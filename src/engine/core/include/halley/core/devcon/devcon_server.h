@@ -3,6 +3,8 @@
 #include <vector>
 #include <memory>
 #include "halley/text/halleystring.h"
+#include "halley/data_structures/circular_buffer.h"
+#include "devcon_messages.h"
 #include <set>
 
 namespace Halley
@@ -13,8 +15,6 @@ namespace Halley
 
 	namespace DevCon {
 		constexpr static int devConPort = 12500;
-		class LogMsg;
-		class ReloadAssetsMsg;
 	}
 
 	class DevConServerConnection
@@ -26,11 +26,18 @@ namespace Halley
 		
 		void reloadAssets(const std::vector<String>& assetIds);
 
+		// Most recent first
+		const CircularBuffer<DevCon::TelemetrySample>& getTelemetry() const;
+
 	private:
+		constexpr static size_t telemetryHistorySize = 1200; // Ten minutes, at the rate the client sends them
+
 		std::shared_ptr<IConnection> connection;
 		std::shared_ptr<MessageQueue> queue;
+		CircularBuffer<DevCon::TelemetrySample> telemetry;
 
 		void onReceiveLogMsg(const DevCon::LogMsg& msg);
+		void onReceiveTelemetryMsg(const DevCon::TelemetryMsg& msg);
 	};
 
 	class DevConServer
@@ -43,6 +50,8 @@ namespace Halley
 		void reloadAssets(std::vector<String> assetIds);
 		void reloadAssets(std::set<String> assetIds);
 
+		const std::vector<std::shared_ptr<DevConServerConnection>>& getConnections() const;
+
 	private:
 		std::unique_ptr<NetworkService> service;
 		std::vector<std::shared_ptr<DevConServerConnection>> connections;
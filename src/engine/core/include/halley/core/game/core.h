@@ -39,6 +39,7 @@ namespace Halley
 		Resources& getResources() override;
 		const Environment& getEnvironment() override;
 		int64_t getTime(CoreAPITimer timer, TimeLine tl, StopwatchAveraging::Mode mode) const override;
+		void setTelemetryWorld(World* world) override;
 
 		void onFixedUpdate(Time time) override;
 		void onVariableUpdate(Time time) override;
@@ -74,6 +75,7 @@ namespace Halley
 
 		void pumpEvents(Time time);
 		void pumpAudio();
+		void sendTelemetry();
 
 		std::array<StopwatchAveraging, int(TimeLine::NUMBER_OF_TIMELINES)> engineTimers;
 		std::array<StopwatchAveraging, int(TimeLine::NUMBER_OF_TIMELINES)> gameTimers;
@@ -102,6 +104,8 @@ namespace Halley
 		std::unique_ptr<RedirectStream> out;
 
 		std::unique_ptr<DevConClient> devConClient;
+		World* telemetryWorld = nullptr;
+		uint64_t frameNumber = 0;
 
 		TreeMap<PluginType, Vector<std::unique_ptr<Plugin>>> plugins;
 		HalleyStatics statics;
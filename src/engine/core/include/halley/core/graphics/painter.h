@@ -14,11 +14,13 @@ namespace Halley
 	class Camera;
 	class RenderContext;
 	class Core;
+	class RenderCommandBuffer;
 
 	class Painter
 	{
 		friend class RenderContext;
 		friend class Core;
+		friend class RenderCommandBuffer;
 
 		struct PainterVertexData
 		{
@@ -58,6 +60,9 @@ namespace Halley
 		// Draw one sliced sprite. Slices -> x = left, y = top, z = right, w = bottom, in [0..1] space relative to the texture
 		void drawSlicedSprite(std::shared_ptr<Material> material, Vector2f scale, Vector4f slices, const void* vertexData);
 
+		// Replays the draw calls recorded into a command buffer, in order
+		void execute(const RenderCommandBuffer& buffer);
+
 		size_t getNumDrawCalls() const { return nDrawCalls; }
 		size_t getNumVertices() const { return nVertices; }
 		size_t getNumTriangles() const { return nTriangles; }
@@ -113,17 +118,23 @@ namespace Halley
 		void endRender();
 		
 		void resetPending();
-		void startDrawCall(std::shared_ptr<Material>& material);
+		void startDrawCall(const std::shared_ptr<Material>& material);
 		void flushPending();
 		void executeDrawTriangles(Material& material, size_t numVertices, void* vertexData, size_t numIndices, unsigned short* indices);
 
 		void makeSpaceForPendingVertices(size_t numBytes);
 		void makeSpaceForPendingIndices(size_t numIndices);
-		PainterVertexData addDrawData(std::shared_ptr<Material>& material, size_t numVertices, size_t numIndices, bool standardQuadsOnly);
+		PainterVertexData addDrawData(const std::shared_ptr<Material>& material, size_t numVertices, size_t numIndices, bool standardQuadsOnly);
 
 		unsigned short* getStandardQuadIndices(size_t numQuads);
 		void generateQuadIndicesOffset(unsigned short firstVertex, unsigned short lineStride, unsigned short* target);
 
+		constexpr static size_t slicedSpriteVertices = 16;
+		constexpr static size_t slicedSpriteIndices = 9 * 6;
+		static void writeSpriteVertices(const MaterialDefinition& material, size_t numSprites, const void* vertexData, char* dst);
+		static void writeSlicedSpriteVertices(const MaterialDefinition& material, Vector2f scale, Vector4f slices, const void* vertexData, char* dst);
+		void generateSlicedSpriteIndices(unsigned short firstIndex, unsigned short* dstIndex);
+
 		void updateProjection();
 
 		Rect4i getRectangleForActiveRenderTarget(Rect4i rectangle);
@@ -0,0 +1,81 @@
+#pragma once
+#include <memory>
+#include <atomic>
+#include <halley/data_structures/vector.h>
+#include <halley/maths/rect.h>
+#include <halley/maths/vector4.h>
+
+namespace Halley
+{
+	class Material;
+	class Painter;
+
+	// Records draw calls so they can be generated away from the render thread and replayed later with Painter::execute().
+	// Vertices are expanded at record time, so replaying a buffer is mostly a copy into the painter's batch.
+	// A buffer must only be recorded by one thread at a time.
+	class RenderCommandBuffer
+	{
+		friend class Painter;
+
+	public:
+		void clear();
+		bool isEmpty() const { return commands.empty(); }
+
+		// Same semantics as the equivalent Painter methods
+		void drawQuads(std::shared_ptr<Material> material, size_t numVertices, const void* vertexData);
+		void drawSprites(std::shared_ptr<Material> material, size_t numSprites, const void* vertexData);
+		void drawSlicedSprite(std::shared_ptr<Material> material, Vector2f scale, Vector4f slices, const void* vertexData);
+
+		void setRelativeClip(Rect4f rect);
+		void setClip();
+
+	private:
+		enum class CommandType
+		{
+			Quads,
+			SlicedSprite,
+			RelativeClip,
+			ResetClip
+		};
+
+		struct Command
+		{
+			CommandType type;
+			std::shared_ptr<Material> material;
+			size_t vertexOffset = 0;
+			size_t numVertices = 0;
+			Rect4f clip;
+		};
+
+		Vector<Command> commands;
+		Vector<char> vertices;
+
+		char* addVertices(const std::shared_ptr<Material>& material, CommandType type, size_t numVertices);
+	};
+
+	// Lock-free, ordered hand-off of command buffers from any number of recording threads to the render thread.
+	// Each buffer is submitted against a sequence number, and the painter replays them strictly in sequence order,
+	// starting on the first ones while later ones are still being recorded.
+	class RenderCommandQueue
+	{
+	public:
+		RenderCommandQueue();
+		~RenderCommandQueue();
+
+		// Not thread-safe; only call when no submissions are in flight
+		void reset(size_t count);
+
+		// Can be called from any thread. The buffer must stay alive and untouched until it's been executed.
+		void submit(size_t sequence, const RenderCommandBuffer& buffer);
+
+		// Replays all buffers that are ready, in order, returning how many were executed. Render thread only.
+		size_t executeReady(Painter& painter);
+		bool isDone() const;
+
+	private:
+		std::unique_ptr<std::atomic<const RenderCommandBuffer*>[]> slots;
+		size_t capacity = 0;
+		size_t count = 0;
+		size_t next = 0;
+	};
+}
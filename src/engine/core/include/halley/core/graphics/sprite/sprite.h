@@ -16,6 +16,7 @@ namespace Halley
 	class Texture;
 	class MaterialDefinition;
 	class Painter;
+	class RenderCommandBuffer;
 
 	struct SpriteVertexAttrib
 	{
@@ -45,6 +46,15 @@ namespace Halley
 		static void draw(const Sprite* sprites, size_t n, Painter& painter);
 		static void drawMixedMaterials(const Sprite* sprites, size_t n, Painter& painter);
 
+		// Records the sprite into a command buffer instead, so it can be generated away from the render thread
+		void draw(RenderCommandBuffer& buffer) const;
+		static void drawMixedMaterials(const Sprite* sprites, size_t n, RenderCommandBuffer& buffer);
+
+		// Draws sprites sharing the same material with a single call; they must all be batchable
+		static void drawBatch(const Sprite* const* sprites, size_t n, Painter& painter);
+		static void drawBatch(const Sprite* const* sprites, size_t n, RenderCommandBuffer& buffer);
+		bool isBatchable() const;
+
 		Sprite& setMaterial(Resources& resources, String materialName = "");
 		Sprite& setMaterial(std::shared_ptr<Material> m);
 		Material& getMaterial() const { return *material; }
@@ -118,6 +128,11 @@ namespace Halley
 		Maybe<Rect4f> clip;
 		bool absoluteClip = false;
 		bool visible = true;
+
+		template <typename T> void doDrawNormal(T& target) const;
+		template <typename T> void doDrawSliced(T& target, Vector4s slices) const;
+		template <typename T, typename F> static void doDraw(size_t n, F getSprite, T& target);
+		template <typename T> static void doDrawMixedMaterials(const Sprite* sprites, size_t n, T& target);
 		bool flip = false;
 		bool sliced = false;
 
@@ -2,8 +2,12 @@
 
 #include <halley/data_structures/vector.h>
 #include <cstddef>
+#include <cstdint>
 #include "halley/maths/rect.h"
+#include "halley/core/graphics/render_command_buffer.h"
 #include <limits>
+#include <memory>
+#include <mutex>
 
 namespace Halley
 {
@@ -25,22 +29,26 @@ namespace Halley
 	public:
 		SpritePainterEntry(const Sprite& sprite, int mask, int layer, float tieBreaker);
 		SpritePainterEntry(const TextRenderer& text, int mask, int layer, float tieBreaker);
-		SpritePainterEntry(SpritePainterEntryType type, size_t spriteIdx, int mask, int layer, float tieBreaker);
+		SpritePainterEntry(SpritePainterEntryType type, size_t spriteIdx, int mask, uint64_t key);
 
-		bool operator<(const SpritePainterEntry& o) const;
 		SpritePainterEntryType getType() const;
 		const Sprite& getSprite() const;
 		const TextRenderer& getText() const;
 		size_t getIndex() const;
 		int getMask() const;
+		uint64_t getKey() const;
+
+		// Sort keys pack the layer (top 16 bits), the tie breaker (next 32 bits), and a hash of the material (low 16 bits),
+		// so that sprites at the same depth sharing a material end up next to each other
+		static uint64_t makeKey(int layer, float tieBreaker, uint16_t materialBits);
+		static uint64_t makeKey(const Sprite& sprite, int layer, float tieBreaker);
 
 	private:
 		const void* ptr = nullptr;
 		unsigned int index = std::numeric_limits<unsigned int>::max();
 		SpritePainterEntryType type;
-		int layer;
 		int mask;
-		float tieBreaker;
+		uint64_t key;
 	};
 
 	class SpritePainter
@@ -53,13 +61,35 @@ namespace Halley
 		void addCopy(const TextRenderer& text, int mask, int layer, float tieBreaker);
 		void draw(int mask, Painter& painter);
 
+		// When enabled (default), large draws have their vertices generated in parallel on the CPU executor,
+		// in chunks which are then replayed on the painter in order
+		void setParallelDraw(bool enabled);
+
 	private:
+		struct SortEntry
+		{
+			uint64_t key;
+			size_t index;
+		};
+
 		Vector<SpritePainterEntry> sprites;
+		Vector<SortEntry> order;
+		Vector<SortEntry> orderScratch;
 		Vector<Sprite> cachedSprites;
 		Vector<TextRenderer> cachedText;
 		bool dirty = false;
+		bool parallelDraw = true;
+
+		Vector<std::unique_ptr<RenderCommandBuffer>> commandBuffers;
+		RenderCommandQueue commandQueue;
+
+		// TextRenderer fills its glyph and material caches lazily (and copies share materials),
+		// so text is never recorded by two workers at once
+		mutable std::mutex textMutex;
+
+		void sort();
+		void drawParallel(int mask, Painter& painter, Rect4f view);
 
-		void draw(const Sprite& sprite, Painter& painter, Rect4f view);
-		void draw(const TextRenderer& text, Painter& painter, Rect4f view);
+		template <typename T> void drawRange(size_t start, size_t end, int mask, T& target, Rect4f view) const;
 	};
 }
@@ -15,6 +15,7 @@ namespace Halley
 	class Painter;
 	class Material;
 	class Sprite;
+	class RenderCommandBuffer;
 
 	using ColourOverride = std::pair<size_t, Maybe<Colour4f>>;
 
@@ -48,6 +49,7 @@ namespace Halley
 
 		void generateSprites(std::vector<Sprite>& sprites) const;
 		void draw(Painter& painter) const;
+		void draw(RenderCommandBuffer& buffer) const;
 
 		void setSpriteFilter(SpriteFilter f);
 
@@ -99,6 +101,8 @@ namespace Halley
 		mutable bool glyphsDirty = true;
 		mutable bool positionDirty = true;
 
+		template <typename T> void doDraw(T& target) const;
+
 		std::shared_ptr<Material> getMaterial(const Font& font) const;
 		void updateMaterial(Material& material, const Font& font) const;
 		void updateMaterialForFont(const Font& font) const;
@@ -12,6 +12,7 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 
 #include "graphics/blend.h"
 #include "graphics/painter.h"
+#include "graphics/render_command_buffer.h"
 #include "graphics/render_context.h"
 #include "graphics/shader.h"
 #include "graphics/texture.h"
@@ -8,6 +8,8 @@
 
 using namespace Halley;
 
+constexpr std::chrono::milliseconds DevConClient::telemetryInterval;
+
 DevConClient::DevConClient(const HalleyAPI& api, std::unique_ptr<NetworkService> service, const String& address, int port)
 	: api(api)
 	, service(std::move(service))
@@ -88,6 +90,23 @@ void DevConClient::onReceiveReloadAssets(const DevCon::ReloadAssetsMsg& msg)
 	}
 }
 
+bool DevConClient::isConnected() const
+{
+	return queue->isConnected();
+}
+
+bool DevConClient::isTelemetryDue() const
+{
+	return queue->isConnected() && std::chrono::steady_clock::now() - lastTelemetry >= telemetryInterval;
+}
+
+void DevConClient::sendTelemetry(DevCon::TelemetrySample sample)
+{
+	lastTelemetry = std::chrono::steady_clock::now();
+	queue->enqueue(std::make_unique<DevCon::TelemetryMsg>(std::move(sample)), 0);
+	queue->sendAll();
+}
+
 void DevConClient::connect()
 {
 	queue = std::make_shared<MessageQueueTCP>(service->connect(address, port));
@@ -12,6 +12,7 @@ void DevCon::setupMessageQueue(MessageQueue& queue)
 
 	queue.addFactory<LogMsg>();
 	queue.addFactory<ReloadAssetsMsg>();
+	queue.addFactory<TelemetryMsg>();
 }
 
 LogMsg::LogMsg(gsl::span<const gsl::byte> data)
@@ -72,3 +73,78 @@ MessageType ReloadAssetsMsg::getMessageType() const
 {
 	return MessageType::ReloadAssets;
 }
+
+
+void TelemetrySystem::serialize(Serializer& s) const
+{
+	s << name;
+	s << timeline;
+	s << averageTime;
+	s << entityCount;
+}
+
+void TelemetrySystem::deserialize(Deserializer& s)
+{
+	s >> name;
+	s >> timeline;
+	s >> averageTime;
+	s >> entityCount;
+}
+
+void TelemetrySample::serialize(Serializer& s) const
+{
+	s << frame;
+	for (size_t i = 0; i < engineTime.size(); ++i) {
+		s << engineTime[i];
+		s << gameTime[i];
+	}
+	s << vsyncTime;
+	s << entityCount;
+	s << systems;
+	s << drawCalls;
+	s << triangles;
+	s << vertices;
+	s << memoryUsage;
+}
+
+void TelemetrySample::deserialize(Deserializer& s)
+{
+	s >> frame;
+	for (size_t i = 0; i < engineTime.size(); ++i) {
+		s >> engineTime[i];
+		s >> gameTime[i];
+	}
+	s >> vsyncTime;
+	s >> entityCount;
+	s >> systems;
+	s >> drawCalls;
+	s >> triangles;
+	s >> vertices;
+	s >> memoryUsage;
+}
+
+
+TelemetryMsg::TelemetryMsg(gsl::span<const gsl::byte> data)
+{
+	Deserializer s(data);
+	s >> sample;
+}
+
+TelemetryMsg::TelemetryMsg(TelemetrySample sample)
+	: sample(std::move(sample))
+{}
+
+void TelemetryMsg::serialize(Serializer& s) const
+{
+	s << sample;
+}
+
+const TelemetrySample& TelemetryMsg::getSample() const
+{
+	return sample;
+}
+
+MessageType TelemetryMsg::getMessageType() const
+{
+	return MessageType::Telemetry;
+}
@@ -12,6 +12,7 @@ using namespace Halley;
 DevConServerConnection::DevConServerConnection(std::shared_ptr<IConnection> conn)
 	: connection(conn)
 	, queue(std::make_shared<MessageQueueTCP>(connection))
+	, telemetry(telemetryHistorySize)
 {
 	DevCon::setupMessageQueue(*queue);
 }
@@ -25,6 +26,10 @@ void DevConServerConnection::update()
 			onReceiveLogMsg(dynamic_cast<DevCon::LogMsg&>(msg));
 			break;
 
+		case DevCon::MessageType::Telemetry:
+			onReceiveTelemetryMsg(dynamic_cast<DevCon::TelemetryMsg&>(msg));
+			break;
+
 		case DevCon::MessageType::ReloadAssets:
 			// TODO;
 
@@ -45,6 +50,16 @@ void DevConServerConnection::onReceiveLogMsg(const DevCon::LogMsg& msg)
 	Logger::log(msg.getLevel(), "[REMOTE] " + msg.getMessage());
 }
 
+void DevConServerConnection::onReceiveTelemetryMsg(const DevCon::TelemetryMsg& msg)
+{
+	telemetry.add(msg.getSample());
+}
+
+const CircularBuffer<DevCon::TelemetrySample>& DevConServerConnection::getTelemetry() const
+{
+	return telemetry;
+}
+
 DevConServer::DevConServer(std::unique_ptr<NetworkService> s, int port)
 	: service(std::move(s))
 {
@@ -82,3 +97,8 @@ void DevConServer::reloadAssets(std::set<String> assetIdsSet)
 	}
 	reloadAssets(std::move(assetIds));
 }
+
+const std::vector<std::shared_ptr<DevConServerConnection>>& DevConServer::getConnections() const
+{
+	return connections;
+}
@@ -12,6 +12,7 @@
 #include "resources/standard_resources.h"
 #include <halley/os/os.h>
 #include <halley/support/debug.h>
+#include <halley/support/profiler.h>
 #include <halley/support/console.h>
 #include <halley/concurrency/concurrent.h>
 #include <fstream>
@@ -19,6 +20,10 @@
 #include <ctime>
 #include "../dummy/dummy_plugins.h"
 #include "halley/core/devcon/devcon_client.h"
+#include "halley/core/devcon/devcon_messages.h"
+#include "halley/core/graphics/painter.h"
+#include <halley/entity/world.h>
+#include <halley/entity/system.h>
 #include "halley/net/connection/network_service.h"
 
 #ifdef _MSC_VER
@@ -161,6 +166,7 @@ void Core::init()
 	if (api->system) {
 		api->system->setThreadName("main");
 	}
+	Profiler::setThreadName("main");
 
 	// Resources
 	initResources();
@@ -292,11 +298,17 @@ void Core::onVariableUpdate(Time time)
 	if (isRunning()) {
 		doRender(time);
 	}
+
+	++frameNumber;
+	if (devConClient && devConClient->isTelemetryDue()) {
+		sendTelemetry();
+	}
 }
 
 void Core::doFixedUpdate(Time time)
 {
 	HALLEY_DEBUG_TRACE();
+	HALLEY_PROFILE_SCOPE("Fixed update");
 	auto& engineTimer = engineTimers[int(TimeLine::FixedUpdate)];
 	auto& gameTimer = gameTimers[int(TimeLine::FixedUpdate)];
 	engineTimer.beginSample();
@@ -319,6 +331,7 @@ void Core::doFixedUpdate(Time time)
 void Core::doVariableUpdate(Time time)
 {
 	HALLEY_DEBUG_TRACE();
+	HALLEY_PROFILE_SCOPE("Variable update");
 	auto& engineTimer = engineTimers[int(TimeLine::VariableUpdate)];
 	auto& gameTimer = gameTimers[int(TimeLine::VariableUpdate)];
 	engineTimer.beginSample();
@@ -349,6 +362,7 @@ void Core::doVariableUpdate(Time time)
 void Core::doRender(Time)
 {
 	HALLEY_DEBUG_TRACE();
+	HALLEY_PROFILE_SCOPE("Render");
 	auto& engineTimer = engineTimers[int(TimeLine::Render)];
 	auto& gameTimer = gameTimers[int(TimeLine::Render)];
 	bool gameSampled = false;
@@ -383,7 +397,10 @@ void Core::doRender(Time)
 		painter->endRender();
 
 		vsyncTimer.beginSample();
-		api->video->finishRender();
+		{
+			HALLEY_PROFILE_SCOPE("Present");
+			api->video->finishRender();
+		}
 		vsyncTimer.endSample();
 	}
 
@@ -460,6 +477,52 @@ int64_t Core::getTime(CoreAPITimer timerType, TimeLine tl, StopwatchAveraging::M
 	}
 }
 
+void Core::setTelemetryWorld(World* world)
+{
+	telemetryWorld = world;
+
+	// System timings are only collected in dev mode by default, but we want them on release builds too when they're being reported
+	if (world && devConClient) {
+		world->setCollectMetrics(true);
+	}
+}
+
+void Core::sendTelemetry()
+{
+	DevCon::TelemetrySample sample;
+	sample.frame = frameNumber;
+	for (int i = 0; i < int(TimeLine::NUMBER_OF_TIMELINES); ++i) {
+		sample.engineTime[i] = engineTimers[i].averageElapsedNanoSeconds();
+		sample.gameTime[i] = gameTimers[i].averageElapsedNanoSeconds();
+	}
+	sample.vsyncTime = vsyncTimer.averageElapsedNanoSeconds();
+
+	if (telemetryWorld) {
+		sample.entityCount = uint32_t(telemetryWorld->numEntities());
+		for (int i = 0; i < int(TimeLine::NUMBER_OF_TIMELINES); ++i) {
+			const auto timeline = TimeLine(i);
+			for (auto& system: telemetryWorld->getSystems(timeline)) {
+				DevCon::TelemetrySystem s;
+				s.name = system->getName();
+				s.timeline = timeline;
+				s.averageTime = system->getNanoSecondsTakenAvg();
+				s.entityCount = uint32_t(system->getEntityCount());
+				sample.systems.push_back(std::move(s));
+			}
+		}
+	}
+
+	if (painter) {
+		sample.drawCalls = uint32_t(painter->getPrevDrawCalls());
+		sample.triangles = uint32_t(painter->getPrevTriangles());
+		sample.vertices = uint32_t(painter->getPrevVertices());
+	}
+
+	sample.memoryUsage = OS::get().getMemoryUsage();
+
+	devConClient->sendTelemetry(std::move(sample));
+}
+
 void Core::initStage(Stage& stage)
 {
 	stage.api = &*api;
@@ -482,9 +545,10 @@ bool Core::transitionStage()
 
 	// Check if there's a stage waiting to be switched to
 	if (pendingStageTransition) {
-		// Get rid of current stage
+		// Get rid of current stage, along with any world it owned
 		if (currentStage) {
 			HALLEY_DEBUG_TRACE();
+			telemetryWorld = nullptr;
 			currentStage.reset();
 			HALLEY_DEBUG_TRACE();
 		}
@@ -1,7 +1,6 @@
 #include "game/halley_statics.h"
 #include <halley/entity/type_deleter.h>
 #include <halley/data_structures/vector.h>
-#include <halley/entity/family_mask.h>
 #include <halley/os/os.h>
 #include <halley/concurrency/executor.h>
 #include <halley/concurrency/concurrent.h>
@@ -18,11 +17,12 @@ namespace Halley {
 		HalleyStaticsPimpl()
 		{
 			logger = new Logger();
-			maskStorage = MaskStorageInterface::createMaskStorage();
 			os = OS::createOS();
 
 			executors = std::make_unique<Executors>();
 			executors->set(*executors);
+			executors->getCPU().setWorkStealing(true);
+			executors->getCPUAux().setWorkStealing(true);
 		}
 
 		~HalleyStaticsPimpl()
@@ -34,7 +34,6 @@ namespace Halley {
 		}
 
 		Vector<TypeDeleterBase*> typeDeleters;
-		void* maskStorage;
 		OS* os;
 		Logger* logger;
 		
@@ -82,7 +81,6 @@ void HalleyStatics::setupGlobals() const
 	Logger::setInstance(*pimpl->logger);
 
 	ComponentDeleterTable::getDeleters() = &pimpl->typeDeleters;
-	MaskStorageInterface::setMaskStorage(pimpl->maskStorage);
 	OS::setInstance(pimpl->os);
 
 	Executors::set(*pimpl->executors);
@@ -4,8 +4,10 @@
 #include "halley/core/graphics/material/material.h"
 #include "halley/core/graphics/material/material_definition.h"
 #include "halley/core/graphics/material/material_parameter.h"
+#include "halley/core/graphics/render_command_buffer.h"
 #include <cstring> // memmove
 #include <gsl/gsl_assert>
+#include <halley/support/profiler.h>
 #include "resources/resources.h"
 
 using namespace Halley;
@@ -56,7 +58,7 @@ static Vector4f& getVertPos(char* vertexAttrib, size_t vertPosOffset)
 	return *reinterpret_cast<Vector4f*>(vertexAttrib + vertPosOffset);
 }
 
-Painter::PainterVertexData Painter::addDrawData(std::shared_ptr<Material>& material, size_t numVertices, size_t numIndices, bool standardQuadsOnly)
+Painter::PainterVertexData Painter::addDrawData(const std::shared_ptr<Material>& material, size_t numVertices, size_t numIndices, bool standardQuadsOnly)
 {
 	Expects(material);
 	Expects(numVertices > 0);
@@ -99,19 +101,73 @@ void Painter::drawSprites(std::shared_ptr<Material> material, size_t numSprites,
 {
 	Expects(vertexData != nullptr);
 
-	const size_t verticesPerSprite = 4;
-	const size_t numVertices = verticesPerSprite * numSprites;
-	const size_t vertPosOffset = material->getDefinition().getVertexPosOffset();
+	auto result = addDrawData(material, numSprites * 4, numSprites * 6, true);
+	writeSpriteVertices(material->getDefinition(), numSprites, vertexData, result.dstVertex);
+	generateQuadIndices(result.firstIndex, numSprites, result.dstIndex);
+}
 
-	auto result = addDrawData(material, numVertices, numSprites * 6, true);
+void Painter::drawSlicedSprite(std::shared_ptr<Material> material, Vector2f scale, Vector4f slices, const void* vertexData)
+{
+	Expects(vertexData != nullptr);
+	if (scale.x < 0.00001f || scale.y < 0.00001f) {
+		//throw Exception("Scale is zero for material with texture " + material->getTexture(0)->getAssetId());
+		return;
+	}
+	//Expects(scale.x > 0.0001f);
+	//Expects(scale.y > 0.0001f);
+
+	auto result = addDrawData(material, slicedSpriteVertices, slicedSpriteIndices, false);
+	writeSlicedSpriteVertices(material->getDefinition(), scale, slices, vertexData, result.dstVertex);
+	generateSlicedSpriteIndices(result.firstIndex, result.dstIndex);
+}
+
+void Painter::execute(const RenderCommandBuffer& buffer)
+{
+	const char* const vertices = buffer.vertices.data();
+
+	for (auto& command: buffer.commands) {
+		switch (command.type) {
+		case RenderCommandBuffer::CommandType::Quads:
+			{
+				auto result = addDrawData(command.material, command.numVertices, command.numVertices * 3 / 2, true);
+				memcpy(result.dstVertex, vertices + command.vertexOffset, result.dataSize);
+				generateQuadIndices(result.firstIndex, command.numVertices / 4, result.dstIndex);
+			}
+			break;
+
+		case RenderCommandBuffer::CommandType::SlicedSprite:
+			{
+				auto result = addDrawData(command.material, slicedSpriteVertices, slicedSpriteIndices, false);
+				memcpy(result.dstVertex, vertices + command.vertexOffset, result.dataSize);
+				generateSlicedSpriteIndices(result.firstIndex, result.dstIndex);
+			}
+			break;
+
+		case RenderCommandBuffer::CommandType::RelativeClip:
+			setRelativeClip(command.clip);
+			break;
+
+		case RenderCommandBuffer::CommandType::ResetClip:
+			setClip();
+			break;
+		}
+	}
+}
+
+void Painter::writeSpriteVertices(const MaterialDefinition& material, size_t numSprites, const void* vertexData, char* dst)
+{
+	const size_t verticesPerSprite = 4;
+	const size_t vertexSize = material.getVertexSize();
+	const size_t vertexStride = material.getVertexStride();
+	const size_t vertPosOffset = material.getVertexPosOffset();
 
 	const char* const src = reinterpret_cast<const char*>(vertexData);
 
 	for (size_t i = 0; i < numSprites; i++) {
 		for (size_t j = 0; j < verticesPerSprite; j++) {
-			size_t srcOffset = i * result.vertexStride;
-			size_t dstOffset = (i * verticesPerSprite + j) * result.vertexStride;
-			memmove(result.dstVertex + dstOffset, src + srcOffset, result.vertexSize);
+			size_t srcOffset = i * vertexStride;
+			size_t dstOffset = (i * verticesPerSprite + j) * vertexStride;
+			memmove(dst + dstOffset, src + srcOffset, vertexSize);
 
 			// j -> vertPos
 			// 0 -> 0, 0
@@ -120,23 +176,13 @@ void Painter::drawSprites(std::shared_ptr<Material> material, size_t numSprites,
 			// 3 -> 0, 1
 			const float x = ((j & 1) ^ ((j & 2) >> 1)) * 1.0f;
 			const float y = ((j & 2) >> 1) * 1.0f;
-			getVertPos(result.dstVertex + dstOffset, vertPosOffset) = Vector4f(x, y, x, y);
+			getVertPos(dst + dstOffset, vertPosOffset) = Vector4f(x, y, x, y);
 		}
 	}
-
-	generateQuadIndices(result.firstIndex, numSprites, result.dstIndex);
 }
 
-void Painter::drawSlicedSprite(std::shared_ptr<Material> material, Vector2f scale, Vector4f slices, const void* vertexData)
+void Painter::writeSlicedSpriteVertices(const MaterialDefinition& material, Vector2f scale, Vector4f slices, const void* vertexData, char* dst)
 {
-	Expects(vertexData != nullptr);
-	if (scale.x < 0.00001f || scale.y < 0.00001f) {
-		//throw Exception("Scale is zero for material with texture " + material->getTexture(0)->getAssetId());
-		return;
-	}
-	//Expects(scale.x > 0.0001f);
-	//Expects(scale.y > 0.0001f);
-
 	//         a        c
 	//   00 -- 01 ----- 02 -- 03
 	//   |     |        |     |
@@ -147,32 +193,31 @@ void Painter::drawSlicedSprite(std::shared_ptr<Material> material, Vector2f scal
 	//   |     |        |     |
 	//   12 -- 13 ----- 14 -- 15
 
-	const size_t numVertices = 16;
-	const size_t numIndices = 9 * 6; // 9 quads, 6 indices per quad
-	const size_t vertPosOffset = material->getDefinition().getVertexPosOffset();
-
-	auto result = addDrawData(material, numVertices, numIndices, false);
-	const char* const src = reinterpret_cast<const char*>(vertexData);
+	const size_t vertexSize = material.getVertexSize();
+	const size_t vertexStride = material.getVertexStride();
+	const size_t vertPosOffset = material.getVertexPosOffset();
 
 	// Vertices
 	std::array<Vector2f, 4> pos = {{ Vector2f(0, 0), Vector2f(slices.x / scale.x, slices.y / scale.y), Vector2f(1 - slices.z / scale.x, 1 - slices.w / scale.y), Vector2f(1, 1) }};
 	std::array<Vector2f, 4> tex = {{ Vector2f(0, 0), Vector2f(slices.x, slices.y), Vector2f(1 - slices.z, 1 - slices.w), Vector2f(1, 1) }};
-	for (size_t i = 0; i < numVertices; i++) {
+	for (size_t i = 0; i < slicedSpriteVertices; i++) {
 		const size_t ix = i & 3;
 		const size_t iy = i >> 2;
-		const size_t dstOffset = i * result.vertexStride;
+		const size_t dstOffset = i * vertexStride;
 
-		memmove(result.dstVertex + dstOffset, src, result.vertexSize);
+		memmove(dst + dstOffset, vertexData, vertexSize);
 
-		Vector4f& vertPos = getVertPos(result.dstVertex + dstOffset, vertPosOffset);
+		Vector4f& vertPos = getVertPos(dst + dstOffset, vertPosOffset);
 		vertPos = Vector4f(pos[ix].x, pos[iy].y, tex[ix].x, tex[iy].y);
 	}
+}
 
-	// Indices
-	unsigned short* dstIndex = result.dstIndex;
+void Painter::generateSlicedSpriteIndices(unsigned short firstIndex, unsigned short* dstIndex)
+{
+	// 9 quads, 6 indices per quad
 	for (size_t y = 0; y < 3; y++) {
 		for (size_t x = 0; x < 3; x++) {
-			generateQuadIndicesOffset(static_cast<unsigned short>(result.firstIndex + x + (y * 4)), 4, dstIndex);
+			generateQuadIndicesOffset(static_cast<unsigned short>(firstIndex + x + (y * 4)), 4, dstIndex);
 			dstIndex += 6;
 		}
 	}
@@ -264,7 +309,7 @@ Rect4i Painter::getRectangleForActiveRenderTarget(Rect4i r)
 	}
 }
 
-void Painter::startDrawCall(std::shared_ptr<Material>& material)
+void Painter::startDrawCall(const std::shared_ptr<Material>& material)
 {
 	if (material != materialPending) {
 		if (materialPending != std::shared_ptr<Material>() && !(*material == *materialPending)) {
@@ -277,6 +322,7 @@ void Painter::startDrawCall(std::shared_ptr<Material>& material)
 void Painter::flushPending()
 {
 	if (verticesPending > 0) {
+		HALLEY_PROFILE_SCOPE("Painter::flushPending");
 		executeDrawTriangles(*materialPending, verticesPending, vertexBuffer.data(), indicesPending, indexBuffer.data());
 	}
 
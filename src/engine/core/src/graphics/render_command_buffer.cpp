@@ -0,0 +1,134 @@
+#include "halley/core/graphics/render_command_buffer.h"
+#include "halley/core/graphics/painter.h"
+#include "halley/core/graphics/material/material.h"
+#include "halley/core/graphics/material/material_definition.h"
+#include <cstring>
+#include <algorithm>
+#include <gsl/gsl_assert>
+
+using namespace Halley;
+
+void RenderCommandBuffer::clear()
+{
+	commands.clear();
+	vertices.clear();
+}
+
+void RenderCommandBuffer::drawQuads(std::shared_ptr<Material> material, size_t numVertices, const void* vertexData)
+{
+	Expects(numVertices % 4 == 0);
+	Expects(vertexData != nullptr);
+
+	auto dst = addVertices(material, CommandType::Quads, numVertices);
+	memcpy(dst, vertexData, numVertices * material->getDefinition().getVertexStride());
+}
+
+void RenderCommandBuffer::drawSprites(std::shared_ptr<Material> material, size_t numSprites, const void* vertexData)
+{
+	Expects(vertexData != nullptr);
+
+	auto dst = addVertices(material, CommandType::Quads, numSprites * 4);
+	Painter::writeSpriteVertices(material->getDefinition(), numSprites, vertexData, dst);
+}
+
+void RenderCommandBuffer::drawSlicedSprite(std::shared_ptr<Material> material, Vector2f scale, Vector4f slices, const void* vertexData)
+{
+	Expects(vertexData != nullptr);
+	if (scale.x < 0.00001f || scale.y < 0.00001f) {
+		return;
+	}
+
+	auto dst = addVertices(material, CommandType::SlicedSprite, Painter::slicedSpriteVertices);
+	Painter::writeSlicedSpriteVertices(material->getDefinition(), scale, slices, vertexData, dst);
+}
+
+void RenderCommandBuffer::setRelativeClip(Rect4f rect)
+{
+	Command command;
+	command.type = CommandType::RelativeClip;
+	command.clip = rect;
+	commands.push_back(std::move(command));
+}
+
+void RenderCommandBuffer::setClip()
+{
+	Command command;
+	command.type = CommandType::ResetClip;
+	commands.push_back(std::move(command));
+}
+
+char* RenderCommandBuffer::addVertices(const std::shared_ptr<Material>& material, CommandType type, size_t numVertices)
+{
+	Expects(material);
+	Expects(numVertices > 0);
+
+	const size_t offset = vertices.size();
+	const size_t bytes = numVertices * material->getDefinition().getVertexStride();
+	vertices.resize(offset + bytes);
+
+	// Consecutive quads with the same material become a single command
+	if (type == CommandType::Quads && !commands.empty()) {
+		auto& last = commands.back();
+		if (last.type == CommandType::Quads && last.material == material) {
+			last.numVertices += numVertices;
+			return vertices.data() + offset;
+		}
+	}
+
+	Command command;
+	command.type = type;
+	command.material = material;
+	command.vertexOffset = offset;
+	command.numVertices = numVertices;
+	commands.push_back(std::move(command));
+
+	return vertices.data() + offset;
+}
+
+RenderCommandQueue::RenderCommandQueue()
+{
+}
+
+RenderCommandQueue::~RenderCommandQueue()
+{
+}
+
+void RenderCommandQueue::reset(size_t n)
+{
+	if (n > capacity) {
+		capacity = std::max(n, capacity * 2);
+		slots.reset(new std::atomic<const RenderCommandBuffer*>[capacity]);
+	}
+	for (size_t i = 0; i < n; ++i) {
+		slots[i].store(nullptr, std::memory_order_relaxed);
+	}
+	count = n;
+	next = 0;
+}
+
+void RenderCommandQueue::submit(size_t sequence, const RenderCommandBuffer& buffer)
+{
+	Expects(sequence < count);
+	slots[sequence].store(&buffer, std::memory_order_release);
+}
+
+size_t RenderCommandQueue::executeReady(Painter& painter)
+{
+	size_t executed = 0;
+	while (next < count) {
+		auto buffer = slots[next].load(std::memory_order_acquire);
+		if (!buffer) {
+			break;
+		}
+		painter.execute(*buffer);
+		slots[next].store(nullptr, std::memory_order_relaxed);
+		++next;
+		++executed;
+	}
+	return executed;
+}
+
+bool RenderCommandQueue::isDone() const
+{
+	return next == count;
+}
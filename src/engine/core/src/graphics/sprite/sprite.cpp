@@ -2,6 +2,7 @@
 #include "graphics/sprite/sprite.h"
 #include "graphics/sprite/sprite_sheet.h"
 #include "halley/core/graphics/painter.h"
+#include "halley/core/graphics/render_command_buffer.h"
 #include "halley/core/graphics/material/material.h"
 #include "halley/core/graphics/material/material_definition.h"
 #include "halley/core/graphics/material/material_parameter.h"
@@ -20,32 +21,83 @@ Sprite::Sprite()
 void Sprite::draw(Painter& painter) const
 {
 	if (sliced) {
-		drawSliced(painter, slices);
+		doDrawSliced(painter, slices);
 	} else {
-		drawNormal(painter);
+		doDrawNormal(painter);
+	}
+}
+
+void Sprite::draw(RenderCommandBuffer& buffer) const
+{
+	if (sliced) {
+		doDrawSliced(buffer, slices);
+	} else {
+		doDrawNormal(buffer);
 	}
 }
 
 void Sprite::drawNormal(Painter& painter) const
+{
+	doDrawNormal(painter);
+}
+
+void Sprite::drawSliced(Painter& painter) const
+{
+	doDrawSliced(painter, slices);
+}
+
+void Sprite::drawSliced(Painter& painter, Vector4s slicesPixel) const
+{
+	doDrawSliced(painter, slicesPixel);
+}
+
+void Sprite::draw(const Sprite* sprites, size_t n, Painter& painter) // static
+{
+	doDraw(n, [&] (size_t i) -> const Sprite& { return sprites[i]; }, painter);
+}
+
+void Sprite::drawBatch(const Sprite* const* sprites, size_t n, Painter& painter) // static
+{
+	doDraw(n, [&] (size_t i) -> const Sprite& { return *sprites[i]; }, painter);
+}
+
+void Sprite::drawBatch(const Sprite* const* sprites, size_t n, RenderCommandBuffer& buffer) // static
+{
+	doDraw(n, [&] (size_t i) -> const Sprite& { return *sprites[i]; }, buffer);
+}
+
+bool Sprite::isBatchable() const
+{
+	return material && !sliced && !clip;
+}
+
+void Sprite::drawMixedMaterials(const Sprite* sprites, size_t n, Painter& painter) // static
+{
+	doDrawMixedMaterials(sprites, n, painter);
+}
+
+void Sprite::drawMixedMaterials(const Sprite* sprites, size_t n, RenderCommandBuffer& buffer) // static
+{
+	doDrawMixedMaterials(sprites, n, buffer);
+}
+
+template <typename T>
+void Sprite::doDrawNormal(T& target) const
 {
 	Expects(material);
 	Expects(material->getDefinition().getVertexStride() == sizeof(SpriteVertexAttrib));
 	
 	if (clip) {
-		painter.setRelativeClip(clip.get() + (absoluteClip ? Vector2f() : vertexAttrib.pos));
+		target.setRelativeClip(clip.get() + (absoluteClip ? Vector2f() : vertexAttrib.pos));
 	}
-	painter.drawSprites(material, 1, &vertexAttrib);
+	target.drawSprites(material, 1, &vertexAttrib);
 	if (clip) {
-		painter.setClip();
+		target.setClip();
 	}
 }
 
-void Sprite::drawSliced(Painter& painter) const
-{
-	drawSliced(painter, slices);
-}
-
-void Sprite::drawSliced(Painter& painter, Vector4s slicesPixel) const
+template <typename T>
+void Sprite::doDrawSliced(T& target, Vector4s slicesPixel) const
 {
 	Expects(material);
 	Expects(material->getDefinition().getVertexStride() == sizeof(SpriteVertexAttrib));
@@ -57,21 +109,22 @@ void Sprite::drawSliced(Painter& painter, Vector4s slicesPixel) const
 	slices.w /= size.y;
 
 	if (clip) {
-		painter.setRelativeClip(clip.get() + vertexAttrib.pos);
+		target.setRelativeClip(clip.get() + vertexAttrib.pos);
 	}
-	painter.drawSlicedSprite(material, vertexAttrib.scale, slices, &vertexAttrib);
+	target.drawSlicedSprite(material, vertexAttrib.scale, slices, &vertexAttrib);
 	if (clip) {
-		painter.setClip();
+		target.setClip();
 	}
 }
 
-void Sprite::draw(const Sprite* sprites, size_t n, Painter& painter) // static
+template <typename T, typename F>
+void Sprite::doDraw(size_t n, F getSprite, T& target)
 {
 	if (n == 0) {
 		return;
 	}
 
-	auto& material = sprites[0].material;
+	auto& material = getSprite(0).material;
 	Expects(material->getDefinition().getVertexStride() == sizeof(SpriteVertexAttrib));
 
 	size_t spriteSize = sizeof(SpriteVertexAttrib);
@@ -87,15 +140,16 @@ void Sprite::draw(const Sprite* sprites, size_t n, Painter& painter) // static
 	}
 
 	for (size_t i = 0; i < n; i++) {
-		auto& sprite = sprites[i];
+		auto& sprite = getSprite(i);
 		Expects(sprite.material == material);
 		memcpy(&vertexData[i * spriteSize], &sprite.vertexAttrib, spriteSize);
 	}
 
-	painter.drawSprites(material, n, vertexData);
+	target.drawSprites(material, n, vertexData);
 }
 
-void Sprite::drawMixedMaterials(const Sprite* sprites, size_t n, Painter& painter)
+template <typename T>
+void Sprite::doDrawMixedMaterials(const Sprite* sprites, size_t n, T& target)
 {
 	if (n == 0) {
 		return;
@@ -106,12 +160,12 @@ void Sprite::drawMixedMaterials(const Sprite* sprites, size_t n, Painter& painte
 	for (size_t i = 0; i < n; ++i) {
 		auto* material = sprites[i].material.get();
 		if (material != lastMaterial) {
-			draw(sprites + start, i - start, painter);
+			doDraw(i - start, [&] (size_t j) -> const Sprite& { return sprites[start + j]; }, target);
 			start = i;
 			lastMaterial = material;
 		}
 	}
-	draw(sprites + start, n - start, painter);
+	doDraw(n - start, [&] (size_t j) -> const Sprite& { return sprites[start + j]; }, target);
 }
 
 Rect4f Sprite::getAABB() const
@@ -3,43 +3,63 @@
 #include "graphics/painter.h"
 #include <gsl/gsl>
 #include "graphics/text/text_renderer.h"
+#include "halley/core/graphics/material/material.h"
+#include <halley/concurrency/executor.h>
+#include <halley/utils/algorithm.h>
+#include <halley/utils/utils.h>
+#include <cstring>
+#include <thread>
+#include <exception>
 
 using namespace Halley;
 
+namespace {
+	// Below this, recording on workers costs more than it saves
+	constexpr size_t minSpritesForParallelDraw = 2048;
+	constexpr size_t spritesPerChunk = 512;
+}
+
 SpritePainterEntry::SpritePainterEntry(const Sprite& sprite, int mask, int layer, float tieBreaker)
 	: ptr(&sprite)
 	, type(SpritePainterEntryType::SpriteRef)
-	, layer(layer)
 	, mask(mask)
-	, tieBreaker(tieBreaker)
+	, key(makeKey(sprite, layer, tieBreaker))
 {}
 
 SpritePainterEntry::SpritePainterEntry(const TextRenderer& text, int mask, int layer, float tieBreaker)
 	: ptr(&text)
 	, type(SpritePainterEntryType::TextRef)
-	, layer(layer)
 	, mask(mask)
-	, tieBreaker(tieBreaker)
+	, key(makeKey(layer, tieBreaker, 0))
 {
 }
 
-SpritePainterEntry::SpritePainterEntry(SpritePainterEntryType type, size_t spriteIdx, int mask, int layer, float tieBreaker)
+SpritePainterEntry::SpritePainterEntry(SpritePainterEntryType type, size_t spriteIdx, int mask, uint64_t key)
 	: index(int(spriteIdx))
 	, type(type)
-	, layer(layer)
 	, mask(mask)
-	, tieBreaker(tieBreaker)
+	, key(key)
 {}
 
-bool SpritePainterEntry::operator<(const SpritePainterEntry& o) const
+uint64_t SpritePainterEntry::makeKey(int layer, float tieBreaker, uint16_t materialBits)
 {
-	if (layer != o.layer) {
-		return layer < o.layer;
-	} else if (tieBreaker != o.tieBreaker) {
-		return tieBreaker < o.tieBreaker;
-	} else {
-		return ptr < o.ptr;
+	// Flip the sign bit of positive floats and every bit of negative ones, so they sort correctly as unsigned ints
+	uint32_t depth;
+	memcpy(&depth, &tieBreaker, sizeof(depth));
+	depth ^= (depth & 0x80000000u) != 0 ? 0xFFFFFFFFu : 0x80000000u;
+
+	const uint64_t layerBits = uint64_t(clamp(layer, -32768, 32767) + 32768);
+	return (layerBits << 48) | (uint64_t(depth) << 16) | materialBits;
+}
+
+uint64_t SpritePainterEntry::makeKey(const Sprite& sprite, int layer, float tieBreaker)
+{
+	uint16_t materialBits = 0;
+	if (sprite.hasMaterial()) {
+		const uint64_t hash = sprite.getMaterial().getHash();
+		materialBits = uint16_t(hash ^ (hash >> 16) ^ (hash >> 32) ^ (hash >> 48));
 	}
+	return makeKey(layer, tieBreaker, materialBits);
 }
 
 SpritePainterEntryType SpritePainterEntry::getType() const
@@ -72,6 +92,11 @@ int SpritePainterEntry::getMask() const
 	return mask;
 }
 
+uint64_t SpritePainterEntry::getKey() const
+{
+	return key;
+}
+
 void SpritePainter::start(size_t nSprites)
 {
 	if (sprites.capacity() < nSprites) {
@@ -90,7 +115,7 @@ void SpritePainter::add(const Sprite& sprite, int mask, int layer, float tieBrea
 
 void SpritePainter::addCopy(const Sprite& sprite, int mask, int layer, float tieBreaker)
 {
-	sprites.push_back(SpritePainterEntry(SpritePainterEntryType::SpriteCached, cachedSprites.size(), mask, layer, tieBreaker));
+	sprites.push_back(SpritePainterEntry(SpritePainterEntryType::SpriteCached, cachedSprites.size(), mask, SpritePainterEntry::makeKey(sprite, layer, tieBreaker)));
 	cachedSprites.push_back(sprite);
 	dirty = true;
 }
@@ -103,19 +128,20 @@ void SpritePainter::add(const TextRenderer& text, int mask, int layer, float tie
 
 void SpritePainter::addCopy(const TextRenderer& text, int mask, int layer, float tieBreaker)
 {
-	sprites.push_back(SpritePainterEntry(SpritePainterEntryType::TextCached, cachedText.size(), mask, layer, tieBreaker));
+	sprites.push_back(SpritePainterEntry(SpritePainterEntryType::TextCached, cachedText.size(), mask, SpritePainterEntry::makeKey(layer, tieBreaker, 0)));
 	cachedText.push_back(text);
 	dirty = true;
 }
 
+void SpritePainter::setParallelDraw(bool enabled)
+{
+	parallelDraw = enabled;
+}
+
 void SpritePainter::draw(int mask, Painter& painter)
 {
 	if (dirty) {
-		// TODO: implement hierarchical bucketing.
-		// - one bucket per layer
-		// - for each layer, one bucket per vertical band of the screen (32px or so)
-		// - sort each leaf bucket
-		std::sort(sprites.begin(), sprites.end()); // lol
+		sort();
 		dirty = false;
 	}
 
@@ -124,31 +150,117 @@ void SpritePainter::draw(int mask, Painter& painter)
 	Rect4f view = cam.getClippingRectangle();
 
 	// Draw!
-	for (auto& s : sprites) {
-		if ((s.getMask() & mask) != 0) {
-			auto type = s.getType();
-			if (type == SpritePainterEntryType::SpriteRef) {
-				draw(s.getSprite(), painter, view);
-			} else if (type == SpritePainterEntryType::SpriteCached) {
-				draw(cachedSprites[s.getIndex()], painter, view);
-			} else if (type == SpritePainterEntryType::TextRef) {
-				draw(s.getText(), painter, view);
-			} else if (type == SpritePainterEntryType::TextCached) {
-				draw(cachedText[s.getIndex()], painter, view);
-			}
-		}
+	if (parallelDraw && order.size() >= minSpritesForParallelDraw && Executors::getCPU().threadCount() > 0) {
+		drawParallel(mask, painter, view);
+	} else {
+		drawRange(0, order.size(), mask, painter, view);
 	}
 	painter.flush();
 }
 
-void SpritePainter::draw(const Sprite& sprite, Painter& painter, Rect4f view)
+void SpritePainter::sort()
 {
-	if (sprite.isInView(view)) {
-		sprite.draw(painter);
+	order.resize(sprites.size());
+	for (size_t i = 0; i < sprites.size(); ++i) {
+		order[i] = SortEntry{ sprites[i].getKey(), i };
 	}
+	radixSort(order, orderScratch, [] (const SortEntry& e) { return e.key; });
 }
 
-void SpritePainter::draw(const TextRenderer& text, Painter& painter, Rect4f view)
+void SpritePainter::drawParallel(int mask, Painter& painter, Rect4f view)
 {
-	text.draw(painter);
+	auto& queue = Executors::getCPU();
+
+	const size_t nChunks = (order.size() + spritesPerChunk - 1) / spritesPerChunk;
+	while (commandBuffers.size() < nChunks) {
+		commandBuffers.push_back(std::make_unique<RenderCommandBuffer>());
+	}
+	commandQueue.reset(nChunks);
+
+	// A chunk that throws is still submitted, empty, so the queue drains; the first exception is rethrown once it has
+	std::mutex errorMutex;
+	std::exception_ptr error;
+
+	for (size_t i = 0; i < nChunks; ++i) {
+		queue.addToQueue([this, i, mask, view, &errorMutex, &error] ()
+		{
+			auto& buffer = *commandBuffers[i];
+			try {
+				buffer.clear();
+				const size_t start = i * spritesPerChunk;
+				drawRange(start, std::min(start + spritesPerChunk, order.size()), mask, buffer, view);
+			} catch (...) {
+				buffer.clear();
+				std::unique_lock<std::mutex> lock(errorMutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+
+			commandQueue.submit(i, buffer);
+		});
+	}
+
+	// Replay chunks as soon as they're ready, and help record the remaining ones while waiting
+	while (!commandQueue.isDone()) {
+		if (commandQueue.executeReady(painter) == 0) {
+			auto task = queue.tryGetNext();
+			if (task) {
+				task();
+			} else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+template <typename T>
+void SpritePainter::drawRange(size_t start, size_t end, int mask, T& target, Rect4f view) const
+{
+	// Runs of plain sprites sharing a material are sent as a single batch
+	Vector<const Sprite*> batch;
+	auto flushBatch = [&] ()
+	{
+		if (!batch.empty()) {
+			Sprite::drawBatch(batch.data(), batch.size(), target);
+			batch.clear();
+		}
+	};
+
+	for (size_t i = start; i < end; ++i) {
+		auto& s = sprites[order[i].index];
+		if ((s.getMask() & mask) == 0) {
+			continue;
+		}
+
+		auto type = s.getType();
+		if (type == SpritePainterEntryType::SpriteRef || type == SpritePainterEntryType::SpriteCached) {
+			auto& sprite = type == SpritePainterEntryType::SpriteRef ? s.getSprite() : cachedSprites[s.getIndex()];
+			if (!sprite.isInView(view)) {
+				continue;
+			}
+			if (sprite.isBatchable()) {
+				if (!batch.empty() && &batch.back()->getMaterial() != &sprite.getMaterial()) {
+					flushBatch();
+				}
+				batch.push_back(&sprite);
+			} else {
+				flushBatch();
+				sprite.draw(target);
+			}
+		} else {
+			flushBatch();
+			std::lock_guard<std::mutex> lock(textMutex);
+			if (type == SpritePainterEntryType::TextRef) {
+				s.getText().draw(target);
+			} else {
+				cachedText[s.getIndex()].draw(target);
+			}
+		}
+	}
+	flushBatch();
 }
@@ -1,6 +1,7 @@
 #include "graphics/text/text_renderer.h"
 #include "graphics/text/font.h"
 #include "halley/core/graphics/painter.h"
+#include "halley/core/graphics/render_command_buffer.h"
 #include "halley/core/graphics/material/material.h"
 #include "halley/core/graphics/material/material_parameter.h"
 #include <gsl/gsl_assert>
@@ -275,6 +276,17 @@ void TextRenderer::generateSprites(std::vector<Sprite>& sprites) const
 }
 
 void TextRenderer::draw(Painter& painter) const
+{
+	doDraw(painter);
+}
+
+void TextRenderer::draw(RenderCommandBuffer& buffer) const
+{
+	doDraw(buffer);
+}
+
+template <typename T>
+void TextRenderer::doDraw(T& target) const
 {
 	generateSprites(spritesCache);
 
@@ -286,11 +298,11 @@ void TextRenderer::draw(Painter& painter) const
 	}
 
 	if (clip) {
-		painter.setRelativeClip(clip.get() + position);
+		target.setRelativeClip(clip.get() + position);
 	}
-	Sprite::drawMixedMaterials(spritesCache.data(), spritesCache.size(), painter);
+	Sprite::drawMixedMaterials(spritesCache.data(), spritesCache.size(), target);
 	if (clip) {
-		painter.setClip();
+		target.setClip();
 	}
 }
 
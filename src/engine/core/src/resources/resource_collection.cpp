@@ -3,6 +3,7 @@
 #include "resources/resources.h"
 #include <halley/resources/resource.h>
 #include "halley/support/logger.h"
+#include "halley/support/profiler.h"
 
 using namespace Halley;
 
@@ -69,6 +70,7 @@ std::vector<String> ResourceCollectionBase::enumerate() const
 }
 
 std::shared_ptr<Resource> ResourceCollectionBase::loadAsset(const String& assetId, ResourceLoadPriority priority) {
+	HALLEY_PROFILE_SCOPE("Load resource", Profiler::isEnabled() ? Profiler::intern(assetId) : nullptr);
 	std::shared_ptr<Resource> newRes;
 
 	if (resourceLoader) {
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <memory>
+#include <cstdint>
+#include "family_mask.h"
+#include <halley/data_structures/vector.h>
+#include <halley/data_structures/tree_map.h>
+
+namespace Halley {
+	class Entity;
+	class Component;
+	class TypeDeleterBase;
+
+	enum class ComponentStorage {
+		Individual, // Each component is allocated individually from a pool
+		Archetype   // Entities with the same mask share contiguous per-component columns
+	};
+
+	// All entities with the same mask live in the same archetype, one row per entity.
+	// Each component type in the mask gets its own column, stored in fixed-size chunks so that
+	// rows never move in memory while the entity stays in this archetype.
+	class Archetype
+	{
+	public:
+		constexpr static size_t rowsPerChunk = 256;
+
+		explicit Archetype(FamilyMaskType mask);
+		~Archetype();
+
+		Archetype(const Archetype& other) = delete;
+		Archetype& operator=(const Archetype& other) = delete;
+
+		FamilyMaskType getMask() const { return mask; }
+		size_t getNumColumns() const { return columns.size(); }
+		size_t getNumChunks() const { return numChunks; }
+		size_t getNumRows() const { return numRows - freeRows.size(); }
+		int getColumnComponentId(size_t column) const { return columns[column].componentId; }
+
+		int getColumnIndex(int componentId) const
+		{
+			return componentId < int(columnByComponent.size()) ? columnByComponent[componentId] : -1;
+		}
+
+		void* getComponent(size_t column, uint32_t row) const
+		{
+			auto& col = columns[column];
+			return col.chunks[row / rowsPerChunk].get() + (row % rowsPerChunk) * col.stride;
+		}
+
+		void* tryGetComponent(int componentId, uint32_t row) const
+		{
+			int column = getColumnIndex(componentId);
+			return column >= 0 ? getComponent(size_t(column), row) : nullptr;
+		}
+
+		// Returns the start of the chunk for the given column; rows [0, rowsPerChunk) are laid out contiguously
+		char* getChunk(size_t column, size_t chunk) const { return columns[column].chunks[chunk].get(); }
+		size_t getStride(size_t column) const { return columns[column].stride; }
+
+		uint32_t allocRow();
+		void freeRow(uint32_t row);
+
+	private:
+		struct Column
+		{
+			int componentId = -1;
+			size_t stride = 0;
+			TypeDeleterBase* deleter = nullptr;
+			Vector<std::unique_ptr<char[]>> chunks;
+		};
+
+		FamilyMaskType mask;
+		Vector<Column> columns;
+		Vector<int> columnByComponent;
+		Vector<uint32_t> freeRows;
+		uint32_t numRows = 0;
+		size_t numChunks = 0;
+
+		void addChunk();
+	};
+
+	class ArchetypeStorage
+	{
+	public:
+		ArchetypeStorage();
+		~ArchetypeStorage();
+
+		Archetype& getArchetype(FamilyMaskType mask);
+		size_t getNumArchetypes() const { return archetypes.size(); }
+
+		// Moves all live components of the entity into the row of the archetype matching its current mask.
+		// Moved-from components are kept alive until flush(), so family removal callbacks can still read them.
+		void relocate(Entity& entity);
+
+		// Destroys all components moved out during relocate(), and releases their old rows
+		void flush();
+
+		static bool isStoredIn(const Entity& entity, const Component* component, int componentId);
+
+	private:
+		struct PendingRelease
+		{
+			void* component;
+			int componentId;
+			bool pooled;
+		};
+
+		TreeMap<FamilyMaskType, std::unique_ptr<Archetype>> archetypes;
+		Vector<PendingRelease> pendingComponents;
+		Vector<std::pair<Archetype*, uint32_t>> pendingRows;
+	};
+}
@@ -10,6 +10,11 @@ namespace Halley
 	public:
 		void* operator new(size_t size);
 		void operator delete(void* ptr);
+
+		// While any World is updating systems concurrently, allocations are serialised.
+		// Components are only ever freed at sync points, between stages, so frees don't need to be.
+		static void beginConcurrentAllocation();
+		static void endConcurrentAllocation();
 	};
 }
 
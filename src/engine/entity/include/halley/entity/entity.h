@@ -12,17 +12,8 @@
 namespace Halley {
 	class World;
 	class System;
-
-	class MessageEntry
-	{
-	public:
-		std::unique_ptr<Message> msg;
-		int type = -1;
-		int age = -1;
-
-		MessageEntry() {}
-		MessageEntry(std::unique_ptr<Message> msg, int type, int age) : msg(std::move(msg)), type(type), age(age) {}
-	};
+	class Archetype;
+	class ComponentBlock;
 
 	class EntityRef;
 
@@ -31,6 +22,7 @@ namespace Halley {
 		friend class World;
 		friend class System;
 		friend class EntityRef;
+		friend class ArchetypeStorage;
 
 	public:
 		~Entity();
@@ -85,9 +77,12 @@ namespace Halley {
 
 	private:
 		Vector<std::pair<int, Component*>> components;
-		Vector<MessageEntry> inbox;
 		FamilyMaskType mask;
 		EntityId uid;
+		Archetype* archetype = nullptr;
+		uint32_t archetypeRow = 0;
+		ComponentBlock* componentBlock = nullptr;
+		uint32_t worldIndex = 0;
 		int liveComponents = 0;
 		bool dirty = false;
 		bool alive = true;
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <type_traits>
+#include "component.h"
+#include "family_mask.h"
+#include "type_deleter.h"
+#include <halley/data_structures/vector.h>
+
+namespace Halley {
+	// A single allocation holding the components of several entities created from the same prefab.
+	// Each component keeps a reference to it, and it's freed once the last one is destroyed.
+	class ComponentBlock
+	{
+	public:
+		ComponentBlock(size_t size, size_t refs);
+
+		ComponentBlock(const ComponentBlock& other) = delete;
+		ComponentBlock& operator=(const ComponentBlock& other) = delete;
+
+		char* getData() const { return data.get(); }
+
+		bool contains(const void* ptr) const
+		{
+			auto p = static_cast<const char*>(ptr);
+			return p >= data.get() && p < data.get() + size;
+		}
+
+		void release();
+
+	private:
+		std::unique_ptr<char[]> data;
+		size_t size;
+		size_t refs;
+	};
+
+	// A fixed set of components, along with their mask and memory layout, that can be instantiated many times over.
+	// See World::instantiate().
+	class EntityPrefab
+	{
+	public:
+		struct Entry
+		{
+			int componentId;
+			size_t size;
+			size_t alignment;
+			size_t offset;
+			std::function<Component*(void*)> construct;
+		};
+
+		template <typename T>
+		EntityPrefab& addComponent(T component)
+		{
+			static_assert(!std::is_pointer<T>::value, "Cannot pass pointer to component");
+			static_assert(std::is_base_of<Component, T>::value, "Components must extend the Component class");
+			static_assert(!std::is_polymorphic<T>::value, "Components cannot be polymorphic (i.e. they can't have virtual methods)");
+			static_assert(std::is_copy_constructible<T>::value, "Prefab components must be copy constructible");
+			TypeDeleter<T>::initialize();
+
+			auto prototype = std::make_shared<T>(std::move(component));
+			addEntry(Entry{ T::componentIndex, sizeof(T), alignof(T), 0, [prototype] (void* dst) -> Component*
+			{
+				return ::new (dst) T(*prototype);
+			}});
+			return *this;
+		}
+
+		FamilyMaskType getMask() const { return mask; }
+		const Vector<Entry>& getEntries() const { return entries; }
+
+		// Bytes taken by the components of each instance in a ComponentBlock
+		size_t getStride() const { return stride; }
+
+	private:
+		Vector<Entry> entries;
+		FamilyMaskType mask;
+		size_t stride = 0;
+
+		void addEntry(Entry entry);
+	};
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <algorithm>
+#include <memory>
+#include <cstdint>
 #include <gsl/gsl_assert>
 #include "family_type.h"
 #include "family_mask.h"
@@ -14,6 +16,39 @@ namespace Halley {
 	class Entity;
 	class FamilyBindingBase;
 
+	// Sparse set mapping entity ids to their index in a family's element array.
+	// Pages are only allocated for ranges of ids that are actually used.
+	class EntityIndexMap {
+	public:
+		constexpr static size_t npos = size_t(-1);
+
+		size_t get(EntityId id) const
+		{
+			const auto slot = getSlot(id);
+			const auto page = slot / pageSize;
+			if (page >= pages.size() || !pages[page]) {
+				return npos;
+			}
+			const auto value = pages[page][slot % pageSize];
+			return value == invalid ? npos : size_t(value);
+		}
+
+		void set(EntityId id, size_t index);
+		void erase(EntityId id);
+		void clear();
+
+	private:
+		constexpr static size_t pageSize = 1024;
+		constexpr static uint32_t invalid = uint32_t(-1);
+
+		Vector<std::unique_ptr<uint32_t[]>> pages;
+
+		static size_t getSlot(EntityId id)
+		{
+			return size_t(id.value & 0xFFFFFFFFll);
+		}
+	};
+
 	class Family {
 		friend class World;
 
@@ -39,9 +74,14 @@ namespace Halley {
 		void notifyAdd(void* entities, size_t count);
 		void notifyRemove(void* entities, size_t count);
 
+		// Returns the index of the entity's element, or EntityIndexMap::npos if it's not in this family
+		size_t getIndexOf(EntityId id) const;
+
 	protected:
 		virtual void addEntity(Entity& entity) = 0;
+		virtual void addEntities(Entity* const* entities, size_t count) = 0;
 		void removeEntity(Entity& entity);
+		virtual void refreshEntity(Entity& entity) = 0;
 		virtual void updateEntities() = 0;
 		virtual void clearEntities() = 0;
 		
@@ -49,6 +89,7 @@ namespace Halley {
 		size_t elemCount = 0;
 		size_t elemSize = 0;
 		Vector<EntityId> toRemove;
+		EntityIndexMap indices;
 
 		Vector<FamilyBindingBase*> addEntityCallbacks;
 		Vector<FamilyBindingBase*> removeEntityCallbacks;
@@ -105,6 +146,8 @@ namespace Halley {
 	protected:
 		void addEntity(Entity& entity) override
 		{
+			Expects(indices.get(entity.getEntityId()) == EntityIndexMap::npos);
+			indices.set(entity.getEntityId(), entities.size());
 			entities.push_back(StorageType());
 			auto& e = entities.back();
 			e.entityId = entity.getEntityId();
@@ -113,6 +156,28 @@ namespace Halley {
 			dirty = true;
 		}
 
+		void addEntities(Entity* const* toAdd, size_t count) override
+		{
+			const size_t needed = entities.size() + count;
+			if (entities.capacity() < needed) {
+				entities.reserve(std::max(needed, entities.capacity() * 2));
+			}
+			for (size_t i = 0; i < count; ++i) {
+				addEntity(*toAdd[i]);
+			}
+		}
+
+		void refreshEntity(Entity& entity) override
+		{
+			// Entity still belongs to the family, but its components might have moved or been replaced
+			const size_t idx = indices.get(entity.getEntityId());
+			if (idx != EntityIndexMap::npos) {
+				T::Type::loadComponents(entity, &entities[idx].data[0]);
+			} else {
+				addEntity(entity);
+			}
+		}
+
 		void updateEntities() override
 		{
 			if (dirty) {
@@ -137,6 +202,7 @@ namespace Halley {
 		{
 			notifyRemove(entities.data(), entities.size());
 			entities.clear();
+			indices.clear();
 			updateElems();
 		}
 
@@ -154,51 +220,38 @@ namespace Halley {
 		void removeDeadEntities()
 		{
 			// Performance-critical code
-			// Benchmarks suggest that using a Vector is faster than std::set and std::unordered_set
+			// Each removal is a lookup in the index map and a swap with the last live element, so this is O(removed)
 			if (!toRemove.empty()) {
 				HALLEY_DEBUG_TRACE();
-				size_t removeCount = toRemove.size();
-				Expects(removeCount > 0);
-				Expects(removeCount <= entities.size());
-				std::sort(toRemove.begin(), toRemove.end());
-
-				for (size_t i = 1; i < toRemove.size(); ++i) {
-					Expects(toRemove[i - 1] != toRemove[i]);
-				}
+				size_t n = entities.size();
+				for (auto& id: toRemove) {
+					const size_t idx = indices.get(id);
+					if (idx == EntityIndexMap::npos || idx >= n) {
+						// Not in this family, or already removed
+						continue;
+					}
 
-				// Move all entities to be removed to the back of the vector
-				{
-					int n = int(entities.size());
-					// Note: it's important to scan it forward. Scanning backwards would improve performance for short-lived entities,
-					// but it causes an issue where an entity is removed and added to the same family in one frame.
-					for (int i = 0; i < n; i++) {
-						EntityId id = entities[i].entityId;
-						auto iter = std::lower_bound(toRemove.begin(), toRemove.end(), id);
-						if (iter != toRemove.end() && id == *iter) {
-							toRemove.erase(iter);
-							if (i != n - 1) {
-								std::swap(entities[i], entities[n - 1]);
-								i--;
-							}
-							n--;
-							if (toRemove.empty()) {
-								break;
-							}
-						}
+					--n;
+					if (idx != n) {
+						std::swap(entities[idx], entities[n]);
+						indices.set(entities[idx].entityId, idx);
+						indices.set(entities[n].entityId, n);
 					}
-					Ensures(size_t(n) + removeCount == entities.size());
 				}
-
-				Expects(toRemove.empty());
+				toRemove.clear();
 
 				// Notify removal
-				size_t newSize = entities.size() - removeCount;
-				Ensures(newSize < entities.size());
-				notifyRemove(entities.data() + newSize, removeCount);
+				const size_t removeCount = entities.size() - n;
+				if (removeCount > 0) {
+					notifyRemove(entities.data() + n, removeCount);
 
-				// Remove them
-				entities.resize(newSize);
-				updateElems();
+					// Remove them
+					for (size_t i = n; i < entities.size(); ++i) {
+						indices.erase(entities[i].entityId);
+					}
+					entities.resize(n);
+					updateElems();
+				}
 			}
 			Ensures(toRemove.empty());
 		}
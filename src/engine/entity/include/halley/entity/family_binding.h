@@ -12,6 +12,7 @@ namespace Halley {
 	public:
 		size_t count() const { return family->count(); }
 		size_t size() const { return family->count(); }
+		size_t getIndexOf(EntityId id) const { return family->getIndexOf(id); }
 
 		virtual ~FamilyBindingBase();
 
@@ -1,4 +1,5 @@
 #pragma once
+#include <type_traits>
 #include "entity.h"
 
 namespace Halley {
@@ -26,7 +27,7 @@ namespace Halley {
 		template <typename T, typename... Ts>
 		struct Evaluator <T, Ts...> {
 			static void buildEntity(Entity& entity, void** data, size_t offset) {
-				data[offset] = entity.tryGetComponent<typename StripMaybeRef<T>::type>();
+				data[offset] = entity.tryGetComponent<typename std::remove_const<typename StripMaybeRef<T>::type>::type>();
 				Evaluator<Ts...>::buildEntity(entity, data, offset + 1);
 			}
 		};
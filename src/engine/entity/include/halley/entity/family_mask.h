@@ -1,53 +1,180 @@
 #pragma once
 
-#include <bitset>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
 #include "halley/data_structures/maybe_ref.h"
 
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HALLEY_FAMILY_MASK_SSE2
+#include <emmintrin.h>
+#endif
+
+// Maximum number of component types, must be at least as large as the number of components generated by codegen
+#ifndef HALLEY_MAX_COMPONENTS
+#define HALLEY_MAX_COMPONENTS 256
+#endif
+
 namespace Halley {
 	namespace FamilyMask {
-		using RealType = std::bitset<256>;
+		constexpr static int maxComponents = HALLEY_MAX_COMPONENTS;
 
-
-		class Handle
+		// Fixed-width bitmask stored inline, so masks can be copied, combined and compared without any global lookups
+		template <size_t Bits>
+		class InlineMask
 		{
 		public:
-			Handle();
-			Handle(const Handle& h);
-			Handle(Handle&& h) noexcept;
-			Handle(const RealType& mask);
-			Handle(RealType&& mask);
+			constexpr static size_t numWords = (Bits + 127) / 128 * 2;
+
+			InlineMask()
+				: words{}
+			{}
+
+			constexpr static size_t size() { return Bits; }
+
+			void set(int bit)
+			{
+				words[bit >> 6] |= uint64_t(1) << (bit & 63);
+			}
 
-			void operator=(const Handle& h);
+			bool test(int bit) const
+			{
+				return (words[bit >> 6] & (uint64_t(1) << (bit & 63))) != 0;
+			}
 
-			bool operator==(const Handle& h) const;
-			bool operator!=(const Handle& h) const;
-			bool operator<(const Handle& h) const;
-			Handle operator&(const Handle& h) const;
+			bool any() const
+			{
+				uint64_t result = 0;
+				for (size_t i = 0; i < numWords; ++i) {
+					result |= words[i];
+				}
+				return result != 0;
+			}
 
-			const RealType& getRealValue() const;
-			
-			bool contains(const Handle& handle) const;
+			InlineMask operator&(const InlineMask& other) const
+			{
+				InlineMask result;
+#ifdef HALLEY_FAMILY_MASK_SSE2
+				for (size_t i = 0; i < numWords; i += 2) {
+					_mm_store_si128(result.lane(i), _mm_and_si128(load(i), other.load(i)));
+				}
+#else
+				for (size_t i = 0; i < numWords; ++i) {
+					result.words[i] = words[i] & other.words[i];
+				}
+#endif
+				return result;
+			}
+
+			InlineMask& operator|=(const InlineMask& other)
+			{
+#ifdef HALLEY_FAMILY_MASK_SSE2
+				for (size_t i = 0; i < numWords; i += 2) {
+					_mm_store_si128(lane(i), _mm_or_si128(load(i), other.load(i)));
+				}
+#else
+				for (size_t i = 0; i < numWords; ++i) {
+					words[i] |= other.words[i];
+				}
+#endif
+				return *this;
+			}
+
+			bool operator==(const InlineMask& other) const
+			{
+#ifdef HALLEY_FAMILY_MASK_SSE2
+				for (size_t i = 0; i < numWords; i += 2) {
+					if (_mm_movemask_epi8(_mm_cmpeq_epi8(load(i), other.load(i))) != 0xFFFF) {
+						return false;
+					}
+				}
+				return true;
+#else
+				for (size_t i = 0; i < numWords; ++i) {
+					if (words[i] != other.words[i]) {
+						return false;
+					}
+				}
+				return true;
+#endif
+			}
+
+			bool operator!=(const InlineMask& other) const
+			{
+				return !(*this == other);
+			}
+
+			bool operator<(const InlineMask& other) const
+			{
+				for (size_t i = 0; i < numWords; ++i) {
+					if (words[i] != other.words[i]) {
+						return words[i] < other.words[i];
+					}
+				}
+				return false;
+			}
+
+			// True if every bit set in other is also set in this mask
+			bool contains(const InlineMask& other) const
+			{
+#ifdef HALLEY_FAMILY_MASK_SSE2
+				const __m128i zero = _mm_setzero_si128();
+				for (size_t i = 0; i < numWords; i += 2) {
+					const __m128i missing = _mm_andnot_si128(load(i), other.load(i));
+					if (_mm_movemask_epi8(_mm_cmpeq_epi8(missing, zero)) != 0xFFFF) {
+						return false;
+					}
+				}
+				return true;
+#else
+				for (size_t i = 0; i < numWords; ++i) {
+					if ((other.words[i] & ~words[i]) != 0) {
+						return false;
+					}
+				}
+				return true;
+#endif
+			}
+
+			size_t getHash() const
+			{
+				uint64_t result = 0xcbf29ce484222325ull;
+				for (size_t i = 0; i < numWords; ++i) {
+					result = (result ^ words[i]) * 0x100000001b3ull;
+				}
+				return size_t(result);
+			}
 
 		private:
-			int value = -1;
+			alignas(16) uint64_t words[numWords];
+
+#ifdef HALLEY_FAMILY_MASK_SSE2
+			__m128i load(size_t i) const
+			{
+				return _mm_load_si128(reinterpret_cast<const __m128i*>(words + i));
+			}
+
+			__m128i* lane(size_t i)
+			{
+				return reinterpret_cast<__m128i*>(words + i);
+			}
+#endif
 		};
 
-		using HandleType = Handle;
+		using RealType = InlineMask<maxComponents>;
+		using HandleType = RealType;
 
 
 		inline void setBit(RealType& mask, int bit) {
-			mask[bit] = true;
+			mask.set(bit);
 		}
 
-		inline bool hasBit(HandleType handle, int bit) {
-			return handle.getRealValue()[bit];
+		inline bool hasBit(const HandleType& handle, int bit) {
+			return handle.test(bit);
 		}
 
 
-
-		HandleType getHandle(RealType mask);
-
-
 		template <typename T>
 		struct RetrieveComponentIndex {
 			static constexpr int componentIndex = T::componentIndex;
@@ -81,12 +208,20 @@ namespace Halley {
 			static HandleType getMask() {
 				RealType mask;
 				makeMask(mask);
-				return getHandle(mask);
+				return mask;
 			}
 		};
 
 		
 
+		template <typename T>
+		struct IsConstComponent : std::is_const<T> {};
+
+		template <typename T>
+		struct IsConstComponent<MaybeRef<T>> : std::is_const<T> {};
+
+
+		// Write mask: every component that the family doesn't declare as const
 		template <typename... Ts>
 		struct MutableEvaluator;
 
@@ -100,16 +235,16 @@ namespace Halley {
 		template <typename T, typename... Ts>
 		struct MutableEvaluator <T, Ts...> {
 			static void makeMask(RealType& mask) {
-				if (std::is_const<T>::value) {
+				if (!IsConstComponent<T>::value) {
 					FamilyMask::setBit(mask, RetrieveComponentIndex<T>::componentIndex);
 				}
-				Evaluator<Ts...>::makeMask(mask);
+				MutableEvaluator<Ts...>::makeMask(mask);
 			}
 
 			static HandleType getMask() {
 				RealType mask;
 				makeMask(mask);
-				return getHandle(mask);
+				return mask;
 			}
 		};
 
@@ -143,17 +278,21 @@ namespace Halley {
 			static HandleType getMask() {
 				RealType mask;
 				makeMask(mask);
-				return getHandle(mask);
+				return mask;
 			}
 		};
 	}
 
-	class MaskStorageInterface
+	using FamilyMaskType = FamilyMask::HandleType;
+}
+
+namespace std {
+	template<size_t Bits>
+	struct hash<Halley::FamilyMask::InlineMask<Bits>>
 	{
-	public:
-		static void* createMaskStorage();
-		static void setMaskStorage(void*);
+		size_t operator()(const Halley::FamilyMask::InlineMask<Bits>& mask) const
+		{
+			return mask.getHash();
+		}
 	};
-
-	using FamilyMaskType = FamilyMask::HandleType;
 }
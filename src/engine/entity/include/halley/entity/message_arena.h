@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include "message.h"
+#include "entity_id.h"
+#include <halley/data_structures/vector.h>
+
+namespace Halley {
+	class System;
+
+	// Linear storage for messages of a single type sent by one system.
+	// Messages are copied into large chunks that are reused between frames, rather than being allocated individually.
+	class MessageArena
+	{
+	public:
+		constexpr static size_t chunkSize = 16384;
+
+		MessageArena();
+		~MessageArena();
+
+		MessageArena(const MessageArena& other) = delete;
+		MessageArena(MessageArena&& other) noexcept;
+		MessageArena& operator=(const MessageArena& other) = delete;
+		MessageArena& operator=(MessageArena&& other) noexcept;
+
+		template <typename T>
+		void add(EntityId target, const T& msg)
+		{
+			static_assert(std::is_base_of<Message, T>::value, "Messages must extend the Message class");
+			auto ptr = ::new (allocate(sizeof(T), alignof(T))) T(msg);
+			messages.push_back(ptr);
+			targets.push_back(target);
+		}
+
+		size_t size() const { return messages.size(); }
+		bool empty() const { return messages.empty(); }
+		Message* const* getMessages() const { return messages.data(); }
+		const EntityId* getTargets() const { return targets.data(); }
+
+		// Destroys all messages, but keeps the memory around for the next frame
+		void clear();
+
+	private:
+		struct Chunk
+		{
+			std::unique_ptr<char[]> data;
+			size_t capacity = 0;
+		};
+
+		Vector<Chunk> chunks;
+		Vector<Message*> messages;
+		Vector<EntityId> targets;
+		size_t curChunk = 0;
+		size_t curPos = 0;
+
+		void* allocate(size_t size, size_t align);
+	};
+
+	// Messages of one type waiting to be processed by a receiving system, as contiguous spans
+	class MessageInbox
+	{
+	public:
+		void add(System* sender, Message* const* msgs, const EntityId* targets, size_t n);
+		void discardFrom(System* sender);
+		void clear();
+
+		size_t size() const { return messages.size(); }
+		bool empty() const { return messages.empty(); }
+		Message* const* getMessages() const { return messages.data(); }
+		const EntityId* getTargets() const { return targets.data(); }
+
+	private:
+		Vector<Message*> messages;
+		Vector<EntityId> targets;
+		Vector<System*> senders;
+	};
+}
@@ -8,6 +8,7 @@
 #include "family_mask.h"
 #include "family_type.h"
 #include "entity.h"
+#include "message_arena.h"
 #include "halley/utils/type_traits.h"
 
 namespace Halley {
@@ -32,11 +33,11 @@ namespace Halley {
 	class System
 	{
 	public:
-		System(std::initializer_list<FamilyBindingBase*> families, std::initializer_list<int> messageTypesReceived);
+		System(std::initializer_list<FamilyBindingBase*> families, std::initializer_list<int> messageTypesReceived, std::initializer_list<int> messageTypesSent = {});
 		virtual ~System() {}
 
 		String getName() const { return name; }
-		void setName(String n) { name = n; }
+		void setName(String n);
 		size_t getEntityCount() const;
 		void tryInit();
 
@@ -44,6 +45,11 @@ namespace Halley {
 		long long getNanoSecondsTakenAvg() const { return timer.averageElapsedNanoSeconds(); }
 		void setCollectSamples(bool collect);
 
+		FamilyMask::RealType getReadMask() const;
+		FamilyMask::RealType getWriteMask() const;
+		const Vector<int>& getMessageTypesReceived() const { return messageTypesReceived; }
+		const Vector<int>& getMessageTypesSent() const { return messageTypesSent; }
+
 	protected:
 		const HalleyAPI& doGetAPI() const { return *api; }
 		World& doGetWorld() const { return *world; }
@@ -72,9 +78,7 @@ namespace Halley {
 		template <typename T>
 		void sendMessageGeneric(EntityId entityId, const T& msg)
 		{
-			auto toSend = std::make_unique<T>();
-			*toSend = msg;
-			doSendMessage(entityId, std::move(toSend), sizeof(T), T::messageIndex);
+			getOutbox(T::messageIndex).pending.add(entityId, msg);
 		}
 
 		template <typename T, typename std::enable_if<HasInitMember<T>::value, int>::type = 0>
@@ -123,14 +127,24 @@ namespace Halley {
 	private:
 		friend class World;
 
+		struct Outbox
+		{
+			MessageArena pending; // Sent, but not yet dispatched to receivers
+			MessageArena sent; // Dispatched, kept alive until this system's next update
+		};
+
 		Vector<FamilyBindingBase*> families;
 		Vector<int> messageTypesReceived;
-		Vector<EntityId> messagesSentTo;
-		Vector<std::pair<EntityId, MessageEntry>> outbox;
+		Vector<int> messageTypesSent;
+		Vector<Outbox> outbox; // Indexed by message type
+		Vector<MessageInbox> inbox; // Indexed by message type
+		Vector<Message*> messagesToProcess;
+		Vector<size_t> messageIndicesToProcess;
 
 		World* world = nullptr;
 		const HalleyAPI* api = nullptr;
 		String name;
+		const char* profileName = "System"; // Interned copy of the name, for profiler zones
 		int systemId = -1;
 		bool initialised = false;
 		bool collectSamples = false;
@@ -138,12 +152,13 @@ namespace Halley {
 		StopwatchAveraging timer;
 
 		void doUpdate(Time time);
+		void doUpdateConcurrent(Time time);
 		void doRender(RenderContext& rc);
 		void onAddedToWorld(World& world, int id);
 
+		Outbox& getOutbox(int msgType);
 		void purgeMessages();
 		void processMessages();
-		void doSendMessage(EntityId target, std::unique_ptr<Message> msg, size_t msgSize, int msgId);
 		void dispatchMessages();
 	};
 
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+#include <halley/data_structures/vector.h>
+
+namespace Halley {
+	class System;
+
+	// Splits a timeline's systems into stages, where no two systems in the same stage conflict.
+	// Two systems conflict if one writes a component that the other reads or writes, or if one sends a message type that
+	// the other receives. Conflicting systems keep their original relative order, so a stage only ever depends on earlier ones.
+	class SystemScheduler
+	{
+	public:
+		void invalidate();
+		bool isValid() const { return valid; }
+
+		void build(const Vector<std::unique_ptr<System>>& systems);
+		const Vector<Vector<System*>>& getStages() const { return stages; }
+
+		static bool conflicts(const System& a, const System& b);
+
+	private:
+		Vector<Vector<System*>> stages;
+		bool valid = false;
+	};
+}
@@ -1,14 +1,34 @@
 #pragma once
 
+#include <new>
+#include <utility>
+#include <type_traits>
 #include <halley/data_structures/vector.h>
 
 namespace Halley {
+	class Serializer;
+	class Deserializer;
+
+	// Components generated with "serializable: true" have serialize() and deserialize() methods
+	template <typename T, typename = void>
+	struct IsSerializableComponent : std::false_type {};
+
+	template <typename T>
+	struct IsSerializableComponent<T, decltype(std::declval<const T&>().serialize(std::declval<Serializer&>()), std::declval<T&>().deserialize(std::declval<Deserializer&>()), void())> : std::true_type {};
+
 	class TypeDeleterBase
 	{
 	public:
 		virtual ~TypeDeleterBase() {}
 		virtual size_t getSize() = 0;
+		virtual size_t getAlignment() = 0;
 		virtual void callDestructor(void* ptr) = 0;
+		virtual void callMoveConstructor(void* dst, void* src) = 0;
+		virtual void callDefaultConstructor(void* dst) = 0;
+
+		virtual bool isSerializable() = 0;
+		virtual void serialize(Serializer& s, const void* ptr) = 0;
+		virtual void deserialize(Deserializer& s, void* ptr) = 0;
 	};
 
 	class ComponentDeleterTable
@@ -28,6 +48,12 @@ namespace Halley {
 			return (*getDeleters())[uid];
 		}
 
+		static TypeDeleterBase* tryGet(int uid)
+		{
+			auto& m = *getDeleters();
+			return uid >= 0 && uid < int(m.size()) ? m[uid] : nullptr;
+		}
+
 		static Vector<TypeDeleterBase*>*& getDeleters()
 		{
 			static Vector<TypeDeleterBase*>* map;
@@ -53,6 +79,11 @@ namespace Halley {
 			return sizeof(T);
 		}
 
+		size_t getAlignment() override
+		{
+			return alignof(T);
+		}
+
 		void callDestructor(void* ptr) override
 		{
 #ifdef _MSC_VER
@@ -60,5 +91,43 @@ namespace Halley {
 #endif
 			static_cast<T*>(ptr)->~T();
 		}
+
+		void callMoveConstructor(void* dst, void* src) override
+		{
+			::new (dst) T(std::move(*static_cast<T*>(src)));
+		}
+
+		void callDefaultConstructor(void* dst) override
+		{
+			::new (dst) T();
+		}
+
+		bool isSerializable() override
+		{
+			return IsSerializableComponent<T>::value;
+		}
+
+		void serialize(Serializer& s, const void* ptr) override
+		{
+			doSerialize(s, static_cast<const T*>(ptr), IsSerializableComponent<T>());
+		}
+
+		void deserialize(Deserializer& s, void* ptr) override
+		{
+			doDeserialize(s, static_cast<T*>(ptr), IsSerializableComponent<T>());
+		}
+
+	private:
+		template <typename U>
+		static void doSerialize(Serializer& s, const U* ptr, std::true_type) { ptr->serialize(s); }
+
+		template <typename U>
+		static void doSerialize(Serializer&, const U*, std::false_type) {}
+
+		template <typename U>
+		static void doDeserialize(Deserializer& s, U* ptr, std::true_type) { ptr->deserialize(s); }
+
+		template <typename U>
+		static void doDeserialize(Deserializer&, U*, std::false_type) {}
 	};
 }
@@ -1,21 +1,29 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <atomic>
 #include <typeinfo>
 #include <type_traits>
 #include "entity_id.h"
 #include "family_mask.h"
 #include "family.h"
+#include "archetype.h"
+#include "entity_prefab.h"
+#include "system_scheduler.h"
 #include <halley/time/halleytime.h>
 #include <halley/text/halleystring.h>
 #include <halley/data_structures/mapped_pool.h>
 #include <halley/time/stopwatch.h>
 #include <halley/data_structures/vector.h>
 #include <halley/data_structures/tree_map.h>
+#include <halley/utils/utils.h>
+#include <gsl/gsl>
 #include "service.h"
 
 namespace Halley {
 	class ConfigNode;
+	class Deserializer;
 	class RenderContext;
 	class Entity;
 	class System;
@@ -33,6 +41,8 @@ namespace Halley {
 		bool hasSystemsOnTimeLine(TimeLine timeline) const;
 		
 		int64_t getAverageTime(TimeLine timeline) const;
+		void setCollectMetrics(bool collect);
+		bool isCollectingMetrics() const;
 
 		System& addSystem(std::unique_ptr<System> system, TimeLine timeline);
 		void removeSystem(System& system);
@@ -44,6 +54,13 @@ namespace Halley {
 		Service& addService(std::shared_ptr<Service> service);
 		void loadSystems(const ConfigNode& config, std::function<std::unique_ptr<System>(String)> createFunction);
 
+		void setParallelSystems(bool enabled);
+		bool isParallelSystems() const;
+
+		void setComponentStorage(ComponentStorage storage);
+		ComponentStorage getComponentStorage() const;
+		const ArchetypeStorage& getArchetypes() const;
+
 		template <typename T>
 		T& getService() const
 		{
@@ -52,6 +69,11 @@ namespace Halley {
 		}
 
 		EntityRef createEntity();
+
+		// Creates count entities from the prefab, with all of their components in a single allocation.
+		// They're added to families together when spawned, so each family is notified only once for the whole batch.
+		void instantiate(const EntityPrefab& prefab, size_t count, std::function<void(EntityRef&, size_t)> onCreated = {});
+
 		void destroyEntity(EntityId id);
 		EntityRef getEntity(EntityId id);
 		Entity* tryGetEntity(EntityId id);
@@ -59,7 +81,16 @@ namespace Halley {
 
 		void spawnPending(); // Warning: use with care, will invalidate entities
 
-		void onEntityDirty();
+		// Snapshots hold every entity id and all serializable components, and are meant for rollback.
+		// Restoring is done in place: entities that still exist keep their non-serializable components,
+		// entities created since are destroyed, and ids are allocated exactly as they were after the snapshot was taken.
+		// Entities destroyed since are re-created with their serializable components only, and a warning is logged if that loses any.
+		void saveSnapshot(Bytes& dst);
+		void restoreSnapshot(gsl::span<const gsl::byte> src);
+
+		const Vector<System*>& getMessageReceivers(int msgType) const;
+
+		void onEntityDirty(Entity& entity);
 
 		template <typename T>
 		Family& getFamily()
@@ -85,10 +116,23 @@ namespace Halley {
 		const HalleyAPI* api;
 		std::array<Vector<std::unique_ptr<System>>, static_cast<int>(TimeLine::NUMBER_OF_TIMELINES)> systems;
 		bool collectMetrics = false;
-		bool entityDirty = false;
+		bool parallelSystems = false;
+		std::atomic<bool> updatingConcurrently;
+		std::mutex entityMutex;
+		std::array<SystemScheduler, static_cast<int>(TimeLine::NUMBER_OF_TIMELINES)> schedulers;
+		ComponentStorage componentStorage = ComponentStorage::Individual;
+		ArchetypeStorage archetypes;
 		
 		Vector<Entity*> entities;
 		Vector<Entity*> entitiesPendingCreation;
+		Vector<Entity*> dirtyEntities;
+
+		struct PrefabBatch {
+			FamilyMaskType mask;
+			Vector<Entity*> entities;
+		};
+		Vector<PrefabBatch> prefabBatchesPending;
+		bool familiesDirty = false;
 		MappedPool<Entity*> entityMap;
 
 		//TreeMap<FamilyMaskType, std::unique_ptr<Family>> families;
@@ -96,6 +140,7 @@ namespace Halley {
 		TreeMap<String, std::shared_ptr<Service>> services;
 
 		TreeMap<FamilyMaskType, std::vector<Family*>> familyCache;
+		Vector<Vector<System*>> messageReceivers; // Indexed by message type
 
 		mutable std::array<StopwatchAveraging, 3> timer;
 
@@ -105,12 +150,15 @@ namespace Halley {
 		void deleteEntity(Entity* entity);
 
 		void updateSystems(TimeLine timeline, Time elapsed);
+		void updateSystemsParallel(TimeLine timeline, Time elapsed);
 		void renderSystems(RenderContext& rc) const;
 		
 		void onAddFamily(Family& family);
+		void updateMessageReceivers();
 
 		Service& getService(const String& name) const;
 
 		const std::vector<Family*>& getFamiliesFor(const FamilyMaskType& mask);
+		void restoreComponents(Entity& entity, Deserializer& s);
 	};
 }
@@ -7,5 +7,6 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 #include "entity/service.h"
 #include "entity/system.h"
 #include "entity/world.h"
+#include "entity/entity_prefab.h"
 #include "entity/family_binding.h"
 #include "entity/family.h"
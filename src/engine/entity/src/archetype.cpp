@@ -0,0 +1,146 @@
+#include <cstddef>
+#include <halley/data_structures/memory_pool.h>
+#include <halley/support/exception.h>
+#include <halley/utils/utils.h>
+#include "archetype.h"
+#include "entity.h"
+#include "type_deleter.h"
+
+using namespace Halley;
+
+Archetype::Archetype(FamilyMaskType mask)
+	: mask(mask)
+{
+	for (int i = 0; i < FamilyMask::maxComponents; ++i) {
+		if (mask.test(i)) {
+			auto deleter = ComponentDeleterTable::get(i);
+			if (deleter->getAlignment() > alignof(std::max_align_t)) {
+				throw Exception("Component " + toString(i) + " is over-aligned and cannot be stored in an archetype.", HalleyExceptions::Entity);
+			}
+
+			Column col;
+			col.componentId = i;
+			col.stride = alignUp(deleter->getSize(), deleter->getAlignment());
+			col.deleter = deleter;
+
+			if (int(columnByComponent.size()) <= col.componentId) {
+				columnByComponent.resize(col.componentId + 1, -1);
+			}
+			columnByComponent[col.componentId] = int(columns.size());
+			columns.push_back(std::move(col));
+		}
+	}
+}
+
+Archetype::~Archetype()
+{
+	// Components are destroyed by their entities, so all rows should have been released by now
+}
+
+uint32_t Archetype::allocRow()
+{
+	if (!freeRows.empty()) {
+		auto row = freeRows.back();
+		freeRows.pop_back();
+		return row;
+	}
+
+	if (numRows == numChunks * rowsPerChunk) {
+		addChunk();
+	}
+	return numRows++;
+}
+
+void Archetype::freeRow(uint32_t row)
+{
+	Expects(row < numRows);
+	freeRows.push_back(row);
+
+	if (freeRows.size() == numRows) {
+		// Archetype is empty, so start filling from the beginning of the first chunk again
+		freeRows.clear();
+		numRows = 0;
+	}
+}
+
+void Archetype::addChunk()
+{
+	for (auto& col: columns) {
+		col.chunks.emplace_back(new char[col.stride * rowsPerChunk]);
+	}
+	++numChunks;
+}
+
+ArchetypeStorage::ArchetypeStorage()
+{
+}
+
+ArchetypeStorage::~ArchetypeStorage()
+{
+	flush();
+}
+
+Archetype& ArchetypeStorage::getArchetype(FamilyMaskType mask)
+{
+	auto iter = archetypes.find(mask);
+	if (iter != archetypes.end()) {
+		return *iter->second;
+	}
+
+	auto result = std::make_unique<Archetype>(mask);
+	auto& ref = *result;
+	archetypes[mask] = std::move(result);
+	return ref;
+}
+
+void ArchetypeStorage::relocate(Entity& entity)
+{
+	auto& target = getArchetype(entity.mask);
+	Archetype* prev = entity.archetype;
+	const bool sameArchetype = prev == &target;
+	const uint32_t row = sameArchetype ? entity.archetypeRow : target.allocRow();
+
+	for (int i = 0; i < entity.liveComponents; ++i) {
+		auto& comp = entity.components[i];
+		void* slot = target.tryGetComponent(comp.first, row);
+		Expects(slot != nullptr);
+		if (slot == comp.second) {
+			continue;
+		}
+
+		const bool pooled = !isStoredIn(entity, comp.second, comp.first);
+		ComponentDeleterTable::get(comp.first)->callMoveConstructor(slot, comp.second);
+		pendingComponents.push_back(PendingRelease{ comp.second, comp.first, pooled });
+		comp.second = static_cast<Component*>(slot);
+	}
+
+	if (!sameArchetype) {
+		if (prev) {
+			pendingRows.emplace_back(prev, entity.archetypeRow);
+		}
+		entity.archetype = &target;
+		entity.archetypeRow = row;
+	}
+}
+
+void ArchetypeStorage::flush()
+{
+	for (auto& p: pendingComponents) {
+		auto deleter = ComponentDeleterTable::get(p.componentId);
+		deleter->callDestructor(p.component);
+		if (p.pooled) {
+			PoolPool::getPool(deleter->getSize())->free(p.component);
+		}
+	}
+	pendingComponents.clear();
+
+	for (auto& r: pendingRows) {
+		r.first->freeRow(r.second);
+	}
+	pendingRows.clear();
+}
+
+bool ArchetypeStorage::isStoredIn(const Entity& entity, const Component* component, int componentId)
+{
+	return entity.archetype && entity.archetype->tryGetComponent(componentId, entity.archetypeRow) == component;
+}
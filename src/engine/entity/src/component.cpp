@@ -2,12 +2,27 @@
 #include <halley/support/exception.h>
 #include "component.h"
 #include <iostream>
+#include <mutex>
+#include <atomic>
 #include <halley/support/console.h>
 
 using namespace Halley;
 
+static std::mutex& getPoolMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+static std::atomic<int> concurrentAllocators(0);
+
 void* Component::operator new(size_t size)
 {
+	// Systems running in parallel can add components concurrently
+	std::unique_lock<std::mutex> lock(getPoolMutex(), std::defer_lock);
+	if (concurrentAllocators > 0) {
+		lock.lock();
+	}
 	return PoolPool::getPool(size)->alloc();
 }
 
@@ -15,3 +30,13 @@ void Component::operator delete(void*)
 {
 	std::cout << ConsoleColour(Console::RED) << "Attempting to delete component!" << ConsoleColour() << std::endl;
 }
+
+void Component::beginConcurrentAllocation()
+{
+	++concurrentAllocators;
+}
+
+void Component::endConcurrentAllocation()
+{
+	--concurrentAllocators;
+}
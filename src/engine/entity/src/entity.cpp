@@ -1,6 +1,8 @@
 #include <halley/data_structures/memory_pool.h>
 #include "entity.h"
 #include "world.h"
+#include "archetype.h"
+#include "entity_prefab.h"
 
 using namespace Halley;
 
@@ -15,6 +17,11 @@ Entity::~Entity()
 		deleteComponent(i->second, i->first);
 	}
 	liveComponents = 0;
+
+	if (archetype) {
+		archetype->freeRow(archetypeRow);
+		archetype = nullptr;
+	}
 }
 
 void Entity::addComponent(Component* component, int id)
@@ -29,8 +36,8 @@ void Entity::addComponent(Component* component, int id)
 
 void Entity::removeComponentAt(int i)
 {
-	// Put it at the end and decrease live count
-	std::swap(components[i], components.back());
+	// Put it at the end of the live components and decrease live count
+	std::swap(components[i], components[liveComponents - 1]);
 	--liveComponents;
 }
 
@@ -38,6 +45,15 @@ void Entity::deleteComponent(Component* component, int id)
 {
 	TypeDeleterBase* deleter = ComponentDeleterTable::get(id);
 	deleter->callDestructor(component);
+
+	// Components living in an archetype column are owned by it, and prefab instances share a block
+	if (ArchetypeStorage::isStoredIn(*this, component, id)) {
+		return;
+	}
+	if (componentBlock && componentBlock->contains(component)) {
+		componentBlock->release();
+		return;
+	}
 	PoolPool::getPool(deleter->getSize())->free(component);
 }
 
@@ -49,7 +65,7 @@ void Entity::markDirty(World& world)
 {
 	if (!dirty) {
 		dirty = true;
-		world.onEntityDirty();
+		world.onEntityDirty(*this);
 	}
 }
 
@@ -74,7 +90,7 @@ void Entity::refresh()
 		for (auto i : components) {
 			FamilyMask::setBit(m, i.first);
 		}
-		mask = FamilyMask::getHandle(m);
+		mask = m;
 	}
 }
 
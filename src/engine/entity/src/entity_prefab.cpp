@@ -0,0 +1,46 @@
+#include "entity_prefab.h"
+#include <halley/support/exception.h>
+#include <halley/text/string_converter.h>
+#include <halley/utils/utils.h>
+#include <cstddef>
+
+using namespace Halley;
+
+ComponentBlock::ComponentBlock(size_t size, size_t refs)
+	: data(new char[size])
+	, size(size)
+	, refs(refs)
+{
+}
+
+void ComponentBlock::release()
+{
+	Expects(refs > 0);
+	if (--refs == 0) {
+		delete this;
+	}
+}
+
+void EntityPrefab::addEntry(Entry entry)
+{
+	if (FamilyMask::hasBit(mask, entry.componentId)) {
+		throw Exception("Component " + toString(entry.componentId) + " was already added to this prefab.", HalleyExceptions::Entity);
+	}
+	if (entry.alignment > alignof(std::max_align_t)) {
+		throw Exception("Component " + toString(entry.componentId) + " is over-aligned and cannot be used in a prefab.", HalleyExceptions::Entity);
+	}
+
+	FamilyMask::setBit(mask, entry.componentId);
+	entries.push_back(std::move(entry));
+
+	// Lay components out in order, then pad the whole instance so the next one starts suitably aligned
+	size_t offset = 0;
+	size_t maxAlign = 1;
+	for (auto& e: entries) {
+		offset = alignUp(offset, e.alignment);
+		e.offset = offset;
+		offset += e.size;
+		maxAlign = std::max(maxAlign, e.alignment);
+	}
+	stride = alignUp(offset, maxAlign);
+}
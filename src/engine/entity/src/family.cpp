@@ -3,10 +3,48 @@
 
 using namespace Halley;
 
+void EntityIndexMap::set(EntityId id, size_t index)
+{
+	const auto slot = getSlot(id);
+	const auto page = slot / pageSize;
+	if (page >= pages.size()) {
+		pages.resize(page + 1);
+	}
+	if (!pages[page]) {
+		pages[page].reset(new uint32_t[pageSize]);
+		std::fill_n(pages[page].get(), pageSize, invalid);
+	}
+	pages[page][slot % pageSize] = uint32_t(index);
+}
+
+void EntityIndexMap::erase(EntityId id)
+{
+	const auto slot = getSlot(id);
+	const auto page = slot / pageSize;
+	if (page < pages.size() && pages[page]) {
+		pages[page][slot % pageSize] = invalid;
+	}
+}
+
+void EntityIndexMap::clear()
+{
+	pages.clear();
+}
+
 Family::Family(FamilyMaskType mask) 
 	: inclusionMask(mask)
 {}
 
+size_t Family::getIndexOf(EntityId id) const
+{
+	// The index map only keys on the slot, so a stale id can map to whichever entity reused it
+	const size_t idx = indices.get(id);
+	if (idx < elemCount && static_cast<const FamilyBase*>(getElement(idx))->entityId == id) {
+		return idx;
+	}
+	return EntityIndexMap::npos;
+}
+
 void Family::addOnEntitiesAdded(FamilyBindingBase* bind)
 {
 	addEntityCallbacks.push_back(bind);
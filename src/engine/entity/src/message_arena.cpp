@@ -0,0 +1,106 @@
+#include "message_arena.h"
+#include <halley/utils/utils.h>
+
+using namespace Halley;
+
+MessageArena::MessageArena()
+{
+}
+
+MessageArena::~MessageArena()
+{
+	clear();
+}
+
+MessageArena::MessageArena(MessageArena&& other) noexcept
+	: chunks(std::move(other.chunks))
+	, messages(std::move(other.messages))
+	, targets(std::move(other.targets))
+	, curChunk(other.curChunk)
+	, curPos(other.curPos)
+{
+	other.messages.clear();
+	other.targets.clear();
+	other.curChunk = 0;
+	other.curPos = 0;
+}
+
+MessageArena& MessageArena::operator=(MessageArena&& other) noexcept
+{
+	clear();
+	chunks = std::move(other.chunks);
+	messages = std::move(other.messages);
+	targets = std::move(other.targets);
+	curChunk = other.curChunk;
+	curPos = other.curPos;
+	other.messages.clear();
+	other.targets.clear();
+	other.curChunk = 0;
+	other.curPos = 0;
+	return *this;
+}
+
+void MessageArena::clear()
+{
+	for (auto& m: messages) {
+		m->~Message();
+	}
+	messages.clear();
+	targets.clear();
+	curChunk = 0;
+	curPos = 0;
+}
+
+void* MessageArena::allocate(size_t size, size_t align)
+{
+	while (true) {
+		if (curChunk == chunks.size()) {
+			Chunk chunk;
+			chunk.capacity = std::max(chunkSize, size + align);
+			chunk.data.reset(new char[chunk.capacity]);
+			chunks.push_back(std::move(chunk));
+		}
+
+		auto& chunk = chunks[curChunk];
+		const size_t base = size_t(reinterpret_cast<uintptr_t>(chunk.data.get()));
+		const size_t start = alignUp(base + curPos, align) - base;
+		if (start + size <= chunk.capacity) {
+			curPos = start + size;
+			return chunk.data.get() + start;
+		}
+
+		// Doesn't fit, move on to the next chunk
+		++curChunk;
+		curPos = 0;
+	}
+}
+
+void MessageInbox::add(System* sender, Message* const* msgs, const EntityId* ts, size_t n)
+{
+	messages.insert(messages.end(), msgs, msgs + n);
+	targets.insert(targets.end(), ts, ts + n);
+	senders.resize(senders.size() + n, sender);
+}
+
+void MessageInbox::discardFrom(System* sender)
+{
+	size_t j = 0;
+	for (size_t i = 0; i < messages.size(); ++i) {
+		if (senders[i] != sender) {
+			messages[j] = messages[i];
+			targets[j] = targets[i];
+			senders[j] = senders[i];
+			++j;
+		}
+	}
+	messages.resize(j);
+	targets.resize(j);
+	senders.resize(j);
+}
+
+void MessageInbox::clear()
+{
+	messages.clear();
+	targets.clear();
+	senders.clear();
+}
@@ -1,12 +1,14 @@
 #include "system.h"
-#include <halley/data_structures/flat_map.h>
 #include "halley/support/debug.h"
+#include "halley/support/profiler.h"
+#include "world.h"
 
 using namespace Halley;
 
-System::System(std::initializer_list<FamilyBindingBase*> uninitializedFamilies, std::initializer_list<int> messageTypesReceived)
+System::System(std::initializer_list<FamilyBindingBase*> uninitializedFamilies, std::initializer_list<int> messageTypesReceived, std::initializer_list<int> messageTypesSent)
 	: families(uninitializedFamilies)
 	, messageTypesReceived(messageTypesReceived)
+	, messageTypesSent(messageTypesSent)
 {
 }
 
@@ -19,6 +21,12 @@ size_t System::getEntityCount() const
 	return n;
 }
 
+void System::setName(String n)
+{
+	name = std::move(n);
+	profileName = Profiler::intern(name);
+}
+
 void System::tryInit()
 {
 	if (!initialised) {
@@ -32,6 +40,24 @@ void System::setCollectSamples(bool collect)
 	collectSamples = collect;
 }
 
+FamilyMask::RealType System::getReadMask() const
+{
+	FamilyMask::RealType mask;
+	for (auto f : families) {
+		mask |= f->readMask;
+	}
+	return mask;
+}
+
+FamilyMask::RealType System::getWriteMask() const
+{
+	FamilyMask::RealType mask;
+	for (auto f : families) {
+		mask |= f->writeMask;
+	}
+	return mask;
+}
+
 void System::onAddedToWorld(World& w, int id) {
 	world = &w;
 	systemId = id;
@@ -40,77 +66,87 @@ void System::onAddedToWorld(World& w, int id) {
 	}
 }
 
+System::Outbox& System::getOutbox(int msgType)
+{
+	if (int(outbox.size()) <= msgType) {
+		outbox.resize(msgType + 1);
+	}
+	return outbox[msgType];
+}
+
 void System::purgeMessages()
 {
-	if (messagesSentTo.size() > 0) {
-		for (auto& target: messagesSentTo) {
-			// Purge all messages of this age
-			Entity* entity = world->tryGetEntity(target);
-
-			if (entity) {
-				auto& inbox = entity->inbox;
-				inbox.erase(std::remove_if(inbox.begin(), inbox.end(), [&] (const MessageEntry& e) { return e.age == systemId; }), inbox.end());
+	// Messages dispatched on the previous update have been seen by all receivers by now
+	for (size_t type = 0; type < outbox.size(); ++type) {
+		auto& sent = outbox[type].sent;
+		if (!sent.empty()) {
+			for (auto& receiver: world->getMessageReceivers(int(type))) {
+				receiver->inbox[type].discardFrom(this);
 			}
+			sent.clear();
 		}
-		messagesSentTo.clear();
 	}
 }
 
 void System::processMessages()
 {
-	// This whole method is probably very inefficient.
-	struct MessageBox
-	{
-		Vector<Message*> msg;
-		Vector<size_t> elemIdx;
-	};
-	FlatMap<int, MessageBox> inboxes;
-
-	if (!families.empty()) {
-		auto& fam = *families[0];
-		size_t sz = fam.count();
-		for (size_t i = 0; i < sz; i++) {
-			FamilyBase* elem = reinterpret_cast<FamilyBase*>(fam.getElement(i));
-			Entity* entity = world->tryGetEntity(elem->entityId);
-			if (entity) {
-				for (const auto& msg: entity->inbox) {
-					if (std::find(messageTypesReceived.begin(), messageTypesReceived.end(), msg.type) != messageTypesReceived.end()) {
-						auto& inbox = inboxes[msg.type];
-						inbox.msg.emplace_back(msg.msg.get());
-						inbox.elemIdx.emplace_back(i);
-					}
-				}
+	if (families.empty()) {
+		for (auto& box: inbox) {
+			box.clear();
+		}
+		return;
+	}
+
+	auto& fam = *families[0];
+
+	for (size_t type = 0; type < inbox.size(); ++type) {
+		auto& box = inbox[type];
+		if (box.empty()) {
+			continue;
+		}
+
+		const size_t n = box.size();
+		auto msgs = box.getMessages();
+		auto targets = box.getTargets();
+		for (size_t i = 0; i < n; ++i) {
+			const size_t idx = fam.getIndexOf(targets[i]);
+			if (idx != EntityIndexMap::npos) {
+				messagesToProcess.push_back(msgs[i]);
+				messageIndicesToProcess.push_back(idx);
 			}
 		}
-		for (auto& iter : inboxes) {
-			int id = iter.first;
-			auto& inbox = iter.second;
-			onMessagesReceived(id, inbox.msg.data(), inbox.elemIdx.data(), inbox.msg.size());
+		box.clear();
+
+		if (!messagesToProcess.empty()) {
+			onMessagesReceived(int(type), messagesToProcess.data(), messageIndicesToProcess.data(), messagesToProcess.size());
+			messagesToProcess.clear();
+			messageIndicesToProcess.clear();
 		}
 	}
 }
 
-void System::doSendMessage(EntityId entityId, std::unique_ptr<Message> msg, size_t, int id)
-{
-	outbox.emplace_back(std::make_pair(entityId, MessageEntry(std::move(msg), id, systemId)));
-}
-
 void System::dispatchMessages()
 {
-	if (!outbox.empty()) {
-		for (auto& o: outbox) {
-			Entity* entity = world->tryGetEntity(o.first);
-			if (entity) {
-				entity->inbox.emplace_back(std::move(o.second));
-				messagesSentTo.push_back(o.first);
+	for (size_t type = 0; type < outbox.size(); ++type) {
+		auto& box = outbox[type];
+		if (!box.pending.empty()) {
+			Expects(box.sent.empty());
+			for (auto& receiver: world->getMessageReceivers(int(type))) {
+				if (receiver->inbox.size() <= type) {
+					receiver->inbox.resize(type + 1);
+				}
+				receiver->inbox[type].add(this, box.pending.getMessages(), box.pending.getTargets(), box.pending.size());
 			}
+
+			// Swap so that the pending arena reuses the memory from the previous batch
+			std::swap(box.pending, box.sent);
 		}
-		outbox.clear();
 	}
 }
 
 void System::doUpdate(Time time) {
 	HALLEY_DEBUG_TRACE_COMMENT(name.c_str());
+	HALLEY_PROFILE_SCOPE(profileName);
 	if (collectSamples) {
 		timer.beginSample();
 	}
@@ -129,8 +165,27 @@ void System::doUpdate(Time time) {
 	HALLEY_DEBUG_TRACE_COMMENT(name.c_str());
 }
 
+void System::doUpdateConcurrent(Time time)
+{
+	// Same as doUpdate, but message purging and dispatching are done by the world at sync points
+	HALLEY_PROFILE_SCOPE(profileName);
+	if (collectSamples) {
+		timer.beginSample();
+	}
+
+	if (!messageTypesReceived.empty()) {
+		processMessages();
+	}
+	updateBase(time);
+
+	if (collectSamples) {
+		timer.endSample();
+	}
+}
+
 void System::doRender(RenderContext& rc) {
 	HALLEY_DEBUG_TRACE_COMMENT(name.c_str());
+	HALLEY_PROFILE_SCOPE(profileName);
 	if (collectSamples) {
 		timer.beginSample();
 	}
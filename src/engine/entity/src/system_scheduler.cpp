@@ -0,0 +1,55 @@
+#include "system_scheduler.h"
+#include "system.h"
+
+using namespace Halley;
+
+static bool intersects(const Vector<int>& a, const Vector<int>& b)
+{
+	for (auto& x: a) {
+		if (std::find(b.begin(), b.end(), x) != b.end()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void SystemScheduler::invalidate()
+{
+	valid = false;
+	stages.clear();
+}
+
+void SystemScheduler::build(const Vector<std::unique_ptr<System>>& systems)
+{
+	stages.clear();
+
+	// Each system goes into the stage right after the last stage of anything it conflicts with
+	Vector<size_t> stageOf(systems.size(), 0);
+	for (size_t i = 0; i < systems.size(); ++i) {
+		size_t stage = 0;
+		for (size_t j = 0; j < i; ++j) {
+			if (stageOf[j] + 1 > stage && conflicts(*systems[i], *systems[j])) {
+				stage = stageOf[j] + 1;
+			}
+		}
+		stageOf[i] = stage;
+
+		if (stages.size() <= stage) {
+			stages.resize(stage + 1);
+		}
+		stages[stage].push_back(systems[i].get());
+	}
+
+	valid = true;
+}
+
+bool SystemScheduler::conflicts(const System& a, const System& b)
+{
+	const auto aWrite = a.getWriteMask();
+	const auto bWrite = b.getWriteMask();
+	if ((aWrite & b.getReadMask()).any() || (bWrite & a.getReadMask()).any()) {
+		return true;
+	}
+
+	return intersects(a.getMessageTypesSent(), b.getMessageTypesReceived()) || intersects(b.getMessageTypesSent(), a.getMessageTypesReceived());
+}
@@ -1,20 +1,26 @@
 #include <iostream>
 #include <chrono>
+#include <exception>
 #include <halley/support/exception.h>
 #include <halley/data_structures/memory_pool.h>
 #include <halley/utils/utils.h>
+#include <halley/bytes/byte_serializer.h>
 #include "world.h"
 #include "system.h"
 #include "family.h"
 #include "halley/text/string_converter.h"
 #include "halley/support/debug.h"
+#include "halley/support/profiler.h"
 #include "halley/file_formats/config_file.h"
+#include "halley/concurrency/concurrent.h"
+#include "halley/support/logger.h"
 
 using namespace Halley;
 
 World::World(const HalleyAPI* api, bool collectMetrics)
 	: api(api)
 	, collectMetrics(collectMetrics)
+	, updatingConcurrently(false)
 {	
 }
 
@@ -45,15 +51,22 @@ System& World::addSystem(std::unique_ptr<System> system, TimeLine timelineType)
 	auto& timeline = getSystems(timelineType);
 	timeline.emplace_back(std::move(system));
 	ref.onAddedToWorld(*this, int(timeline.size()));
+	schedulers[int(timelineType)].invalidate();
+	updateMessageReceivers();
 	return ref;
 }
 
 void World::removeSystem(System& system)
 {
-	for (auto& sys : systems) {
+	for (size_t tl = 0; tl < systems.size(); tl++) {
+		auto& sys = systems[tl];
 		for (size_t i = 0; i < sys.size(); i++) {
 			if (sys[i].get() == &system) {
+				// Make sure no other systems hold on to messages owned by this one
+				system.purgeMessages();
 				sys.erase(sys.begin() + i);
+				schedulers[tl].invalidate();
+				updateMessageReceivers();
 				return;
 			}
 		}
@@ -108,6 +121,21 @@ Service& World::addService(std::shared_ptr<Service> service)
 
 void World::loadSystems(const ConfigNode& root, std::function<std::unique_ptr<System>(String)> createFunction)
 {
+	if (root.hasKey("parallelSystems")) {
+		setParallelSystems(root["parallelSystems"].asBool());
+	}
+
+	if (root.hasKey("componentStorage")) {
+		auto storage = root["componentStorage"].asString();
+		if (storage == "archetype") {
+			setComponentStorage(ComponentStorage::Archetype);
+		} else if (storage == "individual") {
+			setComponentStorage(ComponentStorage::Individual);
+		} else {
+			throw Exception("Unknown component storage: " + storage, HalleyExceptions::Entity);
+		}
+	}
+
 	auto timelines = root["timelines"].asMap();
 	for (auto iter = timelines.begin(); iter != timelines.end(); ++iter) {
 		String timelineName = iter->first;
@@ -129,6 +157,34 @@ void World::loadSystems(const ConfigNode& root, std::function<std::unique_ptr<Sy
 	}
 }
 
+void World::setParallelSystems(bool enabled)
+{
+	parallelSystems = enabled;
+}
+
+bool World::isParallelSystems() const
+{
+	return parallelSystems;
+}
+
+void World::setComponentStorage(ComponentStorage storage)
+{
+	if (storage != componentStorage && (!entities.empty() || !entitiesPendingCreation.empty())) {
+		throw Exception("Component storage can only be changed on an empty world.", HalleyExceptions::Entity);
+	}
+	componentStorage = storage;
+}
+
+ComponentStorage World::getComponentStorage() const
+{
+	return componentStorage;
+}
+
+const ArchetypeStorage& World::getArchetypes() const
+{
+	return archetypes;
+}
+
 Service& World::getService(const String& name) const
 {
 	auto iter = services.find(name);
@@ -140,6 +196,7 @@ Service& World::getService(const String& name) const
 
 EntityRef World::createEntity()
 {
+	std::unique_lock<std::mutex> lock(entityMutex);
 	Entity* entity = new(PoolAllocator<Entity>::alloc()) Entity();
 	if (entity == nullptr) {
 		throw Exception("Error creating entity - out of memory?", HalleyExceptions::Entity);
@@ -149,12 +206,244 @@ EntityRef World::createEntity()
 	return EntityRef(*entity, *this);
 }
 
+void World::instantiate(const EntityPrefab& prefab, size_t count, std::function<void(EntityRef&, size_t)> onCreated)
+{
+	if (count == 0) {
+		return;
+	}
+
+	auto& entries = prefab.getEntries();
+	const FamilyMaskType mask = prefab.getMask();
+
+	PrefabBatch batch;
+	batch.mask = mask;
+	batch.entities.reserve(count);
+
+	std::unique_lock<std::mutex> lock(entityMutex);
+
+	// Archetype storage already keeps components contiguous, so construct them in place there
+	Archetype* archetype = componentStorage == ComponentStorage::Archetype ? &archetypes.getArchetype(mask) : nullptr;
+	ComponentBlock* block = nullptr;
+	if (!archetype && !entries.empty()) {
+		block = new ComponentBlock(prefab.getStride() * count, entries.size() * count);
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		Entity* entity = new(PoolAllocator<Entity>::alloc()) Entity();
+		if (entity == nullptr) {
+			throw Exception("Error creating entity - out of memory?", HalleyExceptions::Entity);
+		}
+
+		char* base = nullptr;
+		if (archetype) {
+			entity->archetype = archetype;
+			entity->archetypeRow = archetype->allocRow();
+		} else {
+			entity->componentBlock = block;
+			base = block->getData() + i * prefab.getStride();
+		}
+
+		entity->components.reserve(entries.size());
+		for (auto& e: entries) {
+			void* slot = archetype ? archetype->tryGetComponent(e.componentId, entity->archetypeRow) : base + e.offset;
+			entity->components.emplace_back(e.componentId, e.construct(slot));
+		}
+		entity->liveComponents = int(entries.size());
+		entity->mask = mask;
+
+		entitiesPendingCreation.push_back(entity);
+		allocateEntity(entity);
+		batch.entities.push_back(entity);
+	}
+
+	Vector<Entity*> created;
+	if (onCreated) {
+		created = batch.entities;
+	}
+	prefabBatchesPending.push_back(std::move(batch));
+	lock.unlock();
+
+	for (size_t i = 0; i < created.size(); ++i) {
+		EntityRef ref(*created[i], *this);
+		onCreated(ref, i);
+	}
+}
+
+namespace {
+	constexpr uint32_t snapshotVersion = 2;
+}
+
+void World::saveSnapshot(Bytes& dst)
+{
+	// Make sure there's nothing pending, so every entity is in the entity list with an up-to-date mask
+	spawnPending();
+
+	auto write = [&] (Serializer& s)
+	{
+		s << snapshotVersion << uint32_t(entities.size());
+		for (auto* e: entities) {
+			uint16_t n = 0;
+			for (int i = 0; i < e->liveComponents; ++i) {
+				if (ComponentDeleterTable::get(e->components[i].first)->isSerializable()) {
+					++n;
+				}
+			}
+
+			// Components that can't be serialized aren't in the snapshot, but how many there were is, so restore can tell
+			s << e->getEntityId().value << uint16_t(e->liveComponents - n) << n;
+			for (int i = 0; i < e->liveComponents; ++i) {
+				auto& c = e->components[i];
+				auto deleter = ComponentDeleterTable::get(c.first);
+				if (deleter->isSerializable()) {
+					s << uint16_t(c.first);
+					deleter->serialize(s, c.second);
+				}
+			}
+		}
+		entityMap.serializeState(s);
+	};
+
+	Serializer dryRun;
+	write(dryRun);
+	dst.resize(dryRun.getSize());
+	Serializer s(gsl::as_writeable_bytes(gsl::span<Byte>(dst)));
+	write(s);
+}
+
+void World::restoreSnapshot(gsl::span<const gsl::byte> src)
+{
+	spawnPending();
+
+	Deserializer s(src);
+	uint32_t version;
+	uint32_t count;
+	s >> version;
+	if (version != snapshotVersion) {
+		throw Exception("Unsupported world snapshot version: " + toString(version), HalleyExceptions::Entity);
+	}
+	s >> count;
+
+	// Restore components of entities that still exist, and re-create the others
+	Vector<uint8_t> keep(entities.size(), 0);
+	Vector<Entity*> recreated;
+	size_t componentsLost = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		EntityId id;
+		uint16_t notSerialized;
+		s >> id.value;
+		s >> notSerialized;
+
+		Entity* entity = tryGetEntity(id);
+		if (entity) {
+			keep[entity->worldIndex] = 1;
+		} else {
+			entity = new(PoolAllocator<Entity>::alloc()) Entity();
+			entity->uid = id;
+			recreated.push_back(entity);
+			componentsLost += notSerialized;
+		}
+		restoreComponents(*entity, s);
+	}
+	if (componentsLost > 0) {
+		Logger::logWarning("World snapshot restore re-created entities without " + toString(componentsLost) + " components that aren't serializable; mark them \"serializable: true\" to keep them across rollbacks.");
+	}
+
+	// Remove entities that didn't exist yet, and flush them out of families before any of their ids can be reused
+	Vector<Entity*> removed;
+	size_t nKept = 0;
+	for (size_t i = 0; i < entities.size(); ++i) {
+		auto* e = entities[i];
+		if (keep[i]) {
+			e->worldIndex = uint32_t(nKept);
+			entities[nKept++] = e;
+		} else {
+			for (auto& fam: getFamiliesFor(e->getMask())) {
+				fam->removeEntity(*e);
+			}
+			removed.push_back(e);
+		}
+	}
+	entities.resize(nKept);
+	for (auto& fam: families) {
+		fam->updateEntities();
+	}
+	Vector<EntityId> removedIds;
+	removedIds.reserve(removed.size());
+	for (auto* e: removed) {
+		removedIds.push_back(e->getEntityId());
+		deleteEntity(e);
+	}
+
+	// Ids are now allocated as they were when the snapshot was taken.
+	// That puts back the revisions the removed entities were created with, so their ids would find them again if they weren't cleared.
+	entityMap.deserializeState(s);
+	for (auto& id: removedIds) {
+		auto v = entityMap.get(id.value);
+		if (v) {
+			*v = nullptr;
+		}
+	}
+	for (auto* e: recreated) {
+		*entityMap.get(e->uid.value) = e;
+		e->worldIndex = uint32_t(entities.size());
+		entities.push_back(e);
+	}
+
+	updateEntities();
+}
+
+void World::restoreComponents(Entity& entity, Deserializer& s)
+{
+	uint16_t n;
+	s >> n;
+
+	FamilyMask::RealType restored;
+	for (uint16_t i = 0; i < n; ++i) {
+		uint16_t id;
+		s >> id;
+		auto deleter = ComponentDeleterTable::tryGet(id);
+		if (!deleter) {
+			throw Exception("Unknown component in world snapshot: " + toString(id), HalleyExceptions::Entity);
+		}
+		FamilyMask::setBit(restored, id);
+
+		Component* component = nullptr;
+		for (int j = 0; j < entity.liveComponents; ++j) {
+			if (entity.components[j].first == id) {
+				component = entity.components[j].second;
+				break;
+			}
+		}
+		if (!component) {
+			component = static_cast<Component*>(PoolPool::getPool(deleter->getSize())->alloc());
+			deleter->callDefaultConstructor(component);
+			entity.addComponent(component, id);
+			entity.markDirty(*this);
+		}
+		deleter->deserialize(s, component);
+	}
+
+	// Serializable components that were added after the snapshot was taken
+	for (int j = entity.liveComponents; --j >= 0; ) {
+		const int id = entity.components[j].first;
+		if (!FamilyMask::hasBit(restored, id) && ComponentDeleterTable::get(id)->isSerializable()) {
+			entity.removeComponentAt(j);
+			entity.markDirty(*this);
+		}
+	}
+}
+
 void World::destroyEntity(EntityId id)
 {
 	auto e = tryGetEntity(id);
 	if (e) {
-		e->destroy();
-		entityDirty = true;
+		std::unique_lock<std::mutex> lock(entityMutex);
+		if (e->isAlive()) {
+			if (!e->needsRefresh()) {
+				dirtyEntities.push_back(e);
+			}
+			e->destroy();
+		}
 	}
 }
 
@@ -169,6 +458,12 @@ EntityRef World::getEntity(EntityId id)
 
 Entity* World::tryGetEntity(EntityId id)
 {
+	// Systems running concurrently may be creating entities, which can grow the map
+	std::unique_lock<std::mutex> lock(entityMutex, std::defer_lock);
+	if (updatingConcurrently) {
+		lock.lock();
+	}
+
 	auto v = entityMap.get(id.value);
 	if (v == nullptr) {
 		return nullptr;
@@ -181,9 +476,13 @@ size_t World::numEntities() const
 	return entities.size();
 }
 
-void World::onEntityDirty()
+void World::onEntityDirty(Entity& entity)
 {
-	entityDirty = true;
+	std::unique_lock<std::mutex> lock(entityMutex, std::defer_lock);
+	if (updatingConcurrently) {
+		lock.lock();
+	}
+	dirtyEntities.push_back(&entity);
 }
 
 void World::deleteEntity(Entity* entity)
@@ -203,8 +502,26 @@ int64_t World::getAverageTime(TimeLine timeline) const
 	return timer[int(timeline)].averageElapsedNanoSeconds();
 }
 
+void World::setCollectMetrics(bool collect)
+{
+	collectMetrics = collect;
+	for (auto& tl: systems) {
+		for (auto& s: tl) {
+			s->setCollectSamples(collect);
+		}
+	}
+}
+
+bool World::isCollectingMetrics() const
+{
+	return collectMetrics;
+}
+
 void World::step(TimeLine timeline, Time elapsed)
 {
+	static const char* const zoneNames[] = { "World::step (fixed)", "World::step (variable)", "World::step (render)" };
+	HALLEY_PROFILE_SCOPE(zoneNames[int(timeline)]);
+
 	auto& t = timer[int(timeline)];
 	if (collectMetrics) {
 		t.beginSample();
@@ -222,6 +539,8 @@ void World::step(TimeLine timeline, Time elapsed)
 
 void World::render(RenderContext& rc) const
 {
+	HALLEY_PROFILE_SCOPE("World::render");
+
 	auto& t = timer[int(TimeLine::Render)];
 	if (collectMetrics) {
 		t.beginSample();
@@ -248,9 +567,22 @@ void World::spawnPending()
 		for (auto& e : entitiesPendingCreation) {
 			e->onReady();
 		}
-		std::move(entitiesPendingCreation.begin(), entitiesPendingCreation.end(), std::insert_iterator<decltype(entities)>(entities, entities.end()));
+		for (auto& e : entitiesPendingCreation) {
+			e->worldIndex = uint32_t(entities.size());
+			entities.push_back(e);
+		}
 		entitiesPendingCreation.clear();
-		entityDirty = true;
+
+		// Prefab instances already have their final mask, so whole batches go straight into their families
+		for (auto& batch : prefabBatchesPending) {
+			for (auto& fam : getFamiliesFor(batch.mask)) {
+				fam->addEntities(batch.entities.data(), batch.entities.size());
+			}
+		}
+		if (!prefabBatchesPending.empty()) {
+			prefabBatchesPending.clear();
+			familiesDirty = true;
+		}
 		HALLEY_DEBUG_TRACE();
 	}
 
@@ -259,62 +591,51 @@ void World::spawnPending()
 
 void World::updateEntities()
 {
-	if (!entityDirty) {
+	if (dirtyEntities.empty() && !familiesDirty) {
 		return;
 	}
+	familiesDirty = false;
 
 	HALLEY_DEBUG_TRACE();
-	size_t nEntities = entities.size();
-
-	std::vector<size_t> entitiesRemoved;
-
-	struct FamilyTodo {
-		std::vector<Entity*> toAdd;
-		std::vector<Entity*> toRemove;
-	};
-	std::map<FamilyMaskType, FamilyTodo> pending;
+	Vector<Entity*> entitiesRemoved;
+
+	// Only entities that were touched since the last update are visited here
+	for (auto* e: dirtyEntities) {
+		auto& entity = *e;
+		if (!entity.isAlive()) {
+			// Remove from systems
+			for (auto& fam: getFamiliesFor(entity.getMask())) {
+				fam->removeEntity(entity);
+			}
+			entitiesRemoved.push_back(&entity);
+			continue;
+		}
 
-	// Update all entities
-	// This loop should be as fast as reasonably possible
-	for (size_t i = 0; i < nEntities; i++) {
-		auto& entity = *entities[i];
-		if (i + 20 < nEntities) { // Watch out for sign! Don't subtract!
-			prefetchL2(entities[i + 20]);
+		// It's alive, so check old and new system inclusions
+		const FamilyMaskType oldMask = entity.getMask();
+		entity.refresh();
+		const FamilyMaskType newMask = entity.getMask();
+		if (componentStorage == ComponentStorage::Archetype) {
+			archetypes.relocate(entity);
 		}
 
-		// Check if it needs any sort of updating
-		if (entity.needsRefresh()) {
-			// First of all, let's check if it's dead
-			if (!entity.isAlive()) {
-				// Remove from systems
-				pending[entity.getMask()].toRemove.push_back(&entity);
-				entitiesRemoved.push_back(i);
+		// Families it stays in just get their component pointers reloaded, as those might have changed
+		for (auto& fam: getFamiliesFor(oldMask)) {
+			if (newMask.contains(fam->inclusionMask)) {
+				fam->refreshEntity(entity);
 			} else {
-				// It's alive, so check old and new system inclusions
-				FamilyMaskType oldMask = entity.getMask();
-				entity.refresh();
-				FamilyMaskType newMask = entity.getMask();
-
-				// Did it change?
-				if (oldMask != newMask) {
-					pending[oldMask].toRemove.push_back(&entity);
-					pending[newMask].toAdd.push_back(&entity);
-				}
+				fam->removeEntity(entity);
 			}
 		}
-	}
-
-	HALLEY_DEBUG_TRACE();
-	for (auto& todo: pending) {
-		for (auto& fam: getFamiliesFor(todo.first)) {
-			for (auto& e: todo.second.toRemove) {
-				fam->removeEntity(*e);
-			}
-			for (auto& e: todo.second.toAdd) {
-				fam->addEntity(*e);
+		if (oldMask != newMask) {
+			for (auto& fam: getFamiliesFor(newMask)) {
+				if (!oldMask.contains(fam->inclusionMask)) {
+					fam->addEntity(entity);
+				}
 			}
 		}
 	}
+	dirtyEntities.clear();
 
 	HALLEY_DEBUG_TRACE();
 	// Update families
@@ -322,25 +643,22 @@ void World::updateEntities()
 		iter->updateEntities();
 	}
 
+	// Families are done with the old component locations, so release them
+	archetypes.flush();
+
 	HALLEY_DEBUG_TRACE();
 	// Actually remove dead entities
-	if (!entitiesRemoved.empty()) {
-		size_t livingEntityCount = entities.size();
-		for (int i = int(entitiesRemoved.size()); --i >= 0; ) {
-			size_t idx = entitiesRemoved[i];
-			auto& entity = *entities[idx];
-
-			// Remove
-			entityMap.freeId(entity.getEntityId().value);
-			deleteEntity(&entity);
-
-			// Put it at the back of the array, so it's removed when the array gets resized
-			std::swap(entities[idx], entities[--livingEntityCount]);
-		}
-		entities.resize(livingEntityCount);
+	for (auto* e: entitiesRemoved) {
+		// Swap with the last entity, so it's removed in constant time
+		const uint32_t idx = e->worldIndex;
+		Expects(idx < entities.size() && entities[idx] == e);
+		entities[idx] = entities.back();
+		entities[idx]->worldIndex = idx;
+		entities.pop_back();
+
+		entityMap.freeId(e->getEntityId().value);
+		deleteEntity(e);
 	}
-
-	entityDirty = false;
 	HALLEY_DEBUG_TRACE();
 }
 
@@ -355,12 +673,81 @@ void World::initSystems() const
 
 void World::updateSystems(TimeLine timeline, Time time)
 {
+	if (parallelSystems) {
+		updateSystemsParallel(timeline, time);
+		return;
+	}
+
 	for (auto& system : getSystems(timeline)) {
 		system->doUpdate(time);
 		spawnPending();
 	}
 }
 
+void World::updateSystemsParallel(TimeLine timeline, Time time)
+{
+	auto& scheduler = schedulers[int(timeline)];
+	if (!scheduler.isValid()) {
+		scheduler.build(getSystems(timeline));
+	}
+
+	auto& queue = Executors::getCPU();
+	Vector<Future<void>> futures;
+
+	// An exception escaping a task would never fulfil its future, so each system's is caught, and the first one
+	// is rethrown here once every system in the stage is done, as it would have been when updating them in sequence
+	std::mutex errorMutex;
+	std::exception_ptr error;
+	auto runSystem = [&] (System* system)
+	{
+		try {
+			system->doUpdateConcurrent(time);
+		} catch (...) {
+			std::unique_lock<std::mutex> lock(errorMutex);
+			if (!error) {
+				error = std::current_exception();
+			}
+		}
+	};
+
+	for (auto& stage: scheduler.getStages()) {
+		HALLEY_DEBUG_TRACE();
+		for (auto& system: stage) {
+			system->purgeMessages();
+		}
+
+		// Run all systems in this stage, keeping the first one on this thread
+		const bool concurrent = stage.size() > 1;
+		updatingConcurrently = concurrent;
+		if (concurrent) {
+			Component::beginConcurrentAllocation();
+		}
+		for (size_t i = 1; i < stage.size(); ++i) {
+			System* system = stage[i];
+			futures.push_back(Concurrent::execute(queue, [&runSystem, system] () { runSystem(system); }));
+		}
+		runSystem(stage[0]);
+		if (!futures.empty()) {
+			Concurrent::waitHelping(queue, Concurrent::whenAll(futures.begin(), futures.end()));
+			futures.clear();
+		}
+		updatingConcurrently = false;
+		if (concurrent) {
+			Component::endConcurrentAllocation();
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+
+		// Sync point: deliver messages in the original system order, and apply structural changes
+		for (auto& system: stage) {
+			system->dispatchMessages();
+		}
+		spawnPending();
+		HALLEY_DEBUG_TRACE();
+	}
+}
+
 void World::renderSystems(RenderContext& rc) const
 {
 	for (auto& system : getSystems(TimeLine::Render)) {
@@ -368,6 +755,27 @@ void World::renderSystems(RenderContext& rc) const
 	}
 }
 
+const Vector<System*>& World::getMessageReceivers(int msgType) const
+{
+	static const Vector<System*> none;
+	return msgType < int(messageReceivers.size()) ? messageReceivers[msgType] : none;
+}
+
+void World::updateMessageReceivers()
+{
+	messageReceivers.clear();
+	for (auto& tl: systems) {
+		for (auto& system: tl) {
+			for (auto type: system->getMessageTypesReceived()) {
+				if (int(messageReceivers.size()) <= type) {
+					messageReceivers.resize(type + 1);
+				}
+				messageReceivers[type].push_back(system.get());
+			}
+		}
+	}
+}
+
 void World::onAddFamily(Family& family)
 {
 	// Add any existing entities to this new family
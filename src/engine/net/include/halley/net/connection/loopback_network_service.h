@@ -0,0 +1,121 @@
+#pragma once
+#include "network_service.h"
+#include "network_packet.h"
+#include "halley/maths/random.h"
+#include <memory>
+#include <vector>
+#include <deque>
+#include <map>
+#include <chrono>
+
+namespace Halley
+{
+	class LoopbackNetworkService;
+
+	struct LoopbackNetworkConditions
+	{
+		float latency = 0; // One way, in seconds
+		float jitter = 0; // Latency varies by up to this much either way, so packets can arrive out of order
+		float packetLoss = 0;
+		float duplication = 0;
+	};
+
+	struct LoopbackNetworkStats
+	{
+		size_t packetsSent = 0;
+		size_t packetsDropped = 0;
+		size_t packetsDuplicated = 0;
+		size_t bytesSent = 0;
+	};
+
+	// An in-memory network, connecting any number of LoopbackNetworkServices without touching sockets.
+	// Packets are handed over without copying, after a simulated delay, and may be lost or duplicated along the way.
+	// Uses its own seeded generator, so a run can be reproduced. Not thread-safe; everything attached to it must be updated from the same thread.
+	class LoopbackNetwork
+	{
+		friend class LoopbackConnection;
+		friend class LoopbackNetworkService;
+
+	public:
+		explicit LoopbackNetwork(uint32_t seed = 0);
+
+		void setConditions(LoopbackNetworkConditions conditions);
+		const LoopbackNetworkConditions& getConditions() const;
+
+		const LoopbackNetworkStats& getStats() const;
+		void resetStats();
+
+		// Once called, the network runs on simulated time, which only moves when this is called, instead of the wall clock
+		void advanceTime(float seconds);
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		LoopbackNetworkConditions conditions;
+		Clock::time_point time;
+		bool manualTime = false;
+		LoopbackNetworkStats stats;
+		Random rng;
+		std::map<int, LoopbackNetworkService*> services;
+		uint64_t nextPacketId = 0;
+
+		void registerService(int port, LoopbackNetworkService& service);
+		void unregisterService(int port, LoopbackNetworkService& service);
+		LoopbackNetworkService* getService(int port) const;
+		Clock::time_point getTime() const;
+	};
+
+	class LoopbackConnection : public IConnection
+	{
+		friend class LoopbackNetworkService;
+
+	public:
+		explicit LoopbackConnection(LoopbackNetwork& network);
+
+		void close() override;
+		ConnectionStatus getStatus() const override;
+		void send(OutboundNetworkPacket&& packet) override;
+		bool receive(InboundNetworkPacket& packet) override;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct InFlightPacket
+		{
+			Clock::time_point arrival;
+			uint64_t id; // Keeps packets sent with the same delay in order
+			NetworkBuffer data;
+
+			bool operator<(const InFlightPacket& other) const;
+		};
+
+		LoopbackNetwork& network;
+		std::weak_ptr<LoopbackConnection> remote;
+		ConnectionStatus status = ConnectionStatus::Undefined;
+		std::vector<InFlightPacket> inbox; // Heap, soonest arrival first
+
+		void deliver(const NetworkBuffer& data, Clock::time_point arrival);
+	};
+
+	class LoopbackNetworkService : public NetworkService
+	{
+	public:
+		// Listens on port, unless it's 0. Addresses are ignored, ports are only meaningful within the same LoopbackNetwork.
+		LoopbackNetworkService(LoopbackNetwork& network, int port = 0);
+		~LoopbackNetworkService();
+
+		void update() override;
+
+		void setAcceptingConnections(bool accepting) override;
+		std::shared_ptr<IConnection> tryAcceptConnection() override;
+		std::shared_ptr<IConnection> connect(String address, int port) override;
+
+	private:
+		LoopbackNetwork& network;
+		int port;
+		bool acceptingConnections = false;
+
+		std::deque<std::shared_ptr<LoopbackConnection>> pendingIncomingConnections;
+		std::vector<std::shared_ptr<LoopbackConnection>> activeConnections;
+	};
+}
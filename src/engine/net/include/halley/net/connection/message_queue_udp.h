@@ -5,7 +5,7 @@
 #include <vector>
 #include <map>
 #include "reliable_connection.h"
-#include <list>
+#include <deque>
 #include <chrono>
 #include "message_queue.h"
 
@@ -13,6 +13,28 @@ namespace Halley
 {
 	class ReliableConnection;
 
+	// Holds messages of a reliable ordered channel that arrived ahead of the next one due, indexed by sequence (mod size).
+	// Anything up to half the sequence space past the last message delivered is kept, growing the buffer as needed;
+	// anything else is a duplicate, or older than what was already delivered. Allocated on the first message.
+	class MessageReorderBuffer
+	{
+	public:
+		// Returns false if the message was dropped
+		bool add(unsigned short seq, std::unique_ptr<NetworkMessage> msg);
+
+		// Moves out every message that's now in order
+		void getReadyMessages(std::vector<std::unique_ptr<NetworkMessage>>& out);
+
+		unsigned short getLastDelivered() const;
+		size_t getCapacity() const;
+
+	private:
+		std::vector<std::unique_ptr<NetworkMessage>> buffer;
+		unsigned short lastDelivered = 0;
+
+		void grow(size_t minSize);
+	};
+
 	class MessageQueueUDP : public MessageQueue, private IReliableConnectionAckListener
 	{
 		struct PendingPacket
@@ -26,7 +48,10 @@ namespace Halley
 
 		struct Channel
 		{
-			std::vector<std::unique_ptr<NetworkMessage>> receiveQueue;
+			std::vector<std::unique_ptr<NetworkMessage>> receiveQueue; // Unordered channels
+			MessageReorderBuffer reorderBuffer; // Reliable ordered channels
+			std::unique_ptr<NetworkMessage> latestReceived; // Unreliable ordered channels
+			std::deque<std::unique_ptr<NetworkMessage>> sendQueue;
 			std::unique_ptr<NetworkMessage> lastAck;
 			unsigned short lastAckSeq = 0;
 			unsigned short lastSentSeq = 0;
@@ -34,13 +59,21 @@ namespace Halley
 			ChannelSettings settings;
 			bool initialized = false;
 
+			void onMessageReceived(std::unique_ptr<NetworkMessage> msg);
 			void getReadyMessages(std::vector<std::unique_ptr<NetworkMessage>>& out);
 		};
 
+		struct OutboundPacket
+		{
+			std::vector<std::unique_ptr<NetworkMessage>> msgs;
+			size_t size = 0;
+		};
+
 	public:
 		MessageQueueUDP(std::shared_ptr<ReliableConnection> connection);
 		~MessageQueueUDP();
-		
+
+		bool isConnected() const override;
 		void setChannel(int channel, ChannelSettings settings) override;
 
 		std::vector<std::unique_ptr<NetworkMessage>> receiveAll() override;
@@ -52,16 +85,17 @@ namespace Halley
 		std::shared_ptr<ReliableConnection> connection;
 		std::vector<Channel> channels;
 
-		std::list<std::unique_ptr<NetworkMessage>> pendingMsgs;
 		std::map<int, PendingPacket> pendingPackets;
+		std::vector<OutboundPacket> packing;
 		int nextPacketId = 0;
 
 		void onPacketAcked(int tag) override;
 		void checkReSend(std::vector<ReliableSubPacket>& collect);
 
-		ReliableSubPacket createPacket();
+		void packMessages(bool reliable, std::vector<ReliableSubPacket>& collect);
+		size_t getHeaderSize(NetworkMessage& msg, bool ordered) const;
 		ReliableSubPacket makeTaggedPacket(std::vector<std::unique_ptr<NetworkMessage>>& msgs, size_t size, bool resends = false, unsigned short resendSeq = 0);
-		std::vector<gsl::byte> serializeMessages(const std::vector<std::unique_ptr<NetworkMessage>>& msgs, size_t size) const;
+		NetworkBuffer serializeMessages(const std::vector<std::unique_ptr<NetworkMessage>>& msgs, size_t size) const;
 
 		void receiveMessages();
 	};
@@ -0,0 +1,56 @@
+#pragma once
+#include <gsl/gsl>
+#include <cstddef>
+
+namespace Halley
+{
+	// A reference-counted slice of a pooled block of memory.
+	// Copying or slicing shares the block, so packets can be passed along the network stack without copying their contents.
+	// Blocks big enough for any datagram are recycled through a global pool; bigger ones are allocated (and freed) individually.
+	class NetworkBuffer
+	{
+	public:
+		constexpr static size_t pooledBlockSize = 2048;
+
+		NetworkBuffer();
+		NetworkBuffer(const NetworkBuffer& other);
+		NetworkBuffer(NetworkBuffer&& other) noexcept;
+		~NetworkBuffer();
+
+		NetworkBuffer& operator=(const NetworkBuffer& other);
+		NetworkBuffer& operator=(NetworkBuffer&& other) noexcept;
+
+		// Allocates size bytes, leaving at least headroom bytes free in front of them for headers
+		static NetworkBuffer allocate(size_t size, size_t headroom = 0);
+		static NetworkBuffer copyFrom(gsl::span<const gsl::byte> src, size_t headroom = 0);
+
+		size_t size() const { return len; }
+		bool empty() const { return len == 0; }
+		gsl::byte* data();
+		const gsl::byte* data() const;
+		gsl::span<gsl::byte> getSpan();
+		gsl::span<const gsl::byte> getSpan() const;
+
+		NetworkBuffer slice(size_t offset, size_t size) const;
+
+		// Grows the slice backwards into the free space in front of it, if it's the only reference to its block.
+		// Returns false if that's not possible, in which case nothing changes.
+		bool growFront(size_t n);
+		void shrinkFront(size_t n);
+
+		bool isUnique() const;
+
+		// Number of blocks currently cached by the pool, for diagnostics
+		static size_t getNumPooledBlocks();
+
+	private:
+		struct Block;
+
+		Block* block = nullptr;
+		size_t offset = 0;
+		size_t len = 0;
+
+		NetworkBuffer(Block* block, size_t offset, size_t len);
+		void release();
+	};
+}
@@ -11,30 +11,34 @@ namespace Halley
 	class MessageQueue;
 	class MessageQueueUDP;
 	class MessageQueueTCP;
+	class MessageReorderBuffer;
 
 	class NetworkMessage
 	{
 		friend class MessageQueue;
 		friend class MessageQueueUDP;
 		friend class MessageQueueTCP;
+		friend class MessageReorderBuffer;
 
 	public:
 		virtual ~NetworkMessage() = default;
 
 		size_t getSerializedSize() const
 		{
-			if (!serialized) {
-				serialized = Serializer::toBytes(*this);
+			if (!serializedSize) {
+				Serializer dry;
+				serialize(dry);
+				serializedSize = dry.getSize();
 			}
-			return serialized.get().size();
+			return serializedSize.get();
 		}
 
+		// Serializes straight into the packet being built; dst must be getSerializedSize() bytes
 		void serializeTo(gsl::span<gsl::byte> dst) const
 		{
-			if (!serialized) {
-				serialized = Serializer::toBytes(*this);
-			}
-			memcpy(dst.data(), serialized.get().data(), serialized.get().size());
+			Expects(size_t(dst.size_bytes()) == getSerializedSize());
+			Serializer s(dst);
+			serialize(s);
 		}
 
 		virtual void serialize(Serializer& s) const = 0;
@@ -43,7 +47,7 @@ namespace Halley
 		unsigned short seq = 0;
 		char channel = -1;
 
-		mutable Maybe<Bytes> serialized;
+		mutable Maybe<size_t> serializedSize;
 	};
 
 	class NetworkMessageFactoryBase
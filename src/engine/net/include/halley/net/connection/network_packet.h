@@ -2,6 +2,7 @@
 #include <vector>
 #include <gsl/gsl>
 #include "halley/utils/utils.h"
+#include "network_buffer.h"
 
 namespace Halley
 {
@@ -11,6 +12,7 @@ namespace Halley
 		size_t copyTo(gsl::span<gsl::byte> dst) const;
 		size_t getSize() const;
 		gsl::span<const gsl::byte> getBytes() const;
+		const NetworkBuffer& getBuffer() const;
 
 		NetworkPacketBase(NetworkPacketBase&& other) = delete;
 		NetworkPacketBase& operator=(NetworkPacketBase&& other) = delete;
@@ -18,18 +20,21 @@ namespace Halley
 	protected:
 		NetworkPacketBase();
 		NetworkPacketBase(gsl::span<const gsl::byte> data, size_t prePadding);
+		explicit NetworkPacketBase(NetworkBuffer data);
 
-		size_t dataStart;
-		std::vector<gsl::byte> data;
+		NetworkBuffer data;
 	};
 
 	class OutboundNetworkPacket : public NetworkPacketBase
 	{
 	public:
+		constexpr static size_t headerRoom = 128;
+
 		OutboundNetworkPacket(const OutboundNetworkPacket& other);
 		explicit OutboundNetworkPacket(OutboundNetworkPacket&& other) noexcept;
 		explicit OutboundNetworkPacket(gsl::span<const gsl::byte> data);
 		explicit OutboundNetworkPacket(const Bytes& data);
+		explicit OutboundNetworkPacket(NetworkBuffer data); // Allocate with at least headerRoom bytes of headroom to avoid a copy in addHeader
 		
 		void addHeader(gsl::span<const gsl::byte> src);
 
@@ -48,7 +53,9 @@ namespace Halley
 		InboundNetworkPacket();
 		explicit InboundNetworkPacket(InboundNetworkPacket&& other);
 		explicit InboundNetworkPacket(gsl::span<const gsl::byte> data);
+		explicit InboundNetworkPacket(NetworkBuffer data);
 		void extractHeader(gsl::span<gsl::byte> dst);
+		NetworkBuffer extractBuffer(size_t size); // Shares memory with this packet
 
 		template <typename T>
 		void extractHeader(T& h)
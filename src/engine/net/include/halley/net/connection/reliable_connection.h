@@ -21,7 +21,7 @@ namespace Halley
 	class ReliableSubPacket
 	{
 	public:
-		std::vector<gsl::byte> data;
+		NetworkBuffer data;
 		int tag = -1;
 		//bool reliable = false;
 		bool resends = false;
@@ -33,13 +33,13 @@ namespace Halley
 
 		ReliableSubPacket(ReliableSubPacket&& other) = default;
 
-		ReliableSubPacket(std::vector<gsl::byte>&& data)
-			: data(data)
+		ReliableSubPacket(NetworkBuffer data)
+			: data(std::move(data))
 			, resends(false)
 		{}
 
-		ReliableSubPacket(std::vector<gsl::byte>&& data, unsigned short resendSeq)
-			: data(data)
+		ReliableSubPacket(NetworkBuffer data, unsigned short resendSeq)
+			: data(std::move(data))
 			, resends(true)
 			, resendSeq(resendSeq)
 		{}
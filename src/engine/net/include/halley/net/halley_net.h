@@ -6,7 +6,9 @@ namespace Halley {}
 #include <halley/net/connection/iconnection.h>
 #include <halley/net/connection/imessage_stream.h>
 #include <halley/net/connection/instability_simulator.h>
+#include <halley/net/connection/loopback_network_service.h>
 #include <halley/net/connection/message_queue.h>
+#include <halley/net/connection/network_buffer.h>
 #include <halley/net/connection/network_message.h>
 #include <halley/net/connection/network_packet.h>
 #include <halley/net/connection/network_service.h>
@@ -0,0 +1,56 @@
+#pragma once
+#include "halley/maths/rect.h"
+#include "halley/data_structures/rect_spatial_checker.h"
+#include "halley/data_structures/maybe.h"
+#include <map>
+#include <vector>
+
+namespace Halley {
+	// Tracks what each peer cares about, so the session only sends them what's relevant.
+	// A peer can be interested in an area of the world (e.g. around its camera) and in any number of groups (e.g. a team or a room).
+	// Peers that haven't registered any interest are interested in everything.
+	class NetworkInterest {
+	public:
+		// Resolution is the spatial grid's cell size, given in 2^resolution world units
+		explicit NetworkInterest(int resolution = 7);
+
+		void addPeer(int peerId);
+		void removePeer(int peerId);
+
+		void setPeerArea(int peerId, Rect4i area);
+		void clearPeerArea(int peerId);
+		void addPeerToGroup(int peerId, int group);
+		void removePeerFromGroup(int peerId, int group);
+
+		void setEntityPosition(int entityId, Vector2i position);
+		void removeEntity(int entityId);
+		Maybe<Vector2i> getEntityPosition(int entityId) const;
+
+		// These all append to result, without duplicates
+		void getPeersInterestedIn(Vector2i position, std::vector<int>& result);
+		void getPeersInGroup(int group, std::vector<int>& result);
+		void getPeersRelevantTo(int peerId, std::vector<int>& result); // Peers whose interest overlaps this peer's, or who share a group with it
+		void getEntitiesInArea(Rect4i area, std::vector<int>& result);
+		void getEntitiesRelevantTo(int peerId, std::vector<int>& result);
+
+	private:
+		struct PeerInterest {
+			Maybe<Rect4i> area;
+			std::vector<int> groups;
+
+			bool isFiltered() const { return area || !groups.empty(); }
+		};
+
+		std::map<int, PeerInterest> peers;
+		std::vector<int> unfilteredPeers;
+		std::map<int, std::vector<int>> groups;
+		std::map<int, Vector2i> entityPositions;
+
+		RectangleSpatialChecker peerAreas;
+		RectangleSpatialChecker entities;
+
+		PeerInterest& getPeer(int peerId);
+		void onFilterChanged(int peerId, bool wasFiltered);
+		static void removeDuplicates(std::vector<int>& result, size_t start);
+	};
+}
@@ -1,11 +1,13 @@
 #pragma once
 #include "halley/utils/utils.h"
 #include "halley/bytes/byte_serializer.h"
+#include <chrono>
 #include "../connection/iconnection.h"
 #include "../connection/network_packet.h"
 #include "network_session_messages.h"
 #include "shared_data.h"
 #include "network_session_control_messages.h"
+#include "network_interest.h"
 
 namespace Halley {
 	class NetworkService;
@@ -34,6 +36,12 @@ namespace Halley {
 		void send(OutboundNetworkPacket&& packet) override;
 		bool receive(InboundNetworkPacket& packet) override;
 
+		// Only maintained by the host, which uses it to route messages and filter shared data updates between peers
+		NetworkInterest& getInterest();
+		void sendToPeers(OutboundNetworkPacket&& packet, const std::vector<int>& peerIds); // Host only
+		void sendToInterested(OutboundNetworkPacket&& packet, Vector2i position);
+		void sendToGroup(OutboundNetworkPacket&& packet, int group);
+
 	protected:
 		SharedData& doGetMySharedData();
 		SharedData& doGetMutableSessionSharedData();
@@ -51,6 +59,36 @@ namespace Halley {
 		virtual void onDisconnected(int peerId);
 		
 	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct PeerConnection
+		{
+			int peerId; // Always 0 (the host) on clients
+			std::shared_ptr<IConnection> connection;
+		};
+
+		struct SharedDataPeerState
+		{
+			uint32_t ackedVersion = 0;
+			Clock::time_point lastSent;
+		};
+
+		// State we're replicating to others (session data and our own on the host, our own on clients, plus everyone's on the host)
+		struct OutboundSharedData
+		{
+			uint32_t version = 0;
+			std::map<uint32_t, Bytes> history; // Recent versions, which peers may have acknowledged and can be used as delta baselines
+			std::map<int, SharedDataPeerState> peers; // By peer id
+			int source = -1; // Peer it came from, if we're just relaying it
+		};
+
+		// State received from others, kept around as baselines for upcoming deltas
+		struct InboundSharedData
+		{
+			uint32_t version = 0;
+			std::map<uint32_t, Bytes> history;
+		};
+
 		NetworkService& service;
 		NetworkSessionType type = NetworkSessionType::Undefined;
 
@@ -60,24 +98,44 @@ namespace Halley {
 		std::unique_ptr<SharedData> sessionSharedData;
 		std::map<int, std::unique_ptr<SharedData>> sharedData;
 
-		std::vector<std::shared_ptr<IConnection>> connections;
+		std::vector<PeerConnection> connections;
 		std::vector<InboundNetworkPacket> inbox;
 
+		std::map<int, OutboundSharedData> outboundSharedData;
+		std::map<int, InboundSharedData> inboundSharedData;
+
+		NetworkInterest interest;
+		std::vector<int> peerIdsScratch;
+		std::vector<const PeerConnection*> connectionsScratch;
+
 		OutboundNetworkPacket makeOutbound(gsl::span<const gsl::byte> data, NetworkSessionMessageHeader header);
 		void sendToAll(OutboundNetworkPacket&& packet, int except = -1);
+		void sendToInterested(OutboundNetworkPacket&& packet, NetworkSessionInterestHeader interestHeader);
+		void routeToPeers(const OutboundNetworkPacket& packet, const std::vector<int>& peerIds, int except);
+		void getPeersInterestedIn(const NetworkSessionInterestHeader& interestHeader, std::vector<int>& result);
+		void getConnectionsRelevantTo(int ownerId, std::vector<const PeerConnection*>& result);
+		const PeerConnection* getPeerConnection(int peerId) const;
+		IConnection* getConnection(int peerId) const;
+		int allocatePeerId() const;
 		void closeConnection(int peerId, const String& reason);
+		void onPeerConnectionClosed(int peerId);
 		void processReceive();
 
-		void retransmitControlMessage(int peerId, gsl::span<const gsl::byte> bytes);
-		void receiveControlMessage(int peerId, InboundNetworkPacket& packet);
+		void receiveControlMessage(int peerId, IConnection& connection, InboundNetworkPacket& packet);
 		void onControlMessage(int peerId, const ControlMsgSetPeerId& msg);
-		void onControlMessage(int peerId, const ControlMsgSetPeerState& msg);
-		void onControlMessage(int peerId, const ControlMsgSetSessionState& msg);
+		void onControlMessage(int peerId, IConnection& connection, const ControlMsgSetPeerState& msg);
+		void onControlMessage(int peerId, IConnection& connection, const ControlMsgSetSessionState& msg);
+		void onControlMessage(int peerId, IConnection& connection, const ControlMsgAckSharedData& msg);
 
 		void setMyPeerId(int id);
 
+		SharedData& getSharedData(int ownerId);
 		void checkForOutboundStateChanges(int ownerId);
-		OutboundNetworkPacket makeUpdateSharedDataPacket(int ownerId);
+		void snapshotSharedData(int ownerId);
+		void sendSharedData(int ownerId, OutboundSharedData& outbound, const PeerConnection& connection);
+		void resendUnackedSharedData();
+		OutboundNetworkPacket makeUpdateSharedDataPacket(int ownerId, uint32_t version, uint32_t baseline, Bytes state);
+		const Bytes* receiveSharedData(int ownerId, IConnection& connection, uint32_t version, uint32_t baseline, const Bytes& state);
 		
 		OutboundNetworkPacket doMakeControlPacket(NetworkSessionControlMessageType msgType, OutboundNetworkPacket&& packet);
 	};
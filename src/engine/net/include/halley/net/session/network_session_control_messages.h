@@ -6,7 +6,8 @@ namespace Halley {
 	enum class NetworkSessionControlMessageType : int8_t {
 		SetPeerId,
 		SetSessionState,
-		SetPeerState
+		SetPeerState,
+		AckSharedData
 	};
 
 	struct ControlMsgHeader
@@ -22,7 +23,10 @@ namespace Halley {
 		void deserialize(Deserializer& s);
 	};
 
+	// Shared data is sent either whole (baseline == 0), or as a SharedDataDelta against a version the receiver has acknowledged
 	struct ControlMsgSetSessionState {
+		uint32_t version = 0;
+		uint32_t baseline = 0;
 		Bytes state;
 
 		void serialize(Serializer& s) const;
@@ -31,9 +35,19 @@ namespace Halley {
 
 	struct ControlMsgSetPeerState {
 		int8_t peerId;
+		uint32_t version = 0;
+		uint32_t baseline = 0;
 		Bytes state;
 
 		void serialize(Serializer& s) const;
 		void deserialize(Deserializer& s);
 	};
+
+	struct ControlMsgAckSharedData {
+		int8_t ownerId; // -1 for session data
+		uint32_t version = 0;
+
+		void serialize(Serializer& s) const;
+		void deserialize(Deserializer& s);
+	};
 }
@@ -23,16 +23,18 @@ namespace Halley {
 	enum class NetworkSessionMessageType : char {
 		Control,
 		ToPeers,
-		ToMaster
+		ToMaster,
+		ToInterested
 	};
 
 	template <>
 	struct EnumNames<NetworkSessionMessageType> {
-		constexpr std::array<const char*, 3> operator()() const {
+		constexpr std::array<const char*, 4> operator()() const {
 			return{{
 				"control",
 				"toPeers",
-				"toMaster"
+				"toMaster",
+				"toInterested"
 			}};
 		}
 	};
@@ -41,4 +43,16 @@ namespace Halley {
 		NetworkSessionMessageType type;
 		char srcPeerId;
 	};
+
+	enum class NetworkSessionInterestTarget : char {
+		Position,
+		Group
+	};
+
+	// Follows the session header on ToInterested messages, which the host resolves into a list of peers
+	struct NetworkSessionInterestHeader {
+		NetworkSessionInterestTarget target;
+		int32_t x; // Group, if target is Group
+		int32_t y;
+	};
 }
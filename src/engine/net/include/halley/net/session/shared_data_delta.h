@@ -0,0 +1,13 @@
+#pragma once
+#include "halley/utils/utils.h"
+#include <gsl/gsl>
+
+namespace Halley {
+	// Binary delta between two serializations of the same SharedData.
+	// Only the byte ranges that changed are encoded, so a field changing in an otherwise stable layout costs a few bytes.
+	class SharedDataDelta {
+	public:
+		static Bytes encode(gsl::span<const Byte> baseline, gsl::span<const Byte> current);
+		static Bytes apply(gsl::span<const Byte> baseline, gsl::span<const Byte> delta);
+	};
+}
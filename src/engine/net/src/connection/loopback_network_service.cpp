@@ -0,0 +1,244 @@
+#include "connection/loopback_network_service.h"
+#include <halley/support/exception.h>
+#include <halley/text/string_converter.h>
+#include <algorithm>
+
+using namespace Halley;
+
+LoopbackNetwork::LoopbackNetwork(uint32_t seed)
+	: rng(seed)
+{}
+
+void LoopbackNetwork::setConditions(LoopbackNetworkConditions c)
+{
+	Expects(c.latency >= 0);
+	Expects(c.jitter >= 0);
+	Expects(c.packetLoss < 0.95f);
+	Expects(c.duplication < 0.95f);
+	conditions = c;
+}
+
+const LoopbackNetworkConditions& LoopbackNetwork::getConditions() const
+{
+	return conditions;
+}
+
+const LoopbackNetworkStats& LoopbackNetwork::getStats() const
+{
+	return stats;
+}
+
+void LoopbackNetwork::resetStats()
+{
+	stats = LoopbackNetworkStats();
+}
+
+void LoopbackNetwork::advanceTime(float seconds)
+{
+	Expects(seconds >= 0);
+	if (!manualTime) {
+		manualTime = true;
+		time = Clock::now();
+	}
+	time += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(seconds));
+}
+
+void LoopbackNetwork::registerService(int port, LoopbackNetworkService& service)
+{
+	if (services.find(port) != services.end()) {
+		throw Exception("Loopback port " + toString(port) + " is already in use.", HalleyExceptions::Network);
+	}
+	services[port] = &service;
+}
+
+void LoopbackNetwork::unregisterService(int port, LoopbackNetworkService& service)
+{
+	auto iter = services.find(port);
+	if (iter != services.end() && iter->second == &service) {
+		services.erase(iter);
+	}
+}
+
+LoopbackNetworkService* LoopbackNetwork::getService(int port) const
+{
+	auto iter = services.find(port);
+	return iter != services.end() ? iter->second : nullptr;
+}
+
+LoopbackNetwork::Clock::time_point LoopbackNetwork::getTime() const
+{
+	return manualTime ? time : Clock::now();
+}
+
+
+bool LoopbackConnection::InFlightPacket::operator<(const InFlightPacket& other) const
+{
+	// Reversed, so the heap's top is the first packet to arrive
+	return arrival != other.arrival ? arrival > other.arrival : id > other.id;
+}
+
+LoopbackConnection::LoopbackConnection(LoopbackNetwork& network)
+	: network(network)
+{}
+
+void LoopbackConnection::close()
+{
+	if (status != ConnectionStatus::Closed) {
+		status = ConnectionStatus::Closed;
+		inbox.clear();
+
+		// Let the other end know straight away, as a real transport would eventually time out
+		auto other = remote.lock();
+		if (other) {
+			other->close();
+		}
+	}
+}
+
+ConnectionStatus LoopbackConnection::getStatus() const
+{
+	return status;
+}
+
+void LoopbackConnection::send(OutboundNetworkPacket&& packet)
+{
+	auto other = remote.lock();
+	if (status == ConnectionStatus::Closed || !other) {
+		return;
+	}
+
+	auto& conditions = network.conditions;
+	auto& stats = network.stats;
+	auto& rng = network.rng;
+
+	++stats.packetsSent;
+	stats.bytesSent += packet.getSize();
+
+	if (conditions.packetLoss > 0 && rng.getFloat(0.0f, 1.0f) < conditions.packetLoss) {
+		++stats.packetsDropped;
+		return;
+	}
+
+	const auto now = network.getTime();
+	bool first = true;
+	do {
+		if (!first) {
+			++stats.packetsDuplicated;
+		}
+		first = false;
+
+		float delay = conditions.latency;
+		if (conditions.jitter > 0) {
+			delay = std::max(0.0f, delay + rng.getFloat(-conditions.jitter, conditions.jitter));
+		}
+		other->deliver(packet.getBuffer(), now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(delay)));
+	} while (conditions.duplication > 0 && rng.getFloat(0.0f, 1.0f) < conditions.duplication);
+}
+
+bool LoopbackConnection::receive(InboundNetworkPacket& packet)
+{
+	if (status == ConnectionStatus::Closed || inbox.empty() || inbox.front().arrival > network.getTime()) {
+		return false;
+	}
+
+	std::pop_heap(inbox.begin(), inbox.end());
+	packet = InboundNetworkPacket(std::move(inbox.back().data));
+	inbox.pop_back();
+	return true;
+}
+
+void LoopbackConnection::deliver(const NetworkBuffer& data, Clock::time_point arrival)
+{
+	if (status == ConnectionStatus::Closed) {
+		return;
+	}
+
+	// The buffer is shared with the sender; nobody writes to a packet once it's been sent, so there's no need to copy it
+	inbox.push_back(InFlightPacket{ arrival, network.nextPacketId++, data });
+	std::push_heap(inbox.begin(), inbox.end());
+}
+
+
+LoopbackNetworkService::LoopbackNetworkService(LoopbackNetwork& network, int port)
+	: network(network)
+	, port(port)
+{
+	Expects(port >= 0);
+	if (port != 0) {
+		network.registerService(port, *this);
+	}
+}
+
+LoopbackNetworkService::~LoopbackNetworkService()
+{
+	for (auto& conn: activeConnections) {
+		conn->close();
+	}
+	for (auto& conn: pendingIncomingConnections) {
+		conn->close();
+	}
+	if (port != 0) {
+		network.unregisterService(port, *this);
+	}
+}
+
+void LoopbackNetworkService::update()
+{
+	// Remove closed connections
+	auto isClosed = [] (const std::shared_ptr<LoopbackConnection>& c) { return c->getStatus() == ConnectionStatus::Closed; };
+	activeConnections.erase(std::remove_if(activeConnections.begin(), activeConnections.end(), isClosed), activeConnections.end());
+	pendingIncomingConnections.erase(std::remove_if(pendingIncomingConnections.begin(), pendingIncomingConnections.end(), isClosed), pendingIncomingConnections.end());
+}
+
+void LoopbackNetworkService::setAcceptingConnections(bool accepting)
+{
+	acceptingConnections = accepting;
+	if (!accepting) {
+		for (auto& conn: pendingIncomingConnections) {
+			conn->close();
+		}
+		pendingIncomingConnections.clear();
+	}
+}
+
+std::shared_ptr<IConnection> LoopbackNetworkService::tryAcceptConnection()
+{
+	auto& pending = pendingIncomingConnections;
+	while (acceptingConnections && !pending.empty()) {
+		auto conn = std::move(pending.front());
+		pending.pop_front();
+
+		auto other = conn->remote.lock();
+		if (conn->getStatus() == ConnectionStatus::Closed || !other) {
+			continue;
+		}
+
+		conn->status = ConnectionStatus::Connected;
+		other->status = ConnectionStatus::Connected;
+		activeConnections.push_back(conn);
+		return conn;
+	}
+	return nullptr;
+}
+
+std::shared_ptr<IConnection> LoopbackNetworkService::connect(String address, int port)
+{
+	auto local = std::make_shared<LoopbackConnection>(network);
+	activeConnections.push_back(local);
+
+	auto target = network.getService(port);
+	if (!target) {
+		local->status = ConnectionStatus::Closed;
+		return local;
+	}
+
+	// Like a handshake, the other end picks this up next time it accepts connections; anything sent before that is still delivered
+	auto remote = std::make_shared<LoopbackConnection>(network);
+	local->remote = remote;
+	remote->remote = local;
+	local->status = ConnectionStatus::Connecting;
+	remote->status = ConnectionStatus::Connecting;
+	target->pendingIncomingConnections.push_back(remote);
+
+	return local;
+}
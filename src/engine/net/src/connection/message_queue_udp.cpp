@@ -7,49 +7,102 @@ ChannelSettings::ChannelSettings(bool reliable, bool ordered, bool keepLastSent)
 	, keepLastSent(keepLastSent)
 {}
 
-void MessageQueueUDP::Channel::getReadyMessages(std::vector<std::unique_ptr<NetworkMessage>>& out)
+namespace {
+	constexpr size_t maxPacketSize = 1200;
+	constexpr size_t initialReorderBufferSize = 64;
+}
+
+bool MessageReorderBuffer::add(unsigned short seq, std::unique_ptr<NetworkMessage> msg)
+{
+	const unsigned short dist = seq - lastDelivered;
+	if (dist == 0 || dist >= 0x8000) {
+		// Already delivered (or older than what was)
+		return false;
+	}
+
+	if (dist >= buffer.size()) {
+		grow(size_t(dist) + 1);
+	}
+
+	// Everything in the buffer is within the same window, so a taken slot can only hold this same message
+	auto& slot = buffer[seq & (buffer.size() - 1)];
+	if (slot) {
+		return false;
+	}
+	msg->seq = seq;
+	slot = std::move(msg);
+	return true;
+}
+
+void MessageReorderBuffer::getReadyMessages(std::vector<std::unique_ptr<NetworkMessage>>& out)
+{
+	if (buffer.empty()) {
+		return;
+	}
+	const size_t mask = buffer.size() - 1;
+	for (auto* slot = &buffer[(lastDelivered + 1) & mask]; *slot; slot = &buffer[(lastDelivered + 1) & mask]) {
+		out.push_back(std::move(*slot));
+		++lastDelivered;
+	}
+}
+
+unsigned short MessageReorderBuffer::getLastDelivered() const
+{
+	return lastDelivered;
+}
+
+size_t MessageReorderBuffer::getCapacity() const
+{
+	return buffer.size();
+}
+
+void MessageReorderBuffer::grow(size_t minSize)
+{
+	size_t newSize = std::max(buffer.size(), initialReorderBufferSize);
+	while (newSize < minSize) {
+		newSize *= 2;
+	}
+
+	std::vector<std::unique_ptr<NetworkMessage>> newBuffer(newSize);
+	for (auto& m: buffer) {
+		if (m) {
+			newBuffer[m->seq & (newSize - 1)] = std::move(m);
+		}
+	}
+	buffer = std::move(newBuffer);
+}
+
+void MessageQueueUDP::Channel::onMessageReceived(std::unique_ptr<NetworkMessage> msg)
 {
 	if (settings.ordered) {
 		if (settings.reliable) {
-			bool trying = true;
-			// Oh my god, this is horrible
-			while (trying && !receiveQueue.empty()) {
-				trying = false;
-				for (size_t i = 0; i < receiveQueue.size(); ++i) {
-					auto& m = receiveQueue[i];
-					unsigned short expected = lastReceivedSeq + 1;
-					if (m->seq == expected) {
-						trying = true;
-						out.push_back(std::move(m));
-						if (receiveQueue.size() > 1) {
-							std::swap(receiveQueue[i], receiveQueue[receiveQueue.size() - 1]);
-						}
-						receiveQueue.pop_back();
-						lastReceivedSeq++;
-						break;
-					}
-				}
-			}
+			const unsigned short seq = msg->seq;
+			reorderBuffer.add(seq, std::move(msg));
 		} else {
-			unsigned short bestDist = 0;
-			size_t fail = size_t(-1);
-			size_t best = fail;
-			// Look for the highest seq message, as long as it's above lastReceived
-			for (size_t i = 0; i < receiveQueue.size(); ++i) {
-				auto& m = receiveQueue[i];
-				unsigned short dist = m->seq - lastReceivedSeq;
-				if (dist < 0x7FFF) {
-					if (dist > bestDist) {
-						bestDist = dist;
-						best = i;
-					}
-				}
+			const unsigned short dist = msg->seq - lastReceivedSeq;
+			if (dist == 0 || dist >= 0x8000) {
+				// Already delivered (or older than what was)
+				return;
 			}
-			if (best != fail) {
-				lastReceivedSeq = receiveQueue[best]->seq;
-				out.push_back(std::move(receiveQueue[best]));
+
+			// Only the most recent one matters
+			if (!latestReceived || static_cast<unsigned short>(msg->seq - latestReceived->seq) < 0x8000) {
+				latestReceived = std::move(msg);
 			}
-			receiveQueue.clear();
+		}
+	} else {
+		receiveQueue.push_back(std::move(msg));
+	}
+}
+
+void MessageQueueUDP::Channel::getReadyMessages(std::vector<std::unique_ptr<NetworkMessage>>& out)
+{
+	if (settings.ordered) {
+		if (settings.reliable) {
+			reorderBuffer.getReadyMessages(out);
+		} else if (latestReceived) {
+			lastReceivedSeq = latestReceived->seq;
+			out.push_back(std::move(latestReceived));
 		}
 	} else {
 		for (auto& m: receiveQueue) {
@@ -72,6 +125,11 @@ MessageQueueUDP::~MessageQueueUDP()
 	connection->removeAckListener(*this);
 }
 
+bool MessageQueueUDP::isConnected() const
+{
+	return connection->getStatus() == ConnectionStatus::Connected;
+}
+
 void MessageQueueUDP::setChannel(int channel, ChannelSettings settings)
 {
 	Expects(channel >= 0);
@@ -156,7 +214,7 @@ void MessageQueueUDP::receiveMessages()
 				if (data.size() < signed(size)) {
 					throw Exception("Message does not contain enough data", HalleyExceptions::Network);
 				}
-				channel.receiveQueue.emplace_back(deserializeMessage(data.subspan(0, size), msgType, sequence));
+				channel.onMessageReceived(deserializeMessage(data.subspan(0, size), msgType, sequence));
 				data = data.subspan(size);
 			}
 		}
@@ -194,7 +252,7 @@ void MessageQueueUDP::enqueue(std::unique_ptr<NetworkMessage> msg, int channelNu
 	msg->channel = channelNumber;
 	msg->seq = ++channel.lastSentSeq;
 
-	pendingMsgs.push_back(std::move(msg));
+	channel.sendQueue.push_back(std::move(msg));
 }
 
 void MessageQueueUDP::sendAll()
@@ -205,13 +263,28 @@ void MessageQueueUDP::sendAll()
 	// Add packets which need to be re-sent
 	checkReSend(toSend);
 
-	// Create packets of pending messages
-	while (!pendingMsgs.empty()) {
-		toSend.emplace_back(createPacket());
+	// Create packets of pending messages. Reliable and unreliable messages never share a packet.
+	packMessages(true, toSend);
+	packMessages(false, toSend);
+
+	// Send, packing as many sub-packets in each datagram as will fit
+	const size_t maxSubHeaderSize = 4;
+	size_t start = 0;
+	size_t datagramSize = 0;
+	for (size_t i = 0; i <= toSend.size(); ++i) {
+		const size_t size = i < toSend.size() ? toSend[i].data.size() + maxSubHeaderSize : 0;
+		if (i == toSend.size() || (i > start && datagramSize + size > maxPacketSize)) {
+			// Always send at least one datagram, even if empty, so acks keep flowing
+			if (i > start || start == 0) {
+				connection->sendTagged(gsl::span<ReliableSubPacket>(toSend.data() + start, i - start));
+			}
+			start = i;
+			datagramSize = 0;
+		}
+		datagramSize += size;
 	}
 
-	// Send and update sequences
-	connection->sendTagged(toSend);
+	// Update sequences
 	for (auto& pending: toSend) {
 		pendingPackets[pending.tag].seq = pending.seq;
 	}
@@ -257,49 +330,45 @@ void MessageQueueUDP::checkReSend(std::vector<ReliableSubPacket>& collect)
 	}
 }
 
-ReliableSubPacket MessageQueueUDP::createPacket()
+void MessageQueueUDP::packMessages(bool reliable, std::vector<ReliableSubPacket>& collect)
 {
-	std::vector<std::unique_ptr<NetworkMessage>> sentMsgs;
-	size_t maxSize = 1200;
-	size_t size = 0;
-	bool first = true;
-	bool packetReliable = false;
-
-	// Figure out what messages are going in this packet
-	auto next = pendingMsgs.begin();
-	for (auto iter = pendingMsgs.begin(); iter != pendingMsgs.end(); iter = next) {
-		++next;
-		auto& msg = *iter;
+	// First fit: each message goes in the first packet with room for it, so small messages fill in the gaps left by big ones.
+	// That means a message can end up in an earlier packet than one enqueued before it on the same channel, so packet order
+	// says nothing about message order; ordered channels rely on sequence numbers, and the receiver's reorder buffer.
+	packing.clear();
+
+	for (auto& channel: channels) {
+		if (!channel.initialized || channel.settings.reliable != reliable) {
+			continue;
+		}
 
-		// Check if this message is compatible
-		auto& channel = channels[msg->channel];
-		bool isReliable = channel.settings.reliable;
-		bool isOrdered = channel.settings.ordered;
-		if (first || isReliable == packetReliable) {
-			// Check if the message fits
-			size_t msgSize = (*iter)->getSerializedSize();
-			int msgType = getMessageType(**iter);
-			size_t headerSize = 1 + (isOrdered ? 2 : 0) + (msgSize >= 128 ? 2 : 1) + (msgType >= 128 ? 2 : 1);
-			size_t totalSize = headerSize + msgSize;
-
-			if (size + totalSize <= maxSize) {
-				// It fits, so add it
-				size += totalSize;
-
-				sentMsgs.push_back(std::move(*iter));
-				pendingMsgs.erase(iter);
-
-				first = false;
-				packetReliable = isReliable;
+		for (auto& msg: channel.sendQueue) {
+			const size_t totalSize = getHeaderSize(*msg, channel.settings.ordered) + msg->getSerializedSize();
+			if (totalSize > maxPacketSize) {
+				throw Exception("Was not able to fit message into packet! Size: " + toString(totalSize) + " bytes.", HalleyExceptions::Network);
 			}
+
+			auto dst = std::find_if(packing.begin(), packing.end(), [&] (const OutboundPacket& p) { return p.size + totalSize <= maxPacketSize; });
+			if (dst == packing.end()) {
+				packing.emplace_back();
+				dst = packing.end() - 1;
+			}
+			dst->size += totalSize;
+			dst->msgs.push_back(std::move(msg));
 		}
+		channel.sendQueue.clear();
 	}
 
-	if (sentMsgs.empty()) {
-		throw Exception("Was not able to fit any messages into packet!", HalleyExceptions::Network);
+	for (auto& p: packing) {
+		collect.push_back(makeTaggedPacket(p.msgs, p.size));
 	}
+}
 
-	return makeTaggedPacket(sentMsgs, size);
+size_t MessageQueueUDP::getHeaderSize(NetworkMessage& msg, bool ordered) const
+{
+	const size_t msgSize = msg.getSerializedSize();
+	const int msgType = getMessageType(msg);
+	return 1 + (ordered ? 2 : 0) + (msgSize >= 128 ? 2 : 1) + (msgType >= 128 ? 2 : 1);
 }
 
 ReliableSubPacket MessageQueueUDP::makeTaggedPacket(std::vector<std::unique_ptr<NetworkMessage>>& msgs, size_t size, bool resends, unsigned short resendSeq)
@@ -322,9 +391,10 @@ ReliableSubPacket MessageQueueUDP::makeTaggedPacket(std::vector<std::unique_ptr<
 	return result;
 }
 
-std::vector<gsl::byte> MessageQueueUDP::serializeMessages(const std::vector<std::unique_ptr<NetworkMessage>>& msgs, size_t size) const
+NetworkBuffer MessageQueueUDP::serializeMessages(const std::vector<std::unique_ptr<NetworkMessage>>& msgs, size_t size) const
 {
-	std::vector<gsl::byte> result(size);
+	auto result = NetworkBuffer::allocate(size);
+	auto dst = result.getSpan();
 	size_t pos = 0;
 	
 	for (auto& msg: msgs) {
@@ -336,39 +406,39 @@ std::vector<gsl::byte> MessageQueueUDP::serializeMessages(const std::vector<std:
 		bool isOrdered = channel.settings.ordered;
 
 		// Write header
-		memcpy(&result[pos], &channelN, 1);
+		memcpy(&dst[pos], &channelN, 1);
 		pos += 1;
 		if (isOrdered) {
 			unsigned short sequence = static_cast<unsigned short>(msg->seq);
-			memcpy(&result[pos], &sequence, 2);
+			memcpy(&dst[pos], &sequence, 2);
 			pos += 2;
 		}
 		if (msgSize >= 128) {
 			std::array<unsigned char, 2> bytes;
 			bytes[0] = static_cast<unsigned char>(msgSize >> 8) | 0x80;
 			bytes[1] = static_cast<unsigned char>(msgSize & 0xFF);
-			memcpy(&result[pos], bytes.data(), 2);
+			memcpy(&dst[pos], bytes.data(), 2);
 			pos += 2;
 		} else {
 			unsigned char byte = msgSize & 0x7F;
-			memcpy(&result[pos], &byte, 1);
+			memcpy(&dst[pos], &byte, 1);
 			pos += 1;
 		}
 		if (msgType >= 128) {
 			std::array<unsigned char, 2> bytes;
 			bytes[0] = static_cast<unsigned char>(msgType >> 8) | 0x80;
 			bytes[1] = static_cast<unsigned char>(msgType & 0xFF);
-			memcpy(&result[pos], bytes.data(), 2);
+			memcpy(&dst[pos], bytes.data(), 2);
 			pos += 2;
 		}
 		else {
 			unsigned char byte = msgType & 0x7F;
-			memcpy(&result[pos], &byte, 1);
+			memcpy(&dst[pos], &byte, 1);
 			pos += 1;
 		}
 
 		// Write message
-		msg->serializeTo(gsl::span<gsl::byte>(result).subspan(pos, msgSize));
+		msg->serializeTo(dst.subspan(pos, msgSize));
 		pos += msgSize;
 	}
 
@@ -0,0 +1,233 @@
+#include "connection/network_buffer.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <new>
+#include <cstring>
+
+using namespace Halley;
+
+constexpr size_t NetworkBuffer::pooledBlockSize;
+
+struct NetworkBuffer::Block
+{
+	std::atomic<int> refs;
+	size_t capacity;
+
+	explicit Block(size_t capacity)
+		: refs(1)
+		, capacity(capacity)
+	{}
+
+	gsl::byte* getData()
+	{
+		return reinterpret_cast<gsl::byte*>(this + 1);
+	}
+};
+
+namespace {
+	class NetworkBufferPool
+	{
+	public:
+		constexpr static size_t maxCachedBlocks = 4096;
+
+		void* acquire(size_t allocationSize)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (!cached.empty()) {
+					auto result = cached.back();
+					cached.pop_back();
+					return result;
+				}
+			}
+			return ::operator new(allocationSize);
+		}
+
+		void release(void* block)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (cached.size() < maxCachedBlocks) {
+					cached.push_back(block);
+					return;
+				}
+			}
+			::operator delete(block);
+		}
+
+		size_t getNumCached()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			return cached.size();
+		}
+
+	private:
+		std::mutex mutex;
+		std::vector<void*> cached;
+	};
+
+	NetworkBufferPool& getPool()
+	{
+		// Never destroyed, as buffers might still be released during static destruction
+		static auto pool = new NetworkBufferPool();
+		return *pool;
+	}
+}
+
+NetworkBuffer::NetworkBuffer()
+{}
+
+NetworkBuffer::NetworkBuffer(Block* block, size_t offset, size_t len)
+	: block(block)
+	, offset(offset)
+	, len(len)
+{}
+
+NetworkBuffer::NetworkBuffer(const NetworkBuffer& other)
+	: block(other.block)
+	, offset(other.offset)
+	, len(other.len)
+{
+	if (block) {
+		block->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+NetworkBuffer::NetworkBuffer(NetworkBuffer&& other) noexcept
+	: block(other.block)
+	, offset(other.offset)
+	, len(other.len)
+{
+	other.block = nullptr;
+	other.offset = 0;
+	other.len = 0;
+}
+
+NetworkBuffer::~NetworkBuffer()
+{
+	release();
+}
+
+NetworkBuffer& NetworkBuffer::operator=(const NetworkBuffer& other)
+{
+	if (this != &other) {
+		if (other.block) {
+			other.block->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+		release();
+		block = other.block;
+		offset = other.offset;
+		len = other.len;
+	}
+	return *this;
+}
+
+NetworkBuffer& NetworkBuffer::operator=(NetworkBuffer&& other) noexcept
+{
+	if (this != &other) {
+		release();
+		block = other.block;
+		offset = other.offset;
+		len = other.len;
+		other.block = nullptr;
+		other.offset = 0;
+		other.len = 0;
+	}
+	return *this;
+}
+
+NetworkBuffer NetworkBuffer::allocate(size_t size, size_t headroom)
+{
+	const size_t capacity = size + headroom;
+	void* memory;
+	if (capacity <= pooledBlockSize) {
+		memory = getPool().acquire(sizeof(Block) + pooledBlockSize);
+		return NetworkBuffer(new (memory) Block(pooledBlockSize), headroom, size);
+	} else {
+		memory = ::operator new(sizeof(Block) + capacity);
+		return NetworkBuffer(new (memory) Block(capacity), headroom, size);
+	}
+}
+
+NetworkBuffer NetworkBuffer::copyFrom(gsl::span<const gsl::byte> src, size_t headroom)
+{
+	auto result = allocate(size_t(src.size_bytes()), headroom);
+	memcpy(result.data(), src.data(), size_t(src.size_bytes()));
+	return result;
+}
+
+gsl::byte* NetworkBuffer::data()
+{
+	return block ? block->getData() + offset : nullptr;
+}
+
+const gsl::byte* NetworkBuffer::data() const
+{
+	return block ? block->getData() + offset : nullptr;
+}
+
+gsl::span<gsl::byte> NetworkBuffer::getSpan()
+{
+	return gsl::span<gsl::byte>(data(), len);
+}
+
+gsl::span<const gsl::byte> NetworkBuffer::getSpan() const
+{
+	return gsl::span<const gsl::byte>(data(), len);
+}
+
+NetworkBuffer NetworkBuffer::slice(size_t start, size_t size) const
+{
+	Expects(start + size <= len);
+	if (block) {
+		block->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+	return NetworkBuffer(block, offset + start, size);
+}
+
+bool NetworkBuffer::growFront(size_t n)
+{
+	// Another reference might be using the memory in front of this slice
+	if (n > offset || !isUnique()) {
+		return false;
+	}
+	offset -= n;
+	len += n;
+	return true;
+}
+
+void NetworkBuffer::shrinkFront(size_t n)
+{
+	Expects(n <= len);
+	offset += n;
+	len -= n;
+}
+
+bool NetworkBuffer::isUnique() const
+{
+	return block && block->refs.load(std::memory_order_acquire) == 1;
+}
+
+size_t NetworkBuffer::getNumPooledBlocks()
+{
+	return getPool().getNumCached();
+}
+
+void NetworkBuffer::release()
+{
+	if (block) {
+		if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			const bool pooled = block->capacity == pooledBlockSize;
+			block->~Block();
+			if (pooled) {
+				getPool().release(block);
+			} else {
+				::operator delete(block);
+			}
+		}
+		block = nullptr;
+		offset = 0;
+		len = 0;
+	}
+}
@@ -4,15 +4,19 @@
 
 using namespace Halley;
 
+constexpr size_t OutboundNetworkPacket::headerRoom;
+
 NetworkPacketBase::NetworkPacketBase()
-	: dataStart(0)
 {}
 
 NetworkPacketBase::NetworkPacketBase(gsl::span<const gsl::byte> src, size_t prePadding)
-	: dataStart(prePadding)
+	: data(NetworkBuffer::copyFrom(src, prePadding))
+{
+}
+
+NetworkPacketBase::NetworkPacketBase(NetworkBuffer data)
+	: data(std::move(data))
 {
-	data.resize(src.size_bytes() + prePadding);
-	memcpy(data.data() + prePadding, src.data(), src.size_bytes());
 }
 
 size_t NetworkPacketBase::copyTo(gsl::span<gsl::byte> dst) const
@@ -20,57 +24,64 @@ size_t NetworkPacketBase::copyTo(gsl::span<gsl::byte> dst) const
 	if (dst.size() < signed(getSize())) {
 		throw Exception("Destination buffer is too small for network packet.", HalleyExceptions::Network);
 	}
-	memcpy(dst.data(), data.data() + dataStart, getSize());
+	memcpy(dst.data(), data.data(), getSize());
 	return getSize();
 }
 
 size_t NetworkPacketBase::getSize() const
 {
-	Expects(data.size() >= dataStart);
-	return data.size() - dataStart;
+	return data.size();
 }
 
 gsl::span<const gsl::byte> NetworkPacketBase::getBytes() const
 {
-	return gsl::span<const gsl::byte>(data).subspan(dataStart, getSize());
+	return data.getSpan();
+}
+
+const NetworkBuffer& NetworkPacketBase::getBuffer() const
+{
+	return data;
 }
 
 OutboundNetworkPacket::OutboundNetworkPacket(const OutboundNetworkPacket& other)
-	: NetworkPacketBase()
+	: NetworkPacketBase(other.data)
 {
-	data = other.data;
-	dataStart = other.dataStart;
 }
 
 OutboundNetworkPacket::OutboundNetworkPacket(OutboundNetworkPacket&& other) noexcept
+	: NetworkPacketBase(std::move(other.data))
 {
-	data = other.data;
-	dataStart = other.dataStart;
-	other.dataStart = 0;
 }
 
 OutboundNetworkPacket::OutboundNetworkPacket(gsl::span<const gsl::byte> data)
-	: NetworkPacketBase(data, 128)
+	: NetworkPacketBase(data, headerRoom)
 {}
 
 OutboundNetworkPacket::OutboundNetworkPacket(const Bytes& data)
-	: NetworkPacketBase(gsl::as_bytes(gsl::span<const Byte>(data)), 128)
+	: NetworkPacketBase(gsl::as_bytes(gsl::span<const Byte>(data)), headerRoom)
+{
+}
+
+OutboundNetworkPacket::OutboundNetworkPacket(NetworkBuffer data)
+	: NetworkPacketBase(std::move(data))
 {
 }
 
 void OutboundNetworkPacket::addHeader(gsl::span<const gsl::byte> src)
 {
-	Expects(src.size_bytes() <= signed(dataStart));
-	
-	dataStart -= src.size_bytes();
-	memcpy(data.data() + dataStart, src.data(), src.size_bytes());
+	const size_t size = size_t(src.size_bytes());
+	if (!data.growFront(size)) {
+		// Out of headroom, or the buffer is shared with another packet (e.g. the same packet sent to several connections)
+		auto newData = NetworkBuffer::allocate(size + data.size(), headerRoom);
+		memcpy(newData.data() + size, data.data(), data.size());
+		data = std::move(newData);
+	}
+	memcpy(data.data(), src.data(), size);
 }
 
 OutboundNetworkPacket& OutboundNetworkPacket::operator=(OutboundNetworkPacket&& other) noexcept
 {
-	data = other.data;
-	dataStart = other.dataStart;
-	other.dataStart = 0;
+	data = std::move(other.data);
 	return *this;
 }
 
@@ -79,29 +90,37 @@ InboundNetworkPacket::InboundNetworkPacket()
 {}
 
 InboundNetworkPacket::InboundNetworkPacket(InboundNetworkPacket&& other)
-	: NetworkPacketBase()
+	: NetworkPacketBase(std::move(other.data))
 {
-	data = other.data;
-	dataStart = other.dataStart;
-	other.dataStart = 0;
 }
 
 InboundNetworkPacket::InboundNetworkPacket(gsl::span<const gsl::byte> data)
 	: NetworkPacketBase(data, 0)
 {}
 
+InboundNetworkPacket::InboundNetworkPacket(NetworkBuffer data)
+	: NetworkPacketBase(std::move(data))
+{}
+
 void InboundNetworkPacket::extractHeader(gsl::span<gsl::byte> dst)
 {
 	Expects(dst.size_bytes() <= signed(data.size()));
 
-	memcpy(dst.data(), data.data() + dataStart, dst.size_bytes());
-	dataStart += dst.size_bytes();
+	memcpy(dst.data(), data.data(), dst.size_bytes());
+	data.shrinkFront(size_t(dst.size_bytes()));
+}
+
+NetworkBuffer InboundNetworkPacket::extractBuffer(size_t size)
+{
+	Expects(size <= data.size());
+
+	auto result = data.slice(0, size);
+	data.shrinkFront(size);
+	return result;
 }
 
 InboundNetworkPacket& InboundNetworkPacket::operator=(InboundNetworkPacket&& other)
 {
-	data = other.data;
-	dataStart = other.dataStart;
-	other.dataStart = 0;
+	data = std::move(other.data);
 	return *this;
 }
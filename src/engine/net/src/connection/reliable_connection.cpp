@@ -44,9 +44,7 @@ ConnectionStatus ReliableConnection::getStatus() const
 
 void ReliableConnection::send(OutboundNetworkPacket&& packet)
 {
-	ReliableSubPacket subPacket;
-	subPacket.data.resize(packet.getSize());
-	packet.copyTo(subPacket.data);
+	ReliableSubPacket subPacket(packet.getBuffer());
 	subPacket.resends = false;
 	subPacket.tag = -1;
 
@@ -56,8 +54,14 @@ void ReliableConnection::send(OutboundNetworkPacket&& packet)
 void ReliableConnection::sendTagged(gsl::span<ReliableSubPacket> subPackets)
 {
 	unsigned short firstSeq = nextSequenceToSend;
-	std::array<gsl::byte, 2048> buffer;
-	gsl::span<gsl::byte, 2048> dst(buffer);
+
+	// Write straight into the buffer that will be sent, leaving room for the layers below to add their headers
+	size_t totalSize = sizeof(ReliableHeader);
+	for (auto& subPacket : subPackets) {
+		totalSize += (subPacket.data.size() >= 64 ? 2 : 1) + (subPacket.resends ? 2 : 0) + subPacket.data.size();
+	}
+	auto buffer = NetworkBuffer::allocate(totalSize, OutboundNetworkPacket::headerRoom);
+	auto dst = buffer.getSpan();
 	size_t pos = sizeof(ReliableHeader);
 
 	for (auto& subPacket : subPackets) {
@@ -77,7 +81,7 @@ void ReliableConnection::sendTagged(gsl::span<ReliableSubPacket> subPackets)
 			memcpy(dst.subspan(pos, 1).data(), &b, 1);
 			pos += 1;
 		}
-		if (resending) {
+		if (isResend) {
 			memcpy(dst.subspan(pos, 2).data(), &resending, 2);
 			pos += 2;
 		}
@@ -118,7 +122,8 @@ void ReliableConnection::sendTagged(gsl::span<ReliableSubPacket> subPackets)
 #endif
 
 	// Send
-	parent->send(OutboundNetworkPacket(dst.subspan(0, pos)));
+	Expects(pos == totalSize);
+	parent->send(OutboundNetworkPacket(std::move(buffer)));
 }
 
 bool ReliableConnection::receive(InboundNetworkPacket& packet)
@@ -190,17 +195,15 @@ void ReliableConnection::processReceivedPacket(InboundNetworkPacket& packet)
 			packet.extractHeader(gsl::as_writeable_bytes(gsl::span<unsigned short>(&resendOf, 1)));
 		}
 
-		// Extract data
-		std::array<char, 2048> buffer;
-		if (size > buffer.size() || size > packet.getSize()) {
+		// Extract data, sharing the datagram's memory
+		if (size > packet.getSize()) {
 			throw Exception("Unexpected sub-packet size: " + toString(size) + " bytes, packet is " + toString(packet.getSize()) + " bytes.", HalleyExceptions::Network);
 		}
-		auto subPacketData = gsl::span<char, 2048>(buffer).subspan(0, size);
-		packet.extractHeader(gsl::as_writeable_bytes(subPacketData));
+		auto subPacketData = packet.extractBuffer(size);
 
 		// Process sub-packet
 		if (onSeqReceived(seq, resend, resendOf)) {
-			pendingPackets.push_back(InboundNetworkPacket(gsl::as_bytes(subPacketData)));
+			pendingPackets.push_back(InboundNetworkPacket(std::move(subPacketData)));
 		}
 		++seq;
 	}
@@ -0,0 +1,195 @@
+#include "session/network_interest.h"
+#include <algorithm>
+
+using namespace Halley;
+
+NetworkInterest::NetworkInterest(int resolution)
+	: peerAreas(resolution)
+	, entities(resolution)
+{
+}
+
+void NetworkInterest::addPeer(int peerId)
+{
+	if (peers.find(peerId) == peers.end()) {
+		peers[peerId];
+		unfilteredPeers.push_back(peerId);
+	}
+}
+
+void NetworkInterest::removePeer(int peerId)
+{
+	auto iter = peers.find(peerId);
+	if (iter == peers.end()) {
+		return;
+	}
+
+	for (int group: iter->second.groups) {
+		auto& members = groups[group];
+		members.erase(std::remove(members.begin(), members.end(), peerId), members.end());
+		if (members.empty()) {
+			groups.erase(group);
+		}
+	}
+	if (iter->second.area) {
+		peerAreas.remove(peerId);
+	}
+	unfilteredPeers.erase(std::remove(unfilteredPeers.begin(), unfilteredPeers.end(), peerId), unfilteredPeers.end());
+	peers.erase(iter);
+}
+
+void NetworkInterest::setPeerArea(int peerId, Rect4i area)
+{
+	auto& peer = getPeer(peerId);
+	const bool wasFiltered = peer.isFiltered();
+	peer.area = area;
+	peerAreas.update(area, peerId);
+	onFilterChanged(peerId, wasFiltered);
+}
+
+void NetworkInterest::clearPeerArea(int peerId)
+{
+	auto& peer = getPeer(peerId);
+	if (peer.area) {
+		peer.area.reset();
+		peerAreas.remove(peerId);
+		onFilterChanged(peerId, true);
+	}
+}
+
+void NetworkInterest::addPeerToGroup(int peerId, int group)
+{
+	auto& peer = getPeer(peerId);
+	if (std::find(peer.groups.begin(), peer.groups.end(), group) == peer.groups.end()) {
+		const bool wasFiltered = peer.isFiltered();
+		peer.groups.push_back(group);
+		groups[group].push_back(peerId);
+		onFilterChanged(peerId, wasFiltered);
+	}
+}
+
+void NetworkInterest::removePeerFromGroup(int peerId, int group)
+{
+	auto& peer = getPeer(peerId);
+	auto iter = std::find(peer.groups.begin(), peer.groups.end(), group);
+	if (iter != peer.groups.end()) {
+		peer.groups.erase(iter);
+		auto& members = groups[group];
+		members.erase(std::remove(members.begin(), members.end(), peerId), members.end());
+		if (members.empty()) {
+			groups.erase(group);
+		}
+		onFilterChanged(peerId, true);
+	}
+}
+
+void NetworkInterest::setEntityPosition(int entityId, Vector2i position)
+{
+	entityPositions[entityId] = position;
+	entities.update(Rect4i(position, position + Vector2i(1, 1)), entityId);
+}
+
+void NetworkInterest::removeEntity(int entityId)
+{
+	if (entityPositions.erase(entityId) > 0) {
+		entities.remove(entityId);
+	}
+}
+
+Maybe<Vector2i> NetworkInterest::getEntityPosition(int entityId) const
+{
+	auto iter = entityPositions.find(entityId);
+	if (iter == entityPositions.end()) {
+		return {};
+	}
+	return iter->second;
+}
+
+void NetworkInterest::getPeersInterestedIn(Vector2i position, std::vector<int>& result)
+{
+	const size_t start = result.size();
+	auto found = peerAreas.query(Rect4i(position, position + Vector2i(1, 1)));
+	result.insert(result.end(), found.results, found.results + found.n);
+	result.insert(result.end(), unfilteredPeers.begin(), unfilteredPeers.end());
+	removeDuplicates(result, start);
+}
+
+void NetworkInterest::getPeersInGroup(int group, std::vector<int>& result)
+{
+	const size_t start = result.size();
+	auto iter = groups.find(group);
+	if (iter != groups.end()) {
+		result.insert(result.end(), iter->second.begin(), iter->second.end());
+	}
+	result.insert(result.end(), unfilteredPeers.begin(), unfilteredPeers.end());
+	removeDuplicates(result, start);
+}
+
+void NetworkInterest::getPeersRelevantTo(int peerId, std::vector<int>& result)
+{
+	const size_t start = result.size();
+
+	auto peerIter = peers.find(peerId);
+	if (peerIter == peers.end() || !peerIter->second.isFiltered()) {
+		// We don't know anything about this peer, so it might be relevant to anyone
+		for (auto& p: peers) {
+			result.push_back(p.first);
+		}
+	} else {
+		auto& peer = peerIter->second;
+		if (peer.area) {
+			auto found = peerAreas.query(peer.area.get());
+			result.insert(result.end(), found.results, found.results + found.n);
+		}
+		for (int group: peer.groups) {
+			auto& members = groups[group];
+			result.insert(result.end(), members.begin(), members.end());
+		}
+		result.insert(result.end(), unfilteredPeers.begin(), unfilteredPeers.end());
+	}
+
+	result.erase(std::remove(result.begin() + start, result.end(), peerId), result.end());
+	removeDuplicates(result, start);
+}
+
+void NetworkInterest::getEntitiesInArea(Rect4i area, std::vector<int>& result)
+{
+	const size_t start = result.size();
+	auto found = entities.query(area);
+	result.insert(result.end(), found.results, found.results + found.n);
+	removeDuplicates(result, start);
+}
+
+void NetworkInterest::getEntitiesRelevantTo(int peerId, std::vector<int>& result)
+{
+	auto peerIter = peers.find(peerId);
+	if (peerIter == peers.end() || !peerIter->second.isFiltered()) {
+		for (auto& e: entityPositions) {
+			result.push_back(e.first);
+		}
+	} else if (peerIter->second.area) {
+		getEntitiesInArea(peerIter->second.area.get(), result);
+	}
+}
+
+NetworkInterest::PeerInterest& NetworkInterest::getPeer(int peerId)
+{
+	addPeer(peerId);
+	return peers[peerId];
+}
+
+void NetworkInterest::onFilterChanged(int peerId, bool wasFiltered)
+{
+	const bool filtered = peers[peerId].isFiltered();
+	if (filtered && !wasFiltered) {
+		unfilteredPeers.erase(std::remove(unfilteredPeers.begin(), unfilteredPeers.end(), peerId), unfilteredPeers.end());
+	} else if (!filtered && wasFiltered) {
+		unfilteredPeers.push_back(peerId);
+	}
+}
+
+void NetworkInterest::removeDuplicates(std::vector<int>& result, size_t start)
+{
+	std::sort(result.begin() + start, result.end());
+	result.erase(std::unique(result.begin() + start, result.end()), result.end());
+}
@@ -2,8 +2,20 @@
 #include "session/network_session_control_messages.h"
 #include "connection/network_service.h"
 #include "connection/network_packet.h"
+#include "session/shared_data_delta.h"
 using namespace Halley;
 
+namespace {
+	// Deltas are only sent against versions at most this old; anything older gets the full state
+	constexpr uint32_t maxDeltaDistance = 32;
+
+	// How many versions a receiver keeps as potential baselines. Must comfortably cover maxDeltaDistance.
+	constexpr uint32_t inboundHistoryLength = 64;
+
+	// Unacknowledged shared data is re-sent (as a delta against the last acknowledged version) this often
+	constexpr float sharedDataResendInterval = 0.25f;
+}
+
 NetworkSession::NetworkSession(NetworkService& service)
 	: service(service)
 {
@@ -23,6 +35,7 @@ void NetworkSession::host(int port)
 
 	type = NetworkSessionType::Host;
 	sessionSharedData = makeSessionSharedData();
+	interest.addPeer(0);
 
 	onStartSession();
 	setMyPeerId(0);
@@ -33,7 +46,7 @@ void NetworkSession::join(const String& address, int port)
 {
 	Expects(type == NetworkSessionType::Undefined);
 
-	connections.emplace_back(service.connect(address, port));
+	connections.push_back(PeerConnection{ 0, service.connect(address, port) });
 	
 	type = NetworkSessionType::Client;
 
@@ -43,7 +56,7 @@ void NetworkSession::join(const String& address, int port)
 void NetworkSession::close()
 {
 	for (auto& c: connections) {
-		c->close();
+		c.connection->close();
 	}
 	connections.clear();
 
@@ -74,7 +87,7 @@ int NetworkSession::getClientCount() const
 	} else if (type == NetworkSessionType::Host) {
 		int i = 1;
 		for (auto& c: connections) {
-			if (c->getStatus() == ConnectionStatus::Connected) {
+			if (c.connection->getStatus() == ConnectionStatus::Connected) {
 				++i;
 			}
 		}
@@ -86,18 +99,39 @@ int NetworkSession::getClientCount() const
 
 void NetworkSession::acceptConnection(std::shared_ptr<IConnection> incoming)
 {
-	connections.emplace_back(std::move(incoming));
+	const int peerId = allocatePeerId();
+	if (peerId == -1) {
+		incoming->close();
+		return;
+	}
+	connections.push_back(PeerConnection{ peerId, std::move(incoming) });
 
 	ControlMsgSetPeerId msg;
-	msg.peerId = int8_t(connections.size());
+	msg.peerId = int8_t(peerId);
 	Bytes bytes = Serializer::toBytes(msg);
-	sharedData[msg.peerId] = makePeerSharedData();
+	auto& data = sharedData[msg.peerId];
+	data = makePeerSharedData();
+	if (outboundSharedData.find(peerId) != outboundSharedData.end()) {
+		// The id belonged to a peer that left, whose data everyone else still has; a new version replaces it
+		data->markModified();
+	}
+
+	auto& conn = connections.back();
+	conn.connection->send(doMakeControlPacket(NetworkSessionControlMessageType::SetPeerId, OutboundNetworkPacket(bytes)));
+	interest.addPeer(msg.peerId);
 
-	auto& conn = *connections.back();
-	conn.send(doMakeControlPacket(NetworkSessionControlMessageType::SetPeerId, OutboundNetworkPacket(bytes)));
-	conn.send(makeUpdateSharedDataPacket(-1));
-	for (auto& i: sharedData) {
-		conn.send(makeUpdateSharedDataPacket(i.first));
+	// Nothing acknowledged yet, so these go out in full. Relevance is symmetric, so the owners relevant to this peer are the peers it's relevant to.
+	std::vector<int> owners = { -1 };
+	interest.getPeersRelevantTo(msg.peerId, owners);
+	for (int ownerId: owners) {
+		if (ownerId != -1 && sharedData.find(ownerId) == sharedData.end()) {
+			continue;
+		}
+		auto& outbound = outboundSharedData[ownerId];
+		if (outbound.version == 0) {
+			snapshotSharedData(ownerId);
+		}
+		sendSharedData(ownerId, outbound, conn);
 	}
 	onConnected(msg.peerId);
 }
@@ -106,7 +140,14 @@ void NetworkSession::update()
 {
 	// Remove dead connections
 	service.update();
-	connections.erase(std::remove_if(connections.begin(), connections.end(), [] (const std::shared_ptr<IConnection>& c) { return c->getStatus() == ConnectionStatus::Closed; }), connections.end());
+	if (type == NetworkSessionType::Host) {
+		for (auto& c: connections) {
+			if (c.connection->getStatus() == ConnectionStatus::Closed) {
+				onPeerConnectionClosed(c.peerId);
+			}
+		}
+	}
+	connections.erase(std::remove_if(connections.begin(), connections.end(), [] (const PeerConnection& c) { return c.connection->getStatus() == ConnectionStatus::Closed; }), connections.end());
 
 	if (type == NetworkSessionType::Host) {
 		if (getClientCount() < maxClients) { // I'm also a client!
@@ -119,23 +160,22 @@ void NetworkSession::update()
 			service.setAcceptingConnections(false);
 		}
 
+		// The host relays everyone's data, as well as its own
 		checkForOutboundStateChanges(-1);
+		for (auto& i: sharedData) {
+			checkForOutboundStateChanges(i.first);
+		}
 	}
 
 	if (type == NetworkSessionType::Client) {
 		if (connections.empty()) {
 			close();
+		} else if (myPeerId != -1 && sharedData.find(myPeerId) != sharedData.end()) {
+			checkForOutboundStateChanges(myPeerId);
 		}
 	}
 
-	if (type == NetworkSessionType::Host || type == NetworkSessionType::Client) {
-		if (myPeerId != -1) {
-			auto iter = sharedData.find(myPeerId);
-			if (iter != sharedData.end()) {
-				checkForOutboundStateChanges(myPeerId);
-			}
-		}
-	}
+	resendUnackedSharedData();
 
 	// Update again to dispatch anything
 	processReceive();
@@ -218,10 +258,10 @@ ConnectionStatus NetworkSession::getStatus() const
 		if (connections.empty()) {
 			return ConnectionStatus::Closed;
 		} else {
-			if (connections[0]->getStatus() == ConnectionStatus::Connected) {
+			if (connections[0].connection->getStatus() == ConnectionStatus::Connected) {
 				return myPeerId != -1 && sessionSharedData ? ConnectionStatus::Connected : ConnectionStatus::Connecting;
 			} else {
-				return connections[0]->getStatus();
+				return connections[0].connection->getStatus();
 			}
 		}
 	} else if (type == NetworkSessionType::Host) {
@@ -240,9 +280,9 @@ OutboundNetworkPacket NetworkSession::makeOutbound(gsl::span<const gsl::byte> da
 
 void NetworkSession::sendToAll(OutboundNetworkPacket&& packet, int except)
 {
-	for (size_t i = 0; i < connections.size(); ++i) {
-		if (int(i) != except) {
-			connections[i]->send(OutboundNetworkPacket(packet));
+	for (auto& c: connections) {
+		if (c.peerId != except) {
+			c.connection->send(OutboundNetworkPacket(packet));
 		}
 	}
 }
@@ -255,7 +295,105 @@ void NetworkSession::send(OutboundNetworkPacket&& packet)
 
 	auto out = makeOutbound(packet.getBytes(), header);
 	for (auto& c: connections) {
-		c->send(OutboundNetworkPacket(out));
+		c.connection->send(OutboundNetworkPacket(out));
+	}
+}
+
+NetworkInterest& NetworkSession::getInterest()
+{
+	return interest;
+}
+
+void NetworkSession::sendToPeers(OutboundNetworkPacket&& packet, const std::vector<int>& peerIds)
+{
+	if (type != NetworkSessionType::Host) {
+		throw Exception("Only the host can send messages to specific peers.", HalleyExceptions::Network);
+	}
+
+	NetworkSessionMessageHeader header;
+	header.type = NetworkSessionMessageType::ToPeers;
+	header.srcPeerId = myPeerId;
+	routeToPeers(makeOutbound(packet.getBytes(), header), peerIds, myPeerId);
+}
+
+void NetworkSession::sendToInterested(OutboundNetworkPacket&& packet, Vector2i position)
+{
+	NetworkSessionInterestHeader interestHeader;
+	interestHeader.target = NetworkSessionInterestTarget::Position;
+	interestHeader.x = position.x;
+	interestHeader.y = position.y;
+	sendToInterested(std::move(packet), interestHeader);
+}
+
+void NetworkSession::sendToGroup(OutboundNetworkPacket&& packet, int group)
+{
+	NetworkSessionInterestHeader interestHeader;
+	interestHeader.target = NetworkSessionInterestTarget::Group;
+	interestHeader.x = group;
+	interestHeader.y = 0;
+	sendToInterested(std::move(packet), interestHeader);
+}
+
+void NetworkSession::sendToInterested(OutboundNetworkPacket&& packet, NetworkSessionInterestHeader interestHeader)
+{
+	if (type == NetworkSessionType::Host) {
+		peerIdsScratch.clear();
+		getPeersInterestedIn(interestHeader, peerIdsScratch);
+		sendToPeers(std::move(packet), peerIdsScratch);
+	} else if (type == NetworkSessionType::Client && !connections.empty()) {
+		// Only the host knows who's interested, so let it do the routing
+		NetworkSessionMessageHeader header;
+		header.type = NetworkSessionMessageType::ToInterested;
+		header.srcPeerId = myPeerId;
+
+		auto out = OutboundNetworkPacket(packet.getBytes());
+		out.addHeader(interestHeader);
+		out.addHeader(header);
+		connections[0].connection->send(std::move(out));
+	}
+}
+
+void NetworkSession::routeToPeers(const OutboundNetworkPacket& packet, const std::vector<int>& peerIds, int except)
+{
+	for (int peerId: peerIds) {
+		if (peerId != except) {
+			auto connection = getConnection(peerId);
+			if (connection) {
+				connection->send(OutboundNetworkPacket(packet));
+			}
+		}
+	}
+}
+
+void NetworkSession::getPeersInterestedIn(const NetworkSessionInterestHeader& interestHeader, std::vector<int>& result)
+{
+	switch (interestHeader.target) {
+	case NetworkSessionInterestTarget::Position:
+		interest.getPeersInterestedIn(Vector2i(interestHeader.x, interestHeader.y), result);
+		break;
+	case NetworkSessionInterestTarget::Group:
+		interest.getPeersInGroup(interestHeader.x, result);
+		break;
+	}
+}
+
+void NetworkSession::getConnectionsRelevantTo(int ownerId, std::vector<const PeerConnection*>& result)
+{
+	result.clear();
+	if (type != NetworkSessionType::Host || ownerId == -1) {
+		// Clients only talk to the host, and session data concerns everyone
+		for (auto& c: connections) {
+			result.push_back(&c);
+		}
+	} else {
+		peerIdsScratch.clear();
+		interest.getPeersRelevantTo(ownerId, peerIdsScratch);
+		for (int peerId: peerIdsScratch) {
+			auto connection = getPeerConnection(peerId);
+			if (connection) {
+				result.push_back(connection);
+			}
+		}
 	}
 }
 
@@ -273,10 +411,12 @@ void NetworkSession::processReceive()
 {
 	InboundNetworkPacket packet;
 	for (size_t i = 0; i < connections.size(); ++i) {
-		bool gotMessage = connections[i]->receive(packet);
-		if (gotMessage) {
+		auto& connection = *connections[i].connection;
+
+		// Take everything that arrived since the last update, otherwise anything sent more often than update() is called backs up
+		while (connection.getStatus() != ConnectionStatus::Closed && connection.receive(packet)) {
 			// Get header
-			int peerId = type == NetworkSessionType::Host ? int(i) + 1 : 0;
+			const int peerId = connections[i].peerId;
 			NetworkSessionMessageHeader header;
 			packet.extractHeader(header);
 
@@ -287,16 +427,32 @@ void NetworkSession::processReceive()
 					if (header.srcPeerId != peerId) {
 						closeConnection(peerId, "Player sent an invalid srcPlayer");
 					} else {
-						sendToAll(makeOutbound(packet.getBytes(), header), int(i));
+						sendToAll(makeOutbound(packet.getBytes(), header), peerId);
 						inbox.emplace_back(std::move(packet));
 					}
 				} else if (header.type == NetworkSessionMessageType::Control) {
 					// Receive control
-					receiveControlMessage(peerId, packet);
+					receiveControlMessage(peerId, connection, packet);
 				} else if (header.type == NetworkSessionMessageType::ToMaster) {
 					// For me only
 					// Consume!
 					inbox.emplace_back(std::move(packet));
+				} else if (header.type == NetworkSessionMessageType::ToInterested) {
+					// Route to whoever is interested, which might include me
+					NetworkSessionInterestHeader interestHeader;
+					if (header.srcPeerId != peerId || packet.getSize() < sizeof(interestHeader)) {
+						closeConnection(peerId, "Player sent an invalid interest message");
+					} else {
+						packet.extractHeader(interestHeader);
+						peerIdsScratch.clear();
+						getPeersInterestedIn(interestHeader, peerIdsScratch);
+
+						header.type = NetworkSessionMessageType::ToPeers;
+						routeToPeers(makeOutbound(packet.getBytes(), header), peerIdsScratch, peerId);
+						if (std::find(peerIdsScratch.begin(), peerIdsScratch.end(), myPeerId) != peerIdsScratch.end()) {
+							inbox.emplace_back(std::move(packet));
+						}
+					}
 				} else {
 					closeConnection(peerId, "Unknown session message type: " + toString(type));
 				}
@@ -307,7 +463,7 @@ void NetworkSession::processReceive()
 					// Consume!
 					inbox.emplace_back(std::move(packet));
 				} else if (header.type == NetworkSessionMessageType::Control) {
-					receiveControlMessage(peerId, packet);
+					receiveControlMessage(peerId, connection, packet);
 				} else {
 					closeConnection(peerId, "Invalid session message type for client: " + toString(type));
 				}
@@ -320,24 +476,58 @@ void NetworkSession::processReceive()
 	}
 }
 
-void NetworkSession::closeConnection(int peerId, const String& reason)
+const NetworkSession::PeerConnection* NetworkSession::getPeerConnection(int peerId) const
 {
-	int connId = type == NetworkSessionType::Host ? peerId - 1 : 0;
-	connections.at(connId)->close();
+	for (auto& c: connections) {
+		if (c.peerId == peerId) {
+			return &c;
+		}
+	}
+	return nullptr;
 }
 
-void NetworkSession::retransmitControlMessage(int peerId, gsl::span<const gsl::byte> bytes)
+IConnection* NetworkSession::getConnection(int peerId) const
 {
-	NetworkSessionMessageHeader header;
-	header.type = NetworkSessionMessageType::Control;
-	header.srcPeerId = peerId;
-	sendToAll(makeOutbound(bytes, header), peerId);
+	auto c = getPeerConnection(peerId);
+	return c ? c->connection.get() : nullptr;
+}
+
+int NetworkSession::allocatePeerId() const
+{
+	// Ids go out in an int8_t, and 0 is the host. Ids of live connections are never handed out again.
+	for (int id = 1; id <= 127; ++id) {
+		if (!getConnection(id)) {
+			return id;
+		}
+	}
+	return -1;
+}
+
+void NetworkSession::closeConnection(int peerId, const String& reason)
+{
+	auto connection = getConnection(peerId);
+	if (connection) {
+		connection->close();
+	}
 }
 
-void NetworkSession::receiveControlMessage(int peerId, InboundNetworkPacket& packet)
+void NetworkSession::onPeerConnectionClosed(int peerId)
 {
-	auto origData = packet.getBytes();
+	// The id can be given to the next peer that connects, which mustn't inherit anything from this one
+	interest.removePeer(peerId);
+	sharedData.erase(peerId);
+	inboundSharedData.erase(peerId);
+	for (auto& o: outboundSharedData) {
+		o.second.peers.erase(peerId);
+		if (o.second.source == peerId) {
+			o.second.source = -1;
+		}
+	}
+	onDisconnected(peerId);
+}
 
+void NetworkSession::receiveControlMessage(int peerId, IConnection& connection, InboundNetworkPacket& packet)
+{
 	ControlMsgHeader header;
 	packet.extractHeader(header);
 
@@ -351,14 +541,19 @@ void NetworkSession::receiveControlMessage(int peerId, InboundNetworkPacket& pac
 	case NetworkSessionControlMessageType::SetSessionState:
 		{
 			ControlMsgSetSessionState msg = Deserializer::fromBytes<ControlMsgSetSessionState>(packet.getBytes());
-			onControlMessage(peerId, msg);
+			onControlMessage(peerId, connection, msg);
 		}
 		break;
 	case NetworkSessionControlMessageType::SetPeerState:
 		{
 			ControlMsgSetPeerState msg = Deserializer::fromBytes<ControlMsgSetPeerState>(packet.getBytes());
-			onControlMessage(peerId, msg);
-			retransmitControlMessage(peerId, origData);
+			onControlMessage(peerId, connection, msg);
+		}
+		break;
+	case NetworkSessionControlMessageType::AckSharedData:
+		{
+			ControlMsgAckSharedData msg = Deserializer::fromBytes<ControlMsgAckSharedData>(packet.getBytes());
+			onControlMessage(peerId, connection, msg);
 		}
 		break;
 	default:
@@ -374,33 +569,56 @@ void NetworkSession::onControlMessage(int peerId, const ControlMsgSetPeerId& msg
 	setMyPeerId(msg.peerId);
 }
 
-void NetworkSession::onControlMessage(int peerId, const ControlMsgSetPeerState& msg)
+void NetworkSession::onControlMessage(int peerId, IConnection& connection, const ControlMsgSetPeerState& msg)
 {
 	if (peerId != 0 && peerId != msg.peerId) {
 		closeConnection(peerId, "Unauthorised control message: SetPeerState");
+		return;
 	}
-	auto iter = sharedData.find(msg.peerId);
 
-	auto s = Deserializer(msg.state);
-	if (iter != sharedData.end()) {
-		iter->second->deserialize(s);
-	} else {
-		sharedData[msg.peerId] = makePeerSharedData();
-		sharedData[msg.peerId]->deserialize(s);
+	auto state = receiveSharedData(msg.peerId, connection, msg.version, msg.baseline, msg.state);
+	if (state) {
+		auto& data = sharedData[msg.peerId];
+		if (!data) {
+			data = makePeerSharedData();
+		}
+		auto s = Deserializer(*state);
+		data->deserialize(s);
+
+		if (type == NetworkSessionType::Host) {
+			// Relay it to everyone else
+			outboundSharedData[msg.peerId].source = peerId;
+			data->markModified();
+		}
 	}
 }
 
-void NetworkSession::onControlMessage(int peerId, const ControlMsgSetSessionState& msg)
+void NetworkSession::onControlMessage(int peerId, IConnection& connection, const ControlMsgSetSessionState& msg)
 {
 	if (peerId != 0) {
 		closeConnection(peerId, "Unauthorised control message: SetSessionState");
+		return;
+	}
+
+	auto state = receiveSharedData(-1, connection, msg.version, msg.baseline, msg.state);
+	if (state) {
+		if (!sessionSharedData) {
+			sessionSharedData = makeSessionSharedData();
+		}
+		auto s = Deserializer(*state);
+		sessionSharedData->deserialize(s);
 	}
+}
 
-	if (!sessionSharedData) {
-		sessionSharedData = makeSessionSharedData();
+void NetworkSession::onControlMessage(int peerId, IConnection& connection, const ControlMsgAckSharedData& msg)
+{
+	auto iter = outboundSharedData.find(msg.ownerId);
+	if (iter != outboundSharedData.end()) {
+		auto& peer = iter->second.peers[peerId];
+		if (msg.version > peer.ackedVersion && msg.version <= iter->second.version) {
+			peer.ackedVersion = msg.version;
+		}
 	}
-	auto s = Deserializer(msg.state);
-	sessionSharedData->deserialize(s);
 }
 
 void NetworkSession::setMyPeerId(int id)
@@ -412,32 +630,143 @@ void NetworkSession::setMyPeerId(int id)
 	onPeerIdAssigned();
 }
 
+SharedData& NetworkSession::getSharedData(int ownerId)
+{
+	return ownerId == -1 ? *sessionSharedData : *sharedData.at(ownerId);
+}
+
 void NetworkSession::checkForOutboundStateChanges(int ownerId)
 {
-	SharedData& data = ownerId == -1 ? *sessionSharedData : *sharedData.at(ownerId);
+	SharedData& data = getSharedData(ownerId);
 	if (data.isModified()) {
-		sendToAll(makeUpdateSharedDataPacket(ownerId));
+		snapshotSharedData(ownerId);
 		data.markUnmodified();
+
+		auto& outbound = outboundSharedData[ownerId];
+		getConnectionsRelevantTo(ownerId, connectionsScratch);
+		for (auto c: connectionsScratch) {
+			if (c->peerId != outbound.source) {
+				sendSharedData(ownerId, outbound, *c);
+			}
+		}
 	}
 }
 
-OutboundNetworkPacket NetworkSession::makeUpdateSharedDataPacket(int ownerId)
+void NetworkSession::snapshotSharedData(int ownerId)
+{
+	auto& outbound = outboundSharedData[ownerId];
+	++outbound.version;
+	outbound.history[outbound.version] = Serializer::toBytes(getSharedData(ownerId));
+
+	// Versions older than this won't be used as baselines any more
+	while (!outbound.history.empty() && outbound.history.begin()->first + maxDeltaDistance < outbound.version) {
+		outbound.history.erase(outbound.history.begin());
+	}
+}
+
+void NetworkSession::sendSharedData(int ownerId, OutboundSharedData& outbound, const PeerConnection& connection)
+{
+	auto& peer = outbound.peers[connection.peerId];
+	const Bytes& current = outbound.history.at(outbound.version);
+
+	// Send the difference from what this peer last acknowledged, if we still have it and it's smaller
+	uint32_t baseline = 0;
+	Bytes state;
+	auto baselineIter = outbound.history.find(peer.ackedVersion);
+	if (peer.ackedVersion != 0 && baselineIter != outbound.history.end()) {
+		state = SharedDataDelta::encode(baselineIter->second, current);
+		baseline = peer.ackedVersion;
+	}
+	if (baseline == 0 || state.size() >= current.size()) {
+		baseline = 0;
+		state = current;
+	}
+
+	peer.lastSent = Clock::now();
+	connection.connection->send(makeUpdateSharedDataPacket(ownerId, outbound.version, baseline, std::move(state)));
+}
+
+void NetworkSession::resendUnackedSharedData()
+{
+	// Updates can be lost on unreliable connections; keep sending until they're acknowledged.
+	// This also catches peers up on data that only became relevant to them since it last changed.
+	const auto now = Clock::now();
+	for (auto& o: outboundSharedData) {
+		auto& outbound = o.second;
+		if (outbound.version == 0) {
+			continue;
+		}
+		getConnectionsRelevantTo(o.first, connectionsScratch);
+		for (auto c: connectionsScratch) {
+			if (c->peerId == outbound.source) {
+				continue;
+			}
+			auto& peer = outbound.peers[c->peerId];
+			if (peer.ackedVersion < outbound.version) {
+				const float elapsed = std::chrono::duration<float>(now - peer.lastSent).count();
+				if (elapsed >= sharedDataResendInterval) {
+					sendSharedData(o.first, outbound, *c);
+				}
+			}
+		}
+	}
+}
+
+OutboundNetworkPacket NetworkSession::makeUpdateSharedDataPacket(int ownerId, uint32_t version, uint32_t baseline, Bytes data)
 {
-	SharedData& data = ownerId == -1 ? *sessionSharedData : *sharedData.at(ownerId);
 	if (ownerId == -1) {
 		ControlMsgSetSessionState state;
-		state.state = Serializer::toBytes(data);
+		state.version = version;
+		state.baseline = baseline;
+		state.state = std::move(data);
 		Bytes bytes = Serializer::toBytes(state);
 		return doMakeControlPacket(NetworkSessionControlMessageType::SetSessionState, OutboundNetworkPacket(bytes));
 	} else {
 		ControlMsgSetPeerState state;
-		state.peerId = ownerId;
-		state.state = Serializer::toBytes(data);
+		state.peerId = int8_t(ownerId);
+		state.version = version;
+		state.baseline = baseline;
+		state.state = std::move(data);
 		Bytes bytes = Serializer::toBytes(state);
 		return doMakeControlPacket(NetworkSessionControlMessageType::SetPeerState, OutboundNetworkPacket(bytes));
 	}
 }
 
+const Bytes* NetworkSession::receiveSharedData(int ownerId, IConnection& connection, uint32_t version, uint32_t baseline, const Bytes& state)
+{
+	auto& inbound = inboundSharedData[ownerId];
+
+	if (inbound.history.find(version) == inbound.history.end()) {
+		if (baseline == 0) {
+			inbound.history[version] = state;
+		} else {
+			auto iter = inbound.history.find(baseline);
+			if (iter == inbound.history.end()) {
+				// Can't decode it, so don't acknowledge it. The sender will fall back to a full update eventually.
+				return nullptr;
+			}
+			inbound.history[version] = SharedDataDelta::apply(iter->second, state);
+		}
+
+		const uint32_t latest = std::max(version, inbound.version);
+		while (inbound.history.begin()->first + inboundHistoryLength < latest) {
+			inbound.history.erase(inbound.history.begin());
+		}
+	}
+
+	ControlMsgAckSharedData ack;
+	ack.ownerId = int8_t(ownerId);
+	ack.version = version;
+	connection.send(doMakeControlPacket(NetworkSessionControlMessageType::AckSharedData, OutboundNetworkPacket(Serializer::toBytes(ack))));
+
+	// Duplicates and updates that arrived out of order are acknowledged, but not applied
+	if (version <= inbound.version) {
+		return nullptr;
+	}
+	inbound.version = version;
+	return &inbound.history.at(version);
+}
+
 OutboundNetworkPacket NetworkSession::doMakeControlPacket(NetworkSessionControlMessageType msgType, OutboundNetworkPacket&& packet)
 {
 	ControlMsgHeader ctrlHeader;
@@ -13,22 +13,42 @@ void ControlMsgSetPeerId::deserialize(Deserializer& s)
 
 void ControlMsgSetSessionState::serialize(Serializer& s) const
 {
+	s << version;
+	s << baseline;
 	s << state;
 }
 
 void ControlMsgSetSessionState::deserialize(Deserializer& s)
 {
+	s >> version;
+	s >> baseline;
 	s >> state;
 }
 
 void ControlMsgSetPeerState::serialize(Serializer& s) const
 {
 	s << peerId;
+	s << version;
+	s << baseline;
 	s << state;
 }
 
 void ControlMsgSetPeerState::deserialize(Deserializer& s)
 {
 	s >> peerId;
+	s >> version;
+	s >> baseline;
 	s >> state;
 }
+
+void ControlMsgAckSharedData::serialize(Serializer& s) const
+{
+	s << ownerId;
+	s << version;
+}
+
+void ControlMsgAckSharedData::deserialize(Deserializer& s)
+{
+	s >> ownerId;
+	s >> version;
+}
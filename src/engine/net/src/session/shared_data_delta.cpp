@@ -0,0 +1,124 @@
+#include "session/shared_data_delta.h"
+#include <halley/support/exception.h>
+#include <cstring>
+
+using namespace Halley;
+
+// Format: varint(newSize), then any number of (varint(bytesToKeep), varint(bytesToReplace), replacement bytes...).
+// Anything after the last op up to newSize is kept from the baseline.
+
+namespace {
+	// Unchanged gaps shorter than this are cheaper to include in the replaced run than to start a new op
+	constexpr size_t minGap = 3;
+
+	void writeVarInt(Bytes& dst, size_t value)
+	{
+		do {
+			Byte b = Byte(value & 0x7F);
+			value >>= 7;
+			if (value != 0) {
+				b |= 0x80;
+			}
+			dst.push_back(b);
+		} while (value != 0);
+	}
+
+	size_t readVarInt(gsl::span<const Byte> src, size_t& pos)
+	{
+		constexpr int bits = int(sizeof(size_t) * 8);
+		size_t result = 0;
+		for (int shift = 0; shift < bits; shift += 7) {
+			if (pos >= size_t(src.size())) {
+				throw Exception("Truncated shared data delta.", HalleyExceptions::Network);
+			}
+			const Byte b = src[pos++];
+			const size_t value = size_t(b & 0x7F);
+			if ((value << shift) >> shift != value) {
+				// Doesn't fit in a size_t
+				throw Exception("Invalid shared data delta.", HalleyExceptions::Network);
+			}
+			result |= value << shift;
+			if ((b & 0x80) == 0) {
+				return result;
+			}
+		}
+		throw Exception("Invalid shared data delta.", HalleyExceptions::Network);
+	}
+}
+
+Bytes SharedDataDelta::encode(gsl::span<const Byte> baseline, gsl::span<const Byte> current)
+{
+	const size_t curSize = size_t(current.size());
+	const size_t baseSize = size_t(baseline.size());
+	const size_t common = std::min(curSize, baseSize);
+
+	Bytes result;
+	writeVarInt(result, curSize);
+
+	size_t lastEnd = 0;
+	size_t i = 0;
+	while (i < curSize) {
+		// Find the start of the next changed run; anything past the baseline counts as changed
+		while (i < common && current[i] == baseline[i]) {
+			++i;
+		}
+		if (i >= curSize) {
+			break;
+		}
+
+		// Extend it until there's a long enough unchanged gap
+		const size_t start = i;
+		size_t end = i + 1;
+		size_t gap = 0;
+		for (size_t j = end; j < curSize && gap < minGap; ++j) {
+			if (j < common && current[j] == baseline[j]) {
+				++gap;
+			} else {
+				gap = 0;
+				end = j + 1;
+			}
+		}
+
+		writeVarInt(result, start - lastEnd);
+		writeVarInt(result, end - start);
+		result.insert(result.end(), current.begin() + start, current.begin() + end);
+
+		lastEnd = end;
+		i = end;
+	}
+
+	return result;
+}
+
+Bytes SharedDataDelta::apply(gsl::span<const Byte> baseline, gsl::span<const Byte> delta)
+{
+	size_t pos = 0;
+	const size_t newSize = readVarInt(delta, pos);
+
+	// Anything past the baseline has to come from the delta itself, so this bounds the allocation by the packet size
+	if (newSize > size_t(baseline.size()) && newSize - size_t(baseline.size()) > size_t(delta.size()) - pos) {
+		throw Exception("Invalid shared data delta.", HalleyExceptions::Network);
+	}
+
+	Bytes result(newSize);
+	memcpy(result.data(), baseline.data(), std::min(newSize, size_t(baseline.size())));
+
+	size_t dstPos = 0;
+	while (pos < size_t(delta.size())) {
+		const size_t keep = readVarInt(delta, pos);
+		const size_t replace = readVarInt(delta, pos);
+		if (keep > newSize - dstPos || replace > newSize - dstPos - keep || replace > size_t(delta.size()) - pos) {
+			throw Exception("Invalid shared data delta.", HalleyExceptions::Network);
+		}
+		dstPos += keep;
+		memcpy(result.data() + dstPos, delta.data() + pos, replace);
+		dstPos += replace;
+		pos += replace;
+	}
+
+	if (newSize > size_t(baseline.size()) && dstPos < newSize) {
+		throw Exception("Shared data delta doesn't cover the whole state.", HalleyExceptions::Network);
+	}
+
+	return result;
+}
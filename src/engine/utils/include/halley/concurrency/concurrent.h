@@ -1,6 +1,12 @@
 #pragma once
 #include <array>
 #include <functional>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <exception>
+#include <algorithm>
 #include <halley/text/halleystring.h>
 #include "executor.h"
 #include "future.h"
@@ -52,28 +58,102 @@ namespace Halley
 			return future.getFuture();
 		}
 
+		// Waits until isDone() returns true, running other tasks from the queue in the meantime.
+		// This makes it safe to wait on work queued from inside a task running on that same queue.
+		template <typename P>
+		void waitHelpingUntil(ExecutionQueue& e, P isDone)
+		{
+			while (!isDone()) {
+				auto task = e.tryGetNext();
+				if (task) {
+					task();
+				} else {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		template <typename T>
+		void waitHelping(ExecutionQueue& e, Future<T> future)
+		{
+			waitHelpingUntil(e, [&] () { return future.isReady(); });
+		}
+
+		namespace Detail {
+			template <typename T, typename F>
+			struct ForeachState
+			{
+				ExecutionQueue& queue;
+				T begin;
+				F f;
+				size_t grain;
+				std::atomic<size_t> remaining;
+
+				// First exception thrown by f, rethrown on the calling thread once every range is accounted for
+				std::atomic<bool> failed;
+				std::mutex errorMutex;
+				std::exception_ptr error;
+
+				ForeachState(ExecutionQueue& queue, T begin, F f, size_t grain, size_t n)
+					: queue(queue)
+					, begin(begin)
+					, f(std::move(f))
+					, grain(grain)
+					, remaining(n)
+					, failed(false)
+				{}
+
+				void setError(std::exception_ptr e)
+				{
+					std::unique_lock<std::mutex> lock(errorMutex);
+					if (!error) {
+						error = e;
+					}
+					failed = true;
+				}
+			};
+
+			template <typename T, typename F>
+			void foreachRange(std::shared_ptr<ForeachState<T, F>> state, size_t from, size_t to)
+			{
+				// Keep splitting off the upper half until the range is small enough, so idle threads can pick those up
+				while (to - from > state->grain) {
+					const size_t mid = from + (to - from) / 2;
+					state->queue.addToQueue([state, mid, to] () { foreachRange(state, mid, to); });
+					to = mid;
+				}
+
+				// Once something failed, the remaining ranges are only counted, so the caller stops waiting as soon as possible
+				try {
+					for (auto i = state->begin + from; i < state->begin + to && !state->failed; ++i) {
+						state->f(*i);
+					}
+				} catch (...) {
+					state->setError(std::current_exception());
+				}
+				state->remaining -= to - from;
+			}
+		}
+
 		template <typename T, typename F>
 		void foreach(ExecutionQueue& e, T begin, T end, F f)
 		{
 			const size_t n = end - begin;
-			constexpr size_t maxThreads = 8;
-			size_t nThreads = std::max(size_t(1), std::min(maxThreads, e.threadCount()));
-			std::array<Future<void>, maxThreads> futures;
-
-			size_t prevEnd = 0;
-			for (size_t j = 0; j < nThreads; ++j) {
-				size_t curStart = prevEnd;
-				size_t curEnd = n * (j + 1) / nThreads;
-				prevEnd = curEnd;
-
-				futures[j] = execute([begin, f, curStart, curEnd]() {
-					for (auto i = begin + curStart; i < begin + curEnd; ++i) {
-						f(*i);
-					}
-				});
+			if (n == 0) {
+				return;
 			}
 
-			whenAll(futures.data(), futures.data() + nThreads).wait();
+			// Aim for a few chunks per thread, so that uneven work per element still balances out
+			constexpr size_t chunksPerThread = 4;
+			const size_t grain = std::max(size_t(1), n / (std::max(size_t(1), e.threadCount()) * chunksPerThread));
+
+			auto state = std::make_shared<Detail::ForeachState<T, F>>(e, begin, std::move(f), grain, n);
+			Detail::foreachRange(state, 0, n);
+			waitHelpingUntil(e, [&] () { return state->remaining.load() == 0; });
+
+			if (state->error) {
+				std::rethrow_exception(state->error);
+			}
 		}
 
 		template <typename T, typename F>
@@ -6,24 +6,38 @@
 #include <functional>
 #include <atomic>
 #include <vector>
+#include <memory>
 #include "halley/text/halleystring.h"
 
 namespace Halley
 {
 	using TaskBase = std::function<void()>;
 
+	class WorkStealingState;
+
 	class ExecutionQueue
 	{
 	public:
 		ExecutionQueue();
+		~ExecutionQueue();
+
+		// When enabled, each worker thread gets its own deque, and idle workers steal from the others.
+		// Tasks queued from a worker go to that worker's deque, so nested tasks don't contend on the queue mutex.
+		// Must be set before any worker threads are started.
+		void setWorkStealing(bool enabled);
+		bool isWorkStealing() const;
+
 		void addToQueue(TaskBase task);
 
 		TaskBase getNext();
+		TaskBase tryGetNext();
 		std::vector<TaskBase> getAll();
 
 		size_t threadCount() const;
 		void onAttached();
 		void onDetached();
+		void onWorkerThreadStarted();
+		void onWorkerThreadStopped();
 		void abort();
 
 		static ExecutionQueue& getDefault();
@@ -36,6 +50,10 @@ namespace Halley
 		std::atomic<int> attachedCount;
 		std::atomic<bool> hasTasks;
 		std::atomic<bool> aborted;
+
+		std::unique_ptr<WorkStealingState> workStealing;
+
+		TaskBase takeWorkStealing(bool block);
 	};
 
 	class Executors
@@ -22,6 +22,7 @@
 \*****************************************************************/
 
 #include <cstdint>
+#include <algorithm>
 
 namespace Halley {
 	template <typename T, size_t blockLen = 16384>
@@ -72,6 +73,7 @@ namespace Halley {
 
 			// Next block is what was stored on the nextFreeEntryIndex
 			std::swap(next, block.data[localIdx].nextFreeEntryIndex);
+			used = std::max(used, entryIdx + 1);
 
 			// External index composes the revision with the index, so it's unique, but easily mappable
 			int64_t externalIdx = static_cast<int64_t>(entryIdx) | (static_cast<int64_t>(rev & 0x7FFFFFFF) << 32); // TODO: compute properly
@@ -111,8 +113,44 @@ namespace Halley {
 			return reinterpret_cast<T*>(&(data.data));
 		}
 
+		// Writes the allocation state (free list and revisions), but not the values themselves.
+		// Restoring it makes the pool hand out exactly the same ids as it did after the state was saved.
+		template <typename S>
+		void serializeState(S& s) const
+		{
+			s << next << used;
+			for (uint32_t i = 0; i < used; ++i) {
+				auto& entry = blocks[i / blockLen].data[i % blockLen];
+				s << entry.nextFreeEntryIndex << entry.revision;
+			}
+		}
+
+		template <typename D>
+		void deserializeState(D& s)
+		{
+			uint32_t newUsed;
+			s >> next >> newUsed;
+
+			while (blocks.size() * blockLen < newUsed) {
+				blocks.push_back(Block(blocks.size()));
+			}
+			for (uint32_t i = 0; i < newUsed; ++i) {
+				auto& entry = blocks[i / blockLen].data[i % blockLen];
+				s >> entry.nextFreeEntryIndex >> entry.revision;
+			}
+
+			// Anything used since then goes back to its initial state
+			for (uint32_t i = newUsed; i < used; ++i) {
+				auto& entry = blocks[i / blockLen].data[i % blockLen];
+				entry.nextFreeEntryIndex = i + 1;
+				entry.revision = 0;
+			}
+			used = newUsed;
+		}
+
 	private:
 		Vector<Block> blocks;
 		uint32_t next = 0;
+		uint32_t used = 0;
 	};
 }
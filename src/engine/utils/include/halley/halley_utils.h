@@ -62,6 +62,7 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 #include "support/debug.h"
 #include "support/exception.h"
 #include "support/logger.h"
+#include "support/profiler.h"
 #include "support/redirect_stream.h"
 
 #include "text/encode.h"
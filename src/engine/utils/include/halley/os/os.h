@@ -50,11 +50,13 @@ namespace Halley {
 		virtual void onWindowCreated(void* windowHandle);
 
 		virtual ComputerData getComputerData();
+		virtual size_t getMemoryUsage(); // Resident bytes used by this process, or 0 if unknown
 		virtual String getUserDataDir();
 		virtual String getCurrentWorkingDir();
 		virtual String getEnvironmentVariable(const String& name);
 		virtual String makeDataPath(String appDataPath, String userProvidedPath);
 		virtual Path parseProgramPath(const String& commandLine);
+		virtual Path getExecutablePath(); // Binary of the running program, or empty if unknown
 		virtual void createDirectories(const Path& path);
 		virtual void atomicWriteFile(const Path& path, const Bytes& data, Maybe<Path> backupOldVersionPath = {});
 		virtual std::vector<Path> enumerateDirectory(const Path& path);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "halley/text/halleystring.h"
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+namespace Halley
+{
+	class ProfilerThreadBuffer;
+
+	struct ProfilerEvent
+	{
+		const char* name = nullptr; // Always a literal or an interned string, see Profiler::intern()
+		const char* detail = nullptr; // Optional, e.g. the asset being loaded
+		int64_t start = 0; // Nanoseconds, see Profiler::getTime()
+		int64_t end = 0;
+		int threadId = 0;
+		int depth = 0; // Number of zones this one is nested in, on the same thread
+	};
+
+	struct ProfilerThreadInfo
+	{
+		int id = 0;
+		String name;
+	};
+
+	struct ProfilerCapture
+	{
+		std::vector<ProfilerThreadInfo> threads;
+		std::vector<ProfilerEvent> events; // Sorted by start time
+		std::vector<int64_t> frames; // Start time of each frame, as marked by Profiler::markFrame()
+
+		// Chrome trace event format, loadable in chrome://tracing and Perfetto
+		String toChromeTrace() const;
+	};
+
+	// Records nested, timed zones (see HALLEY_PROFILE_SCOPE) on every thread, into per-thread ring buffers.
+	// Recording doesn't lock; only registering a new thread, interning names and capturing do.
+	// Disabled by default, in which case a zone costs a single relaxed atomic load.
+	class Profiler
+	{
+	public:
+		constexpr static size_t eventsPerThread = 16384; // Must be a power of two
+		constexpr static size_t maxFrames = 1024;
+
+		static void setEnabled(bool enabled);
+		static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+		// Names the calling thread in captures. Threads that don't set a name are numbered.
+		static void setThreadName(const String& name);
+
+		// Returns a copy of the string that lives forever, for zone names that aren't literals
+		static const char* intern(const String& name);
+
+		static int64_t getTime();
+		static void markFrame();
+
+		// Everything that finished after the given time, as long as it's still in the buffers
+		static ProfilerCapture capture(int64_t since = 0);
+		static ProfilerCapture captureFrames(size_t numFrames);
+
+	private:
+		static std::atomic<bool> enabled;
+	};
+
+	class ProfilerScope
+	{
+	public:
+		explicit ProfilerScope(const char* name, const char* detail = nullptr)
+		{
+			if (Profiler::isEnabled()) {
+				begin(name, detail);
+			}
+		}
+
+		~ProfilerScope()
+		{
+			if (buffer) {
+				end();
+			}
+		}
+
+		ProfilerScope(const ProfilerScope& other) = delete;
+		ProfilerScope& operator=(const ProfilerScope& other) = delete;
+
+	private:
+		ProfilerThreadBuffer* buffer = nullptr;
+		const char* name = nullptr;
+		const char* detail = nullptr;
+		int64_t start = 0;
+
+		void begin(const char* name, const char* detail);
+		void end();
+	};
+
+	#define HALLEY_PROFILE_CONCAT_IMPL(a, b) a##b
+	#define HALLEY_PROFILE_CONCAT(a, b) HALLEY_PROFILE_CONCAT_IMPL(a, b)
+	#define HALLEY_PROFILE_SCOPE(...) Halley::ProfilerScope HALLEY_PROFILE_CONCAT(halleyProfileScope, __LINE__)(__VA_ARGS__)
+}
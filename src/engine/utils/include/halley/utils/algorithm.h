@@ -1,5 +1,10 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <halley/data_structures/vector.h>
+
 namespace Halley
 {
 
@@ -64,5 +69,48 @@ namespace Halley
 		return *(begin + rng.getInt(decltype(size)(0), size - 1));
 	}
 
+	// Stable LSD radix sort by a 64-bit unsigned key, one byte per pass.
+	// Passes where every element shares the same byte are skipped, so keys with unused high bits are cheap.
+	// scratch is used as temporary storage, and is kept around by the caller to avoid reallocating it.
+	template <typename T, typename F>
+	void radixSort(Vector<T>& values, Vector<T>& scratch, F getKey)
+	{
+		constexpr size_t numPasses = 8;
+		constexpr size_t numBuckets = 256;
+
+		const size_t n = values.size();
+		if (n < 2) {
+			return;
+		}
+
+		std::array<std::array<size_t, numBuckets>, numPasses> counts;
+		std::memset(counts.data(), 0, sizeof(counts));
+		for (auto& v: values) {
+			const uint64_t key = getKey(v);
+			for (size_t pass = 0; pass < numPasses; ++pass) {
+				++counts[pass][(key >> (pass * 8)) & 0xFF];
+			}
+		}
+
+		scratch.resize(n);
+		for (size_t pass = 0; pass < numPasses; ++pass) {
+			auto& count = counts[pass];
+			const size_t shift = pass * 8;
+			if (count[(getKey(values[0]) >> shift) & 0xFF] == n) {
+				continue;
+			}
+
+			size_t offset = 0;
+			for (auto& c: count) {
+				const size_t cur = c;
+				c = offset;
+				offset += cur;
+			}
 
+			for (auto& v: values) {
+				scratch[count[(getKey(v) >> shift) & 0xFF]++] = std::move(v);
+			}
+			std::swap(values, scratch);
+		}
+	}
 }
@@ -3,19 +3,207 @@
 #include <halley/support/exception.h>
 #include "halley/text/string_converter.h"
 #include "halley/support/logger.h"
+#include "halley/support/profiler.h"
+#include <array>
+
+#include "work_stealing_deque.h"
 
 using namespace Halley;
 
+namespace Halley {
+	class WorkStealingState
+	{
+	public:
+		constexpr static size_t maxWorkers = 64;
+
+		struct Worker
+		{
+			WorkStealingDeque<TaskBase> deque;
+			std::atomic<bool> active;
+
+			Worker() : active(false) {}
+		};
+
+		std::array<Worker, maxWorkers> workers;
+		std::atomic<size_t> numWorkers;
+		std::deque<TaskBase*> injected; // Tasks queued from outside the pool, guarded by the queue mutex
+		std::atomic<size_t> numInjected;
+		std::atomic<int> pending;
+		std::atomic<int> sleeping;
+
+		WorkStealingState()
+			: numWorkers(0)
+			, numInjected(0)
+			, pending(0)
+			, sleeping(0)
+		{}
+	};
+}
+
+namespace {
+	struct CurrentWorker
+	{
+		ExecutionQueue* queue = nullptr;
+		size_t index = 0;
+	};
+
+	thread_local CurrentWorker currentWorker;
+}
+
 Executors* Executors::instance = nullptr;
 
 ExecutionQueue::ExecutionQueue()
-	: aborted(false)
+	: attachedCount(0)
+	, aborted(false)
 {
 	hasTasks.store(false);
 }
 
+ExecutionQueue::~ExecutionQueue()
+{
+	if (workStealing) {
+		for (auto& w: workStealing->workers) {
+			while (auto task = w.deque.steal()) {
+				delete task;
+			}
+		}
+		for (auto task: workStealing->injected) {
+			delete task;
+		}
+	}
+}
+
+void ExecutionQueue::setWorkStealing(bool enabled)
+{
+	if (enabled == isWorkStealing()) {
+		return;
+	}
+	if (attachedCount > 0) {
+		throw Exception("Can't change work stealing mode of an execution queue with attached executors", HalleyExceptions::Concurrency);
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	if (enabled) {
+		workStealing = std::make_unique<WorkStealingState>();
+		for (auto& task: queue) {
+			workStealing->injected.push_back(new TaskBase(std::move(task)));
+			++workStealing->numInjected;
+			++workStealing->pending;
+		}
+		queue.clear();
+	} else {
+		for (auto task: workStealing->injected) {
+			queue.emplace_back(std::move(*task));
+			delete task;
+		}
+		workStealing.reset();
+	}
+}
+
+bool ExecutionQueue::isWorkStealing() const
+{
+	return static_cast<bool>(workStealing);
+}
+
+void ExecutionQueue::onWorkerThreadStarted()
+{
+	if (!workStealing) {
+		return;
+	}
+
+	auto& ws = *workStealing;
+	for (size_t i = 0; i < WorkStealingState::maxWorkers; ++i) {
+		bool expected = false;
+		if (ws.workers[i].active.compare_exchange_strong(expected, true)) {
+			currentWorker.queue = this;
+			currentWorker.index = i;
+
+			size_t n = ws.numWorkers.load();
+			while (n < i + 1 && !ws.numWorkers.compare_exchange_weak(n, i + 1)) {}
+			return;
+		}
+	}
+	throw Exception("Too many worker threads attached to work stealing queue", HalleyExceptions::Concurrency);
+}
+
+void ExecutionQueue::onWorkerThreadStopped()
+{
+	if (workStealing && currentWorker.queue == this) {
+		// Anything left in the deque can still be stolen by the other workers
+		workStealing->workers[currentWorker.index].active = false;
+		currentWorker.queue = nullptr;
+	}
+}
+
+TaskBase ExecutionQueue::takeWorkStealing(bool block)
+{
+	auto& ws = *workStealing;
+	const bool isWorker = currentWorker.queue == this;
+
+	while (true) {
+		TaskBase* task = nullptr;
+
+		// Own tasks first, most recent first
+		if (isWorker) {
+			task = ws.workers[currentWorker.index].deque.pop();
+		}
+
+		// Then tasks queued from outside the pool
+		if (!task && ws.numInjected.load() > 0) {
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!ws.injected.empty()) {
+				task = ws.injected.front();
+				ws.injected.pop_front();
+				--ws.numInjected;
+			}
+		}
+
+		// Then steal from the other workers, starting after ourselves to spread the load
+		if (!task) {
+			const size_t n = ws.numWorkers.load();
+			const size_t start = isWorker ? currentWorker.index + 1 : 0;
+			for (size_t i = 0; i < n && !task; ++i) {
+				task = ws.workers[(start + i) % n].deque.steal();
+			}
+		}
+
+		if (task) {
+			--ws.pending;
+			TaskBase result = std::move(*task);
+			delete task;
+			return result;
+		}
+
+		if (aborted) {
+			return TaskBase([] () {});
+		}
+		if (!block) {
+			return TaskBase();
+		}
+
+		if (ws.pending.load() > 0) {
+			// Something is queued, but we lost the race for it (or it's still being pushed), so try again
+			std::this_thread::yield();
+			continue;
+		}
+
+		++ws.sleeping;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (ws.pending.load() <= 0 && !aborted) {
+				condition.wait(lock);
+			}
+		}
+		--ws.sleeping;
+	}
+}
+
 TaskBase ExecutionQueue::getNext()
 {
+	if (workStealing) {
+		return takeWorkStealing(true);
+	}
+
 	std::unique_lock<std::mutex> lock(mutex);
 	while (queue.empty()) {
 		if (!aborted) {
@@ -32,8 +220,32 @@ TaskBase ExecutionQueue::getNext()
 	return value;
 }
 
+TaskBase ExecutionQueue::tryGetNext()
+{
+	if (workStealing) {
+		return takeWorkStealing(false);
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	if (queue.empty()) {
+		return TaskBase();
+	}
+
+	TaskBase value = std::move(queue.front());
+	queue.pop_front();
+	return value;
+}
+
 std::vector<TaskBase> ExecutionQueue::getAll()
 {
+	if (workStealing) {
+		std::vector<TaskBase> tasks;
+		while (auto task = takeWorkStealing(false)) {
+			tasks.emplace_back(std::move(task));
+		}
+		return tasks;
+	}
+
 	std::unique_lock<std::mutex> lock(mutex);
 	hasTasks.store(false);
 	std::vector<TaskBase> tasks(queue.begin(), queue.end());
@@ -44,6 +256,25 @@ std::vector<TaskBase> ExecutionQueue::getAll()
 void ExecutionQueue::addToQueue(TaskBase task)
 {
 #if HAS_THREADS
+	if (workStealing) {
+		auto& ws = *workStealing;
+		auto t = new TaskBase(std::move(task));
+		if (currentWorker.queue == this) {
+			ws.workers[currentWorker.index].deque.push(t);
+		} else {
+			std::unique_lock<std::mutex> lock(mutex);
+			ws.injected.push_back(t);
+			++ws.numInjected;
+		}
+
+		++ws.pending;
+		if (ws.sleeping.load() > 0) {
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.notify_one();
+		}
+		return;
+	}
+
 	std::unique_lock<std::mutex> lock(mutex);
 	queue.emplace_back(task);
 	hasTasks.store(true);
@@ -120,6 +351,7 @@ bool Executor::runPending()
 #if HAS_THREADS
 	auto tasks = queue.getAll();
 	for (auto& t : tasks) {
+		HALLEY_PROFILE_SCOPE("Task");
 		t();
 	}
 #endif
@@ -129,10 +361,12 @@ bool Executor::runPending()
 void Executor::runForever()
 {
 #if HAS_THREADS
+	queue.onWorkerThreadStarted();
 	try {
 		while (running)	{
 			auto next = queue.getNext();
 			if (running) {
+				HALLEY_PROFILE_SCOPE("Task");
 				next();
 			}
 		}
@@ -142,6 +376,7 @@ void Executor::runForever()
 	} catch (...) {
 		Logger::logError("Executor aborting due to unknown exception.");
 	}
+	queue.onWorkerThreadStopped();
 #endif
 }
 
@@ -163,8 +398,10 @@ ThreadPool::ThreadPool(const String& name, ExecutionQueue& queue, size_t n, Make
 	threads.resize(n);
 
 	for (size_t i = 0; i < n; i++) {
-		threads[i] = makeThread(name + " Pool " + toString(i), [this, i]()
+		const String threadName = name + " Pool " + toString(i);
+		threads[i] = makeThread(threadName, [this, i, threadName]()
 		{
+			Profiler::setThreadName(threadName);
 			try {
 				executors[i]->runForever();
 			} catch (std::exception& e) {
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+namespace Halley
+{
+	// Chase-Lev work-stealing deque, as described in "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al., 2013).
+	// The owner thread pushes and pops from the bottom, any other thread can steal from the top.
+	template <typename T>
+	class WorkStealingDeque
+	{
+		class Buffer
+		{
+		public:
+			explicit Buffer(int64_t capacity)
+				: capacity(capacity)
+				, mask(capacity - 1)
+				, items(new std::atomic<T*>[size_t(capacity)])
+			{}
+
+			int64_t size() const { return capacity; }
+
+			T* get(int64_t i) const
+			{
+				return items[size_t(i & mask)].load(std::memory_order_relaxed);
+			}
+
+			void put(int64_t i, T* value)
+			{
+				items[size_t(i & mask)].store(value, std::memory_order_relaxed);
+			}
+
+			std::unique_ptr<Buffer> grow(int64_t bottom, int64_t top) const
+			{
+				auto result = std::make_unique<Buffer>(capacity * 2);
+				for (int64_t i = top; i < bottom; ++i) {
+					result->put(i, get(i));
+				}
+				return result;
+			}
+
+		private:
+			int64_t capacity;
+			int64_t mask;
+			std::unique_ptr<std::atomic<T*>[]> items;
+		};
+
+	public:
+		explicit WorkStealingDeque(int64_t capacity = 256)
+			: top(0)
+			, bottom(0)
+		{
+			buffers.push_back(std::make_unique<Buffer>(capacity));
+			buffer.store(buffers.back().get(), std::memory_order_relaxed);
+		}
+
+		WorkStealingDeque(const WorkStealingDeque& other) = delete;
+		WorkStealingDeque& operator=(const WorkStealingDeque& other) = delete;
+
+		// Owner thread only
+		void push(T* value)
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed);
+			const int64_t t = top.load(std::memory_order_acquire);
+			Buffer* a = buffer.load(std::memory_order_relaxed);
+			if (b - t > a->size() - 1) {
+				// Old buffers are kept alive, as thieves might still be reading from them
+				buffers.push_back(a->grow(b, t));
+				a = buffers.back().get();
+				buffer.store(a, std::memory_order_release);
+			}
+			a->put(b, value);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		// Owner thread only
+		T* pop()
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			Buffer* a = buffer.load(std::memory_order_relaxed);
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+
+			T* result = nullptr;
+			if (t <= b) {
+				result = a->get(b);
+				if (t == b) {
+					// Last element, race against thieves for it
+					if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+						result = nullptr;
+					}
+					bottom.store(b + 1, std::memory_order_relaxed);
+				}
+			} else {
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return result;
+		}
+
+		// Any thread
+		T* steal()
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t b = bottom.load(std::memory_order_acquire);
+
+			if (t < b) {
+				Buffer* a = buffer.load(std::memory_order_acquire);
+				T* result = a->get(t);
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					return nullptr;
+				}
+				return result;
+			}
+			return nullptr;
+		}
+
+		bool empty() const
+		{
+			return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<int64_t> top;
+		std::atomic<int64_t> bottom;
+		std::atomic<Buffer*> buffer;
+		std::vector<std::unique_ptr<Buffer>> buffers;
+	};
+}
@@ -81,6 +81,11 @@ Halley::ComputerData Halley::OS::getComputerData()
 	return ComputerData();
 }
 
+size_t OS::getMemoryUsage()
+{
+	return 0;
+}
+
 String OS::getUserDataDir()
 {
 	return "";
@@ -106,6 +111,11 @@ Path OS::parseProgramPath(const String& commandLine)
 	return Path(commandLine).parentPath() / ".";
 }
 
+Path OS::getExecutablePath()
+{
+	return Path();
+}
+
 void OS::createDirectories(const Path& path)
 {
 }
@@ -82,16 +82,39 @@ ComputerData OSLinux::getComputerData()
 	return data;
 }
 
+size_t OSLinux::getMemoryUsage()
+{
+	// Second field is the resident set size, in pages
+	size_t pages = 0;
+	FILE* fp = fopen("/proc/self/statm", "r");
+	if (fp) {
+		if (fscanf(fp, "%*s %zu", &pages) != 1) {
+			pages = 0;
+		}
+		fclose(fp);
+	}
+	return pages * size_t(sysconf(_SC_PAGESIZE));
+}
+
 Path OSLinux::parseProgramPath(const String& path)
+{
+	auto exe = getExecutablePath();
+	if (!exe.getString().isEmpty()) {
+		return exe.parentPath() / ".";
+	} else {
+		return OSUnix::parseProgramPath(path);
+	}
+}
+
+Path OSLinux::getExecutablePath()
 {
 	constexpr size_t len = 1024;
 	char buffer[len];
 	memset(buffer, 0, len);
-	if (readlink("/proc/self/exe", buffer, len) > 0) {
-		return Path(String(buffer)).parentPath() / ".";
-	} else {
-		return OSUnix::parseProgramPath(path);
+	if (readlink("/proc/self/exe", buffer, len - 1) > 0) {
+		return Path(String(buffer));
 	}
+	return Path();
 }
 
 String OSLinux::getUserDataDir()
@@ -31,7 +31,9 @@ namespace Halley {
 	public:
 		String getUserDataDir() override;
 		ComputerData getComputerData() override;
+		size_t getMemoryUsage() override;
 		Path parseProgramPath(const String&) override;
+		Path getExecutablePath() override;
 
 		void openURL(const String& url) override;
 	};
@@ -47,10 +47,7 @@ String OSMac::getUserDataDir()
 Path OSMac::parseProgramPath(const String&)
 {
 	// Ignore parameter and use our own path
-	char buffer[2048];
-	uint32_t bufSize = 2048;
-	_NSGetExecutablePath(buffer, &bufSize);
-	Path programPath = Path(String(buffer)).parentPath() / ".";
+	Path programPath = getExecutablePath().parentPath() / ".";
 
 	std::cout << "Setting CWD to " << programPath << std::endl;
 	chdir(programPath.string().c_str());
@@ -58,6 +55,14 @@ Path OSMac::parseProgramPath(const String&)
 	return programPath;
 }
 
+Path OSMac::getExecutablePath()
+{
+	char buffer[2048];
+	uint32_t bufSize = 2048;
+	_NSGetExecutablePath(buffer, &bufSize);
+	return Path(String(buffer));
+}
+
 void OSMac::openURL(const String& url)
 {
 	if (url.startsWith("http://") || url.startsWith("https://")) {
@@ -41,8 +41,10 @@
 #include <fstream>
 #include <Windows.h>
 #include <shellapi.h>
+#include <psapi.h>
 
 #pragma comment(lib, "wbemuuid.lib")
+#pragma comment(lib, "psapi.lib")
 //#pragma comment(lib, "comsupp.lib")
 #pragma comment(lib, "comsuppw.lib")
 
@@ -254,6 +256,15 @@ Halley::ComputerData Halley::OSWin32::getComputerData()
 	return data;
 }
 
+size_t OSWin32::getMemoryUsage()
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return size_t(counters.WorkingSetSize);
+	}
+	return 0;
+}
+
 Halley::String Halley::OSWin32::getUserDataDir()
 {
 	PWSTR path;
@@ -286,12 +297,16 @@ String OSWin32::getEnvironmentVariable(const String& name)
 }
 
 Path OSWin32::parseProgramPath(const String&)
+{
+	return getExecutablePath().parentPath() / ".";
+}
+
+Path OSWin32::getExecutablePath()
 {
 	HMODULE hModule = GetModuleHandleW(nullptr);
 	WCHAR path[MAX_PATH];
 	GetModuleFileNameW(hModule, path, MAX_PATH);
-	String programPath(path);
-	return Path(programPath).parentPath() / ".";
+	return Path(String(path));
 }
 
 void Halley::OSWin32::setConsoleColor(int foreground, int background)
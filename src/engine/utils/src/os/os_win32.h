@@ -38,10 +38,12 @@ namespace Halley {
 		void initializeConsole() override;
 
 		ComputerData getComputerData() override;
+		size_t getMemoryUsage() override;
 		String getUserDataDir() override;
 		String getCurrentWorkingDir() override;
 		String getEnvironmentVariable(const String& name) override;
 		Path parseProgramPath(const String&) override;
+		Path getExecutablePath() override;
 		void setConsoleColor(int foreground, int background) override;
 		void createDirectories(const Path& path) override;
 		void atomicWriteFile(const Path& path, const Bytes& data, Maybe<Path> backupOldVersionPath) override;
@@ -2,6 +2,7 @@
 
 #include <halley/support/console.h>
 #include <halley/support/debug.h>
+#include <halley/support/profiler.h>
 #include <halley/runner/main_loop.h>
 #include <halley/runner/game_loader.h>
 
@@ -44,6 +45,7 @@ void MainLoop::runLoop()
 
 	if (fps <= 0) {
 		while (isRunning()) {
+			Profiler::markFrame();
 			target.transitionStage();
 			constexpr Time fixedDelta = 1.0 / 60.0;
 			target.onFixedUpdate(fixedDelta);
@@ -51,6 +53,7 @@ void MainLoop::runLoop()
 		}
 	} else {
 		while (isRunning()) {
+			Profiler::markFrame();
 			if (target.transitionStage()) {
 				// Reset counters
 				startTime = targetTime = lastTime = Clock::now();
@@ -0,0 +1,361 @@
+#include "halley/support/profiler.h"
+#include "halley/text/string_converter.h"
+#include <gsl/gsl_assert>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+using namespace Halley;
+
+constexpr size_t Profiler::eventsPerThread;
+constexpr size_t Profiler::maxFrames;
+
+std::atomic<bool> Profiler::enabled(false);
+
+namespace Halley {
+	class ProfilerThreadBuffer
+	{
+	public:
+		struct Entry
+		{
+			const char* name;
+			const char* detail;
+			int64_t start;
+			int64_t end;
+			int depth;
+		};
+
+		// Guarded by the registry mutex
+		int id = 0;
+		String name;
+		bool active = true;
+
+		// Only touched by the owning thread
+		int depth = 0;
+
+		std::vector<Entry> entries;
+		std::atomic<uint64_t> written;
+
+		ProfilerThreadBuffer(int id, String name)
+			: id(id)
+			, name(std::move(name))
+			, entries(Profiler::eventsPerThread)
+			, written(0)
+		{}
+
+		void record(const char* eventName, const char* detail, int64_t start, int64_t end)
+		{
+			const uint64_t n = written.load(std::memory_order_relaxed);
+			entries[n & (Profiler::eventsPerThread - 1)] = Entry{ eventName, detail, start, end, depth };
+			written.store(n + 1, std::memory_order_release);
+		}
+
+		void collect(int64_t since, std::vector<ProfilerEvent>& result) const
+		{
+			const uint64_t n = written.load(std::memory_order_acquire);
+			const uint64_t first = n > Profiler::eventsPerThread ? n - Profiler::eventsPerThread : 0;
+			const size_t prevSize = result.size();
+			std::vector<uint64_t> indices;
+
+			for (uint64_t i = first; i < n; ++i) {
+				const auto& e = entries[i & (Profiler::eventsPerThread - 1)];
+				if (e.end > since) {
+					ProfilerEvent event;
+					event.name = e.name;
+					event.detail = e.detail;
+					event.start = e.start;
+					event.end = e.end;
+					event.threadId = id;
+					event.depth = e.depth;
+					result.push_back(event);
+					indices.push_back(i);
+				}
+			}
+
+			// The owner kept writing while we read, so the oldest entries might have been overwritten under us; drop them.
+			// That includes the slot of event nAfter, which is filled in before the counter is published.
+			const uint64_t nAfter = written.load(std::memory_order_acquire);
+			const uint64_t validFrom = nAfter + 1 > Profiler::eventsPerThread ? nAfter + 1 - Profiler::eventsPerThread : 0;
+			if (validFrom > first) {
+				const size_t nInvalid = size_t(std::lower_bound(indices.begin(), indices.end(), validFrom) - indices.begin());
+				result.erase(result.begin() + prevSize, result.begin() + prevSize + nInvalid);
+			}
+		}
+	};
+}
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	class ProfilerRegistry
+	{
+	public:
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ProfilerThreadBuffer>> buffers;
+		std::unordered_set<std::string> interned;
+		std::deque<int64_t> frames;
+		Clock::time_point origin = Clock::now();
+
+		ProfilerThreadBuffer* acquire(const String& name)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			// Reuse the buffer of a thread that's gone, if there's one
+			for (auto& b: buffers) {
+				if (!b->active) {
+					b->active = true;
+					b->name = name.isEmpty() ? "Thread " + toString(b->id) : name;
+					b->depth = 0;
+					b->written.store(0, std::memory_order_relaxed);
+					return b.get();
+				}
+			}
+
+			const int id = int(buffers.size()) + 1;
+			buffers.push_back(std::make_unique<ProfilerThreadBuffer>(id, name.isEmpty() ? "Thread " + toString(id) : name));
+			return buffers.back().get();
+		}
+
+		void release(ProfilerThreadBuffer* buffer)
+		{
+			// Its events are kept around until another thread needs a buffer
+			std::unique_lock<std::mutex> lock(mutex);
+			buffer->active = false;
+		}
+
+		void rename(ProfilerThreadBuffer* buffer, const String& name)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			buffer->name = name;
+		}
+	};
+
+	ProfilerRegistry& getRegistry()
+	{
+		// Never destroyed, as threads might still be exiting during static destruction
+		static auto registry = new ProfilerRegistry();
+		return *registry;
+	}
+
+	struct CurrentThread
+	{
+		ProfilerThreadBuffer* buffer = nullptr;
+		String name;
+
+		~CurrentThread()
+		{
+			if (buffer) {
+				getRegistry().release(buffer);
+			}
+		}
+
+		ProfilerThreadBuffer& getBuffer()
+		{
+			// Created on first use, so threads that never record anything don't pay for a buffer
+			if (!buffer) {
+				buffer = getRegistry().acquire(name);
+			}
+			return *buffer;
+		}
+	};
+
+	thread_local CurrentThread currentThread;
+
+	void appendEscaped(std::string& dst, const char* str)
+	{
+		for (const char* c = str; *c; ++c) {
+			switch (*c) {
+			case '"':
+				dst += "\\\"";
+				break;
+			case '\\':
+				dst += "\\\\";
+				break;
+			case '\n':
+				dst += "\\n";
+				break;
+			case '\t':
+				dst += "\\t";
+				break;
+			default:
+				if (static_cast<unsigned char>(*c) < 0x20) {
+					char buffer[8];
+					snprintf(buffer, sizeof(buffer), "\\u%04x", int(*c));
+					dst += buffer;
+				} else {
+					dst += *c;
+				}
+			}
+		}
+	}
+
+	void appendTime(std::string& dst, int64_t ns)
+	{
+		// Microseconds, as the format expects
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.3f", double(ns) / 1000.0);
+		dst += buffer;
+	}
+
+	void appendThreadName(std::string& dst, int id, const char* name)
+	{
+		dst += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+		dst += std::to_string(id);
+		dst += ",\"args\":{\"name\":\"";
+		appendEscaped(dst, name);
+		dst += "\"}},\n";
+	}
+
+	void appendZone(std::string& dst, int tid, const char* name, const char* detail, int64_t start, int64_t end)
+	{
+		dst += "{\"name\":\"";
+		appendEscaped(dst, name);
+		dst += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+		dst += std::to_string(tid);
+		dst += ",\"ts\":";
+		appendTime(dst, start);
+		dst += ",\"dur\":";
+		appendTime(dst, end - start);
+		if (detail) {
+			dst += ",\"args\":{\"detail\":\"";
+			appendEscaped(dst, detail);
+			dst += "\"}";
+		}
+		dst += "},\n";
+	}
+}
+
+void Profiler::setEnabled(bool e)
+{
+	enabled.store(e, std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName(const String& name)
+{
+	currentThread.name = name;
+	if (currentThread.buffer) {
+		getRegistry().rename(currentThread.buffer, name);
+	}
+}
+
+const char* Profiler::intern(const String& name)
+{
+	auto& registry = getRegistry();
+	std::unique_lock<std::mutex> lock(registry.mutex);
+	return registry.interned.insert(name.cppStr()).first->c_str();
+}
+
+int64_t Profiler::getTime()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - getRegistry().origin).count();
+}
+
+void Profiler::markFrame()
+{
+	if (!isEnabled()) {
+		return;
+	}
+
+	const int64_t time = getTime();
+	auto& registry = getRegistry();
+	std::unique_lock<std::mutex> lock(registry.mutex);
+	registry.frames.push_back(time);
+	if (registry.frames.size() > maxFrames) {
+		registry.frames.pop_front();
+	}
+}
+
+ProfilerCapture Profiler::capture(int64_t since)
+{
+	ProfilerCapture result;
+	auto& registry = getRegistry();
+	{
+		std::unique_lock<std::mutex> lock(registry.mutex);
+		for (auto& b: registry.buffers) {
+			ProfilerThreadInfo info;
+			info.id = b->id;
+			info.name = b->name;
+			result.threads.push_back(std::move(info));
+			b->collect(since, result.events);
+		}
+		for (auto f: registry.frames) {
+			if (f >= since) {
+				result.frames.push_back(f);
+			}
+		}
+	}
+
+	// Parents before children when they start at the same time
+	std::sort(result.events.begin(), result.events.end(), [] (const ProfilerEvent& a, const ProfilerEvent& b)
+	{
+		return a.start != b.start ? a.start < b.start : a.depth < b.depth;
+	});
+	return result;
+}
+
+ProfilerCapture Profiler::captureFrames(size_t numFrames)
+{
+	int64_t since = 0;
+	{
+		auto& registry = getRegistry();
+		std::unique_lock<std::mutex> lock(registry.mutex);
+		if (numFrames > 0 && numFrames <= registry.frames.size()) {
+			since = registry.frames[registry.frames.size() - numFrames];
+		}
+	}
+	return capture(since);
+}
+
+String ProfilerCapture::toChromeTrace() const
+{
+	std::string result;
+	result.reserve(128 * (events.size() + frames.size() + threads.size()) + 64);
+	result += "{\"traceEvents\":[\n";
+
+	// Frames go on their own track, above everything else
+	appendThreadName(result, 0, "Frames");
+	for (size_t i = 0; i < frames.size(); ++i) {
+		int64_t end = i + 1 < frames.size() ? frames[i + 1] : frames[i];
+		if (i + 1 == frames.size()) {
+			for (auto& e: events) {
+				end = std::max(end, e.end);
+			}
+		}
+		appendZone(result, 0, "Frame", nullptr, frames[i], end);
+	}
+
+	for (auto& t: threads) {
+		appendThreadName(result, t.id, t.name.c_str());
+	}
+	for (auto& e: events) {
+		appendZone(result, e.threadId, e.name, e.detail, e.start, e.end);
+	}
+
+	// Get rid of the trailing comma
+	if (result.size() >= 2 && result[result.size() - 2] == ',') {
+		result.erase(result.size() - 2, 1);
+	}
+	result += "],\n\"displayTimeUnit\":\"ms\"}\n";
+	return String(result);
+}
+
+void ProfilerScope::begin(const char* n, const char* d)
+{
+	buffer = &currentThread.getBuffer();
+	name = n;
+	detail = d;
+	++buffer->depth;
+	start = Profiler::getTime();
+}
+
+void ProfilerScope::end()
+{
+	const int64_t endTime = Profiler::getTime();
+	--buffer->depth;
+	buffer->record(name, detail, start, endTime);
+}
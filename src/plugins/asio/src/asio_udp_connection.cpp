@@ -80,22 +80,22 @@ bool AsioUDPConnection::matchesEndpoint(const UDPEndpoint& remoteEndpoint) const
 	return remote == remoteEndpoint;
 }
 
-void AsioUDPConnection::onReceive(gsl::span<const gsl::byte> data)
+void AsioUDPConnection::onReceive(NetworkBuffer data)
 {
 	Expects(data.size() <= 1500);
 
 	if (status == ConnectionStatus::Connecting) {
-		if (data.size_bytes() == sizeof(HandshakeAccept)) {
+		if (data.size() == sizeof(HandshakeAccept)) {
 			HandshakeAccept accept;
 			if (memcmp(data.data(), &accept, sizeof(accept.handshake)) == 0) {
 				// Yep, accept handshake
-				memcpy(&accept, data.data(), data.size_bytes());
+				memcpy(&accept, data.data(), data.size());
 				onOpen(accept.id);
 			}
 		}
 	} else if (status == ConnectionStatus::Connected) {
 		if (data.size() <= 1500) {
-			pendingReceive.push_back(InboundNetworkPacket(data));
+			pendingReceive.push_back(InboundNetworkPacket(std::move(data)));
 		}
 	}
 }
@@ -130,12 +130,12 @@ void AsioUDPConnection::sendNext()
 		return;
 	}
 
-	auto& packet = pendingSend.front();
-	size_t size = packet.copyTo(sendBuffer);
-	pendingSend.pop_front();
+	// Send straight from the packet's buffer, which stays at the front of the queue until it's done
+	auto bytes = pendingSend.front().getBytes();
 
-	socket.async_send_to(boost::asio::buffer(sendBuffer, size), remote, [this] (const boost::system::error_code& error, std::size_t)
+	socket.async_send_to(boost::asio::buffer(bytes.data(), bytes.size()), remote, [this] (const boost::system::error_code& error, std::size_t)
 	{
+		pendingSend.pop_front();
 		if (error) {
 			std::cout << "Error sending packet: " << error.message() << std::endl;
 			close();
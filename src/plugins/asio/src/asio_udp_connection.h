@@ -32,7 +32,7 @@ namespace Halley
 		bool receive(InboundNetworkPacket& packet) override;
 		
 		bool matchesEndpoint(const UDPEndpoint& remoteEndpoint) const;
-		void onReceive(gsl::span<const gsl::byte> data);
+		void onReceive(NetworkBuffer data);
 		void setError(const std::string& cs);
 		
 		void open(short connectionId);
@@ -46,9 +46,8 @@ namespace Halley
 		ConnectionStatus status;
 		short connectionId;
 
-		std::deque<OutboundNetworkPacket> pendingSend;
+		std::deque<OutboundNetworkPacket> pendingSend; // The front one is being sent
 		std::deque<InboundNetworkPacket> pendingReceive;
-		std::array<gsl::byte, 2048> sendBuffer;
 		std::string error;
 
 		void sendNext();
@@ -125,7 +125,12 @@ void AsioUDPNetworkService::startListening()
 
 void AsioUDPNetworkService::receiveNext()
 {
-	auto buffer = asio::buffer(receiveBuffer);
+	// Packets are handed over as slices of this buffer, so only reuse it if they've all been released
+	if (!receiveBuffer.isUnique()) {
+		receiveBuffer = NetworkBuffer::allocate(NetworkBuffer::pooledBlockSize);
+	}
+
+	auto buffer = asio::buffer(receiveBuffer.data(), receiveBuffer.size());
 	socket.async_receive_from(buffer, remoteEndpoint, [this] (const boost::system::error_code& error, size_t size)
 	{
 		try {
@@ -138,7 +143,7 @@ void AsioUDPNetworkService::receiveNext()
 				errorMsgPtr = &errorMsg;
 			}
 
-			receivePacket(gsl::span<gsl::byte>(receiveBuffer.data(), size), errorMsgPtr);
+			receivePacket(receiveBuffer.slice(0, size), errorMsgPtr);
 		} catch (...) {
 			std::cout << "Exception while receiving a packet." << std::endl;
 		}
@@ -147,7 +152,7 @@ void AsioUDPNetworkService::receiveNext()
 	});
 }
 
-void AsioUDPNetworkService::receivePacket(gsl::span<gsl::byte> received, std::string* error)
+void AsioUDPNetworkService::receivePacket(NetworkBuffer received, std::string* error)
 {
 	if (error) {
 		std::cout << "Error receiving packet: " << (*error) << std::endl;
@@ -161,7 +166,7 @@ void AsioUDPNetworkService::receivePacket(gsl::span<gsl::byte> received, std::st
 		return;
 	}
 
-	if (received.size_bytes() == 0) {
+	if (received.empty()) {
 		return;
 	}
 
@@ -169,23 +174,23 @@ void AsioUDPNetworkService::receivePacket(gsl::span<gsl::byte> received, std::st
 	short id = -1;
 	std::array<unsigned char, 2> bytes;
 	auto dst = gsl::as_writeable_bytes(gsl::span<unsigned char, 2>(bytes));
-	dst[0] = received[0];
+	dst[0] = received.data()[0];
 	if (bytes[0] & 0x80) {
-		if (received.size_bytes() < 2) {
+		if (received.size() < 2) {
 			// Invalid header
 			std::cout << "Invalid header\n";
 			return;
 		}
-		dst[1] = received[1];
-		received = received.subspan(2);
+		dst[1] = received.data()[1];
+		received.shrinkFront(2);
 		id = short(bytes[0] & 0x7F) | short(bytes[1]);
 	} else {
-		received = received.subspan(1);
+		received.shrinkFront(1);
 		id = short(bytes[0]);
 	}
 
 	// No connection id, check if it's a connection request
-	if (id == 0 && isValidConnectionRequest(received)) {
+	if (id == 0 && isValidConnectionRequest(received.getSpan())) {
 		auto& pending = pendingIncomingConnections;
 		if (std::find(pending.begin(), pending.end(), remoteEndpoint) == pending.end()) {
 			pending.push_back(remoteEndpoint);
@@ -215,7 +220,7 @@ void AsioUDPNetworkService::receivePacket(gsl::span<gsl::byte> received, std::st
 			connection->close();
 		} else {
 			try {
-				connection->onReceive(received);
+				connection->onReceive(std::move(received));
 
 				if (conn->first == 0) {
 					// Hold on, we're still on 0, re-bind to the id
@@ -37,11 +37,11 @@ namespace Halley
 		std::list<UDPEndpoint> pendingIncomingConnections;
 		std::unordered_map<short, std::shared_ptr<AsioUDPConnection>> activeConnections;
 
-		std::array<gsl::byte, 2048> receiveBuffer;
+		NetworkBuffer receiveBuffer;
 
 		void startListening();
 		void receiveNext();
-		void receivePacket(gsl::span<gsl::byte> data, std::string* error);
+		void receivePacket(NetworkBuffer data, std::string* error);
 		bool isValidConnectionRequest(gsl::span<const gsl::byte> data);
 		short getFreeId() const;
 	};
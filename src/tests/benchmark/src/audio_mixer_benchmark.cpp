@@ -0,0 +1,179 @@
+#include "benchmarks.h"
+#include <halley/audio/audio_offline_renderer.h>
+#include <halley/audio/audio_clip.h>
+#include <halley/concurrency/executor.h>
+#include <halley/time/stopwatch.h>
+#include <halley/maths/random.h>
+#include "audio_mixer.h"
+#include "audio_mixer_sse.h"
+#include "audio_mixer_avx.h"
+#include <cmath>
+#include <iostream>
+
+using namespace Halley;
+
+namespace {
+	constexpr size_t samplesPerBuffer = 512;
+	constexpr size_t packsPerBuffer = samplesPerBuffer / AudioSamplePack::NumSamples;
+
+	struct MixerVariant
+	{
+		const char* name;
+		std::function<std::unique_ptr<AudioMixer>()> make;
+	};
+
+	Vector<MixerVariant> getVariants()
+	{
+		Vector<MixerVariant> result;
+		result.push_back({ "scalar", [] () { return std::make_unique<AudioMixer>(); } });
+#ifdef HAS_SSE
+		result.push_back({ "sse   ", [] () { return std::make_unique<AudioMixerSSE>(); } });
+#endif
+#ifdef HAS_AVX
+		if (AudioMixer::hasAVX()) {
+			result.push_back({ "avx   ", [] () { return std::make_unique<AudioMixerAVX>(); } });
+		} else {
+			std::cout << "(AVX not supported on this CPU, skipping)" << std::endl;
+		}
+#endif
+		return result;
+	}
+
+	// Synthetic mono clip, so the benchmark doesn't depend on any assets
+	class SineClip final : public IAudioClip
+	{
+	public:
+		SineClip(float frequency, size_t length)
+			: samples(length)
+		{
+			for (size_t i = 0; i < length; ++i) {
+				samples[i] = 0.25f * std::sin(6.2831853f * frequency * float(i) / AudioConfig::sampleRate);
+			}
+		}
+
+		size_t copyChannelData(size_t, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst) const override
+		{
+			memcpy(dst.data(), samples.data() + pos, len * sizeof(AudioConfig::SampleFormat));
+			return len;
+		}
+
+		size_t getNumberOfChannels() const override { return 1; }
+		size_t getLength() const override { return samples.size(); }
+
+	private:
+		std::vector<AudioConfig::SampleFormat> samples;
+	};
+
+	std::vector<AudioSamplePack> makeNoise(size_t nPacks, int seed)
+	{
+		Random rng(seed);
+		std::vector<AudioSamplePack> result(nPacks);
+		for (auto& pack: result) {
+			for (auto& s: pack.samples) {
+				s = rng.getFloat(-1.0f, 1.0f);
+			}
+		}
+		return result;
+	}
+
+	float maxDifference(const std::vector<AudioSamplePack>& a, const std::vector<AudioSamplePack>& b)
+	{
+		float result = 0.0f;
+		for (size_t i = 0; i < a.size(); ++i) {
+			for (size_t j = 0; j < AudioSamplePack::NumSamples; ++j) {
+				result = std::max(result, std::abs(a[i].samples[j] - b[i].samples[j]));
+			}
+		}
+		return result;
+	}
+
+	template <typename F>
+	double nsPerBuffer(size_t iterations, F f)
+	{
+		Stopwatch timer;
+		for (size_t i = 0; i < iterations; ++i) {
+			f();
+		}
+		timer.pause();
+		return double(timer.elapsedNanoSeconds()) / double(iterations);
+	}
+
+	void benchmarkMixerOps(const Vector<MixerVariant>& variants)
+	{
+		constexpr size_t iterations = 200000;
+		const auto src = makeNoise(packsPerBuffer, 1);
+		const auto initialDst = makeNoise(packsPerBuffer, 2);
+
+		// Reference output, to check that every implementation agrees with the scalar one
+		std::vector<AudioSamplePack> refConstant = initialDst;
+		std::vector<AudioSamplePack> refRamp = initialDst;
+		AudioMixer reference;
+		reference.mixAudio(src, refConstant, 0.5f, 0.5f);
+		reference.mixAudio(src, refRamp, 0.0f, 1.0f);
+
+		std::cout << "Mixer operations, " << samplesPerBuffer << " samples per buffer:" << std::endl;
+		for (auto& variant: variants) {
+			auto mixer = variant.make();
+
+			std::vector<AudioSamplePack> dst = initialDst;
+			mixer->mixAudio(src, dst, 0.5f, 0.5f);
+			const float errorConstant = maxDifference(dst, refConstant);
+			dst = initialDst;
+			mixer->mixAudio(src, dst, 0.0f, 1.0f);
+			const float errorRamp = maxDifference(dst, refRamp);
+
+			// Keep the gains tiny, so repeated mixing doesn't overflow into denormals/infinities
+			const double mix = nsPerBuffer(iterations, [&] () { mixer->mixAudio(src, dst, 0.001f, 0.001f); });
+			const double ramp = nsPerBuffer(iterations, [&] () { mixer->mixAudio(src, dst, 0.001f, 0.0f); });
+			const double sum = nsPerBuffer(iterations, [&] () { mixer->sumAudio(src, dst); });
+			const double compress = nsPerBuffer(iterations, [&] () { mixer->compressRange(dst); });
+
+			std::cout << variant.name
+				<< "  mix: " << mix << " ns"
+				<< "  mix+ramp: " << ramp << " ns"
+				<< "  sum: " << sum << " ns"
+				<< "  compress: " << compress << " ns"
+				<< "  (max error vs scalar: " << std::max(errorConstant, errorRamp) << ")" << std::endl;
+		}
+	}
+
+	void benchmarkOfflineRender(const Vector<MixerVariant>& variants)
+	{
+		constexpr size_t numEmitters = 64;
+		constexpr float duration = 10.0f;
+
+		Random rng(1234);
+		Vector<std::shared_ptr<const IAudioClip>> clips;
+		for (int i = 0; i < 8; ++i) {
+			clips.push_back(std::make_shared<SineClip>(110.0f * (i + 1), AudioConfig::sampleRate));
+		}
+
+		std::cout << "Offline render, " << numEmitters << " looping positional emitters, " << duration << "s:" << std::endl;
+		for (auto& variant: variants) {
+			AudioOfflineRenderer renderer(AudioConfig::sampleRate, int(samplesPerBuffer), variant.make());
+			renderer.setMaxVoices(0.0f, numEmitters);
+			for (size_t i = 0; i < numEmitters; ++i) {
+				const auto pos = Vector2f(rng.getFloat(-300.0f, 300.0f), rng.getFloat(-300.0f, 300.0f));
+				renderer.play(rng.getFloat(0.0f, 1.0f), clips[i % clips.size()], AudioPosition::makePositional(pos), 0.2f, true);
+			}
+
+			Stopwatch timer;
+			const size_t nBuffers = renderer.render(duration);
+			timer.pause();
+
+			const double ns = double(timer.elapsedNanoSeconds()) / double(nBuffers);
+			const double realTime = double(renderer.getNumberOfFrames()) / AudioConfig::sampleRate / (timer.elapsedNanoSeconds() * 1e-9);
+			std::cout << variant.name << "  " << ns << " ns per mixed buffer  (" << realTime << "x real time)" << std::endl;
+		}
+	}
+}
+
+void Halley::benchmarkAudioMixer()
+{
+	Executors executors;
+	Executors::set(executors);
+
+	const auto variants = getVariants();
+	benchmarkMixerOps(variants);
+	benchmarkOfflineRender(variants);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <functional>
+#include <halley/data_structures/vector.h>
+#include <halley/text/halleystring.h>
+
+namespace Halley {
+	struct Benchmark
+	{
+		String name;
+		String description;
+		std::function<void()> run;
+	};
+
+	void benchmarkFamilyMask();
+	void benchmarkAudioMixer();
+	void benchmarkNetworkSoak();
+
+	inline Vector<Benchmark> getBenchmarks()
+	{
+		return {
+			{ "family_mask", "Inline family masks vs interned mask handles", &benchmarkFamilyMask },
+			{ "audio_mixer", "Scalar, SSE and AVX audio mixers, standalone and through an offline render", &benchmarkAudioMixer },
+			{ "network_soak", "Reliability layer over a simulated lossy network: throughput, delivery latency and overhead", &benchmarkNetworkSoak }
+		};
+	}
+}
@@ -0,0 +1,201 @@
+#include "benchmarks.h"
+#include <halley/entity/family_mask.h>
+#include <halley/time/stopwatch.h>
+#include <halley/maths/random.h>
+#include <bitset>
+#include <unordered_map>
+#include <iostream>
+
+using namespace Halley;
+
+namespace {
+	// The previous scheme: every mask is interned in a global table, and handles are indices into it
+	class InternedMasks
+	{
+	public:
+		using Bits = std::bitset<FamilyMask::maxComponents>;
+
+		int getHandle(const Bits& bits)
+		{
+			auto iter = indices.find(bits);
+			if (iter != indices.end()) {
+				return iter->second;
+			}
+			const int idx = int(values.size());
+			values.push_back(bits);
+			indices[bits] = idx;
+			return idx;
+		}
+
+		const Bits& get(int handle) const
+		{
+			return values[handle];
+		}
+
+		int intersect(int a, int b)
+		{
+			return getHandle(get(a) & get(b));
+		}
+
+		bool contains(int a, int b) const
+		{
+			auto& mine = get(a);
+			auto& theirs = get(b);
+			return (mine & theirs) == theirs;
+		}
+
+	private:
+		Vector<Bits> values;
+		std::unordered_map<Bits, int> indices;
+	};
+
+	template <typename F>
+	int64_t measure(F f)
+	{
+		Stopwatch timer;
+		f();
+		timer.pause();
+		return timer.elapsedNanoSeconds();
+	}
+
+	struct Results
+	{
+		int64_t build = 0;
+		int64_t contains = 0;
+		int64_t intersect = 0;
+		size_t checksum = 0;
+	};
+
+	Vector<Vector<int>> makeComponentLists(size_t count, int maxComponentsPerEntity, int componentTypes)
+	{
+		Random rng(1234);
+		Vector<Vector<int>> result(count);
+		for (auto& list: result) {
+			const int n = rng.getInt(1, maxComponentsPerEntity);
+			for (int i = 0; i < n; ++i) {
+				list.push_back(rng.getInt(0, componentTypes - 1));
+			}
+		}
+		return result;
+	}
+
+	Results runInterned(const Vector<Vector<int>>& entities, const Vector<Vector<int>>& families, int rounds)
+	{
+		Results r;
+		InternedMasks storage;
+		Vector<int> entityMasks(entities.size());
+		Vector<int> familyMasks(families.size());
+
+		r.build = measure([&] () {
+			for (int round = 0; round < rounds; ++round) {
+				for (size_t i = 0; i < entities.size(); ++i) {
+					InternedMasks::Bits bits;
+					for (auto c: entities[i]) {
+						bits[c] = true;
+					}
+					entityMasks[i] = storage.getHandle(bits);
+				}
+			}
+			for (size_t i = 0; i < families.size(); ++i) {
+				InternedMasks::Bits bits;
+				for (auto c: families[i]) {
+					bits[c] = true;
+				}
+				familyMasks[i] = storage.getHandle(bits);
+			}
+		});
+
+		r.contains = measure([&] () {
+			for (int round = 0; round < rounds; ++round) {
+				for (auto e: entityMasks) {
+					for (auto f: familyMasks) {
+						r.checksum += storage.contains(e, f) ? 1 : 0;
+					}
+				}
+			}
+		});
+
+		r.intersect = measure([&] () {
+			for (int round = 0; round < rounds; ++round) {
+				for (auto e: entityMasks) {
+					for (auto f: familyMasks) {
+						r.checksum += storage.intersect(e, f) == f ? 1 : 0;
+					}
+				}
+			}
+		});
+
+		return r;
+	}
+
+	Results runInline(const Vector<Vector<int>>& entities, const Vector<Vector<int>>& families, int rounds)
+	{
+		Results r;
+		Vector<FamilyMaskType> entityMasks(entities.size());
+		Vector<FamilyMaskType> familyMasks(families.size());
+
+		r.build = measure([&] () {
+			for (int round = 0; round < rounds; ++round) {
+				for (size_t i = 0; i < entities.size(); ++i) {
+					FamilyMask::RealType mask;
+					for (auto c: entities[i]) {
+						FamilyMask::setBit(mask, c);
+					}
+					entityMasks[i] = mask;
+				}
+			}
+			for (size_t i = 0; i < families.size(); ++i) {
+				FamilyMask::RealType mask;
+				for (auto c: families[i]) {
+					FamilyMask::setBit(mask, c);
+				}
+				familyMasks[i] = mask;
+			}
+		});
+
+		r.contains = measure([&] () {
+			for (int round = 0; round < rounds; ++round) {
+				for (auto& e: entityMasks) {
+					for (auto& f: familyMasks) {
+						r.checksum += e.contains(f) ? 1 : 0;
+					}
+				}
+			}
+		});
+
+		r.intersect = measure([&] () {
+			for (int round = 0; round < rounds; ++round) {
+				for (auto& e: entityMasks) {
+					for (auto& f: familyMasks) {
+						r.checksum += (e & f) == f ? 1 : 0;
+					}
+				}
+			}
+		});
+
+		return r;
+	}
+
+	void print(const char* name, const Results& r, size_t entityOps, size_t pairOps)
+	{
+		auto perOp = [] (int64_t ns, size_t ops) { return double(ns) / double(ops); };
+		std::cout << name
+			<< "  build: " << perOp(r.build, entityOps) << " ns/mask"
+			<< "  contains: " << perOp(r.contains, pairOps) << " ns/op"
+			<< "  and+compare: " << perOp(r.intersect, pairOps) << " ns/op"
+			<< "  (checksum " << r.checksum << ")" << std::endl;
+	}
+}
+
+void Halley::benchmarkFamilyMask()
+{
+	constexpr int rounds = 20;
+	const auto entities = makeComponentLists(10000, 12, 96);
+	const auto families = makeComponentLists(64, 3, 96);
+
+	const size_t entityOps = entities.size() * rounds;
+	const size_t pairOps = entities.size() * families.size() * rounds;
+
+	print("interned", runInterned(entities, families, rounds), entityOps, pairOps);
+	print("inline  ", runInline(entities, families, rounds), entityOps, pairOps);
+}
@@ -0,0 +1,34 @@
+#include <iostream>
+#include "benchmarks.h"
+
+using namespace Halley;
+
+int main(int argc, char** argv)
+{
+	auto benchmarks = getBenchmarks();
+
+	if (argc < 2) {
+		std::cout << "Usage: halley-benchmark [name|all]" << std::endl;
+		std::cout << "Available benchmarks:" << std::endl;
+		for (auto& b: benchmarks) {
+			std::cout << "- " << b.name << ": " << b.description << std::endl;
+		}
+		return 1;
+	}
+
+	const String name = argv[1];
+	bool found = false;
+	for (auto& b: benchmarks) {
+		if (name == "all" || name == b.name) {
+			std::cout << "== " << b.name << " ==" << std::endl;
+			b.run();
+			found = true;
+		}
+	}
+
+	if (!found) {
+		std::cout << "Unknown benchmark: " << name << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,360 @@
+#include "benchmarks.h"
+#include <halley/net/connection/loopback_network_service.h>
+#include <halley/net/connection/reliable_connection.h>
+#include <halley/net/connection/message_queue_udp.h>
+#include <halley/net/session/network_session.h>
+#include <halley/time/stopwatch.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <chrono>
+
+using namespace Halley;
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	constexpr int hostPort = 1000;
+	constexpr size_t numClients = 8;
+	constexpr size_t reliablePerTick = 4;
+	constexpr size_t payloadSize = 48;
+	constexpr size_t sharedDataSize = 64;
+	constexpr auto tickLength = std::chrono::milliseconds(5);
+	constexpr auto sendDuration = std::chrono::seconds(2);
+	constexpr auto maxDrainDuration = std::chrono::seconds(10);
+	constexpr auto sessionDrainDuration = std::chrono::seconds(1); // Session packets aren't resent, so anything lost never arrives
+
+	enum Channels
+	{
+		ChannelReliable,
+		ChannelUnreliable
+	};
+
+	class SoakMessage : public NetworkMessage
+	{
+	public:
+		SoakMessage(int64_t sentAt, size_t size)
+			: sentAt(sentAt)
+			, payload(size)
+		{}
+
+		explicit SoakMessage(gsl::span<const gsl::byte> src)
+		{
+			Deserializer s(src);
+			s >> sentAt;
+			s >> payload;
+		}
+
+		void serialize(Serializer& s) const override
+		{
+			s << sentAt;
+			s << payload;
+		}
+
+		int64_t sentAt = 0;
+		Bytes payload;
+	};
+
+	class SoakSharedData : public SharedData
+	{
+	public:
+		int64_t updatedAt = 0;
+		Bytes state;
+
+		void serialize(Serializer& s) const override
+		{
+			s << updatedAt;
+			s << state;
+		}
+
+		void deserialize(Deserializer& s) override
+		{
+			s >> updatedAt;
+			s >> state;
+		}
+	};
+
+	using SoakSession = NetworkSessionImpl<SoakSharedData, SoakSharedData>;
+
+	struct Scenario
+	{
+		String name;
+		LoopbackNetworkConditions conditions;
+	};
+
+	struct Endpoint
+	{
+		std::shared_ptr<ReliableConnection> connection;
+		std::unique_ptr<MessageQueueUDP> queue;
+	};
+
+	struct SoakResults
+	{
+		size_t reliableSent = 0;
+		size_t reliableReceived = 0;
+		size_t unreliableSent = 0;
+		size_t unreliableReceived = 0;
+		size_t payloadBytes = 0;
+		std::vector<int64_t> latencies; // Reliable messages only, in nanoseconds
+	};
+
+	int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+	}
+
+	Endpoint makeEndpoint(std::shared_ptr<IConnection> connection)
+	{
+		Endpoint result;
+		result.connection = std::make_shared<ReliableConnection>(connection);
+		result.queue = std::make_unique<MessageQueueUDP>(result.connection);
+		result.queue->addFactory<SoakMessage>();
+		result.queue->setChannel(ChannelReliable, ChannelSettings(true, true));
+		result.queue->setChannel(ChannelUnreliable, ChannelSettings(false, false));
+		return result;
+	}
+
+	void receive(Endpoint& endpoint, SoakResults& results)
+	{
+		const int64_t time = now();
+		for (auto& msg: endpoint.queue->receiveAll()) {
+			auto& soak = dynamic_cast<SoakMessage&>(*msg);
+			if (soak.payload.size() == payloadSize) {
+				++results.reliableReceived;
+				results.latencies.push_back(time - soak.sentAt);
+			} else {
+				++results.unreliableReceived;
+			}
+		}
+	}
+
+	void send(Endpoint& endpoint, SoakResults& results)
+	{
+		const int64_t time = now();
+		for (size_t i = 0; i < reliablePerTick; ++i) {
+			auto msg = std::make_unique<SoakMessage>(time, payloadSize);
+			results.payloadBytes += msg->getSerializedSize();
+			endpoint.queue->enqueue(std::move(msg), ChannelReliable);
+			++results.reliableSent;
+		}
+
+		// Different size, to tell them apart on arrival
+		auto msg = std::make_unique<SoakMessage>(time, payloadSize / 2);
+		results.payloadBytes += msg->getSerializedSize();
+		endpoint.queue->enqueue(std::move(msg), ChannelUnreliable);
+		++results.unreliableSent;
+	}
+
+	double percentile(std::vector<int64_t>& values, double p)
+	{
+		if (values.empty()) {
+			return 0;
+		}
+		const size_t n = std::min(values.size() - 1, size_t(p * double(values.size())));
+		std::nth_element(values.begin(), values.begin() + n, values.end());
+		return double(values[n]) * 1e-6;
+	}
+
+	void runScenario(const Scenario& scenario)
+	{
+		LoopbackNetwork network(1234);
+		network.setConditions(scenario.conditions);
+
+		// One host with a connection to each client, all exchanging traffic both ways
+		LoopbackNetworkService hostService(network, hostPort);
+		std::vector<std::unique_ptr<LoopbackNetworkService>> clientServices;
+		std::vector<Endpoint> endpoints;
+		for (size_t i = 0; i < numClients; ++i) {
+			clientServices.push_back(std::make_unique<LoopbackNetworkService>(network));
+			endpoints.push_back(makeEndpoint(clientServices.back()->connect("localhost", hostPort)));
+		}
+		hostService.setAcceptingConnections(true);
+		while (auto conn = hostService.tryAcceptConnection()) {
+			endpoints.push_back(makeEndpoint(conn));
+		}
+		hostService.setAcceptingConnections(false);
+
+		SoakResults results;
+		Stopwatch cpuTime(false);
+		const auto start = Clock::now();
+		auto end = start;
+
+		for (auto nextTick = start; ; nextTick += tickLength) {
+			std::this_thread::sleep_until(nextTick);
+
+			const bool sending = nextTick - start < sendDuration;
+			cpuTime.start();
+			for (auto& e: endpoints) {
+				if (sending) {
+					send(e, results);
+				}
+				e.queue->sendAll();
+			}
+			for (auto& e: endpoints) {
+				receive(e, results);
+			}
+			cpuTime.pause();
+
+			end = Clock::now();
+			if (!sending && (results.reliableReceived >= results.reliableSent || end - start > sendDuration + maxDrainDuration)) {
+				break;
+			}
+		}
+
+		const double wallTime = std::chrono::duration<double>(end - start).count();
+		const auto& stats = network.getStats();
+		const size_t totalReceived = results.reliableReceived + results.unreliableReceived;
+
+		std::cout << scenario.name
+			<< "  reliable: " << results.reliableReceived << "/" << results.reliableSent
+			<< "  unreliable: " << results.unreliableReceived << "/" << results.unreliableSent
+			<< "  throughput: " << int64_t(double(totalReceived) / wallTime) << " msg/s"
+			<< "  latency p50: " << percentile(results.latencies, 0.5) << " ms"
+			<< "  p99: " << percentile(results.latencies, 0.99) << " ms"
+			<< "  wire/payload: " << double(stats.bytesSent) / double(results.payloadBytes)
+			<< "  (" << stats.packetsSent << " packets, " << stats.packetsDropped << " dropped)"
+			<< "  cpu: " << double(cpuTime.elapsedNanoSeconds()) / double(std::max(totalReceived, size_t(1))) << " ns/msg" << std::endl;
+	}
+
+	bool isConnected(const std::vector<std::unique_ptr<SoakSession>>& sessions)
+	{
+		return std::all_of(sessions.begin(), sessions.end(), [] (const std::unique_ptr<SoakSession>& s) { return s->getStatus() == ConnectionStatus::Connected; });
+	}
+
+	void runSessionScenario(const Scenario& scenario)
+	{
+		LoopbackNetwork network(1234);
+
+		// One host session and its clients, each changing a few bytes of its shared data and messaging everyone every tick
+		LoopbackNetworkService hostService(network, hostPort);
+		std::vector<std::unique_ptr<LoopbackNetworkService>> clientServices;
+		std::vector<std::unique_ptr<SoakSession>> sessions;
+		sessions.push_back(std::make_unique<SoakSession>(hostService));
+		sessions.back()->setMaxClients(int(numClients) + 1); // Counts the host
+		sessions.back()->host(hostPort);
+		for (size_t i = 0; i < numClients; ++i) {
+			clientServices.push_back(std::make_unique<LoopbackNetworkService>(network));
+			sessions.push_back(std::make_unique<SoakSession>(*clientServices.back()));
+			sessions.back()->join("localhost", hostPort);
+		}
+
+		// Peer ids are handed out once, so joining happens over a clean network
+		const auto joinStart = Clock::now();
+		while (!isConnected(sessions)) {
+			if (Clock::now() - joinStart > maxDrainDuration) {
+				std::cout << scenario.name << "  failed to join" << std::endl;
+				return;
+			}
+			for (auto& s: sessions) {
+				s->update();
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		network.setConditions(scenario.conditions);
+		network.resetStats();
+
+		const size_t numPeers = sessions.size();
+		size_t packetsSent = 0;
+		size_t packetsReceived = 0;
+		size_t ticks = 0;
+		std::vector<int64_t> latencies; // Session packets, in nanoseconds
+		std::vector<int64_t> stateAges; // How far behind each peer's view of everyone else's shared data is, in nanoseconds
+		Stopwatch cpuTime(false);
+		const auto start = Clock::now();
+		auto end = start;
+
+		for (auto nextTick = start; ; nextTick += tickLength) {
+			std::this_thread::sleep_until(nextTick);
+
+			const bool sending = nextTick - start < sendDuration;
+			cpuTime.start();
+			const int64_t time = now();
+			for (auto& s: sessions) {
+				if (sending) {
+					auto& data = s->getMySharedData();
+					data.state.resize(sharedDataSize);
+					data.state[ticks % sharedDataSize] = Byte(ticks);
+					data.updatedAt = time;
+					data.markModified();
+
+					Bytes packet(sizeof(time) + payloadSize);
+					memcpy(packet.data(), &time, sizeof(time));
+					s->send(OutboundNetworkPacket(packet));
+					packetsSent += numPeers - 1;
+				}
+				s->update();
+			}
+
+			const int64_t receiveTime = now();
+			InboundNetworkPacket packet;
+			for (auto& s: sessions) {
+				while (s->receive(packet)) {
+					int64_t sentAt;
+					memcpy(&sentAt, packet.getBytes().data(), sizeof(sentAt));
+					latencies.push_back(receiveTime - sentAt);
+					++packetsReceived;
+				}
+
+				if (sending) {
+					for (int peerId = 0; peerId < int(numPeers); ++peerId) {
+						auto data = peerId != s->getMyPeerId() ? s->tryGetClientSharedData(peerId) : nullptr;
+						if (data && data->updatedAt != 0) {
+							stateAges.push_back(receiveTime - data->updatedAt);
+						}
+					}
+				}
+			}
+			cpuTime.pause();
+			++ticks;
+
+			end = Clock::now();
+			if (!sending && (packetsReceived >= packetsSent || end - start > sendDuration + sessionDrainDuration)) {
+				break;
+			}
+		}
+
+		const auto& stats = network.getStats();
+		std::cout << scenario.name
+			<< "  packets: " << packetsReceived << "/" << packetsSent
+			<< "  latency p50: " << percentile(latencies, 0.5) << " ms"
+			<< "  p99: " << percentile(latencies, 0.99) << " ms"
+			<< "  state age p50: " << percentile(stateAges, 0.5) << " ms"
+			<< "  p99: " << percentile(stateAges, 0.99) << " ms"
+			<< "  wire: " << stats.bytesSent / std::max(ticks * numPeers, size_t(1)) << " bytes/peer/tick"
+			<< "  (" << stats.packetsSent << " packets, " << stats.packetsDropped << " dropped)"
+			<< "  cpu: " << int64_t(double(cpuTime.elapsedNanoSeconds()) / double(std::max(ticks, size_t(1)))) << " ns/tick" << std::endl;
+	}
+
+	LoopbackNetworkConditions makeConditions(float latency, float jitter, float packetLoss, float duplication)
+	{
+		LoopbackNetworkConditions result;
+		result.latency = latency;
+		result.jitter = jitter;
+		result.packetLoss = packetLoss;
+		result.duplication = duplication;
+		return result;
+	}
+}
+
+void Halley::benchmarkNetworkSoak()
+{
+	const std::vector<Scenario> scenarios = {
+		{ "perfect   ", makeConditions(0.000f, 0.000f, 0.00f, 0.00f) },
+		{ "lan       ", makeConditions(0.002f, 0.001f, 0.01f, 0.00f) },
+		{ "internet  ", makeConditions(0.040f, 0.010f, 0.05f, 0.01f) },
+		{ "congested ", makeConditions(0.080f, 0.040f, 0.20f, 0.05f) }
+	};
+
+	std::cout << numClients << " clients and a host over a loopback network, " << reliablePerTick << " reliable + 1 unreliable messages per peer every "
+		<< tickLength.count() << " ms for " << sendDuration.count() << "s:" << std::endl;
+	for (auto& s: scenarios) {
+		runScenario(s);
+	}
+
+	std::cout << std::endl << "NetworkSession with " << numClients << " clients and a host, each changing its shared data and sending a packet to every peer every "
+		<< tickLength.count() << " ms for " << sendDuration.count() << "s:" << std::endl;
+	for (auto& s: scenarios) {
+		runSessionScenario(s);
+	}
+}
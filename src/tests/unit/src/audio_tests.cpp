@@ -0,0 +1,284 @@
+#include "unit_tests.h"
+#include <halley/audio/audio_clip.h>
+#include <halley/audio/vorbis_dec.h>
+#include <halley/audio/audio_offline_renderer.h>
+#include <halley/concurrency/executor.h>
+#include <halley/resources/resource_data.h>
+#include "audio_source_clip.h"
+#include "audio_clip_streamer.h"
+#include "audio_clip_chunks.h"
+#include "audio_mixer.h"
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <functional>
+
+using namespace Halley;
+
+namespace {
+	// Relative to the tests directory, which is where ctest runs the unit tests from
+	const char* const longClipPath = "audio/assets_src/audio/Loveshadow_-_Marcos_Theme.ogg"; // Stereo, a few minutes, starts silent
+	const char* const shortClipPath = "audio/assets_src/audio/g1.ogg"; // Mono, about half a second, starts straight away
+	constexpr size_t blockSize = 1024;
+
+	class MemoryDataReader : public ResourceDataReader
+	{
+	public:
+		MemoryDataReader(std::shared_ptr<ResourceDataStatic> data)
+			: data(std::move(data))
+		{}
+
+		size_t size() const override { return data->getSize(); }
+
+		int read(gsl::span<gsl::byte> dst) override
+		{
+			const size_t n = std::min(size_t(dst.size()), size() - std::min(pos, size()));
+			memcpy(dst.data(), static_cast<const char*>(data->getData()) + pos, n);
+			pos += n;
+			return int(n);
+		}
+
+		void seek(int64_t offset, int whence) override
+		{
+			switch (whence) {
+			case SEEK_SET:
+				pos = size_t(offset);
+				break;
+			case SEEK_CUR:
+				pos = size_t(int64_t(pos) + offset);
+				break;
+			case SEEK_END:
+				pos = size_t(int64_t(size()) + offset);
+				break;
+			}
+		}
+
+		size_t tell() const override { return pos; }
+		void close() override {}
+
+	private:
+		std::shared_ptr<ResourceDataStatic> data;
+		size_t pos = 0;
+	};
+
+	std::shared_ptr<ResourceDataStatic> loadClipData(const char* path)
+	{
+		std::shared_ptr<ResourceDataStatic> data = ResourceDataStatic::loadFromFileSystem(Path(path));
+		check(data && data->getSize() > 0, String("test clip can be loaded from ") + path);
+		return data;
+	}
+
+	std::shared_ptr<AudioClip> makeStreamingClip(std::shared_ptr<ResourceDataStatic> data)
+	{
+		auto stream = std::make_shared<ResourceDataStream>(data->getPath(), [data] ()
+		{
+			return std::make_unique<MemoryDataReader>(data);
+		});
+
+		auto clip = std::make_shared<AudioClip>(2);
+		clip->loadFromStream(stream, Metadata());
+		return clip;
+	}
+
+	std::shared_ptr<AudioClip> makeClip(std::shared_ptr<ResourceDataStatic> data)
+	{
+		auto clip = std::make_shared<AudioClip>(1);
+		clip->loadFromStatic(data, Metadata());
+		return clip;
+	}
+
+	// Polls until the condition holds, failing if it takes far longer than decoding ever should
+	void waitFor(const std::function<bool()>& condition, const String& what)
+	{
+		const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (!condition()) {
+			check(std::chrono::steady_clock::now() < timeout, what);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	// One emitter's worth of playback, checked against a direct decode of the clip
+	class Playback
+	{
+	public:
+		Playback(std::shared_ptr<const IAudioClip> clip, std::shared_ptr<ResourceDataStatic> data, size_t startPos)
+			: source(clip, false, 0)
+			, reference(data)
+		{
+			waitFor([&] () { return source.isReady(); }, "playback becomes ready");
+
+			source.skipAudio(startPos);
+			reference.seek(startPos);
+
+			const size_t nChannels = source.getNumberOfChannels();
+			output.resize(nChannels, std::vector<AudioConfig::SampleFormat>(blockSize));
+			expected.resize(nChannels, std::vector<float>(blockSize));
+		}
+
+		// Waits until the next block is decoded, so reading it can't underrun
+		void waitForBlock()
+		{
+			waitFor([&] () { return source.prefetch(blockSize); }, "next block gets decoded");
+		}
+
+		// Mixes the next block, and returns whether it matched the reference and wasn't silent
+		bool readBlock()
+		{
+			AudioSourceData dst;
+			for (size_t i = 0; i < output.size(); ++i) {
+				dst[i] = gsl::span<AudioConfig::SampleFormat>(output[i]);
+			}
+			source.getAudioData(blockSize, dst);
+			reference.read(expected);
+
+			bool audible = false;
+			for (size_t i = 0; i < output.size(); ++i) {
+				for (size_t j = 0; j < blockSize; ++j) {
+					if (std::abs(output[i][j] - expected[i][j]) > 0.0001f) {
+						return false;
+					}
+					audible = audible || std::abs(output[i][j]) > 0.0001f;
+				}
+			}
+			return audible;
+		}
+
+	private:
+		AudioSourceClip source;
+		VorbisData reference;
+		std::vector<std::vector<AudioConfig::SampleFormat>> output;
+		std::vector<std::vector<float>> expected;
+	};
+
+	// Plays two emitters on the same clip, far enough apart that they can't share buffered data
+	void playTwoEmitters(bool parallel)
+	{
+		auto data = loadClipData(longClipPath);
+		auto clip = makeStreamingClip(data);
+		Playback first(clip, data, 5 * AudioConfig::sampleRate);
+		Playback second(clip, data, 20 * AudioConfig::sampleRate);
+
+		// Each block is only read once it's decoded, so every one of them has to be the right audio
+		constexpr int nBlocks = 40;
+		auto play = [&] (Playback& playback) -> int
+		{
+			int matches = 0;
+			for (int i = 0; i < nBlocks; ++i) {
+				playback.waitForBlock();
+				matches += playback.readBlock() ? 1 : 0;
+			}
+			return matches;
+		};
+
+		int firstMatches = 0;
+		int secondMatches = 0;
+		if (parallel) {
+			// Same as AudioEngine mixing them in different partitions
+			std::thread worker([&] () { secondMatches = play(second); });
+			firstMatches = play(first);
+			worker.join();
+		} else {
+			for (int i = 0; i < nBlocks; ++i) {
+				first.waitForBlock();
+				second.waitForBlock();
+				firstMatches += first.readBlock() ? 1 : 0;
+				secondMatches += second.readBlock() ? 1 : 0;
+			}
+		}
+		check(firstMatches == nBlocks, "first emitter plays the clip from its own position");
+		check(secondMatches == nBlocks, "second emitter plays the clip from its own position");
+	}
+}
+
+void Halley::testAudioStreamingEmitters()
+{
+	playTwoEmitters(false);
+}
+
+void Halley::testAudioStreamingEmittersParallel()
+{
+	playTwoEmitters(true);
+}
+
+void Halley::testAudioStreamingClipPrimedStreamers()
+{
+	auto data = loadClipData(longClipPath);
+	auto clip = makeStreamingClip(data);
+
+	// Playback never creates a streamer; it takes one that's already primed, and another one is primed for the next playback
+	for (int i = 0; i < 3; ++i) {
+		std::shared_ptr<AudioClipStreamer> streamer;
+		waitFor([&] () { streamer = clip->takeStreamer(); return streamer != nullptr; }, "a primed streamer is available");
+		check(streamer->isReady(), "streamers are handed out primed");
+	}
+}
+
+void Halley::testAudioCompressedClipPrefetch()
+{
+	auto data = loadClipData(shortClipPath);
+	auto chunks = std::make_shared<AudioClipChunks>(std::make_unique<VorbisData>(data));
+	AudioDecodeWorker::get().add(chunks);
+	VorbisData reference(data);
+
+	const size_t length = chunks->getLength();
+	const size_t chunkSize = AudioClipChunks::chunkSize;
+	const size_t nChannels = chunks->getNumberOfChannels();
+	check(length > chunkSize + blockSize, "test clip spans more than one chunk");
+
+	// Nothing is decoded on the mixing thread, so playback waits for the first chunk
+	waitFor([&] () { return chunks->prefetch(0); }, "first chunk gets decoded");
+
+	std::vector<AudioConfig::SampleFormat> output(blockSize);
+	std::vector<std::vector<float>> expected(nChannels, std::vector<float>(blockSize));
+	for (size_t pos = 0; pos + blockSize <= length; pos += blockSize) {
+		reference.read(expected);
+		for (size_t channel = 0; channel < nChannels; ++channel) {
+			chunks->copyChannelData(channel, pos, blockSize, output);
+			for (size_t i = 0; i < blockSize; ++i) {
+				check(std::abs(output[i] - expected[channel][i]) < 0.0001f, "compressed clip plays without gaps");
+			}
+		}
+
+		// Reading past halfway through a chunk asks for the next one, which then gets decoded without anything else asking for it
+		const size_t next = (pos / chunkSize + 1) * chunkSize;
+		if (pos + blockSize > next - chunkSize / 2 && next < length) {
+			waitFor([&] () { return chunks->isDecoded(next); }, "next chunk is decoded ahead of playback");
+		}
+	}
+}
+
+void Halley::testAudioEngineParallelMix()
+{
+	auto clip = makeClip(loadClipData(shortClipPath));
+
+	// Enough emitters to be split across the audio thread and the mix workers, when there are any
+	auto render = [&] () -> std::vector<AudioConfig::SampleFormat>
+	{
+		AudioOfflineRenderer renderer;
+		for (int i = 0; i < 64; ++i) {
+			renderer.play(0.005f * float(i), clip, AudioPosition::makeUI(0.0f), 0.01f);
+		}
+		renderer.render(0.5f);
+		auto samples = renderer.getSamples();
+		return std::vector<AudioConfig::SampleFormat>(samples.begin(), samples.end());
+	};
+
+	const auto serial = render();
+	std::vector<AudioConfig::SampleFormat> parallel;
+	{
+		// The engine starts a mix worker per aux thread
+		Executor aux0(Executors::getCPUAux());
+		Executor aux1(Executors::getCPUAux());
+		Executor aux2(Executors::getCPUAux());
+		parallel = render();
+	}
+
+	check(serial.size() == parallel.size(), "parallel mix renders the same length");
+	bool audible = false;
+	for (size_t i = 0; i < serial.size(); ++i) {
+		check(std::abs(serial[i] - parallel[i]) < 0.0001f, "parallel mix matches the serial one");
+		audible = audible || std::abs(serial[i]) > 0.0001f;
+	}
+	check(audible, "mix is not silent");
+}
@@ -0,0 +1,35 @@
+#include "unit_tests.h"
+#include <halley/concurrency/concurrent.h>
+#include <numeric>
+#include <chrono>
+
+using namespace Halley;
+
+void Halley::testForeachException()
+{
+	Vector<int> values(1000);
+	std::iota(values.begin(), values.end(), 0);
+
+	std::atomic<int64_t> sum(0);
+	Concurrent::foreach(values.begin(), values.end(), [&] (int v) { sum += v; });
+	check(sum == int64_t(values.size()) * int64_t(values.size() - 1) / 2, "every element was visited");
+
+	// Throwing from a worker used to leave the caller waiting forever
+	const auto callerThread = std::this_thread::get_id();
+	std::atomic<bool> thrown(false);
+	bool caught = false;
+	try {
+		Concurrent::foreach(values.begin(), values.end(), [&] (int v)
+		{
+			// Slow enough that the workers get a share of the ranges
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			if (std::this_thread::get_id() != callerThread && !thrown.exchange(true)) {
+				throw Exception("Expected failure", HalleyExceptions::Concurrency);
+			}
+		});
+	} catch (Exception& e) {
+		caught = String(e.what()).contains("Expected failure");
+	}
+	check(thrown, "a worker ran part of the foreach");
+	check(caught, "exception thrown by f on a worker reaches the caller");
+}
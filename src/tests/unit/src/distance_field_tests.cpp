@@ -0,0 +1,110 @@
+#include "unit_tests.h"
+#include <halley/tools/distance_field/distance_field_generator.h>
+#include <halley/file_formats/image.h>
+#include <halley/maths/random.h>
+#include <halley/text/string_converter.h>
+#include <cstring>
+
+using namespace Halley;
+
+namespace {
+	using AlphaFunction = std::function<int(int x, int y)>;
+
+	std::unique_ptr<Image> makeImage(Vector2i size, const AlphaFunction& getAlpha)
+	{
+		auto image = std::make_unique<Image>(Image::Format::RGBA, size);
+		auto pixels = reinterpret_cast<int*>(image->getPixels());
+		for (int y = 0; y < size.y; ++y) {
+			for (int x = 0; x < size.x; ++x) {
+				pixels[x + y * size.x] = int(Image::convertRGBAToInt(255, 255, 255, getAlpha(x, y)));
+			}
+		}
+		return image;
+	}
+
+	// Random circles, so there are both solid areas and edges in every direction
+	std::unique_ptr<Image> makeBlobs(Random& rng, Vector2i size)
+	{
+		struct Blob
+		{
+			float x, y, radius;
+		};
+		std::vector<Blob> blobs(rng.getSizeT(size_t(1), size_t(6)));
+		for (auto& b: blobs) {
+			b = Blob{ rng.getFloat(0, float(size.x)), rng.getFloat(0, float(size.y)), rng.getFloat(0.5f, float(std::max(size.x, size.y)) / 3) };
+		}
+
+		return makeImage(size, [&] (int x, int y)
+		{
+			for (auto& b: blobs) {
+				if ((x - b.x) * (x - b.x) + (y - b.y) * (y - b.y) < b.radius * b.radius) {
+					return 255;
+				}
+			}
+			return 0;
+		});
+	}
+
+	std::unique_ptr<Image> makeNoise(Random& rng, Vector2i size)
+	{
+		return makeImage(size, [&] (int, int) { return rng.getInt(0, 255); });
+	}
+
+	void checkMatchesReference(Image& src, Vector2i size, float radius, const String& what)
+	{
+		const auto result = DistanceFieldGenerator::generate(src, size, radius);
+		const auto reference = DistanceFieldGenerator::generateReference(src, size, radius);
+		const bool same = result->getByteSize() == reference->getByteSize() && memcmp(result->getPixels(), reference->getPixels(), result->getByteSize()) == 0;
+		check(same, what + " matches the reference (" + toString(src.getWidth()) + "x" + toString(src.getHeight()) + " to "
+			+ toString(size.x) + "x" + toString(size.y) + ", radius " + toString(radius) + ")");
+	}
+}
+
+void Halley::testDistanceFieldMatchesReference()
+{
+	Random rng(1234);
+
+	for (int i = 0; i < 60; ++i) {
+		const Vector2i srcSize(rng.getInt(1, 80), rng.getInt(1, 80));
+		const int scale = rng.getInt(1, 4);
+		const Vector2i size(std::max(1, srcSize.x / scale), std::max(1, srcSize.y / scale));
+		const float radius = rng.getFloat(0.2f, 12.0f);
+		auto src = i % 2 == 0 ? makeBlobs(rng, srcSize) : makeNoise(rng, srcSize);
+		checkMatchesReference(*src, size, radius, i % 2 == 0 ? "random blobs" : "random noise");
+	}
+
+	{
+		// Large enough to be split across tasks
+		auto src = makeBlobs(rng, Vector2i(150, 131));
+		checkMatchesReference(*src, Vector2i(150, 131), 3.0f, "large image");
+		checkMatchesReference(*src, Vector2i(37, 32), 2.0f, "large downsampled image");
+	}
+
+	{
+		// Radius covering the whole image, and then some
+		auto src = makeBlobs(rng, Vector2i(21, 17));
+		checkMatchesReference(*src, Vector2i(21, 17), 100.0f, "huge radius");
+	}
+
+	for (float radius: { 0.0f, 0.0005f, 0.000999f }) {
+		auto src = makeNoise(rng, Vector2i(13, 9));
+		checkMatchesReference(*src, Vector2i(13, 9), radius, "tiny radius");
+		checkMatchesReference(*src, Vector2i(6, 4), radius, "tiny radius downsampled");
+	}
+
+	for (int alpha: { 0, 255 }) {
+		auto src = makeImage(Vector2i(19, 11), [&] (int, int) { return alpha; });
+		const String what = alpha == 0 ? "empty image" : "full image";
+		checkMatchesReference(*src, Vector2i(19, 11), 3.0f, what);
+		checkMatchesReference(*src, Vector2i(9, 5), 1.5f, what);
+		checkMatchesReference(*src, Vector2i(19, 11), 0.0f, what);
+	}
+
+	// Widths around multiples of 4 leave different tails after the SSE loops
+	for (int w = 1; w <= 13; ++w) {
+		for (int h: { 1, 2, 3, 7 }) {
+			auto src = makeNoise(rng, Vector2i(w, h));
+			checkMatchesReference(*src, Vector2i(w, h), 2.5f, "odd size");
+		}
+	}
+}
@@ -0,0 +1,242 @@
+#include "unit_tests.h"
+#include <halley/entity/world.h>
+#include <halley/entity/system.h>
+#include <halley/entity/message.h>
+#include <halley/bytes/byte_serializer.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace Halley;
+
+namespace {
+	// Hand-written equivalents of what codegen generates for a component
+	class FirstComponent : public Component
+	{
+	public:
+		static constexpr int componentIndex = 0;
+		int value = 0;
+
+		FirstComponent() {}
+		FirstComponent(int value) : value(value) {}
+	};
+
+	class SecondComponent : public Component
+	{
+	public:
+		static constexpr int componentIndex = 1;
+		int value = 0;
+
+		SecondComponent() {}
+		SecondComponent(int value) : value(value) {}
+	};
+
+	class ThirdComponent : public Component
+	{
+	public:
+		static constexpr int componentIndex = 2;
+		int value = 0;
+
+		ThirdComponent() {}
+		ThirdComponent(int value) : value(value) {}
+	};
+
+	// As generated with "serializable: true"
+	class PositionComponent : public Component
+	{
+	public:
+		static constexpr int componentIndex = 3;
+		int x = 0;
+		int y = 0;
+
+		PositionComponent() {}
+		PositionComponent(int x, int y) : x(x), y(y) {}
+
+		void serialize(Serializer& s) const { s << x << y; }
+		void deserialize(Deserializer& s) { s >> x >> y; }
+	};
+
+	class ThrowingSystem : public System
+	{
+	public:
+		ThrowingSystem(std::atomic<int>& updates) : System({}, {}), updates(updates) {}
+
+	protected:
+		void updateBase(Time) override
+		{
+			// Slow enough that the other systems in the stage are picked up by workers in the meantime
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			++updates;
+			throw Exception("Expected failure", HalleyExceptions::Entity);
+		}
+
+	private:
+		std::atomic<int>& updates;
+	};
+
+	class PingMessage : public Message
+	{
+	public:
+		static constexpr int messageIndex = 0;
+
+		size_t getSize() const override { return sizeof(PingMessage); }
+	};
+
+	class PingSenderSystem : public System
+	{
+	public:
+		Vector<EntityId> targets;
+
+		PingSenderSystem() : System({}, {}, { PingMessage::messageIndex }) {}
+
+	protected:
+		void updateBase(Time) override
+		{
+			for (auto& target: targets) {
+				sendMessageGeneric(target, PingMessage());
+			}
+			targets.clear();
+		}
+	};
+
+	class PingReceiverSystem : public System
+	{
+	public:
+		class MainFamily : public FamilyBaseOf<MainFamily>
+		{
+		public:
+			FirstComponent& first;
+
+			using Type = FamilyType<FirstComponent>;
+
+		protected:
+			MainFamily(FirstComponent& first) : first(first) {}
+		};
+
+		FamilyBinding<MainFamily> mainFamily;
+		Vector<EntityId> received;
+
+		PingReceiverSystem() : System({ &mainFamily }, { PingMessage::messageIndex }) {}
+
+	protected:
+		void onMessagesReceived(int, Message**, size_t* idx, size_t n) override
+		{
+			for (size_t i = 0; i < n; ++i) {
+				received.push_back(mainFamily[idx[i]].entityId);
+			}
+		}
+	};
+}
+
+void Halley::testEntityRemoveComponents()
+{
+	World world(nullptr, false);
+	const auto id = world.createEntity()
+		.addComponent(FirstComponent(1))
+		.addComponent(SecondComponent(2))
+		.addComponent(ThirdComponent(3))
+		.getEntityId();
+	world.spawnPending();
+
+	// Removing a component from the middle first used to swap a dead component back into the live ones
+	world.getEntity(id)
+		.removeComponent<SecondComponent>()
+		.removeComponent<FirstComponent>();
+	world.spawnPending();
+
+	auto e = world.getEntity(id);
+	check(e.tryGetComponent<FirstComponent>() == nullptr, "first component was removed");
+	check(e.tryGetComponent<SecondComponent>() == nullptr, "second component was removed");
+	check(e.tryGetComponent<ThirdComponent>() != nullptr, "third component is still there");
+	check(e.getComponent<ThirdComponent>().value == 3, "third component kept its value");
+}
+
+void Halley::testEntitySnapshotRestore()
+{
+	World world(nullptr, false);
+	const auto movedId = world.createEntity().addComponent(PositionComponent(1, 2)).addComponent(FirstComponent(10)).getEntityId();
+	const auto destroyedId = world.createEntity().addComponent(PositionComponent(3, 4)).addComponent(FirstComponent(20)).getEntityId();
+	const auto gainedId = world.createEntity().addComponent(FirstComponent(30)).getEntityId();
+	world.spawnPending();
+
+	Bytes snapshot;
+	world.saveSnapshot(snapshot);
+
+	world.getEntity(movedId).getComponent<PositionComponent>().x = 100;
+	world.getEntity(movedId).getComponent<PositionComponent>().y = 200;
+	world.getEntity(gainedId).addComponent(PositionComponent(5, 6));
+	const auto createdId = world.createEntity().addComponent(PositionComponent(7, 8)).getEntityId();
+	world.spawnPending();
+	world.destroyEntity(destroyedId);
+	world.spawnPending();
+
+	world.restoreSnapshot(gsl::as_bytes(gsl::span<const Byte>(snapshot)));
+
+	check(world.numEntities() == 3, "restored world has the entities from the snapshot");
+	check(world.tryGetEntity(createdId) == nullptr, "entity created after the snapshot is gone");
+
+	auto moved = world.getEntity(movedId);
+	check(moved.getComponent<PositionComponent>().x == 1 && moved.getComponent<PositionComponent>().y == 2, "modified component is restored");
+	check(moved.getComponent<FirstComponent>().value == 10, "entity that still existed keeps its non-serializable components");
+
+	check(world.tryGetEntity(destroyedId) != nullptr, "destroyed entity is re-created with its id");
+	auto destroyed = world.getEntity(destroyedId);
+	check(destroyed.getComponent<PositionComponent>().x == 3 && destroyed.getComponent<PositionComponent>().y == 4, "re-created entity has its serializable components");
+	check(destroyed.tryGetComponent<FirstComponent>() == nullptr, "re-created entity doesn't have its non-serializable components");
+
+	auto gained = world.getEntity(gainedId);
+	check(gained.tryGetComponent<PositionComponent>() == nullptr, "serializable component added after the snapshot is removed");
+	check(gained.getComponent<FirstComponent>().value == 30, "entity that lost a component keeps the others");
+
+	// Ids are allocated exactly as they were after the snapshot was taken
+	const auto recreatedId = world.createEntity().addComponent(PositionComponent(7, 8)).getEntityId();
+	world.spawnPending();
+	check(recreatedId == createdId, "ids after restore match the original timeline");
+}
+
+void Halley::testEntityStaleMessageTarget()
+{
+	World world(nullptr, false);
+	auto& sender = dynamic_cast<PingSenderSystem&>(world.addSystem(std::make_unique<PingSenderSystem>(), TimeLine::FixedUpdate));
+	auto& receiver = dynamic_cast<PingReceiverSystem&>(world.addSystem(std::make_unique<PingReceiverSystem>(), TimeLine::FixedUpdate));
+
+	const auto staleId = world.createEntity().addComponent(FirstComponent(1)).getEntityId();
+	world.step(TimeLine::FixedUpdate, 0);
+	world.destroyEntity(staleId);
+	world.step(TimeLine::FixedUpdate, 0);
+
+	// The new entity takes over the destroyed one's slot, with a different revision
+	const auto newId = world.createEntity().addComponent(FirstComponent(2)).getEntityId();
+	world.step(TimeLine::FixedUpdate, 0);
+	check((newId.value & 0xFFFFFFFFll) == (staleId.value & 0xFFFFFFFFll), "new entity reuses the destroyed entity's slot");
+	check(receiver.mainFamily.getIndexOf(staleId) == EntityIndexMap::npos, "stale id is not found in the family");
+
+	sender.targets = { staleId, newId };
+	world.step(TimeLine::FixedUpdate, 0);
+	check(receiver.received.size() == 1, "only one message is delivered");
+	check(!receiver.received.empty() && receiver.received[0] == newId, "message went to the live entity");
+}
+
+void Halley::testEntityParallelSystemException()
+{
+	World world(nullptr, false);
+	world.setParallelSystems(true);
+
+	constexpr int nSystems = 4;
+	std::atomic<int> updates(0);
+	for (int i = 0; i < nSystems; ++i) {
+		world.addSystem(std::make_unique<ThrowingSystem>(updates), TimeLine::FixedUpdate);
+	}
+
+	// Systems that throw on a worker used to leave the world waiting for them forever
+	for (int step = 1; step <= 2; ++step) {
+		bool caught = false;
+		try {
+			world.step(TimeLine::FixedUpdate, 0);
+		} catch (Exception& e) {
+			caught = String(e.what()).contains("Expected failure");
+		}
+		check(caught, "exception thrown by a system reaches the caller of step");
+		check(updates == nSystems * step, "every system in the stage ran before the exception was rethrown");
+	}
+}
@@ -0,0 +1,44 @@
+#include <iostream>
+#include <halley/core/game/halley_statics.h>
+#include "unit_tests.h"
+
+using namespace Halley;
+
+int main(int argc, char** argv)
+{
+	auto tests = getUnitTests();
+
+	if (argc < 2) {
+		std::cout << "Usage: halley-unit-tests [name|all]" << std::endl;
+		std::cout << "Available tests:" << std::endl;
+		for (auto& t: tests) {
+			std::cout << "- " << t.name << ": " << t.description << std::endl;
+		}
+		return 1;
+	}
+
+	HalleyStatics statics;
+	statics.resume(nullptr);
+
+	const String name = argv[1];
+	bool found = false;
+	int failed = 0;
+	for (auto& t: tests) {
+		if (name == "all" || name == t.name) {
+			found = true;
+			try {
+				t.run();
+				std::cout << "[ OK ] " << t.name << std::endl;
+			} catch (std::exception& e) {
+				std::cout << "[FAIL] " << t.name << ": " << e.what() << std::endl;
+				++failed;
+			}
+		}
+	}
+
+	if (!found && name != "all") {
+		std::cout << "Unknown test: " << name << std::endl;
+		return 1;
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,394 @@
+#include "unit_tests.h"
+#include <halley/net/session/network_session.h>
+#include <halley/net/connection/loopback_network_service.h>
+#include <halley/net/session/shared_data_delta.h>
+#include <halley/net/connection/message_queue_udp.h>
+#include <halley/maths/random.h>
+#include <algorithm>
+
+using namespace Halley;
+
+namespace {
+	constexpr int hostPort = 1000;
+
+	class TestSharedData : public SharedData
+	{
+	public:
+		int value = 0;
+
+		void serialize(Serializer& s) const override { s << value; }
+		void deserialize(Deserializer& s) override { s >> value; }
+	};
+
+	class TestSession : public NetworkSessionImpl<TestSharedData, TestSharedData>
+	{
+	public:
+		Vector<int> disconnected;
+
+		TestSession(NetworkService& service) : NetworkSessionImpl(service) {}
+
+		// Everything received since the last call, one byte per packet
+		Vector<int> receiveAll()
+		{
+			Vector<int> result;
+			InboundNetworkPacket packet;
+			while (receive(packet)) {
+				result.push_back(int(packet.getBytes()[0]));
+			}
+			return result;
+		}
+
+	protected:
+		void onDisconnected(int peerId) override
+		{
+			disconnected.push_back(peerId);
+		}
+	};
+
+	struct TestClient
+	{
+		std::unique_ptr<LoopbackNetworkService> service;
+		std::unique_ptr<TestSession> session;
+	};
+
+	OutboundNetworkPacket makePacket(int value)
+	{
+		return OutboundNetworkPacket(Bytes{ Byte(value) });
+	}
+
+	class TestMessage : public NetworkMessage
+	{
+	public:
+		explicit TestMessage(int value) : value(value) {}
+
+		int value;
+
+		void serialize(Serializer& s) const override { s << value; }
+	};
+
+	// Adds a message whose value is its sequence, returning whether it was kept
+	bool addMessage(MessageReorderBuffer& buffer, unsigned short seq)
+	{
+		return buffer.add(seq, std::make_unique<TestMessage>(int(seq)));
+	}
+
+	struct LoopbackRun
+	{
+		Vector<int> received;
+		LoopbackNetworkStats stats;
+	};
+
+	// Sends numbered packets one way over a lossy loopback network on simulated time, recording what arrives and in which order
+	LoopbackRun runLoopback(uint32_t seed)
+	{
+		LoopbackNetworkConditions conditions;
+		conditions.latency = 0.05f;
+		conditions.jitter = 0.04f;
+		conditions.packetLoss = 0.1f;
+		conditions.duplication = 0.1f;
+
+		LoopbackNetwork network(seed);
+		network.setConditions(conditions);
+		network.advanceTime(0);
+
+		LoopbackNetworkService hostService(network, hostPort);
+		LoopbackNetworkService clientService(network);
+		hostService.setAcceptingConnections(true);
+		auto client = clientService.connect("localhost", hostPort);
+		auto host = hostService.tryAcceptConnection();
+		check(host != nullptr, "loopback connection is accepted");
+
+		LoopbackRun result;
+		InboundNetworkPacket packet;
+		for (int i = 0; i < 300; ++i) {
+			if (i < 200) {
+				client->send(OutboundNetworkPacket(Bytes{ Byte(i & 0xFF), Byte(i >> 8) }));
+			}
+			network.advanceTime(0.01f);
+			while (host->receive(packet)) {
+				const auto bytes = packet.getBytes();
+				result.received.push_back(int(bytes[0]) | (int(bytes[1]) << 8));
+			}
+		}
+		result.stats = network.getStats();
+		return result;
+	}
+
+	Vector<int> getReadyMessages(MessageReorderBuffer& buffer)
+	{
+		std::vector<std::unique_ptr<NetworkMessage>> msgs;
+		buffer.getReadyMessages(msgs);
+		Vector<int> result;
+		for (auto& m: msgs) {
+			result.push_back(static_cast<TestMessage&>(*m).value);
+		}
+		return result;
+	}
+
+	// Delivers everything up to and including seq, in order
+	void deliverUpTo(MessageReorderBuffer& buffer, unsigned short seq)
+	{
+		while (buffer.getLastDelivered() != seq) {
+			addMessage(buffer, buffer.getLastDelivered() + 1);
+			getReadyMessages(buffer);
+		}
+	}
+
+	Bytes makeRandomBytes(Random& rng, size_t size)
+	{
+		Bytes result(size);
+		for (auto& b: result) {
+			b = Byte(rng.getInt(0, 255));
+		}
+		return result;
+	}
+
+	gsl::span<const Byte> asSpan(const Bytes& bytes)
+	{
+		return gsl::span<const Byte>(bytes);
+	}
+
+	bool deltaRoundTrips(const Bytes& baseline, const Bytes& current)
+	{
+		const auto delta = SharedDataDelta::encode(asSpan(baseline), asSpan(current));
+		return SharedDataDelta::apply(asSpan(baseline), asSpan(delta)) == current;
+	}
+
+	bool deltaIsRejected(const Bytes& baseline, const Bytes& delta)
+	{
+		try {
+			SharedDataDelta::apply(asSpan(baseline), asSpan(delta));
+			return false;
+		} catch (Exception&) {
+			return true;
+		}
+	}
+}
+
+void Halley::testNetworkSessionPeerIds()
+{
+	LoopbackNetwork network(1);
+	LoopbackNetworkService hostService(network, hostPort);
+	TestSession host(hostService);
+	host.setMaxClients(8);
+	host.host(hostPort);
+
+	Vector<TestClient> clients;
+	auto connect = [&] () -> TestSession&
+	{
+		clients.emplace_back();
+		auto& client = clients.back();
+		client.service = std::make_unique<LoopbackNetworkService>(network);
+		client.session = std::make_unique<TestSession>(*client.service);
+		client.session->join("", hostPort);
+		return *client.session;
+	};
+	auto updateAll = [&] ()
+	{
+		for (int i = 0; i < 4; ++i) {
+			host.update();
+			for (auto& c: clients) {
+				if (c.session) {
+					c.session->update();
+				}
+			}
+		}
+	};
+
+	auto& first = connect();
+	auto& second = connect();
+	auto& third = connect();
+	updateAll();
+	check(first.getMyPeerId() == 1 && second.getMyPeerId() == 2 && third.getMyPeerId() == 3, "clients get peer ids in the order they connect");
+
+	// Connections after the one that left move down, but their peer ids must not
+	clients[0].session.reset();
+	updateAll();
+	check(host.disconnected == Vector<int>{ 1 }, "host is told which peer left");
+
+	host.sendToPeers(makePacket(2), { 2 });
+	host.sendToPeers(makePacket(3), { 3 });
+	updateAll();
+	check(second.receiveAll() == Vector<int>{ 2 }, "traffic for peer 2 only reaches peer 2");
+	check(third.receiveAll() == Vector<int>{ 3 }, "traffic for peer 3 only reaches peer 3");
+
+	// The id of a peer that left can be reused, but never the id of one that's still connected
+	auto& fourth = connect();
+	updateAll();
+	check(fourth.getMyPeerId() == 1, "new client gets the free peer id");
+
+	host.sendToPeers(makePacket(1), { 1 });
+	updateAll();
+	check(fourth.receiveAll() == Vector<int>{ 1 }, "traffic for the reused id reaches the new peer");
+	check(second.receiveAll().empty() && third.receiveAll().empty(), "other peers don't get traffic for the reused id");
+}
+
+void Halley::testSharedDataDeltaRoundTrip()
+{
+	Random rng(1234);
+
+	check(deltaRoundTrips({}, {}), "empty state round trips");
+	check(deltaRoundTrips({}, makeRandomBytes(rng, 100)), "state from nothing round trips");
+	check(deltaRoundTrips(makeRandomBytes(rng, 100), {}), "state shrinking to nothing round trips");
+
+	// An unchanged state is just its size
+	const auto same = makeRandomBytes(rng, 300);
+	const auto emptyDelta = SharedDataDelta::encode(asSpan(same), asSpan(same));
+	check(emptyDelta.size() == 2, "unchanged state encodes to only its size");
+	check(SharedDataDelta::apply(asSpan(same), asSpan(emptyDelta)) == same, "unchanged state round trips");
+
+	for (int i = 0; i < 1000; ++i) {
+		const auto baseline = makeRandomBytes(rng, rng.getSizeT(0, 300));
+		Bytes current;
+		switch (rng.getInt(0, 2)) {
+		case 0:
+			// Unrelated
+			current = makeRandomBytes(rng, rng.getSizeT(0, 300));
+			break;
+		case 1:
+			// A few edits, possibly resized
+			current = baseline;
+			current.resize(rng.getSizeT(0, 300), Byte(rng.getInt(0, 255)));
+			for (size_t n = rng.getSizeT(0, 8); n > 0 && !current.empty(); --n) {
+				current[rng.getRandomIndex(current)] = Byte(rng.getInt(0, 255));
+			}
+			break;
+		case 2:
+			// Edits close together, to exercise merging runs across short gaps
+			current = baseline;
+			if (!current.empty()) {
+				const size_t start = rng.getRandomIndex(current);
+				for (size_t j = start; j < std::min(current.size(), start + 12); j += rng.getSizeT(1, 4)) {
+					current[j] = Byte(current[j] ^ 0xFF);
+				}
+			}
+			break;
+		}
+		check(deltaRoundTrips(baseline, current), "random states round trip");
+	}
+}
+
+void Halley::testSharedDataDeltaInvalid()
+{
+	Random rng(5678);
+	const auto baseline = makeRandomBytes(rng, 16);
+
+	check(deltaIsRejected(baseline, {}), "empty delta is rejected");
+	check(deltaIsRejected(baseline, { Byte(0x80) }), "truncated size is rejected");
+	check(deltaIsRejected(baseline, { Byte(16), Byte(0), Byte(0x80) }), "truncated op is rejected");
+
+	// Every prefix of a delta for a grown state is missing something
+	auto grown = baseline;
+	grown.push_back(1);
+	grown.push_back(2);
+	grown[3] = Byte(grown[3] ^ 0xFF);
+	const auto delta = SharedDataDelta::encode(asSpan(baseline), asSpan(grown));
+	for (size_t len = 0; len < delta.size(); ++len) {
+		check(deltaIsRejected(baseline, Bytes(delta.begin(), delta.begin() + len)), "truncated delta is rejected");
+	}
+
+	// Sizes that the delta can't possibly fill
+	check(deltaIsRejected(baseline, { Byte(17) }), "growth without data is rejected");
+	check(deltaIsRejected(baseline, { Byte(0x80), Byte(0x80), Byte(0x80), Byte(0x80), Byte(0x0F) }), "huge size is rejected");
+	check(deltaIsRejected(baseline, { Byte(16), Byte(10), Byte(7), Byte(0), Byte(0), Byte(0), Byte(0), Byte(0), Byte(0), Byte(0) }), "op past the end is rejected");
+	check(deltaIsRejected(baseline, { Byte(16), Byte(0), Byte(4), Byte(0), Byte(0) }), "op with missing data is rejected");
+
+	// Varints that don't fit, or that would wrap the bounds checks around
+	Bytes overflow(10, Byte(0xFF));
+	overflow.push_back(Byte(0x01));
+	check(deltaIsRejected(baseline, overflow), "overlong varint is rejected");
+	Bytes highBits(9, Byte(0x80));
+	highBits.push_back(Byte(0x7E));
+	check(deltaIsRejected(baseline, highBits), "varint with bits past 64 is rejected");
+
+	Bytes hugeKeep = { Byte(16) };
+	hugeKeep.insert(hugeKeep.end(), 9, Byte(0xFF));
+	hugeKeep.push_back(Byte(0x01));
+	hugeKeep.push_back(Byte(2));
+	hugeKeep.push_back(Byte(0));
+	hugeKeep.push_back(Byte(0));
+	check(deltaIsRejected(baseline, hugeKeep), "keep that would wrap around is rejected");
+
+	Bytes hugeReplace = { Byte(16), Byte(4) };
+	hugeReplace.insert(hugeReplace.end(), 9, Byte(0xFF));
+	hugeReplace.push_back(Byte(0x01));
+	check(deltaIsRejected(baseline, hugeReplace), "replace that would wrap around is rejected");
+}
+
+void Halley::testMessageReorderBuffer()
+{
+	{
+		MessageReorderBuffer buffer;
+		check(addMessage(buffer, 3) && addMessage(buffer, 2), "messages ahead of the next one are kept");
+		check(getReadyMessages(buffer).empty(), "nothing is delivered while the next message is missing");
+		check(addMessage(buffer, 1), "next message is kept");
+		check(getReadyMessages(buffer) == Vector<int>{ 1, 2, 3 }, "messages are delivered in sequence order");
+	}
+
+	{
+		MessageReorderBuffer buffer;
+		addMessage(buffer, 1);
+		check(addMessage(buffer, 2), "first copy of a message is kept");
+		check(!addMessage(buffer, 2), "duplicate of a buffered message is dropped");
+		check(getReadyMessages(buffer) == Vector<int>{ 1, 2 }, "duplicates are delivered once");
+		check(!addMessage(buffer, 2) && !addMessage(buffer, 1), "duplicate of a delivered message is dropped");
+		check(getReadyMessages(buffer).empty(), "duplicates of delivered messages are not delivered again");
+	}
+
+	{
+		// Sequences wrap around at 16 bits
+		MessageReorderBuffer buffer;
+		deliverUpTo(buffer, 65530);
+		for (int seq = 65536 + 2; seq > 65530; --seq) {
+			addMessage(buffer, static_cast<unsigned short>(seq));
+		}
+		check(getReadyMessages(buffer) == Vector<int>{ 65531, 65532, 65533, 65534, 65535, 0, 1, 2 }, "messages are delivered in order across the wraparound");
+		check(buffer.getLastDelivered() == 2, "delivery carries on after the wraparound");
+	}
+
+	{
+		// The buffer grows to cover anything up to half the sequence space ahead, across the wraparound
+		MessageReorderBuffer buffer;
+		deliverUpTo(buffer, 60000);
+		const unsigned short last = buffer.getLastDelivered();
+		check(addMessage(buffer, last + 0x7FFF), "message at the far end of the window is kept");
+		check(buffer.getCapacity() == 0x8000, "buffer grows to cover the whole window");
+		for (int i = 0x7FFE; i >= 1; --i) {
+			check(addMessage(buffer, static_cast<unsigned short>(last + i)), "messages within the window are kept");
+		}
+		const auto ready = getReadyMessages(buffer);
+		check(ready.size() == 0x7FFF, "every message in the window is delivered");
+		bool inOrder = true;
+		for (size_t i = 0; i < ready.size(); ++i) {
+			inOrder = inOrder && ready[i] == static_cast<unsigned short>(last + 1 + i);
+		}
+		check(inOrder, "messages in a grown buffer are delivered in order");
+	}
+
+	{
+		MessageReorderBuffer buffer;
+		deliverUpTo(buffer, 100);
+		const size_t capacity = buffer.getCapacity();
+		check(!addMessage(buffer, 100 + 0x8000), "message half the sequence space ahead is dropped");
+		check(!addMessage(buffer, 99) && !addMessage(buffer, 100 - 0x7FFF), "messages behind the last one delivered are dropped");
+		check(buffer.getCapacity() == capacity, "messages outside the window don't grow the buffer");
+		check(addMessage(buffer, 101) && getReadyMessages(buffer) == Vector<int>{ 101 }, "messages in the window are still delivered");
+	}
+}
+
+void Halley::testLoopbackNetworkDeterministic()
+{
+	const auto a = runLoopback(1234);
+	const auto b = runLoopback(1234);
+
+	check(a.stats.packetsSent == 200, "every packet is sent");
+	check(a.stats.packetsDropped > 0 && a.stats.packetsDuplicated > 0, "packets are lost and duplicated");
+	check(a.received.size() == 200 - a.stats.packetsDropped + a.stats.packetsDuplicated, "every packet that isn't lost arrives");
+	check(!std::is_sorted(a.received.begin(), a.received.end()), "jitter reorders packets");
+
+	check(a.received == b.received, "same seed delivers the same packets in the same order");
+	check(a.stats.packetsDropped == b.stats.packetsDropped && a.stats.packetsDuplicated == b.stats.packetsDuplicated, "same seed loses and duplicates the same packets");
+
+	const auto c = runLoopback(4321);
+	check(a.received != c.received, "different seed gives a different run");
+}
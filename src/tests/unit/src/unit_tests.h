@@ -0,0 +1,62 @@
+#pragma once
+
+#include <functional>
+#include <halley/data_structures/vector.h>
+#include <halley/text/halleystring.h>
+#include <halley/support/exception.h>
+
+namespace Halley {
+	struct UnitTest
+	{
+		String name;
+		String description;
+		std::function<void()> run;
+	};
+
+	// Throws, so the runner can report the failure and carry on with the other tests
+	inline void check(bool condition, const String& what)
+	{
+		if (!condition) {
+			throw Exception("Check failed: " + what, HalleyExceptions::Utils);
+		}
+	}
+
+	void testForeachException();
+	void testEntityRemoveComponents();
+	void testEntityStaleMessageTarget();
+	void testEntitySnapshotRestore();
+	void testEntityParallelSystemException();
+	void testAudioStreamingEmitters();
+	void testAudioStreamingEmittersParallel();
+	void testAudioStreamingClipPrimedStreamers();
+	void testAudioCompressedClipPrefetch();
+	void testAudioEngineParallelMix();
+	void testNetworkSessionPeerIds();
+	void testSharedDataDeltaRoundTrip();
+	void testSharedDataDeltaInvalid();
+	void testMessageReorderBuffer();
+	void testLoopbackNetworkDeterministic();
+	void testDistanceFieldMatchesReference();
+
+	inline Vector<UnitTest> getUnitTests()
+	{
+		return {
+			{ "foreach_exception", "Exceptions thrown from Concurrent::foreach are rethrown on the calling thread", &testForeachException },
+			{ "entity_remove_components", "Removing several components from an entity in the same frame", &testEntityRemoveComponents },
+			{ "entity_stale_message_target", "Messages sent to a destroyed entity are not delivered to the one reusing its slot", &testEntityStaleMessageTarget },
+			{ "entity_snapshot_restore", "Restoring a world snapshot brings back the same entity ids and component values", &testEntitySnapshotRestore },
+			{ "entity_parallel_system_exception", "Exceptions thrown by systems updated in parallel are rethrown by World::step", &testEntityParallelSystemException },
+			{ "audio_streaming_emitters", "Emitters playing the same streaming clip at different positions", &testAudioStreamingEmitters },
+			{ "audio_streaming_emitters_parallel", "Emitters playing the same streaming clip, mixed on different threads", &testAudioStreamingEmittersParallel },
+			{ "audio_streaming_clip_primed_streamers", "Streaming clips hand out primed streamers, and prime another for the next playback", &testAudioStreamingClipPrimedStreamers },
+			{ "audio_compressed_clip_prefetch", "Compressed clips are decoded ahead of playback, off the mixing thread", &testAudioCompressedClipPrefetch },
+			{ "audio_engine_parallel_mix", "Mixing emitters on the mix workers gives the same output as mixing them on the audio thread", &testAudioEngineParallelMix },
+			{ "network_session_peer_ids", "Traffic for a peer keeps reaching it after other peers disconnect", &testNetworkSessionPeerIds },
+			{ "shared_data_delta_round_trip", "Shared data deltas reproduce the new state from the baseline", &testSharedDataDeltaRoundTrip },
+			{ "shared_data_delta_invalid", "Malformed shared data deltas are rejected", &testSharedDataDeltaInvalid },
+			{ "message_reorder_buffer", "Reliable ordered messages are delivered once and in order, whatever order they arrive in", &testMessageReorderBuffer },
+			{ "loopback_network_deterministic", "Loopback network loss, duplication and ordering are reproducible for a given seed", &testLoopbackNetworkDeterministic },
+			{ "distance_field_reference", "Distance fields match the brute-force search they replaced", &testDistanceFieldMatchesReference }
+		};
+	}
+}
@@ -94,6 +94,9 @@ namespace Halley
 		virtual void import(const ImportingAsset&, IAssetCollector&) {}
 		virtual int dropFrontCount() const { return 1; }
 
+		// Bump this whenever the output changes for the same input, so previous imports (including cached ones) are discarded
+		virtual int getVersion() const { return 0; }
+
 		virtual String getAssetId(const Path& file, const Maybe<Metadata>& metadata) const
 		{
 			return file.dropFront(dropFrontCount()).string();
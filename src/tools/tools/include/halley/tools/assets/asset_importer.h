@@ -16,8 +16,12 @@ namespace Halley
 		std::vector<std::reference_wrapper<IAssetImporter>> getImporters(ImportAssetType type) const;
 		const std::vector<Path>& getAssetsSrc() const;
 
+		// Identifies the set of importers (including plugins) that run for this type, and their versions
+		uint64_t getImporterVersion(ImportAssetType type) const;
+
 	private:
 		std::map<ImportAssetType, std::vector<std::unique_ptr<IAssetImporter>>> importers;
+		std::map<ImportAssetType, uint64_t> importerVersions;
 		std::vector<Path> assetsSrc;
 	};
 }
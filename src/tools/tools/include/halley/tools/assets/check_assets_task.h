@@ -24,7 +24,7 @@ namespace Halley
 		DirectoryMonitor monitorGenSrc;
 		bool oneShot;
 
-		static std::vector<ImportAssetsDatabaseEntry> filterNeedsImporting(ImportAssetsDatabase& db, const std::map<String, ImportAssetsDatabaseEntry>& assets);
+		static std::vector<ImportAssetsDatabaseEntry> filterNeedsImporting(ImportAssetsDatabase& db, const AssetImporter& importer, const std::map<String, ImportAssetsDatabaseEntry>& assets);
 		void checkAllAssets(ImportAssetsDatabase& db, std::vector<Path> srcPaths, Path dstPath, String taskName, bool packAfter);
 		Maybe<Path> findDirectoryMeta(const std::vector<Path>& metas, const Path& path) const;
 		bool importFile(ImportAssetsDatabase& db, std::map<String, ImportAssetsDatabaseEntry>& assets, const bool isCodegen, const std::vector<Path>& directoryMetas, const Path& srcPath, const Path& filePath);
@@ -0,0 +1,61 @@
+#pragma once
+#include "halley/file/path.h"
+#include "halley/text/halleystring.h"
+#include "halley/data_structures/maybe.h"
+#include "halley/plugin/iasset_importer.h"
+#include <map>
+#include <vector>
+#include <cstdint>
+
+namespace Halley
+{
+	class Serializer;
+	class Deserializer;
+
+	class ImportAssetsCacheEntry
+	{
+	public:
+		std::map<ImportAssetType, uint64_t> importerVersions;
+		std::vector<std::pair<Path, uint64_t>> additionalInputs; // As requested from IAssetCollector::readAdditionalFile, with the hash of their contents
+		std::vector<AssetResource> outputs;
+		std::vector<std::pair<Path, Bytes>> outFiles;
+
+		void serialize(Serializer& s) const;
+		void deserialize(Deserializer& s);
+	};
+
+	// Results of previous imports, keyed by a hash of everything that went into them (see ImportAssetsDatabase::getInputHash()),
+	// including the build of the program that imported them (see getBuildId()).
+	// The directory is meant to be shared by every checkout on the machine, so nothing in here may depend on where a project lives.
+	// Safe to use from multiple threads and processes: entries are written to a temporary file and moved into place.
+	class ImportAssetsCache
+	{
+	public:
+		constexpr static uint64_t defaultMaxSize = 4ull * 1024 * 1024 * 1024;
+
+		// An empty directory disables the cache
+		explicit ImportAssetsCache(Path directory, uint64_t maxSize = defaultMaxSize);
+
+		// HALLEY_IMPORT_CACHE if set (empty to disable), otherwise under the user data directory
+		static Path getDefaultDirectory();
+
+		// Hash of the running program's binary. Importers don't get a new version every time their code changes,
+		// so this keeps entries made by other builds (older engines, other checkouts) from being used.
+		static uint64_t getBuildId();
+
+		bool isEnabled() const;
+		const Path& getDirectory() const;
+
+		Maybe<ImportAssetsCacheEntry> get(uint64_t key) const;
+		void put(uint64_t key, const ImportAssetsCacheEntry& entry) const;
+
+		// Removes the least recently used entries if the cache has grown past its maximum size
+		void trim() const;
+
+	private:
+		Path directory;
+		uint64_t maxSize;
+
+		Path getEntryPath(uint64_t key) const;
+	};
+}
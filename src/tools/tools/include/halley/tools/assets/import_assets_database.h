@@ -22,6 +22,8 @@ namespace Halley
 		std::vector<TimestampedPath> additionalInputFiles; // These were requested by the importer, rather than enumerated directly
 		std::vector<AssetResource> outputFiles;
 		ImportAssetType assetType = ImportAssetType::Undefined;
+		uint64_t inputHash = 0; // See ImportAssetsDatabase::getInputHash()
+		std::map<ImportAssetType, uint64_t> importerVersions; // Every importer that ran, including for additional assets
 
 		ImportAssetsDatabaseEntry() {}
 
@@ -61,6 +63,7 @@ namespace Halley
 		{
 		public:
 			std::array<int64_t, 3> timestamp;
+			uint64_t hash = 0; // Contents of the file itself, only recalculated when a timestamp changes
 			Metadata metadata;
 
 			void serialize(Serializer& s) const;
@@ -70,15 +73,21 @@ namespace Halley
 	public:
 		ImportAssetsDatabase(Path directory, Path dbFile, Path assetsDbFile, std::vector<String> platforms);
 
+		// Bumped to force everything to be imported again
+		static int getAssetVersion();
+
 		void load();
 		void save() const;
 		std::unique_ptr<AssetDatabase> makeAssetDatabase(const String& platform) const;
 
 		bool needToLoadInputMetadata(const Path& path, std::array<int64_t, 3> timestamps) const;
-		void setInputFileMetadata(const Path& path, std::array<int64_t, 3> timestamps, const Metadata& data);
+		void setInputFileMetadata(const Path& path, std::array<int64_t, 3> timestamps, const Metadata& data, uint64_t hash);
 		Maybe<Metadata> getMetadata(const Path& path) const;
 
-		bool needsImporting(const ImportAssetsDatabaseEntry& asset) const;
+		// Hash of the asset's id, type, and the path, contents and metadata of each input file; independent of timestamps and of where the source lives
+		uint64_t getInputHash(const ImportAssetsDatabaseEntry& asset) const;
+
+		bool needsImporting(const ImportAssetsDatabaseEntry& asset, const AssetImporter& importer) const;
 		void markAsImported(const ImportAssetsDatabaseEntry& asset);
 		void markDeleted(const ImportAssetsDatabaseEntry& asset);
 		void markFailed(const ImportAssetsDatabaseEntry& asset);
@@ -2,22 +2,61 @@
 #include "halley/tools/tasks/editor_task.h"
 #include "halley/file/path.h"
 #include "import_assets_database.h"
+#include "import_assets_cache.h"
 #include <vector>
 #include <set>
+#include <memory>
+#include <condition_variable>
 
 namespace Halley
 {
 	class Project;
+	class ImportAssetsWriter;
 	
 	class ImportAssetsTask : public EditorTask
 	{
 	public:
 		ImportAssetsTask(String taskName, ImportAssetsDatabase& db, const AssetImporter& importer, Path assetsPath, Vector<ImportAssetsDatabaseEntry> files, std::vector<String> deletedAssets, Project& project, bool packAfter);
+		~ImportAssetsTask();
 
 	protected:
 		void run() override;
 
 	private:
+		// Everything produced so far for one of the files being imported, across all of its nodes
+		struct AssetState
+		{
+			ImportAssetsDatabaseEntry& asset;
+			uint64_t inputSize = 0;
+			bool useCache = false;
+			bool fromCache = false;
+			uint64_t cacheKey = 0;
+			std::atomic<int> pendingNodes{ 1 };
+
+			std::mutex mutex;
+			bool failed = false;
+			String error;
+			std::vector<AssetResource> out;
+			std::vector<std::pair<Path, Bytes>> outFiles;
+			std::vector<TimestampedPath> additionalInputs;
+			std::vector<std::pair<Path, uint64_t>> additionalInputHashes;
+			std::map<ImportAssetType, uint64_t> importerVersions;
+
+			explicit AssetState(ImportAssetsDatabaseEntry& asset) : asset(asset) {}
+		};
+
+		// One run of the importers; the root reads the input files, and each additional asset it generates becomes a node of its own
+		struct ImportNode
+		{
+			AssetState* state = nullptr;
+			ImportingAsset asset;
+			bool isRoot = false;
+			int depth = 0;
+			uint64_t order = 0;
+
+			bool operator<(const ImportNode& other) const;
+		};
+
 		ImportAssetsDatabase& db;
 		const AssetImporter& importer;
 		Path assetsPath;
@@ -30,15 +69,29 @@ namespace Halley
 		
 		std::atomic<int64_t> totalImportTime;
 		std::atomic<size_t> assetsImported{};
+		std::atomic<size_t> assetsFromCache{};
 		size_t assetsToImport{};
 
 		std::mutex mutex;
 		
 		std::string curFileLabel;
 
-		bool importAsset(ImportAssetsDatabaseEntry& asset);
+		bool parallelImport = false;
+		std::vector<std::unique_ptr<AssetState>> assetStates;
+		std::vector<std::unique_ptr<ImportNode>> readyNodes; // Heap, see ImportNode::operator<
+		uint64_t nextNodeOrder = 0;
+		std::atomic<size_t> nodesPending{};
+		std::mutex nodesMutex;
+		std::condition_variable nodesDone;
+		std::unique_ptr<ImportAssetsWriter> writer;
+
+		void scheduleNode(std::unique_ptr<ImportNode> node);
+		bool runNextNode();
+		void runNode(ImportNode& node);
+		void finishNode(AssetState& state);
+		void finishAsset(AssetState& state);
 
-		std::vector<Path> loadFont(const ImportAssetsDatabaseEntry& asset, Path dstDir);
-		std::vector<Path> genericImporter(const ImportAssetsDatabaseEntry& asset, Path dstDir);
+		uint64_t getCacheKey(const ImportAssetsDatabaseEntry& asset) const;
+		Maybe<ImportAssetsCacheEntry> getCachedImport(uint64_t key, std::vector<TimestampedPath>& additionalInputs) const;
 	};
 }
@@ -20,5 +20,6 @@ namespace Halley
 		String name;
 		Vector<VariableSchema> members;
 		std::unordered_set<String> includeFiles;
+		bool serializable = false;
 	};
 }
\ No newline at end of file
@@ -80,6 +80,10 @@ namespace Halley
 		CodegenLanguage language = CodegenLanguage::CPlusPlus;
 		int smearing = 0;
 
+		// "strictAccess: true": components tagged read are const in the family type, so only the ones tagged write count as written when
+		// scheduling systems in parallel. Without it, a system is assumed to write every component in its families.
+		bool strictAccess = false;
+
 		std::unordered_set<String> includeFiles;
 
 		Vector<FamilySchema> families;
@@ -11,5 +11,8 @@ namespace Halley
 	{
 	public:
 		static std::unique_ptr<Image> generate(Image& src, Vector2i size, float radius);
+
+		// Searches around every source pixel, as generate() used to. Much slower, but simple enough to check generate() against.
+		static std::unique_ptr<Image> generateReference(Image& src, Vector2i size, float radius);
 	};
 }
@@ -18,11 +18,13 @@ namespace Halley {
 		static bool createParentDir(const Path& p);
 
 		static int64_t getLastWriteTime(const Path& p);
+		static bool setLastWriteTime(const Path& p, int64_t time);
 		static bool isFile(const Path& p);
 		static bool isDirectory(const Path& p);
 
 		static void copyFile(const Path& src, const Path& dst);
 		static bool remove(const Path& path);
+		static bool rename(const Path& src, const Path& dst); // Replaces dst if it exists
 
 		static void writeFile(const Path& path, gsl::span<const gsl::byte> data);
 		static void writeFile(const Path& path, const Bytes& data);
@@ -8,6 +8,7 @@
 namespace Halley
 {
 	class ImportAssetsDatabase;
+	class ImportAssetsCache;
 
 	class HalleyStatics;
 	class IHalleyPlugin;
@@ -36,6 +37,7 @@ namespace Halley
 
 		ImportAssetsDatabase& getImportAssetsDatabase() const;
 		ImportAssetsDatabase& getCodegenDatabase() const;
+		const ImportAssetsCache& getImportAssetsCache() const;
 
 		const AssetImporter& getAssetImporter() const;
 		std::vector<std::unique_ptr<IAssetImporter>> getAssetImportersFromPlugins(ImportAssetType type) const;
@@ -52,6 +54,7 @@ namespace Halley
 
 		std::unique_ptr<ImportAssetsDatabase> importAssetsDatabase;
 		std::unique_ptr<ImportAssetsDatabase> codegenDatabase;
+		std::unique_ptr<ImportAssetsCache> importAssetsCache;
 		std::unique_ptr<AssetImporter> assetImporter;
 
 		std::vector<HalleyPluginPtr> plugins;
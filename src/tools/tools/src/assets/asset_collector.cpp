@@ -4,6 +4,7 @@
 #include "halley/resources/metadata.h"
 #include "halley/support/logger.h"
 #include "halley/bytes/compression.h"
+#include "halley/utils/hash.h"
 
 using namespace Halley;
 
@@ -72,7 +73,9 @@ Bytes AssetCollector::readAdditionalFile(const Path& filePath)
 		Path f = path / filePath;
 		if (FileSystem::exists(f)) {
 			additionalInputs.push_back(TimestampedPath(f, FileSystem::getLastWriteTime(f)));
-			return FileSystem::readFile(f);
+			auto data = FileSystem::readFile(f);
+			additionalInputHashes.emplace_back(filePath, Hash::hash(data));
+			return data;
 		}
 	}
 	throw Exception("Unable to find asset dependency: \"" + filePath.getString() + "\"", HalleyExceptions::Tools);
@@ -97,3 +100,8 @@ const std::vector<TimestampedPath>& AssetCollector::getAdditionalInputs() const
 {
 	return additionalInputs;
 }
+
+const std::vector<std::pair<Path, uint64_t>>& AssetCollector::getAdditionalInputHashes() const
+{
+	return additionalInputHashes;
+}
@@ -17,6 +17,9 @@
 #include "halley/tools/project/project.h"
 #include <boost/variant/detail/substitute.hpp>
 #include "importers/texture_importer.h"
+#include "halley/utils/hash.h"
+#include <typeinfo>
+#include <cstring>
 
 using namespace Halley;
 
@@ -49,6 +52,16 @@ AssetImporter::AssetImporter(Project& project, const std::vector<Path>& assetsSr
 			importerSet.emplace_back(std::move(pluginImporter));
 		}
 	}
+
+	for (auto& i: importers) {
+		Hash::Hasher hasher;
+		for (auto& importer: i.second) {
+			const char* name = typeid(*importer).name();
+			hasher.feedBytes(gsl::as_bytes(gsl::span<const char>(name, std::strlen(name))));
+			hasher.feed(importer->getVersion());
+		}
+		importerVersions[i.first] = hasher.digest();
+	}
 }
 
 IAssetImporter& AssetImporter::getRootImporter(Path path) const
@@ -102,3 +115,13 @@ const std::vector<Path>& AssetImporter::getAssetsSrc() const
 {
 	return assetsSrc;
 }
+
+uint64_t AssetImporter::getImporterVersion(ImportAssetType type) const
+{
+	auto i = importerVersions.find(type);
+	if (i != importerVersions.end()) {
+		return i->second;
+	}
+
+	throw Exception("Unknown asset type: " + toString(int(type)), HalleyExceptions::Tools);
+}
@@ -10,6 +10,7 @@
 #include "halley/support/logger.h"
 #include "../yaml/halley-yamlcpp.h"
 #include "halley/resources/resource_data.h"
+#include "halley/utils/hash.h"
 
 using namespace Halley;
 using namespace std::chrono_literals;
@@ -129,10 +130,10 @@ bool CheckAssetsTask::importFile(ImportAssetsDatabase& db, std::map<String, Impo
 		privateMetaPath = {};
 	}
 
-	// Load metadata if needed
+	// Load metadata and hash contents if needed
 	if (db.needToLoadInputMetadata(filePath, timestamps)) {
 		Metadata meta = getMetaData(filePath, dirMetaPath, privateMetaPath);
-		db.setInputFileMetadata(filePath, timestamps, meta);
+		db.setInputFileMetadata(filePath, timestamps, meta, Hash::hash(FileSystem::readFile(srcPath / filePath)));
 		dbChanged = true;
 	}
 
@@ -205,6 +206,10 @@ void CheckAssetsTask::checkAllAssets(ImportAssetsDatabase& db, std::vector<Path>
 		db.save();
 	}
 
+	for (auto& a: assets) {
+		a.second.inputHash = db.getInputHash(a.second);
+	}
+
 	// Check for missing input files
 	db.markAssetsAsStillPresent(assets);
 	auto toDelete = db.getAllMissing();
@@ -221,19 +226,19 @@ void CheckAssetsTask::checkAllAssets(ImportAssetsDatabase& db, std::vector<Path>
 	}
 
 	// Import assets
-	auto toImport = filterNeedsImporting(db, assets);
+	auto toImport = filterNeedsImporting(db, project.getAssetImporter(), assets);
 	if (!toImport.empty() || !deletedAssets.empty()) {
 		Logger::logInfo("Assets to be imported: " + toString(toImport.size()));
 		addPendingTask(EditorTaskAnchor(std::make_unique<ImportAssetsTask>(taskName, db, project.getAssetImporter(), dstPath, std::move(toImport), std::move(deletedAssets), project, packAfter)));
 	}
 }
 
-std::vector<ImportAssetsDatabaseEntry> CheckAssetsTask::filterNeedsImporting(ImportAssetsDatabase& db, const std::map<String, ImportAssetsDatabaseEntry>& assets)
+std::vector<ImportAssetsDatabaseEntry> CheckAssetsTask::filterNeedsImporting(ImportAssetsDatabase& db, const AssetImporter& importer, const std::map<String, ImportAssetsDatabaseEntry>& assets)
 {
 	Vector<ImportAssetsDatabaseEntry> toImport;
 
 	for (auto& a: assets) {
-		if (db.needsImporting(a.second)) {
+		if (db.needsImporting(a.second, importer)) {
 			toImport.push_back(a.second);
 		}
 	}
@@ -0,0 +1,201 @@
+#include "halley/tools/assets/import_assets_cache.h"
+#include "halley/tools/file/filesystem.h"
+#include "halley/bytes/byte_serializer.h"
+#include "halley/os/os.h"
+#include "halley/support/logger.h"
+#include "halley/utils/hash.h"
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <random>
+#include <algorithm>
+
+using namespace Halley;
+
+constexpr static int currentCacheVersion = 1;
+
+void ImportAssetsCacheEntry::serialize(Serializer& s) const
+{
+	s << importerVersions;
+	s << additionalInputs;
+	s << outputs;
+	s << outFiles;
+}
+
+void ImportAssetsCacheEntry::deserialize(Deserializer& s)
+{
+	s >> importerVersions;
+	s >> additionalInputs;
+	s >> outputs;
+	s >> outFiles;
+}
+
+ImportAssetsCache::ImportAssetsCache(Path directory, uint64_t maxSize)
+	: directory(std::move(directory))
+	, maxSize(maxSize)
+{}
+
+Path ImportAssetsCache::getDefaultDirectory()
+{
+	const char* env = std::getenv("HALLEY_IMPORT_CACHE");
+	if (env) {
+		return Path(String(env));
+	}
+
+	const auto userDataDir = OS::get().getUserDataDir();
+	if (userDataDir.isEmpty()) {
+		return Path();
+	}
+	return Path(userDataDir) / "halley" / "import_cache";
+}
+
+uint64_t ImportAssetsCache::getBuildId()
+{
+	static const uint64_t buildId = [] () -> uint64_t
+	{
+		const auto exe = OS::get().getExecutablePath();
+		const auto data = exe.getString().isEmpty() ? Bytes() : FileSystem::readFile(exe);
+		if (data.empty()) {
+			Logger::logWarning("Unable to read the running program, import cache entries made by other builds might be used");
+			return 0;
+		}
+		return Hash::hash(data);
+	}();
+	return buildId;
+}
+
+bool ImportAssetsCache::isEnabled() const
+{
+	return !directory.getString().isEmpty();
+}
+
+const Path& ImportAssetsCache::getDirectory() const
+{
+	return directory;
+}
+
+Maybe<ImportAssetsCacheEntry> ImportAssetsCache::get(uint64_t key) const
+{
+	if (!isEnabled()) {
+		return {};
+	}
+
+	const auto path = getEntryPath(key);
+	auto data = FileSystem::readFile(path);
+	if (data.empty()) {
+		return {};
+	}
+
+	try {
+		auto s = Deserializer(data);
+		int version;
+		uint64_t storedKey;
+		s >> version;
+		s >> storedKey;
+		if (version != currentCacheVersion || storedKey != key) {
+			return {};
+		}
+
+		ImportAssetsCacheEntry entry;
+		s >> entry;
+
+		// The modification time is what trim() goes by, so entries that keep being used are kept
+		FileSystem::setLastWriteTime(path, int64_t(std::time(nullptr)));
+		return entry;
+	} catch (std::exception& e) {
+		// Written by something else, or truncated; it'll be overwritten once this is imported again
+		Logger::logWarning("Ignoring invalid import cache entry " + path + ": " + e.what());
+		return {};
+	}
+}
+
+void ImportAssetsCache::put(uint64_t key, const ImportAssetsCacheEntry& entry) const
+{
+	if (!isEnabled()) {
+		return;
+	}
+
+	const int version = currentCacheVersion;
+	const auto data = Serializer::toBytes([&] (Serializer& s)
+	{
+		s << version;
+		s << key;
+		s << entry;
+	});
+
+	// Other threads or checkouts might be reading or writing the same entry, so never let them see a partial file
+	std::random_device rng;
+	char suffix[24];
+	snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", rng(), rng());
+	const auto dst = getEntryPath(key);
+	const auto tmp = dst.replaceExtension(String(suffix));
+	try {
+		FileSystem::writeFile(tmp, data);
+	} catch (std::exception& e) {
+		// Not being able to cache an import isn't an error in the import itself
+		Logger::logWarning("Unable to write import cache entry: " + String(e.what()));
+		FileSystem::remove(tmp);
+		return;
+	}
+	if (!FileSystem::rename(tmp, dst)) {
+		FileSystem::remove(tmp);
+	}
+}
+
+void ImportAssetsCache::trim() const
+{
+	if (!isEnabled()) {
+		return;
+	}
+
+	struct CachedFile
+	{
+		Path path;
+		int64_t lastUsed;
+		uint64_t size;
+	};
+	std::vector<CachedFile> files;
+	uint64_t totalSize = 0;
+
+	try {
+		for (auto& f: FileSystem::enumerateDirectory(directory)) {
+			const auto path = directory / f;
+			const uint64_t size = FileSystem::fileSize(path);
+			files.push_back(CachedFile{ path, FileSystem::getLastWriteTime(path), size });
+			totalSize += size;
+		}
+	} catch (std::exception& e) {
+		// Another process is probably trimming it at the same time
+		Logger::logWarning("Unable to trim import cache: " + String(e.what()));
+		return;
+	}
+
+	if (totalSize <= maxSize) {
+		return;
+	}
+
+	// Go well below the limit, so this doesn't have to happen again on every import
+	const uint64_t targetSize = maxSize / 4 * 3;
+	std::sort(files.begin(), files.end(), [] (const CachedFile& a, const CachedFile& b) { return a.lastUsed < b.lastUsed; });
+
+	size_t nRemoved = 0;
+	for (auto& f: files) {
+		if (totalSize <= targetSize) {
+			break;
+		}
+		if (FileSystem::remove(f.path)) {
+			totalSize -= f.size;
+			++nRemoved;
+		}
+	}
+	Logger::logInfo("Removed " + toString(nRemoved) + " least recently used entries from the import cache, " + String::prettySize(totalSize) + " left");
+}
+
+Path ImportAssetsCache::getEntryPath(uint64_t key) const
+{
+	char name[24];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+
+	// Spread over subdirectories, so none of them gets too large
+	return directory / String(name, 2) / (String(name) + ".dat");
+}
@@ -2,8 +2,10 @@
 #include "halley/bytes/byte_serializer.h"
 #include "halley/resources/resource_data.h"
 #include "halley/tools/file/filesystem.h"
+#include "halley/utils/hash.h"
+#include <algorithm>
 
-constexpr static int currentAssetVersion = 53;
+constexpr static int currentAssetVersion = 54;
 
 using namespace Halley;
 
@@ -16,6 +18,8 @@ void ImportAssetsDatabaseEntry::serialize(Serializer& s) const
 	s << outputFiles;
 	int t = int(assetType);
 	s << t;
+	s << inputHash;
+	s << importerVersions;
 }
 
 void ImportAssetsDatabaseEntry::deserialize(Deserializer& s)
@@ -28,6 +32,8 @@ void ImportAssetsDatabaseEntry::deserialize(Deserializer& s)
 	int t;
 	s >> t;
 	assetType = ImportAssetType(t);
+	s >> inputHash;
+	s >> importerVersions;
 }
 
 void ImportAssetsDatabase::AssetEntry::serialize(Serializer& s) const
@@ -47,6 +53,7 @@ void ImportAssetsDatabase::InputFileEntry::serialize(Serializer& s) const
 	for (int i = 0; i < nTimestamps; ++i) {
 		s << timestamp[i];
 	}
+	s << hash;
 	s << metadata;
 }
 
@@ -62,6 +69,7 @@ void ImportAssetsDatabase::InputFileEntry::deserialize(Deserializer& s)
 	for (int i = nTimestamps; i < int(timestamp.size()); ++i) {
 		timestamp[i] = 0;
 	}
+	s >> hash;
 	s >> metadata;
 }
 
@@ -74,6 +82,11 @@ ImportAssetsDatabase::ImportAssetsDatabase(Path directory, Path dbFile, Path ass
 	load();
 }
 
+int ImportAssetsDatabase::getAssetVersion()
+{
+	return currentAssetVersion;
+}
+
 void ImportAssetsDatabase::load()
 {
 	std::lock_guard<std::mutex> lock(mutex);
@@ -116,13 +129,14 @@ bool ImportAssetsDatabase::needToLoadInputMetadata(const Path& path, std::array<
 	return false;
 }
 
-void ImportAssetsDatabase::setInputFileMetadata(const Path& path, std::array<int64_t, 3> timestamps, const Metadata& data)
+void ImportAssetsDatabase::setInputFileMetadata(const Path& path, std::array<int64_t, 3> timestamps, const Metadata& data, uint64_t hash)
 {
 	std::lock_guard<std::mutex> lock(mutex);
 
 	auto pathStr = path.toString();
 	auto& input = inputFiles[pathStr];
 	input.timestamp = timestamps;
+	input.hash = hash;
 	input.metadata = data;
 }
 
@@ -139,7 +153,33 @@ Maybe<Metadata> ImportAssetsDatabase::getMetadata(const Path& path) const
 	}
 }
 
-bool ImportAssetsDatabase::needsImporting(const ImportAssetsDatabaseEntry& asset) const
+uint64_t ImportAssetsDatabase::getInputHash(const ImportAssetsDatabaseEntry& asset) const
+{
+	// Sort the inputs, as enumeration order isn't guaranteed to be the same everywhere
+	std::vector<String> paths;
+	for (auto& i: asset.inputFiles) {
+		paths.push_back(i.first.toString());
+	}
+	std::sort(paths.begin(), paths.end());
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Hash::Hasher hasher;
+	hasher.feedBytes(gsl::as_bytes(gsl::span<const Byte>(Serializer::toBytes(asset.assetId))));
+	hasher.feed(int(asset.assetType));
+	for (auto& path: paths) {
+		hasher.feedBytes(gsl::as_bytes(gsl::span<const Byte>(Serializer::toBytes(path))));
+
+		auto iter = inputFiles.find(path);
+		if (iter != inputFiles.end()) {
+			hasher.feed(iter->second.hash);
+			hasher.feedBytes(gsl::as_bytes(gsl::span<const Byte>(Serializer::toBytes(iter->second.metadata))));
+		}
+	}
+	return hasher.digest();
+}
+
+bool ImportAssetsDatabase::needsImporting(const ImportAssetsDatabaseEntry& asset, const AssetImporter& importer) const
 {
 	std::lock_guard<std::mutex> lock(mutex);
 	
@@ -168,15 +208,14 @@ bool ImportAssetsDatabase::needsImporting(const ImportAssetsDatabaseEntry& asset
 		return true;
 	}
 
-	// Any of the input files changed?
-	// Note: We don't have to check old files on new input, because the size matches and all entries matched.
-	for (auto& i: asset.inputFiles) {
-		auto result = std::find_if(oldAsset.inputFiles.begin(), oldAsset.inputFiles.end(), [&](const TimestampedPath& entry) { return entry.first == i.first; });
-		if (result == oldAsset.inputFiles.end()) {
-			// File wasn't there before
-			return true;
-		} else if (result->second != i.second) {
-			// Timestamp changed
+	// Any of the input files changed? Timestamps alone don't count, so touching files or switching branches back and forth doesn't reimport
+	if (asset.inputHash != oldAsset.inputHash) {
+		return true;
+	}
+
+	// Any of the importers changed?
+	for (auto& v: oldAsset.importerVersions) {
+		if (importer.getImporterVersion(v.first) != v.second) {
 			return true;
 		}
 	}
@@ -259,6 +298,7 @@ std::vector<ImportAssetsDatabaseEntry> ImportAssetsDatabase::getAllMissing() con
 
 std::vector<AssetResource> ImportAssetsDatabase::getOutFiles(String assetId) const
 {
+	std::lock_guard<std::mutex> lock(mutex);
 	auto iter = assetsImported.find(assetId);
 	if (iter != assetsImported.end()) {
 		return iter->second.asset.outputFiles;
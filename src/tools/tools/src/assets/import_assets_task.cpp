@@ -11,9 +11,110 @@
 #include "halley/support/logger.h"
 #include "halley/time/stopwatch.h"
 #include "halley/support/debug.h"
+#include "halley/utils/hash.h"
+#include "halley/support/profiler.h"
+#include <condition_variable>
+#include <algorithm>
 
 using namespace Halley;
 
+namespace Halley {
+	// Writes import outputs on a thread of its own, so workers never wait on the disk.
+	// Everything queued while a batch is being written goes in the next batch, in the order it was queued.
+	class ImportAssetsWriter
+	{
+	public:
+		constexpr static size_t maxQueuedBytes = 256 * 1024 * 1024;
+
+		ImportAssetsWriter()
+		{
+			thread = std::thread([this] () { run(); });
+		}
+
+		~ImportAssetsWriter()
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			condition.notify_all();
+			thread.join();
+		}
+
+		// Blocks while too much is queued, so a slow disk doesn't make memory usage balloon
+		void enqueue(size_t bytes, std::function<void()> operation)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (queuedBytes > 0 && queuedBytes + bytes > maxQueuedBytes) {
+				drained.wait(lock);
+			}
+			queue.emplace_back(bytes, std::move(operation));
+			queuedBytes += bytes;
+			condition.notify_all();
+		}
+
+		void flush()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!queue.empty() || writing) {
+				drained.wait(lock);
+			}
+		}
+
+	private:
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::condition_variable drained;
+		std::vector<std::pair<size_t, std::function<void()>>> queue;
+		size_t queuedBytes = 0;
+		bool writing = false;
+		bool stopping = false;
+
+		void run()
+		{
+			Profiler::setThreadName("Asset writer");
+
+			std::vector<std::pair<size_t, std::function<void()>>> batch;
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true) {
+				while (queue.empty() && !stopping) {
+					condition.wait(lock);
+				}
+				if (queue.empty()) {
+					return;
+				}
+
+				std::swap(batch, queue);
+				writing = true;
+				lock.unlock();
+
+				{
+					HALLEY_PROFILE_SCOPE("Write assets");
+					for (auto& op: batch) {
+						try {
+							op.second();
+						} catch (std::exception& e) {
+							Logger::logException(e);
+						}
+					}
+				}
+
+				size_t written = 0;
+				for (auto& op: batch) {
+					written += op.first;
+				}
+				batch.clear();
+
+				lock.lock();
+				queuedBytes -= written;
+				writing = false;
+				drained.notify_all();
+			}
+		}
+	};
+}
+
 ImportAssetsTask::ImportAssetsTask(String taskName, ImportAssetsDatabase& db, const AssetImporter& importer, Path assetsPath, Vector<ImportAssetsDatabaseEntry> files, std::vector<String> deletedAssets, Project& project, bool packAfter)
 	: EditorTask(taskName, true, true)
 	, db(db)
@@ -26,46 +127,85 @@ ImportAssetsTask::ImportAssetsTask(String taskName, ImportAssetsDatabase& db, co
 	, totalImportTime(0)
 {}
 
+ImportAssetsTask::~ImportAssetsTask() = default;
+
+bool ImportAssetsTask::ImportNode::operator<(const ImportNode& other) const
+{
+	// Biggest assets first, as they're the ones that would otherwise be left running on their own at the end.
+	// Within the same asset, finish what's been started before anything else, so its memory can be released.
+	if (state->inputSize != other.state->inputSize) {
+		return state->inputSize < other.state->inputSize;
+	}
+	if (depth != other.depth) {
+		return depth < other.depth;
+	}
+	return order > other.order;
+}
+
 void ImportAssetsTask::run()
 {
 	Stopwatch timer;
 	using namespace std::chrono_literals;
-	auto lastSave = std::chrono::steady_clock::now();
 
 	assetsImported = 0;
+	assetsFromCache = 0;
 	assetsToImport = files.size();
-	std::vector<Future<void>> tasks;
+	parallelImport = !Debug::isDebug() && Executors::getCPUAux().threadCount() > 0;
+	writer = std::make_unique<ImportAssetsWriter>();
 
-	constexpr bool parallelImport = !Debug::isDebug();
-
-	for (size_t i = 0; i < files.size(); ++i) {
-		auto importFunc = [&, i] () {
-			if (isCancelled()) {
-				return;
-			}
+	// Sizes of the inputs are only an estimate of how long each will take, but it's a good one for the assets that matter (big images and audio)
+	for (auto& file: files) {
+		auto state = std::make_unique<AssetState>(file);
+		for (auto& f: file.inputFiles) {
+			const auto path = file.srcDir / f.first;
+			state->inputSize += FileSystem::exists(path) ? FileSystem::fileSize(path) : 0;
+		}
 
-			if (importAsset(files[i])) {
-				++assetsImported;
-				setProgress(float(assetsImported) * 0.98f / float(assetsToImport), files[i].assetId);
-			}
+		auto node = std::make_unique<ImportNode>();
+		node->state = state.get();
+		node->isRoot = true;
+		node->asset.assetId = file.assetId;
+		node->asset.assetType = file.assetType;
+		assetStates.push_back(std::move(state));
+		scheduleNode(std::move(node));
+	}
 
-			auto now = std::chrono::steady_clock::now();
-			if (now - lastSave > 1s) {
-				db.save();
-				lastSave = now;
-			}
-		};
+	// Save progress every now and then, so it isn't all lost if the editor is closed halfway through
+	// Assets are only marked as imported once the writer is done with their files, so this never saves one whose outputs are missing
+	auto lastSave = std::chrono::steady_clock::now();
+	auto saveIfDue = [&] ()
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (now - lastSave > 1s) {
+			db.save();
+			lastSave = now;
+		}
+	};
 
-		if (parallelImport) {
-			tasks.push_back(Concurrent::execute(Executors::getCPUAux(), importFunc));
-		} else {
-			importFunc();
+	if (parallelImport) {
+		std::unique_lock<std::mutex> lock(nodesMutex);
+		while (nodesPending > 0) {
+			nodesDone.wait_for(lock, 100ms);
+			lock.unlock();
+			saveIfDue();
+			lock.lock();
+		}
+	} else {
+		while (runNextNode()) {
+			saveIfDue();
 		}
 	}
 
-	Concurrent::whenAll(tasks.begin(), tasks.end()).get();
+	writer->flush();
+	writer.reset();
+	assetStates.clear();
 	db.save();
 
+	// Only imports that weren't restored from it add to the cache
+	if (assetsImported > assetsFromCache) {
+		project.getImportAssetsCache().trim();
+	}
+
 	if (!isCancelled()) {
 		setProgress(1.0f, "");
 
@@ -77,106 +217,307 @@ void ImportAssetsTask::run()
 	timer.pause();
 	Time realTime = timer.elapsedNanoSeconds() / 1000000000.0;
 	Time importTime = totalImportTime / 1000000000.0;
-	Logger::logInfo("Import took " + toString(realTime) + " seconds, on which " + toString(importTime) + " seconds of work were performed (" + toString(importTime / realTime) + "x realtime)");
+	Logger::logInfo("Import took " + toString(realTime) + " seconds, on which " + toString(importTime) + " seconds of work were performed (" + toString(importTime / realTime) + "x realtime), " + toString(size_t(assetsFromCache)) + " assets were restored from the import cache");
+}
+
+void ImportAssetsTask::scheduleNode(std::unique_ptr<ImportNode> node)
+{
+	++nodesPending;
+	{
+		std::unique_lock<std::mutex> lock(nodesMutex);
+		node->order = nextNodeOrder++;
+		readyNodes.push_back(std::move(node));
+		std::push_heap(readyNodes.begin(), readyNodes.end(), [] (const std::unique_ptr<ImportNode>& a, const std::unique_ptr<ImportNode>& b) { return *a < *b; });
+	}
+
+	// Each task runs whichever node is the most important when it starts, not necessarily this one
+	if (parallelImport) {
+		Concurrent::execute(Executors::getCPUAux(), [this] () { runNextNode(); });
+	}
+}
+
+bool ImportAssetsTask::runNextNode()
+{
+	std::unique_ptr<ImportNode> node;
+	{
+		std::unique_lock<std::mutex> lock(nodesMutex);
+		if (readyNodes.empty()) {
+			return false;
+		}
+		std::pop_heap(readyNodes.begin(), readyNodes.end(), [] (const std::unique_ptr<ImportNode>& a, const std::unique_ptr<ImportNode>& b) { return *a < *b; });
+		node = std::move(readyNodes.back());
+		readyNodes.pop_back();
+	}
+
+	// Any nodes generated by this one have already been scheduled, so this only reaches zero once everything is done.
+	// Done under the lock, so run() can't return (and destroy this) before we're finished with it.
+	// It has to happen whatever goes wrong, or run() would wait for this node forever.
+	auto done = gsl::finally([this] ()
+	{
+		std::unique_lock<std::mutex> lock(nodesMutex);
+		if (--nodesPending == 0) {
+			nodesDone.notify_all();
+		}
+	});
+
+	// Importer failures are handled by runNode; this is for its bookkeeping (the database, the writer) failing,
+	// which would otherwise escape a task nobody waits on
+	try {
+		runNode(*node);
+	} catch (std::exception& e) {
+		addError("\"" + node->state->asset.assetId + "\" - " + e.what());
+	} catch (...) {
+		addError("\"" + node->state->asset.assetId + "\" - unknown error");
+	}
+	node.reset();
+
+	return true;
 }
 
-bool ImportAssetsTask::importAsset(ImportAssetsDatabaseEntry& asset)
+void ImportAssetsTask::runNode(ImportNode& node)
 {
-	Logger::logInfo("Importing " + asset.assetId);
+	auto& state = *node.state;
+	auto& asset = state.asset;
+
+	{
+		std::unique_lock<std::mutex> lock(state.mutex);
+		if (state.failed || isCancelled()) {
+			lock.unlock();
+			finishNode(state);
+			return;
+		}
+	}
+
+	HALLEY_PROFILE_SCOPE("Import asset", Profiler::isEnabled() ? Profiler::intern(node.asset.assetId) : nullptr);
 	Stopwatch timer;
 
-	std::vector<AssetResource> out;
-	std::vector<std::pair<Path, Bytes>> outFiles;
-	std::vector<TimestampedPath> additionalInputs;
 	try {
-		// Create queue
-		std::list<ImportingAsset> toLoad;
-
-		// Load files from disk
-		ImportingAsset importingAsset;
-		importingAsset.assetId = asset.assetId;
-		importingAsset.assetType = asset.assetType;
-		for (auto& f: asset.inputFiles) {
-			auto meta = db.getMetadata(f.first);
-			importingAsset.inputFiles.emplace_back(ImportingAssetFile(f.first, FileSystem::readFile(asset.srcDir / f.first), meta ? meta.get() : Metadata()));
-		}
-		toLoad.emplace_back(std::move(importingAsset));
-
-		// Import
-		while (!toLoad.empty()) {
-			auto cur = std::move(toLoad.front());
-			toLoad.pop_front();
-			
-			AssetCollector collector(cur, assetsPath, importer.getAssetsSrc(), [=] (float assetProgress, const String& label) -> bool
+		if (node.isRoot) {
+			Logger::logInfo("Importing " + asset.assetId);
+
+			// Codegen writes straight into its destination, so there's nothing to cache
+			auto& cache = project.getImportAssetsCache();
+			state.useCache = cache.isEnabled() && asset.assetType != ImportAssetType::Codegen;
+			if (state.useCache) {
+				state.cacheKey = getCacheKey(asset);
+				std::vector<TimestampedPath> additionalInputs;
+				auto cached = getCachedImport(state.cacheKey, additionalInputs);
+				if (cached) {
+					Logger::logInfo("- " + asset.assetId + " restored from import cache");
+					std::unique_lock<std::mutex> lock(state.mutex);
+					state.fromCache = true;
+					state.out = std::move(cached->outputs);
+					state.outFiles = std::move(cached->outFiles);
+					state.importerVersions = std::move(cached->importerVersions);
+					state.additionalInputs = std::move(additionalInputs);
+					++assetsFromCache;
+				}
+			}
+
+			// Load files from disk
+			if (!state.fromCache) {
+				for (auto& f: asset.inputFiles) {
+					auto meta = db.getMetadata(f.first);
+					node.asset.inputFiles.emplace_back(ImportingAssetFile(f.first, FileSystem::readFile(asset.srcDir / f.first), meta ? meta.get() : Metadata()));
+				}
+			}
+		}
+
+		if (!state.fromCache) {
+			AssetCollector collector(node.asset, assetsPath, importer.getAssetsSrc(), [=] (float assetProgress, const String& label) -> bool
 			{
 				//setProgress(lerp(curFileProgressStart, curFileProgressEnd, assetProgress), curFileLabel + " " + label);
 				return !isCancelled();
 			});
 
-			for (auto& importer: importer.getImporters(cur.assetType)) {
-				importer.get().import(cur, collector);
-			}
-			
-			for (auto& additional: collector.collectAdditionalAssets()) {
-				toLoad.emplace_front(std::move(additional));
+			for (auto& importer: importer.getImporters(node.asset.assetType)) {
+				importer.get().import(node.asset, collector);
 			}
 
-			for (auto& outFile: collector.collectOutFiles()) {
-				outFiles.push_back(std::move(outFile));
-			}
+			{
+				std::unique_lock<std::mutex> lock(state.mutex);
+				state.importerVersions[node.asset.assetType] = importer.getImporterVersion(node.asset.assetType);
 
-			for (auto& o: collector.getAssets()) {
-				out.push_back(o);
+				for (auto& outFile: collector.collectOutFiles()) {
+					state.outFiles.push_back(std::move(outFile));
+				}
+
+				for (auto& o: collector.getAssets()) {
+					state.out.push_back(o);
+				}
+
+				for (auto& i: collector.getAdditionalInputs()) {
+					state.additionalInputs.push_back(i);
+				}
+
+				for (auto& i: collector.getAdditionalInputHashes()) {
+					state.additionalInputHashes.push_back(i);
+				}
 			}
 
-			for (auto& i: collector.getAdditionalInputs()) {
-				additionalInputs.push_back(i);
+			// Generated assets (e.g. the images of a spritesheet, then their textures) can go on other threads
+			for (auto& additional: collector.collectAdditionalAssets()) {
+				auto child = std::make_unique<ImportNode>();
+				child->state = &state;
+				child->asset = std::move(additional);
+				child->depth = node.depth + 1;
+				++state.pendingNodes;
+				scheduleNode(std::move(child));
 			}
 		}
 	} catch (std::exception& e) {
-		addError("\"" + asset.assetId + "\" - " + e.what());
-		asset.additionalInputFiles = std::move(additionalInputs);
-		db.markFailed(asset);
+		std::unique_lock<std::mutex> lock(state.mutex);
+		if (!state.failed) {
+			state.failed = true;
+			state.error = e.what();
+		}
+	}
 
-		return false;
+	timer.pause();
+	totalImportTime += timer.elapsedNanoSeconds();
+
+	finishNode(state);
+}
+
+void ImportAssetsTask::finishNode(AssetState& state)
+{
+	if (--state.pendingNodes == 0) {
+		finishAsset(state);
+	}
+}
+
+void ImportAssetsTask::finishAsset(AssetState& state)
+{
+	// Every node is done, so nothing else touches the state anymore
+	auto& asset = state.asset;
+
+	if (state.failed) {
+		addError("\"" + asset.assetId + "\" - " + state.error);
+		asset.additionalInputFiles = std::move(state.additionalInputs);
+		asset.importerVersions = std::move(state.importerVersions);
+		db.markFailed(asset);
+		return;
 	}
 
 	// Check if it didn't get cancelled
 	if (isCancelled()) {
-		return false;
+		return;
 	}
 
+	auto& outFiles = state.outFiles;
+
 	// Retrieve previous output from this asset, and remove any files which went missing
 	auto previous = db.getOutFiles(asset.assetId);
 	for (auto& f: previous) {
 		for (auto& v: f.platformVersions) {
 			if (std::find_if(outFiles.begin(), outFiles.end(), [&] (const std::pair<Path, Bytes>& r) { return r.first == v.second.filepath; }) == outFiles.end()) {
 				// File no longer exists as part of this asset, remove it
-				FileSystem::remove(assetsPath / v.second.filepath);
+				const auto path = assetsPath / v.second.filepath;
+				writer->enqueue(0, [path] () { FileSystem::remove(path); });
 			}
 		}
 	}
 
-	// Write files
+	// Write files, and store them in the cache, for other checkouts or for when this input comes back
+	size_t totalSize = 0;
 	for (auto& outFile: outFiles) {
-		auto path = assetsPath / outFile.first;
-		Logger::logInfo("- " + asset.assetId + " -> " + path + " (" + String::prettySize(outFile.second.size()) + ")");
-		FileSystem::writeFile(path, outFile.second);
+		Logger::logInfo("- " + asset.assetId + " -> " + (assetsPath / outFile.first) + " (" + String::prettySize(outFile.second.size()) + ")");
+		totalSize += outFile.second.size();
 	}
 
+	// Shared, as std::function needs to be copyable
+	auto entry = std::make_shared<ImportAssetsCacheEntry>();
+	entry->importerVersions = state.importerVersions;
+	entry->additionalInputs = std::move(state.additionalInputHashes);
+	entry->outputs = state.out;
+	entry->outFiles = std::move(outFiles);
+	const bool storeInCache = state.useCache && !state.fromCache;
+	const auto cacheKey = state.cacheKey;
+	auto& cache = project.getImportAssetsCache();
+	auto dstPath = assetsPath;
+
 	// Add to list of output assets
-	for (auto& o: out) {
+	{
 		std::unique_lock<std::mutex> lock(mutex);
-		outputAssets.insert(toString(o.type) + ":" + o.name);
+		for (auto& o: state.out) {
+			outputAssets.insert(toString(o.type) + ":" + o.name);
+		}
 	}
 
-	// Store output in db
-	asset.additionalInputFiles = std::move(additionalInputs);
-	asset.outputFiles = std::move(out);
-	db.markAsImported(asset);
+	// Store output in db, but only once the files are on disk, or an interrupted import would leave it marked as up to date.
+	// If writing fails, the asset is never marked, and gets imported again next time.
+	asset.additionalInputFiles = std::move(state.additionalInputs);
+	asset.outputFiles = std::move(state.out);
+	asset.importerVersions = std::move(state.importerVersions);
+	writer->enqueue(totalSize, [this, entry, storeInCache, cacheKey, &cache, dstPath, &asset] ()
+	{
+		try {
+			for (auto& outFile: entry->outFiles) {
+				FileSystem::writeFile(dstPath / outFile.first, outFile.second);
+			}
+		} catch (std::exception& e) {
+			addError("\"" + asset.assetId + "\" - " + e.what());
+			return;
+		}
+		db.markAsImported(asset);
+		if (storeInCache) {
+			cache.put(cacheKey, *entry);
+		}
+	});
 
-	timer.pause();
-	totalImportTime += timer.elapsedNanoSeconds();
+	++assetsImported;
+	setProgress(float(assetsImported) * 0.98f / float(assetsToImport), asset.assetId);
+}
 
-	return true;
+uint64_t ImportAssetsTask::getCacheKey(const ImportAssetsDatabaseEntry& asset) const
+{
+	// Everything that decides what the import outputs. Importer code can change without any of the versions changing, so the build of this program goes in too.
+	Hash::Hasher hasher;
+	hasher.feed(asset.inputHash);
+	hasher.feed(importer.getImporterVersion(asset.assetType));
+	hasher.feed(ImportAssetsDatabase::getAssetVersion());
+	hasher.feed(ImportAssetsCache::getBuildId());
+	return hasher.digest();
+}
+
+Maybe<ImportAssetsCacheEntry> ImportAssetsTask::getCachedImport(uint64_t key, std::vector<TimestampedPath>& additionalInputs) const
+{
+	auto entry = project.getImportAssetsCache().get(key);
+	if (!entry) {
+		return {};
+	}
+
+	std::vector<TimestampedPath> inputs;
+	try {
+		// Importers further down the chain aren't part of the key
+		for (auto& v: entry->importerVersions) {
+			if (importer.getImporterVersion(v.first) != v.second) {
+				return {};
+			}
+		}
+
+		// Neither are the files they requested, so make sure those still match
+		for (auto& i: entry->additionalInputs) {
+			bool found = false;
+			for (auto& srcPath: importer.getAssetsSrc()) {
+				const auto f = srcPath / i.first;
+				if (FileSystem::exists(f)) {
+					if (Hash::hash(FileSystem::readFile(f)) != i.second) {
+						return {};
+					}
+					inputs.push_back(TimestampedPath(f, FileSystem::getLastWriteTime(f)));
+					found = true;
+					break;
+				}
+			}
+			if (!found) {
+				return {};
+			}
+		}
+	} catch (...) {
+		return {};
+	}
+
+	additionalInputs = std::move(inputs);
+	return entry;
 }
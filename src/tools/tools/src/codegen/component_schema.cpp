@@ -14,4 +14,6 @@ ComponentSchema::ComponentSchema(YAML::Node node)
 			members.emplace_back(VariableSchema(TypeSchema(m->second.as<std::string>()), m->first.as<std::string>()));
 		}
 	}
+
+	serializable = node["serializable"].as<bool>(false);
 }
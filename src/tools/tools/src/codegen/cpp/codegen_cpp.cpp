@@ -174,9 +174,26 @@ Vector<String> CodegenCPP::generateComponentHeader(ComponentSchema component)
 			.addConstructor(component.members);
 	}
 
+	if (component.serializable) {
+		// Used by World snapshots
+		String serializeBody = "s";
+		String deserializeBody = "s";
+		for (auto& member: component.members) {
+			serializeBody += " << " + member.name;
+			deserializeBody += " >> " + member.name;
+		}
+		gen.addBlankLine()
+			.addMethodDefinition(MethodSchema(TypeSchema("void"), { VariableSchema(TypeSchema("Halley::Serializer&"), "s") }, "serialize", true), component.members.empty() ? Vector<String>() : Vector<String>{ serializeBody + ";" })
+			.addBlankLine()
+			.addMethodDefinition(MethodSchema(TypeSchema("void"), { VariableSchema(TypeSchema("Halley::Deserializer&"), "s") }, "deserialize"), component.members.empty() ? Vector<String>() : Vector<String>{ deserializeBody + ";" });
+	}
+
 	gen.finish()
 		.writeTo(contents);
 
+	contents.push_back("");
+	contents.push_back("static_assert(" + component.name + "Component::componentIndex < Halley::FamilyMask::maxComponents, \"Too many component types, increase HALLEY_MAX_COMPONENTS\");");
+
 	return contents;
 }
 
@@ -284,15 +301,19 @@ Vector<String> CodegenCPP::generateSystemHeader(SystemSchema& system) const
 			return VariableSchema(TypeSchema(type, !comp.write), lowerFirst(comp.name));
 		});
 
+		// The family type decides which components the system writes, see SystemSchema::strictAccess
+		Vector<String> familyTypes;
+		for (auto& comp : fam.components) {
+			String type = String(comp.write || !system.strictAccess ? "" : "const ") + comp.name + "Component";
+			familyTypes.push_back(comp.optional ? "Halley::MaybeRef<" + type + ">" : type);
+		}
+
 		sysClassGen
 			.addClass(CPPClassGenerator(upperFirst(fam.name) + "Family", "Halley::FamilyBaseOf<" + upperFirst(fam.name) + "Family>")
 				.addAccessLevelSection(CPPAccess::Public)
 				.addMembers(members)
 				.addBlankLine()
-				.addTypeDefinition("Type", "Halley::FamilyType<" + String::concatList(convert<ComponentReferenceSchema, String>(fam.components, [](auto& comp)
-				{
-					return comp.optional ? "Halley::MaybeRef<" + comp.name + "Component>" : comp.name + "Component";
-				}), ", ") + ">")
+				.addTypeDefinition("Type", "Halley::FamilyType<" + String::concatList(familyTypes, ", ") + ">")
 				.addBlankLine()
 				.addAccessLevelSection(CPPAccess::Protected)
 				.addConstructor(members)
@@ -315,9 +336,11 @@ Vector<String> CodegenCPP::generateSystemHeader(SystemSchema& system) const
 	// Receive messages
 	bool hasReceive = false;
 	Vector<String> msgsReceived;
+	Vector<String> msgsSent;
 	for (auto& msg : system.messages) {
 		if (msg.send) {
 			sysClassGen.addMethodDefinition(MethodSchema(TypeSchema("void"), { VariableSchema(TypeSchema("Halley::EntityId"), "entityId"), VariableSchema(TypeSchema(msg.name + "Message&", true), "msg") }, "sendMessage"), "sendMessageGeneric(entityId, msg);");
+			msgsSent.push_back(msg.name + "Message::messageIndex");
 		}
 		if (msg.receive) {
 			hasReceive = true;
@@ -376,7 +399,7 @@ Vector<String> CodegenCPP::generateSystemHeader(SystemSchema& system) const
 
 	sysClassGen
 		.addAccessLevelSection(CPPAccess::Public)
-		.addCustomConstructor({}, { VariableSchema(TypeSchema(""), "System", "{" + String::concatList(convert<FamilySchema, String>(system.families, [](auto& fam) { return "&" + fam.name + "Family"; }), ", ") + "}, {" + String::concatList(msgsReceived, ", ") + "}") })
+		.addCustomConstructor({}, { VariableSchema(TypeSchema(""), "System", "{" + String::concatList(convert<FamilySchema, String>(system.families, [](auto& fam) { return "&" + fam.name + "Family"; }), ", ") + "}, {" + String::concatList(msgsReceived, ", ") + "}, {" + String::concatList(msgsSent, ", ") + "}") })
 		.finish()
 		.writeTo(contents);
 
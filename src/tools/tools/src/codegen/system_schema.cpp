@@ -80,6 +80,7 @@ SystemSchema::SystemSchema(YAML::Node node)
 	}
 
 	smearing = node["smearing"].as<int>(1);
+	strictAccess = node["strictAccess"].as<bool>(false);
 
 	if (node["access"].IsDefined()) {
 		int accessValue = 0;
@@ -1,41 +1,305 @@
 #include "halley/tools/distance_field/distance_field_generator.h"
-#include <cassert>
 #include <halley/file_formats/image.h>
+#include <halley/concurrency/concurrent.h>
 #include <gsl/gsl_assert>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <vector>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define HAS_SSE
+#include <emmintrin.h>
+#endif
 
 using namespace Halley;
 
-static float getDistanceAt(const int* src, int srcW, int srcH, int xCentre, int yCentre, float radius)
-{
-	auto getAlpha = [&](int x, int y) { return (src[x + y * srcW] & 0xFF000000) >> 24; };
-	bool isInside = getAlpha(xCentre, yCentre) > 127;
-	if (radius < 0.001f) {
-		return isInside ? 1.0f : 0.0f;
+// Each source pixel gets the squared distance to the closest pixel of the opposite value (inside being alpha > 127), found with an
+// exact Euclidean distance transform (Meijster et al.): a pass down each column, then a lower envelope of parabolas along each row.
+// The distance field itself only ever looked as far as a square window of radius pixels, though, and the average over each texel
+// depends on what's reported beyond that; so pixels further than the radius from the closest one get the minimum over that window instead.
+
+namespace {
+	// Reported when there's nothing of the opposite value within the window
+	constexpr int noDistance = std::numeric_limits<int>::max();
+
+	// Column distance when there's nothing of that value in the whole column; still leaves room to add the height of the image
+	constexpr int32_t farAway = 1 << 20;
+
+	// Window minimum for columns with nothing within the radius; as the radius is under 32768, adding the square of a horizontal offset can't overflow
+	constexpr int32_t noCandidate = 1 << 30;
+
+	constexpr int columnsPerTask = 64;
+	constexpr int minPixelsForThreading = 128 * 128;
+
+	inline int32_t isInside(int pixel)
+	{
+		return ((pixel >> 24) & 0xFF) > 127 ? -1 : 0;
+	}
+
+	float getDistanceValue(int distSqr, bool isInside, float radius)
+	{
+		const float dist = float(sqrt(distSqr));
+		const float normalDistance = (2 * dist - 1) / (2 * radius);
+		return 0.5f * (isInside ? 1.0f + normalDistance : 1.0f - normalDistance);
+	}
+
+	float getDistanceAt(const int* src, int srcW, int srcH, int xCentre, int yCentre, float radius)
+	{
+		auto getAlpha = [&](int x, int y) { return (src[x + y * srcW] & 0xFF000000) >> 24; };
+		bool isInside = getAlpha(xCentre, yCentre) > 127;
+		if (radius < 0.001f) {
+			return isInside ? 1.0f : 0.0f;
+		}
+
+		int iRadius = int(ceil(radius));
+		int x0 = std::max(0, xCentre - iRadius);
+		int x1 = std::min(xCentre + iRadius, srcW - 1);
+		int y0 = std::max(0, yCentre - iRadius);
+		int y1 = std::min(yCentre + iRadius, srcH - 1);
+
+		int bestDistSqr = noDistance;
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				bool thisInside = getAlpha(x, y) > 127;
+				if (isInside != thisInside) {
+					// Candidate for best neighbour
+					int distSqr = (x - xCentre) * (x - xCentre) + (y - yCentre) * (y - yCentre);
+					bestDistSqr = std::min(distSqr, bestDistSqr);
+				}
+			}
+		}
+
+		return getDistanceValue(bestDistSqr, isInside, radius);
+	}
+
+	template <typename F>
+	void forEachRange(int n, int rangeSize, bool parallel, F f)
+	{
+		const int nRanges = (n + rangeSize - 1) / rangeSize;
+		if (!parallel || nRanges <= 1) {
+			f(0, n);
+			return;
+		}
+
+		std::vector<int> ranges(nRanges);
+		std::iota(ranges.begin(), ranges.end(), 0);
+		Concurrent::foreach(ranges.begin(), ranges.end(), [&] (int i)
+		{
+			f(i * rangeSize, std::min(n, (i + 1) * rangeSize));
+		});
+	}
+
+#ifdef HAS_SSE
+	inline __m128i min32(__m128i a, __m128i b)
+	{
+		// _mm_min_epi32 needs SSE4.1
+		const __m128i aLess = _mm_cmplt_epi32(a, b);
+		return _mm_or_si128(_mm_and_si128(aLess, a), _mm_andnot_si128(aLess, b));
 	}
+#endif
 
-	int iRadius = int(ceil(radius));
-	int x0 = std::max(0, xCentre - iRadius);
-	int x1 = std::min(xCentre + iRadius, srcW - 1);
-	int y0 = std::max(0, yCentre - iRadius);
-	int y1 = std::min(yCentre + iRadius, srcH - 1);
-
-	int bestDistSqr = 2147483647;
-	for (int y = y0; y <= y1; y++) {
-		for (int x = x0; x <= x1; x++) {
-			bool thisInside = getAlpha(x, y) > 127;
-			if (isInside != thisInside) {
-				// Candidate for best neighbour
-				int distSqr = (x - xCentre) * (x - xCentre) + (y - yCentre) * (y - yCentre);
-				bestDistSqr = std::min(distSqr, bestDistSqr);
+	// Vertical distance to the closest pixel inside (toInside) and outside (toOutside), for columns [x0, x1).
+	// Goes a whole row at a time, so the inner loops run over contiguous memory.
+	void columnPass(const int* src, int32_t* toInside, int32_t* toOutside, int w, int h, int x0, int x1)
+	{
+		// Top to bottom
+		for (int y = 0; y < h; ++y) {
+			const int* row = src + y * w;
+			int32_t* in = toInside + y * w;
+			int32_t* out = toOutside + y * w;
+			const int32_t* prevIn = y > 0 ? in - w : nullptr;
+			const int32_t* prevOut = y > 0 ? out - w : nullptr;
+
+			int x = x0;
+#ifdef HAS_SSE
+			const __m128i one = _mm_set1_epi32(1);
+			const __m128i threshold = _mm_set1_epi32(127);
+			const __m128i far = _mm_set1_epi32(farAway);
+			for (; x + 4 <= x1; x += 4) {
+				const __m128i alpha = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x)), 24);
+				const __m128i inside = _mm_cmpgt_epi32(alpha, threshold);
+				const __m128i nextIn = prevIn ? _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prevIn + x)), one) : far;
+				const __m128i nextOut = prevOut ? _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prevOut + x)), one) : far;
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(in + x), _mm_andnot_si128(inside, nextIn));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_and_si128(inside, nextOut));
+			}
+#endif
+			for (; x < x1; ++x) {
+				const int32_t inside = isInside(row[x]);
+				in[x] = (prevIn ? prevIn[x] + 1 : farAway) & ~inside;
+				out[x] = (prevOut ? prevOut[x] + 1 : farAway) & inside;
+			}
+		}
+
+		// Bottom to top
+		for (int y = h - 2; y >= 0; --y) {
+			int32_t* in = toInside + y * w;
+			int32_t* out = toOutside + y * w;
+			const int32_t* nextIn = in + w;
+			const int32_t* nextOut = out + w;
+
+			int x = x0;
+#ifdef HAS_SSE
+			const __m128i one = _mm_set1_epi32(1);
+			for (; x + 4 <= x1; x += 4) {
+				auto curIn = reinterpret_cast<__m128i*>(in + x);
+				auto curOut = reinterpret_cast<__m128i*>(out + x);
+				_mm_storeu_si128(curIn, min32(_mm_loadu_si128(curIn), _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(nextIn + x)), one)));
+				_mm_storeu_si128(curOut, min32(_mm_loadu_si128(curOut), _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(nextOut + x)), one)));
+			}
+#endif
+			for (; x < x1; ++x) {
+				in[x] = std::min(in[x], nextIn[x] + 1);
+				out[x] = std::min(out[x], nextOut[x] + 1);
 			}
 		}
 	}
 
-	const float dist = float(sqrt(bestDistSqr));
-	const float normalDistance = (2 * dist - 1) / (2 * radius);
-	const float finalValue = 0.5f * (isInside ? 1.0f + normalDistance : 1.0f - normalDistance);
+	class RowPass
+	{
+	public:
+		RowPass(int w, int radius)
+			: w(w)
+			, radius(radius)
+			, s(w)
+			, t(w)
+			, toInside(w)
+			, toOutside(w)
+			, result(w)
+			, candidatesInside(w)
+			, candidatesOutside(w)
+			, countInside(w + 1)
+			, countOutside(w + 1)
+			, offsetSqr(2 * radius + 1)
+		{
+			for (int i = -radius; i <= radius; ++i) {
+				offsetSqr[i + radius] = i * i;
+			}
+		}
+
+		// Replaces the column distances to inside pixels with the final squared distance of each pixel in the row
+		void run(const int* src, int32_t* columnToInside, const int32_t* columnToOutside)
+		{
+			transform(columnToInside, toInside);
+			transform(columnToOutside, toOutside);
+
+			bool prepared = false;
+			const int64_t radiusSqr = int64_t(radius) * int64_t(radius);
+			for (int x = 0; x < w; ++x) {
+				const bool inside = isInside(src[x]) != 0;
+				const int64_t distSqr = inside ? toOutside[x] : toInside[x];
+				if (distSqr <= radiusSqr) {
+					result[x] = int32_t(distSqr);
+				} else {
+					if (!prepared) {
+						prepare(columnToInside, columnToOutside);
+						prepared = true;
+					}
+					result[x] = inside ? getWindowMinimum(x, candidatesOutside, countOutside) : getWindowMinimum(x, candidatesInside, countInside);
+				}
+			}
+			std::copy(result.begin(), result.end(), columnToInside);
+		}
+
+	private:
+		const int w;
+		const int radius;
+		std::vector<int> s;
+		std::vector<int> t;
+		std::vector<int64_t> toInside;
+		std::vector<int64_t> toOutside;
+		std::vector<int32_t> result;
+		std::vector<int32_t> candidatesInside;
+		std::vector<int32_t> candidatesOutside;
+		std::vector<int> countInside;
+		std::vector<int> countOutside;
+		std::vector<int32_t> offsetSqr;
+
+		// Squared distance to the closest pixel of each column, along the row
+		void transform(const int32_t* g, std::vector<int64_t>& dst)
+		{
+			auto f = [&] (int64_t x, int i) { return (x - i) * (x - i) + int64_t(g[i]) * int64_t(g[i]); };
+			auto sep = [&] (int64_t i, int64_t u)
+			{
+				const int64_t num = u * u - i * i + int64_t(g[u]) * int64_t(g[u]) - int64_t(g[i]) * int64_t(g[i]);
+				const int64_t den = 2 * (u - i);
+				return num >= 0 ? num / den : -((-num + den - 1) / den); // Rounds down
+			};
+
+			int q = 0;
+			s[0] = 0;
+			t[0] = 0;
+			for (int u = 1; u < w; ++u) {
+				while (q >= 0 && f(t[q], s[q]) > f(t[q], u)) {
+					--q;
+				}
+				if (q < 0) {
+					q = 0;
+					s[0] = u;
+				} else {
+					const int64_t start = 1 + sep(s[q], u);
+					if (start < w) {
+						++q;
+						s[q] = u;
+						t[q] = int(start);
+					}
+				}
+			}
+
+			for (int u = w - 1; u >= 0; --u) {
+				dst[u] = f(u, s[q]);
+				if (u == t[q]) {
+					--q;
+				}
+			}
+		}
+
+		void prepare(const int32_t* columnToInside, const int32_t* columnToOutside)
+		{
+			auto prepareOne = [&] (const int32_t* g, std::vector<int32_t>& candidates, std::vector<int>& count)
+			{
+				count[0] = 0;
+				for (int x = 0; x < w; ++x) {
+					const bool inWindow = g[x] <= radius;
+					candidates[x] = inWindow ? g[x] * g[x] : noCandidate;
+					count[x + 1] = count[x] + (inWindow ? 1 : 0);
+				}
+			};
+			prepareOne(columnToInside, candidatesInside, countInside);
+			prepareOne(columnToOutside, candidatesOutside, countOutside);
+		}
+
+		int getWindowMinimum(int x, const std::vector<int32_t>& candidates, const std::vector<int>& count) const
+		{
+			const int x0 = std::max(0, x - radius);
+			const int x1 = std::min(w - 1, x + radius);
+			if (count[x1 + 1] == count[x0]) {
+				return noDistance;
+			}
 
-	return finalValue;
+			const int32_t* c = candidates.data() + x0;
+			const int32_t* o = offsetSqr.data() + (x0 - x + radius);
+			const int n = x1 - x0 + 1;
+			int32_t best = noCandidate;
+			int i = 0;
+#ifdef HAS_SSE
+			__m128i best4 = _mm_set1_epi32(noCandidate);
+			for (; i + 4 <= n; i += 4) {
+				const __m128i sum = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(o + i)));
+				best4 = min32(best4, sum);
+			}
+			alignas(16) int32_t lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), best4);
+			best = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+#endif
+			for (; i < n; ++i) {
+				best = std::min(best, c[i] + o[i]);
+			}
+			return best;
+		}
+	};
 }
 
 std::unique_ptr<Image> DistanceFieldGenerator::generate(Image& srcImg, Vector2i size, float radius)
@@ -54,12 +318,82 @@ std::unique_ptr<Image> DistanceFieldGenerator::generate(Image& srcImg, Vector2i
 	int texelW = srcW / w;
 	int texelH = srcH / h;
 
+	const float srcRadius = radius * srcW / w;
+	const bool parallel = srcW * srcH >= minPixelsForThreading;
+
+	// Squared distance for each source pixel, see the top of the file
+	std::vector<int32_t> distSqr;
+	if (srcRadius >= 0.001f) {
+		Expects(srcW < 32768 && srcH < 32768);
+		const int windowRadius = std::min(int(ceil(srcRadius)), std::max(srcW, srcH)); // The window never goes past the image anyway
+
+		distSqr.resize(size_t(srcW) * size_t(srcH));
+		std::vector<int32_t> toOutside(distSqr.size());
+		forEachRange(srcW, columnsPerTask, parallel, [&] (int x0, int x1)
+		{
+			columnPass(src, distSqr.data(), toOutside.data(), srcW, srcH, x0, x1);
+		});
+
+		const int rowsPerTask = std::max(1, minPixelsForThreading / std::max(1, srcW));
+		forEachRange(srcH, rowsPerTask, parallel, [&] (int y0, int y1)
+		{
+			RowPass pass(srcW, windowRadius);
+			for (int y = y0; y < y1; ++y) {
+				pass.run(src + y * srcW, distSqr.data() + y * srcW, toOutside.data() + y * srcW);
+			}
+		});
+	}
+
+	const int dstRowsPerTask = std::max(1, minPixelsForThreading / std::max(1, w * texelW * texelH));
+	forEachRange(h, dstRowsPerTask, parallel, [&] (int y0, int y1)
+	{
+		for (int y = y0; y < y1; y++) {
+			for (int x = 0; x < w; x++) {
+				int* dst = dstStart + x + y * w;
+				float distAcc = 0;
+				// For each sub-pixel, compute the distance to closest pixel of the opposite value
+				// Then average it all
+				for (int j = 0; j < texelH; j++) {
+					for (int i = 0; i < texelW; i++) {
+						const int srcX = x * srcW / w + i;
+						const int srcY = y * srcH / h + j;
+						const bool inside = isInside(src[srcX + srcY * srcW]) != 0;
+						if (distSqr.empty()) {
+							distAcc += inside ? 1.0f : 0.0f;
+						} else {
+							distAcc += getDistanceValue(distSqr[srcX + srcY * srcW], inside, srcRadius);
+						}
+					}
+				}
+				int distance = clamp(int(distAcc * 255 / (texelW * texelH)), 0, 255);
+				*dst = Image::convertRGBAToInt(255, 255, 255, distance);
+			}
+		}
+	});
+
+	return dstImg;
+}
+
+std::unique_ptr<Image> DistanceFieldGenerator::generateReference(Image& srcImg, Vector2i size, float radius)
+{
+	Expects(srcImg.getPixels() != nullptr);
+	const int srcW = srcImg.getWidth();
+	const int srcH = srcImg.getHeight();
+	const int* src = reinterpret_cast<int*>(srcImg.getPixels());
+
+	auto dstImg = std::make_unique<Image>(Image::Format::RGBA, size);
+
+	const int w = size.x;
+	const int h = size.y;
+	int* dstStart = reinterpret_cast<int*>(dstImg->getPixels());
+
+	int texelW = srcW / w;
+	int texelH = srcH / h;
+
 	for (int y = 0; y < h; y++) {
 		for (int x = 0; x < w; x++) {
 			int* dst = dstStart + x + y * w;
 			float distAcc = 0;
-			// For each sub-pixel, compute the distance to closest pixel of the opposite value
-			// Then average it all
 			for (int j = 0; j < texelH; j++) {
 				for (int i = 0; i < texelW; i++) {
 					distAcc += getDistanceAt(src, srcW, srcH, x * srcW / w + i, y * srcH / h + j, radius * srcW / w);
@@ -3,6 +3,7 @@
 #include <halley/file/path.h>
 #include "halley/os/os.h"
 #include "halley/maths/random.h"
+#include "halley/support/exception.h"
 #include <cstdio>
 
 using namespace Halley;
@@ -45,6 +46,13 @@ int64_t FileSystem::getLastWriteTime(const Path& p)
 	}
 }
 
+bool FileSystem::setLastWriteTime(const Path& p, int64_t time)
+{
+	boost::system::error_code ec;
+	last_write_time(getNative(p), std::time_t(time), ec);
+	return ec.value() == 0;
+}
+
 bool FileSystem::isFile(const Path& p)
 {
 	return is_regular_file(getNative(p));
@@ -68,12 +76,22 @@ bool FileSystem::remove(const Path& path)
 	return nRemoved > 0 && ec.value() == 0;
 }
 
+bool FileSystem::rename(const Path& src, const Path& dst)
+{
+	boost::system::error_code ec;
+	boost::filesystem::rename(getNative(src), getNative(dst), ec);
+	return ec.value() == 0;
+}
+
 void FileSystem::writeFile(const Path& path, gsl::span<const gsl::byte> data)
 {
 	createParentDir(path);
 	std::ofstream fp(path.string(), std::ios::binary | std::ios::out);
 	fp.write(reinterpret_cast<const char*>(data.data()), data.size());
 	fp.close();
+	if (!fp) {
+		throw Exception("Unable to write file: " + path, HalleyExceptions::Tools);
+	}
 }
 
 void FileSystem::writeFile(const Path& path, const Bytes& data)
@@ -1,4 +1,5 @@
 #include "halley/tools/assets/import_assets_database.h"
+#include "halley/tools/assets/import_assets_cache.h"
 #include "halley/tools/project/project.h"
 #include "halley/tools/file/filesystem.h"
 #include "halley/core/game/halley_statics.h"
@@ -13,6 +14,7 @@ Project::Project(std::vector<String> _platforms, Path projectRootPath, Path hall
 {
 	importAssetsDatabase = std::make_unique<ImportAssetsDatabase>(getUnpackedAssetsPath(), getUnpackedAssetsPath() / "import.db", getUnpackedAssetsPath() / "assets.db", platforms);
 	codegenDatabase = std::make_unique<ImportAssetsDatabase>(getGenPath(), getGenPath() / "import.db", getGenPath() / "assets.db", std::vector<String>{ "" });
+	importAssetsCache = std::make_unique<ImportAssetsCache>(ImportAssetsCache::getDefaultDirectory());
 	assetImporter = std::make_unique<AssetImporter>(*this, std::vector<Path>{getSharedAssetsSrcPath(), getAssetsSrcPath()});
 }
 
@@ -78,6 +80,11 @@ ImportAssetsDatabase& Project::getCodegenDatabase() const
 	return *codegenDatabase;
 }
 
+const ImportAssetsCache& Project::getImportAssetsCache() const
+{
+	return *importAssetsCache;
+}
+
 const AssetImporter& Project::getAssetImporter() const
 {
 	return *assetImporter;